@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdbool.h>
+
+// ============================================================
+// Anomaly detector benchmark
+//
+// Replays every pzem_emulator scenario (inrush, heater cycling, overload,
+// bolted short, brownout, thermal runaway, …) through the active rule
+// table and the real anomaly_analyze(), at the production cadence — fast
+// current-only polls between full reads — on simulated time, so a
+// minute of load takes milliseconds. Each scenario carries ground-truth
+// labels derived from its script and the protection limits in config.h,
+// independent of the rule table, so changing a rule changes the numbers.
+//
+// Reported per run:
+//   - sample confusion matrix, expected type (rows) × detected (columns)
+//   - per type: labelled episodes hit / missed, false onsets, false trips
+//   - detection delay per type: min / median / p95 / max
+//   - CPU time per anomaly_analyze() call (mean and worst)
+//   - learned scorer (anomaly_model.h): flagged windows per scenario under
+//     the active model, cost per reading and per window (kernel timed on
+//     a worst-case-size model), and its static memory
+//
+// Enabled with ANOMALY_BENCH_ENABLED; runs from app_main before any task
+// starts and leaves the detector reset.
+// ============================================================
+
+/**
+ * @brief Run the benchmark and log the report. Call after
+ *        anomaly_rules_init(), anomaly_detector_init() and anomaly_model_init().
+ * @return true if every labelled episode was detected and no onset tripped
+ *         the relay outside one.
+ */
+bool anomaly_bench_run(void);
@@ -3,55 +3,139 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include "pzem_sensor.h"
+#include "rolling_stats.h"
+#include "config.h"
 
-// Anomaly types in priority order
+// Anomaly types. Evaluation order comes from the rule table (anomaly_rules.h).
 typedef enum {
     ANOMALY_NONE        = 0,
     ANOMALY_SHORT_CIRCUIT,
     ANOMALY_OVERCURRENT,
+    ANOMALY_OVERPOWER,          // Meter's on-chip power alarm, sustained
     ANOMALY_WIRE_FIRE,
     ANOMALY_OVERVOLTAGE,
     ANOMALY_UNDERVOLTAGE,
+    ANOMALY_LOW_POWER_FACTOR,   // PF under load below the limit, sustained
+    ANOMALY_FREQUENCY,          // Frequency out of band or changing too fast
+    ANOMALY_TYPE_COUNT,
 } anomaly_type_t;
 
-// Internal state for sustained overcurrent detection
+// Episode transition an event reports
+typedef enum {
+    ANOMALY_PHASE_ONSET = 0,    // rule confirmed, episode opened
+    ANOMALY_PHASE_UPDATE,       // periodic rollup while it persists
+    ANOMALY_PHASE_CLEAR,        // condition gone for ANOMALY_CLEAR_HOLD_MS
+} anomaly_phase_t;
+
+// Internal confirm state of one rule on one channel.
+// Time-qualified rather than sample-counted so fast current-only polls and
+// full reads can be mixed without changing the confirm window.
 typedef struct {
-    uint8_t count;       // Consecutive readings above threshold
-    uint8_t threshold;   // Required count before triggering
-} overcurrent_state_t;
+    bool     above;          // Last evaluated sample met the condition
+    uint32_t above_since_ms; // Timestamp of the first sample in the current run
+    // Thermal (I²t) rules only
+    uint64_t heat;           // Accumulated (I² − Ir²)·dt, mA²·ms
+    uint32_t last_ms;        // Thermal: previous sample; ROCOF: reference sample (0 = none yet)
+    // Rate-of-change (ROCOF) rules only
+    uint32_t rate;           // |Δf|/Δt over the last closed window, 0.01 Hz/s
+    uint16_t ref_dhz;        // Frequency at last_ms
+} rule_confirm_state_t;
 
 // Internal state for wire fire (thermal runaway) detection
 typedef struct {
-    float    history[10];    // Rolling power history
-    uint8_t  head;           // Next write index
-    uint8_t  count;          // How many samples filled
-    float    baseline_power; // Adaptive baseline (W)
+    rolling_stats_t window;                    // Power over FIRE_HISTORY_SIZE full reads
+    uint32_t        samples[FIRE_HISTORY_SIZE];  // Window storage (0.1 W)
+    uint16_t        min_q[FIRE_HISTORY_SIZE];
+    uint16_t        max_q[FIRE_HISTORY_SIZE];
+    uint32_t        baseline_dw;               // Adaptive baseline (0.1 W)
+    uint32_t        last_dw;                   // Previous full read, for step detection
 } fire_detector_state_t;
 
-// An anomaly event produced when a problem is detected
+// Internal state of one anomaly type on one channel. The rollup is kept in
+// the native unit of the rule that opened the episode.
+typedef struct {
+    bool     active;
+    bool     clearing;       // Condition false, clear hold running
+    uint8_t  rule;           // Table index of the owning rule
+    uint8_t  metric;         // Copied from the owning rule so a table
+    uint8_t  severity;       //   swap cannot change a running episode
+    bool     trip;
+    uint32_t id;
+    uint32_t relay_trips;    // relay_get_trip_count() when the onset last went out
+    uint32_t onset_ms;       // First sample of the confirmed run
+    uint32_t last_ms;        // Last sample folded into the rollup
+    uint32_t report_ms;      // Last onset/update emitted
+    uint32_t clear_since_ms; // First sample of the current false run
+    uint32_t peak;
+    uint32_t min;
+    uint64_t integral;       // Σ value·dt (native unit·ms)
+} anomaly_episode_t;
+
+// An anomaly episode transition
 typedef struct {
     anomaly_type_t type;
-    float          i_rms;
-    float          v_rms;
-    float          power;
+    uint32_t       i_ma;         // Current (mA)
+    uint32_t       power_dw;     // Active power (0.1 W)
+    uint16_t       v_dv;         // Voltage (0.1 V)
     uint32_t       timestamp;
+    uint8_t        channel;      // Bus channel the triggering reading came from
+    uint8_t        severity;     // rule_severity_t of the rule that fired
     bool           relay_triggered;
+    // Episode rollup
+    uint8_t        phase;        // anomaly_phase_t
+    uint8_t        metric;       // rule_metric_t that peak/min/integral are in
+    uint32_t       episode_id;   // Same for onset, updates and clear
+    uint32_t       duration_ms;  // Onset to this sample (to the end on clear)
+    uint32_t       peak;         // Highest value of the metric so far
+    uint32_t       min;          // Lowest value of the metric so far
+    uint64_t       integral;     // Σ value·dt, native unit·ms
+    uint32_t       trip_latency_us; // Tripping onsets: reading complete → relay open
 } anomaly_event_t;
 
 /**
- * @brief Initialize the anomaly detector and log configured thresholds.
+ * @brief Initialize the anomaly detector and log the active rule table.
+ *        Call after anomaly_rules_init().
  */
 void anomaly_detector_init(void);
 
 /**
- * @brief Analyze a PZEM reading for anomalies.
- * @param data   Pointer to latest PZEM data.
- * @param event  Output event (populated only when return is true).
- * @return true if a critical anomaly was detected.
+ * @brief Analyze a PZEM reading against the active rule table in one pass.
+ *        Detector state is kept per bus channel (data->channel).
+ *        Fast-poll samples (data->current_only) evaluate only current rules;
+ *        events carry V/P from the channel's last full read.
+ *        Each anomaly type is tracked as an episode, and only its
+ *        transitions are returned — at most one per type per reading.
+ *        Transitions that do not fit in @p max_events are deferred to the
+ *        next reading.
+ * @param data        Pointer to latest PZEM data.
+ * @param events      Output array, ANOMALY_TYPE_COUNT entries is always enough.
+ * @param max_events  Capacity of @p events.
+ * @return Number of events written.
+ */
+uint8_t anomaly_analyze(const pzem_data_t *data, anomaly_event_t *events, uint8_t max_events);
+
+/**
+ * @brief Anomaly types with a trip rule confirmed on the channel's last
+ *        analyzed sample, one bit per anomaly_type_t. The caller trips the
+ *        relay whenever this is non-zero and the relay is not TRIPPED — not
+ *        only on onsets, so a relay closed again into a fault that never
+ *        cleared opens again.
+ * @param channel  Bus channel.
+ * @return Bit mask (1 << type), 0 if none.
  */
-bool anomaly_analyze(const pzem_data_t *data, anomaly_event_t *event);
+uint32_t anomaly_detector_trips_due(uint8_t channel);
 
 /**
- * @brief Reset internal detector state (overcurrent count, fire baseline).
+ * @brief Reset internal detector state (rule confirm timers, fire baseline)
+ *        on every channel. Thermal rules keep their accumulated heat, and
+ *        open episodes are kept so their clears are still reported.
+ *        Only from the task that calls anomaly_analyze — other tasks use
+ *        anomaly_detector_request_reset().
  */
 void anomaly_detector_reset(void);
+
+/**
+ * @brief Ask for anomaly_detector_reset() from any task. It runs at the
+ *        start of the next anomaly_analyze() call, in the sensing task.
+ */
+void anomaly_detector_request_reset(void);
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "cJSON.h"
+#include "pzem_sensor.h"
+#include "config.h"
+
+// ============================================================
+// Learned anomaly scorer (int8 autoencoder)
+//
+// The rule table only sees what crosses a threshold. Loose-connection
+// heating (voltage drooping with load), a failing appliance or slow
+// insulation breakdown changes the shape of the load rather than its size,
+// so full reads are also summarised into windows of
+// ANOMALY_MODEL_WINDOW readings and each window is scored by a small
+// autoencoder trained offline on normal operation:
+//
+//     x  = window features (below), native units
+//     q  = clamp(((x − center) · mult) >> 16, ±127)          int8 input
+//     h  = clamp(relu(W1·q + b1) >> shift1, 0..127)          int8 hidden
+//     y  = clamp((W2·h + b2) >> shift2, ±127)                int8 output
+//     score = Σ (q − y)²
+//
+// A window the model cannot reconstruct — score ≥ threshold for `confirm`
+// windows in a row — is flagged and uploaded with its readings for review.
+// Flags never touch the relay.
+//
+// Per reading the cost is a handful of integer adds into the window
+// accumulators; the kernel runs once per window and is bounded by
+// 2 · ANOMALY_MODEL_FEATURES · ANOMALY_MODEL_MAX_HIDDEN MACs. Everything is
+// statically allocated. The model arrives as JSON from the server (see
+// anomaly_model_from_json) and is kept in NVS with a CRC; with no model
+// the scorer only accumulates.
+// ============================================================
+
+#define ANOMALY_MODEL_FEATURES      12
+#define ANOMALY_MODEL_MAX_HIDDEN    16
+
+// Feature order the model is trained on (native units of pzem_data_t)
+typedef enum {
+    AMODEL_F_V_MEAN = 0,        // 0.1 V
+    AMODEL_F_V_SPREAD,          // max − min, 0.1 V
+    AMODEL_F_I_MEAN,            // mA
+    AMODEL_F_I_SPREAD,          // mA
+    AMODEL_F_P_MEAN,            // 0.1 W
+    AMODEL_F_P_SPREAD,          // 0.1 W
+    AMODEL_F_PF_MEAN,           // 0.01
+    AMODEL_F_PF_MIN,            // 0.01
+    AMODEL_F_F_MEAN,            // 0.1 Hz
+    AMODEL_F_I_STEP,            // largest |ΔI| between consecutive reads, mA
+    AMODEL_F_P_STEP,            // largest |ΔP|, 0.1 W
+    AMODEL_F_SOURCE_Z,          // −cov(V, I) / var(I): supply-side impedance, mΩ
+} anomaly_model_feature_t;
+
+typedef struct {
+    uint32_t version;                       // server revision (0 = no model)
+    uint8_t  n_hidden;                      // 1..ANOMALY_MODEL_MAX_HIDDEN
+    uint8_t  shift1;                        // hidden requantisation
+    uint8_t  shift2;                        // output requantisation
+    uint8_t  confirm;                       // consecutive windows over threshold
+    uint32_t threshold;                     // score that counts as anomalous
+    int32_t  center[ANOMALY_MODEL_FEATURES];
+    int32_t  mult[ANOMALY_MODEL_FEATURES];  // Q16 LSB per native unit
+    int8_t   w1[ANOMALY_MODEL_MAX_HIDDEN][ANOMALY_MODEL_FEATURES];
+    int32_t  b1[ANOMALY_MODEL_MAX_HIDDEN];
+    int8_t   w2[ANOMALY_MODEL_FEATURES][ANOMALY_MODEL_MAX_HIDDEN];
+    int32_t  b2[ANOMALY_MODEL_FEATURES];
+} anomaly_model_t;
+
+// One full reading kept for the upload of a flagged window
+typedef struct {
+    uint32_t i_ma;
+    uint32_t power_dw;
+    uint16_t v_dv;
+    uint16_t freq_dhz;
+    uint16_t dt_ms;                         // since the window's first reading
+    uint8_t  pf_pct;
+} anomaly_model_sample_t;
+
+// A flagged window, queued to the HTTP task
+typedef struct {
+    uint32_t model_version;
+    uint32_t score;
+    uint32_t threshold;
+    uint32_t start_ms;                      // timestamp of the window's first reading
+    int32_t  features[ANOMALY_MODEL_FEATURES];
+    uint8_t  channel;
+    uint8_t  count;                         // readings in samples[]
+    anomaly_model_sample_t samples[ANOMALY_MODEL_WINDOW];
+} anomaly_model_flag_t;
+
+/**
+ * @brief Restore the NVS copy of the model, if any. Call before the
+ *        anomaly task starts.
+ */
+void anomaly_model_init(void);
+
+/**
+ * @brief Feed one reading (anomaly task only). Fast current-only samples
+ *        are ignored; a gap of more than two read intervals restarts the
+ *        window.
+ * @param out Filled when this reading closes a flagged window.
+ * @return true if out holds a flag.
+ */
+bool anomaly_model_update(const pzem_data_t *data, anomaly_model_flag_t *out);
+
+/**
+ * @brief The inference kernel: quantise @p features and return the
+ *        reconstruction error. Pure; safe to call from a benchmark.
+ */
+uint32_t anomaly_model_score(const anomaly_model_t *model,
+                             const int32_t features[ANOMALY_MODEL_FEATURES]);
+
+/**
+ * @brief Version of the active model (0 = none).
+ */
+uint32_t anomaly_model_version(void);
+
+/**
+ * @brief Validate, publish and persist a model (HTTP task).
+ * @return ESP_ERR_INVALID_ARG if it is malformed (active model kept).
+ */
+esp_err_t anomaly_model_apply(const anomaly_model_t *model);
+
+/**
+ * @brief Build a model from the server's document:
+ *        {"version":N,"model":{"features":12,"n_hidden":8,"shift1":7,
+ *          "shift2":7,"threshold":4000,"confirm":2,"center":[…12],
+ *          "mult":[…12],"w1":[…n_hidden×12, row-major],"b1":[…n_hidden],
+ *          "w2":[…12×n_hidden, row-major],"b2":[…12]}}
+ */
+esp_err_t anomaly_model_from_json(const cJSON *doc, anomaly_model_t *out);
+
+/**
+ * @brief Static RAM held by the scorer (model plus per-channel windows).
+ */
+size_t anomaly_model_ram_bytes(void);
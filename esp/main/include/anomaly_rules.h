@@ -0,0 +1,127 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "cJSON.h"
+
+// ============================================================
+// Anomaly rule table
+//
+// anomaly_analyze() walks the active table once per reading. Each rule
+// compares one metric of the reading against a threshold in the metric's
+// native unit, must hold for confirm_ms before it fires, and carries the
+// reported anomaly type, severity and relay action. Table order is
+// priority order: per anomaly type, the first confirmed rule opens the
+// episode and owns it until it clears — except that a confirmed trip rule
+// always opens it, and takes over an episode a log rule opened (same
+// episode id, onset re-sent with relay_triggered).
+//
+// The table starts from the compiled defaults (config.h), is replaced by
+// the copy saved in NVS, and then by whatever the server serves for this
+// device. Readers never block: a new table is built in a spare buffer and
+// published with one atomic pointer store; the writer waits for readers
+// to leave the previous buffer before it may be reused.
+// ============================================================
+
+#define ANOMALY_MAX_RULES       16
+
+typedef enum {
+    RULE_METRIC_CURRENT = 0,    // mA (also evaluated on fast current-only samples)
+    RULE_METRIC_VOLTAGE,        // 0.1 V
+    RULE_METRIC_POWER,          // 0.1 W
+    RULE_METRIC_POWER_ALARM,    // meter alarm flag; threshold = W programmed into the meter
+    RULE_METRIC_POWER_RISE,     // window mean / baseline ×100; arg = minimum mean (0.1 W), arg2 = current ceiling (mA, 0 = none)
+    RULE_METRIC_THERMAL,        // I²t heat, % of trip; threshold = rated mA, arg = K (A²s), arg2 = cooling τ (ms)
+    RULE_METRIC_POWER_FACTOR,   // 0.01; arg = minimum current (mA) for PF to count
+    RULE_METRIC_FREQUENCY,      // 0.1 Hz
+    RULE_METRIC_ROCOF,          // |df/dt|, 0.01 Hz/s; arg = window (ms)
+    RULE_METRIC_COUNT,
+} rule_metric_t;
+
+typedef enum {
+    RULE_CMP_GT = 0,
+    RULE_CMP_LT,
+} rule_cmp_t;
+
+// Matches the server's anomaly_events.severity column
+typedef enum {
+    RULE_SEVERITY_LOW = 0,
+    RULE_SEVERITY_MEDIUM,
+    RULE_SEVERITY_HIGH,
+    RULE_SEVERITY_CRITICAL,
+} rule_severity_t;
+
+typedef enum {
+    RULE_ACTION_LOG = 0,        // report only
+    RULE_ACTION_TRIP,           // report and open the relay
+} rule_action_t;
+
+typedef struct {
+    uint8_t  type;              // anomaly_type_t reported
+    uint8_t  metric;            // rule_metric_t
+    uint8_t  cmp;               // rule_cmp_t
+    uint8_t  severity;          // rule_severity_t
+    uint8_t  action;            // rule_action_t
+    uint16_t confirm_ms;        // condition must hold this long (0 = instant)
+    uint32_t threshold;         // native unit of the metric
+    uint32_t arg;               // metric-specific second parameter
+    uint32_t arg2;              // metric-specific third parameter
+} anomaly_rule_t;
+
+typedef struct {
+    uint32_t       version;     // server revision (0 = compiled defaults)
+    uint8_t        count;
+    anomaly_rule_t rules[ANOMALY_MAX_RULES];
+} anomaly_ruleset_t;
+
+/**
+ * @brief Load the NVS copy if present and valid, else the compiled defaults.
+ *        Call after nvs_flash_init() and before the anomaly task starts.
+ */
+void anomaly_rules_init(void);
+
+/**
+ * @brief Pin the active table for one evaluation. Never blocks.
+ *        Every acquire must be paired with anomaly_rules_release().
+ */
+const anomaly_ruleset_t *anomaly_rules_acquire(void);
+void anomaly_rules_release(void);
+
+/**
+ * @brief Version of the active table.
+ */
+uint32_t anomaly_rules_version(void);
+
+/**
+ * @brief Publication counter, bumped after every table swap. Read it before
+ *        anomaly_rules_acquire(): a different value means the table may have
+ *        changed even when the same buffer comes back.
+ */
+uint32_t anomaly_rules_generation(void);
+
+/**
+ * @brief Validate, persist and publish a new table.
+ * @return ESP_ERR_INVALID_ARG if any rule is malformed (active table kept).
+ */
+esp_err_t anomaly_rules_apply(const anomaly_ruleset_t *set);
+
+/**
+ * @brief Server name of a metric ("current", …) and the decimal places that
+ *        turn its evaluated value into the human unit (mA → A is 3; the
+ *        thermal heat percentage and the alarm flag are 0).
+ */
+const char *anomaly_rules_metric_name(uint8_t metric);
+uint8_t anomaly_rules_metric_decimals(uint8_t metric);
+
+/**
+ * @brief Build a table from the server's rule document:
+ *        {"version":N,"rules":[{"type":"overcurrent","metric":"current",
+ *          "op":">","threshold":28,"confirm_ms":2000,"severity":"high",
+ *          "action":"trip"}, …]}
+ *        Thresholds are in A / V / W / Hz / Hz/s (ratio for power_rise,
+ *        which also takes "min_power" in W and "max_current" in A; power_factor takes
+ *        "min_current" in A; rocof takes "window_ms"; thermal takes "k" in
+ *        A²s and "cool_ms") and are converted to native units here.
+ */
+esp_err_t anomaly_rules_from_json(const cJSON *doc, anomaly_ruleset_t *out);
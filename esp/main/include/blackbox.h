@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "config.h"
+#include "pzem_sensor.h"
+#include "anomaly_detector.h"
+
+// ============================================================
+// Pre-trip black-box recorder
+//
+// The anomaly task appends every sample it evaluates (fast and full) to a
+// ring sized for BLACKBOX_WINDOW_MS on every channel. The ring lives in
+// RTC slow memory, which keeps its contents across a panic, watchdog or
+// software reset.
+//
+// blackbox_freeze() on a trip only marks the ring; the copy into the
+// frozen record is made by the next blackbox_record() call, long after the
+// read task has opened the relay. One frozen record
+// is held until the HTTP task has uploaded it and called
+// blackbox_release(); later trips are not recorded meanwhile. The record
+// is CRC-protected in RTC memory too, so an upload interrupted by a reset
+// is retried after boot, and a reset that was not a clean power-on
+// freezes the surviving ring as a "reset" record.
+//
+// Single writer (the anomaly task), single reader (the HTTP task); the
+// hand-over is one atomic state word, no locks.
+// ============================================================
+
+#define BLACKBOX_SAMPLES \
+    ((BLACKBOX_WINDOW_MS / PZEM_FAST_POLL_INTERVAL_MS) * PZEM_CHANNEL_COUNT)
+
+#define BLACKBOX_FLAG_CURRENT_ONLY  0x01    // fast poll: power_dw not measured
+
+typedef struct {
+    uint32_t t_ms;
+    uint32_t i_ma;
+    uint32_t power_dw;
+    uint16_t v_dv;
+    uint8_t  channel;
+    uint8_t  flags;
+} blackbox_sample_t;
+
+typedef enum {
+    BLACKBOX_REASON_TRIP = 0,   // relay tripped on an anomaly onset
+    BLACKBOX_REASON_RESET,      // ring survived an abnormal reset
+} blackbox_reason_t;
+
+typedef struct {
+    uint32_t          magic;
+    uint8_t           reason;        // blackbox_reason_t
+    uint8_t           anomaly_type;  // anomaly_type_t (ANOMALY_NONE for resets)
+    uint8_t           channel;       // channel that tripped
+    uint8_t           reset_reason;  // esp_reset_reason_t (resets only)
+    uint32_t          episode_id;    // links the upload to the anomaly event
+    uint32_t          trip_ms;       // timestamp of the triggering sample
+    uint16_t          count;
+    blackbox_sample_t samples[BLACKBOX_SAMPLES];   // oldest first
+    uint32_t          crc;           // CRC32 over everything above
+} blackbox_record_t;
+
+/**
+ * @brief Adopt a frozen record left in RTC memory, or freeze the surviving
+ *        ring after an abnormal reset; then start a fresh ring.
+ *        Call once at boot before the anomaly task starts.
+ */
+void blackbox_init(void);
+
+/**
+ * @brief Append one sample (anomaly task only). Completes a pending freeze
+ *        first. NULL or a failed read only completes the freeze.
+ */
+void blackbox_record(const pzem_data_t *data);
+
+/**
+ * @brief Freeze the ring as it stands for this trip (anomaly task only).
+ *        O(1); ignored while a previous record awaits upload.
+ */
+void blackbox_freeze(const anomaly_event_t *event);
+
+/**
+ * @brief Frozen record awaiting upload, or NULL (HTTP task).
+ */
+const blackbox_record_t *blackbox_pending(void);
+
+/**
+ * @brief Drop the uploaded record and re-arm the recorder (HTTP task).
+ */
+void blackbox_release(void);
@@ -15,10 +15,80 @@
 #define PZEM_RX_PIN             GPIO_NUM_3   // GPIO3 (RX0) -> PZEM RX (RX-to-RX, custom PCB)
 #define PZEM_BAUD_RATE          9600
 #define PZEM_DEVICE_ADDR        0xF8         // Common default for many PZEM-004T v3 modules
-#define PZEM_READ_TIMEOUT_MS    1000
-#define PZEM_READ_INTERVAL_MS   1000         // Read every 1 second
+#define PZEM_READ_TIMEOUT_MS    1000         // Upper bound for any single Modbus attempt
+#define PZEM_READ_INTERVAL_MS   1000         // Full 10-register read every 1 second
 #define PZEM_UART_BUF_SIZE      256
 
+// Two-tier polling: between full reads, only the current registers
+// (0x0001–0x0002, 9-byte reply, ~20 ms on the wire) are polled so short
+// circuits and overcurrent are seen within one fast period instead of 1 s.
+// PZEM_FAST_POLL_VOLTAGE widens that read to 0x0000–0x0002 (11 bytes, ~2 ms
+// more) so power-quality events get voltage at the fast rate too.
+// PZEM_READ_INTERVAL_MS must be a multiple of PZEM_FAST_POLL_INTERVAL_MS.
+#define PZEM_FAST_POLL_ENABLED      1
+#define PZEM_FAST_POLL_INTERVAL_MS  200
+#define PZEM_FAST_READ_TIMEOUT_MS   100      // single attempt, no retry
+#define PZEM_FAST_POLL_VOLTAGE      1
+
+// Adaptive Modbus timeouts and per-read budget. Each slave's timeout is
+// learned from its measured response latency (see modbus_rtu_timeout_ms),
+// and all attempts + address probes of one full read must fit in
+// PZEM_READ_BUDGET_MS, so a dead or flaky meter costs at most that much of
+// the 1 Hz cycle (previously up to ~9 s: 3 addrs × 3 attempts × 1 s).
+#define MODBUS_TIMEOUT_INITIAL_MS   250      // until the first reply is timed
+#define MODBUS_TIMEOUT_MIN_MS       40
+#define MODBUS_TIMEOUT_MAX_MS       PZEM_READ_TIMEOUT_MS
+#define MODBUS_RETRY_GAP_MS         20       // bus recovery gap before a retry
+#define PZEM_READ_BUDGET_MS         400      // per channel per full read
+#define MODBUS_EVENT_QUEUE_LEN  16           // UART driver event queue depth
+#define MODBUS_RX_TOUT_CHARS    4            // RX idle timeout (chars) ≥ 3.5-char frame gap
+
+// ============================================================
+// Multi-channel Modbus bus
+// One ESP32 can poll several PZEM-004T meters sharing PZEM_UART_NUM.
+// Every meter on a shared bus MUST first be given a unique slave address
+// (0x01–0xF7); 0xF8 is the general address that *every* PZEM answers, so it
+// is only safe with a single meter. Channel n is reported to the server as
+// its own device (see http_client.c for the per-channel device_id).
+// ============================================================
+#define PZEM_MAX_CHANNELS       16
+#define PZEM_CHANNEL_COUNT      1            // 1 = single-meter unit (probes fallback addrs)
+#define PZEM_CHANNEL_ADDRS      { PZEM_DEVICE_ADDR }
+// Meter model and phase per channel (meter_model_id_t, see meter_model.h).
+// A three-phase SDM630 takes three channels: same address, phases 0, 1, 2.
+#define PZEM_CHANNEL_MODELS     { METER_PZEM004T }
+#define PZEM_CHANNEL_PHASES     { 0 }
+
+// Bus discovery (boot, on demand, or after repeated failures): verifies the
+// NVS address registry and configured addresses, then scans 0x01–0xF7 for
+// any channel still missing. The pass runs in slices of at most
+// PZEM_DISCOVERY_SLICE_MS between read cycles, so protection polling never
+// stalls behind it; a full scan for one missing meter is 247 probes
+// (~15 s of bus time at the probe timeout below). The read path itself only
+// ever talks to the resolved address.
+#define PZEM_DISCOVERY_SLICE_MS     250
+#define PZEM_PROBE_TIMEOUT_MS       60       // per address; a 1-register reply takes ~25 ms
+#define PZEM_REDISCOVER_AFTER_FAILS 10       // consecutive full-read failures on a channel
+
+// ============================================================
+// PZEM emulator (bench/CI builds only — see pzem_emulator.h)
+// When enabled the UART is never touched: every Modbus request is answered
+// by an in-process emulated meter per channel, replaying the scripted
+// profile below. MUST be 0 for any unit wired to real meters.
+// ============================================================
+#define PZEM_EMULATOR_ENABLED       0
+#define PZEM_EMULATOR_SCENARIO      0        // pzem_emu_scenario_t (0 = steady load)
+#define PZEM_EMULATOR_SILENT_PCT    0        // default fault injection, % of requests
+#define PZEM_EMULATOR_GARBLE_PCT    0
+#define PZEM_EMULATOR_TURNAROUND_MS 10       // meter processing time before replying
+
+// Detector benchmark (see anomaly_bench.h): replays every emulator scenario
+// through the live rule table at boot and logs accuracy, detection delay
+// and CPU time per reading. Adds a few seconds to boot; keep 0 in the field.
+#define ANOMALY_BENCH_ENABLED       0
+#define ANOMALY_BENCH_SCENARIO_MS   60000    // simulated time per scenario
+#define ANOMALY_BENCH_GRACE_MS      5000     // detection this long after the fault ends still counts
+
 // ============================================================
 // Relay — SLA-05VDC-SL-C (optocoupler-isolated module)
 // Active LOW: IN=LOW  -> relay energized (ON/closed)
@@ -28,6 +98,7 @@
 #define RELAY_ACTIVE_LEVEL      0            // 0 = active LOW
 #define RELAY_COOLDOWN_MS       1000
 #define RELAY_AUTO_RESET        false
+#define TRIP_LATENCY_BUDGET_US  5000         // reading → relay open; slower trips are logged
 
 // ============================================================
 // Status LED
@@ -54,11 +125,138 @@
 // ============================================================
 #define OVERCURRENT_THRESHOLD_A     28.0f  // 30A relay - 2A margin (PEC Sec. 240)
 #define SHORT_CIRCUIT_THRESHOLD_A   50.0f  // Severe fault detection (PZEM max 100A)
+// Short-time delay of the instantaneous element: a motor start draws
+// 6–8× rated for up to ~300 ms and must ride through. A bolted fault held
+// this long has already tripped the I²t element (80 A: two fast polls).
+#define SHORT_CIRCUIT_CONFIRM_MS    400
 #define MAX_POWER_W                 3000.0f // Practical room load limit (not a PEC value)
 #define WIRE_FIRE_POWER_RATIO       1.5f   // 1.5× baseline triggers thermal alert
 #define WIRE_FIRE_MIN_POWER_W       2100.0f // 70% of MAX_POWER_W before ratio check
-#define OVERCURRENT_CONFIRM_COUNT   3       // Consecutive readings to confirm (~3s)
+// Wire fire only counts at or below OVERCURRENT_THRESHOLD_A: a rise that
+// takes the current past the rating is an overload, cleared by the I²t element.
+// Overcurrent is an inverse-time (I²t) element: heat builds as (I² − Ir²)·dt
+// above the rated current and decays with OVERCURRENT_COOL_TAU_MS below it,
+// tripping when it reaches K — t_trip = K / (I² − Ir²) from cold.
+// K = 1960 A²s gives 34 s at 29 A, 2 s at 42 A, 1.6 s at 45 A; a 0.5 s
+// 40 A motor start uses ~20 % of it. Above SHORT_CIRCUIT_THRESHOLD_A the
+// instantaneous element trips first (B/C-curve magnetic region).
+#define OVERCURRENT_TRIP_K_A2S      1960
+#define OVERCURRENT_COOL_TAU_MS     60000   // Conductor cooling time constant
+#define OVERPOWER_CONFIRM_MS        3000    // PZEM power alarm held this long before tripping
+#define POWER_ALARM_RETRY_MS        30000   // retry programming the meter alarm after a failure
 #define FIRE_HISTORY_SIZE           10      // Rolling window for thermal runaway
+// Wire fire watches for a slow creep over its baseline. A jump of more
+// than FIRE_STEP_PCT between two full reads is a load switching on or off:
+// window and baseline restart at the new level. The baseline only follows
+// the load while the window is flat (spread within FIRE_FLAT_PCT of its
+// mean), so a sustained rise cannot drag it along.
+#define FIRE_STEP_PCT               20
+#define FIRE_FLAT_PCT               5
+// A detected anomaly is an episode: one onset, a rollup every
+// ANOMALY_ROLLUP_MS while it lasts, and one clear after the condition has
+// been false for ANOMALY_CLEAR_HOLD_MS. While open, the rule's threshold is
+// relaxed by ANOMALY_CLEAR_MARGIN_PCT so a reading dithering at the limit
+// extends the episode instead of ending and restarting it.
+// Power factor and frequency are only in full reads (1 Hz). Sustained low
+// PF under load points at an inductive fault or a failed correction
+// capacitor; below PF_MIN_CURRENT_A the meter's PF is noise. A frequency
+// excursion or a fast ROCOF means the supply is a generator or an island.
+#define POWER_FACTOR_MIN            0.60f
+#define PF_MIN_CURRENT_A            1.0f
+#define PF_CONFIRM_MS               60000
+#define FREQUENCY_MIN_HZ            59.4f   // ±1 % of NOMINAL_FREQUENCY_HZ
+#define FREQUENCY_MAX_HZ            60.6f
+#define FREQUENCY_CONFIRM_MS        3000
+#define ROCOF_MAX_HZ_S              1.0f    // meter resolution is 0.1 Hz per window
+#define ROCOF_WINDOW_MS             1000
+#define ROCOF_CONFIRM_MS            1000
+#define ANOMALY_ROLLUP_MS           60000
+#define ANOMALY_CLEAR_HOLD_MS       5000
+#define ANOMALY_CLEAR_MARGIN_PCT    2
+
+// ============================================================
+// Power quality (IEEE 1159 / EN 50160 RMS variations)
+// Every voltage reading, fast or full, is classified against the nominal:
+// a sag below PQ_SAG_PCT, a swell above PQ_SWELL_PCT, an interruption below
+// PQ_INTERRUPT_PCT (IEEE 1159; EN 50160 uses 5 %). An event ends once the
+// voltage is back inside the band by PQ_HYSTERESIS_PCT (IEC 61000-4-30
+// default 2 %) and is reported once, as a single record, when it ends.
+// A PZEM-004T's measuring side is powered from the line it measures, so it
+// goes silent when the line drops out: PQ_SILENT_MISSES consecutive missed
+// replies count as an interruption from the first miss (flagged "silent",
+// since a broken bus looks the same).
+// ============================================================
+#define PQ_ENABLED                  1
+#define PQ_SAG_PCT                  90
+#define PQ_SWELL_PCT                110
+#define PQ_INTERRUPT_PCT            10
+#define PQ_HYSTERESIS_PCT           2
+#define PQ_SILENT_MISSES            2       // 0 = never infer interruptions from silence
+#define PQ_MAX_EVENTS_PER_POST      8
+
+// ============================================================
+// Learned anomaly scorer (see anomaly_model.h)
+// Full reads are scored in windows by an int8 autoencoder from the server;
+// windows it cannot reconstruct are uploaded for review and never trip the
+// relay. At most one upload per channel every ANOMALY_MODEL_HOLDOFF_MS.
+// ============================================================
+#define ANOMALY_MODEL_ENABLED           1
+#define ANOMALY_MODEL_WINDOW            10      // full reads per scored window
+#define ANOMALY_MODEL_HOLDOFF_MS        300000
+#define ANOMALY_MODEL_Z_MIN_SPREAD_MA   500     // current swing needed to fit source impedance
+
+// ============================================================
+// Prepaid credit (see prepaid.h)
+// The balance is kept and enforced on the device; the server only signs
+// top-ups, tariff and warning levels. HTTP_CREDIT_POLL_MS is the idle
+// refresh — a newer seq announced with a relay poll, or a warning level
+// crossed, syncs straight away.
+// ============================================================
+#define PREPAID_ENABLED             1
+// The balance is recomputed and enforced from the energy task this often —
+// never from the read task, which must not wait on the credit mutex or
+// drive the relay for a non-safety reason.
+#define PREPAID_EVAL_MS             1000
+
+// ============================================================
+// Consumption forecast (see forecast.h)
+// Each hour-of-week bucket is an EWMA with α = 2^-FORECAST_EWMA_SHIFT, so
+// one weekday hour remembers roughly the last 2^SHIFT weeks.
+// ============================================================
+#define FORECAST_ENABLED            1
+#define FORECAST_Q_BITS             2       // bucket resolution 0.25 W, max 16383 W
+#define FORECAST_EWMA_SHIFT         3
+#define FORECAST_MIN_COVERAGE_PCT   50      // part of an hour that must be observed
+#define FORECAST_EVAL_MS            60000   // projection refresh
+
+// ============================================================
+// Appliance events (step-change NILM, see nilm.h)
+// Steps in the full-read power trace are clustered into per-appliance
+// signatures; the device uploads the edges and per-appliance energy
+// instead of a dense raw series, so the raw snapshot is thinned to
+// HTTP_POWER_INTERVAL_NILM reads while this is on.
+// ============================================================
+#define NILM_ENABLED                1
+#define NILM_MAX_APPLIANCES         12      // signatures per channel
+#define NILM_STEP_MIN_DW            300     // smallest edge, 0.1 W (30 W) ...
+#define NILM_STEP_PCT               5       // ... or this share of the running level
+#define NILM_SETTLE_READS           3       // agreeing full reads that end a transient
+#define NILM_SETTLE_TOL_DW          100     // their allowed spread, 0.1 W ...
+#define NILM_SETTLE_PCT             3       // ... or this share of the level
+#define NILM_MAX_TRANSIENT_MS       30000   // never settled: rebase without an edge
+#define NILM_MATCH_MIN_DW           150     // signature tolerance floor, 0.1 W / 0.1 var ...
+#define NILM_MATCH_PCT              12      // ... or this share of the signature's step
+#define NILM_CENTROID_SHIFT         4       // centroid is an EWMA (α = 1/16) after 16 edges
+#define NILM_IDLE_DW                50      // below this level nothing is running
+#define NILM_PERSIST_MS             900000  // energy totals checkpoint
+#define NILM_MAX_EVENTS_PER_POST    8
+
+// ============================================================
+// Black-box Recorder
+// Every sample the anomaly task sees goes into a ring in RTC memory; a trip
+// freezes the last BLACKBOX_WINDOW_MS of it for upload with the anomaly.
+// ============================================================
+#define BLACKBOX_WINDOW_MS          10000   // pre-trip history kept per channel
 
 // ============================================================
 // WiFi Configuration
@@ -75,37 +273,72 @@
 #define HTTP_TIMEOUT_MS         30000                // 30s — Render cold starts can be slow
 #define HTTP_API_KEY            "bw_fd0fdbbc6e3f51a520eba4d733df02ac88ffd559f7c4f4837dcc45c06b138a2b"
 #define HTTP_POWER_INTERVAL     10
+#define HTTP_POWER_INTERVAL_NILM 60     // raw snapshot spacing while appliance events are on
+#define HTTP_RULES_POLL_MS      60000   // anomaly rule table refresh
+#define HTTP_RULES_MAX_BODY     4096    // 16 rules ≈ 2.5 KB of JSON
+#define HTTP_BLACKBOX_RETRY_MS  5000    // spacing of black-box upload attempts
+#define HTTP_MODEL_POLL_MS      600000  // anomaly model refresh
+#define HTTP_MODEL_MAX_BODY     4096    // 16 hidden units ≈ 2.5 KB of JSON
+#define HTTP_CREDIT_POLL_MS     300000  // prepaid credit refresh / balance report
+#define HTTP_CREDIT_MAX_BODY    512
+#define HTTP_BUDGET_POLL_MS     3600000 // budget refresh / forecast report
+#define HTTP_NILM_SUMMARY_MS    900000  // per-appliance energy report
+#define HTTP_BUDGET_MAX_BODY    384
 #define HTTP_DEVICE_ID          "bluewatt-004"
 
+// ============================================================
+// Wall clock (SNTP once WiFi is up)
+// ============================================================
+#define SNTP_SERVER             "pool.ntp.org"
+#define LOCAL_TZ                "PHT-8"         // POSIX TZ: UTC+8, no DST
+#define CLOCK_VALID_AFTER       1735689600      // 2025-01-01 — earlier means not synced
+
 // ============================================================
 // NVS
 // ============================================================
 #define NVS_NAMESPACE           "bluewatt"
 #define NVS_MAX_TRIP_LOGS       100
 
+// ============================================================
+// Lifetime energy counter (see energy_counter.h)
+// The PZEM energy register resets on pzem_reset_energy() and wraps at
+// 9999.99 kWh; the firmware keeps a monotonic per-channel total and
+// checkpoints it to a ring of NVS slots from a low-priority task.
+// ============================================================
+#define ENERGY_METER_WRAP_WH        10000000UL   // PZEM register rolls over here
+#define ENERGY_WRAP_MARGIN_WH       100000UL     // last value this close to wrap → rollover
+#define ENERGY_MAX_POWER_W          26000        // PZEM full scale (260 V × 100 A): bounds a real step
+#define ENERGY_STEP_SLACK_WH        10           // plus this; a larger jump is a glitch → rebaseline
+#define ENERGY_RING_SLOTS           8            // NVS slots per channel (wear levelling)
+#define ENERGY_CHECKPOINT_WH        50           // checkpoint after this much new energy…
+#define ENERGY_CHECKPOINT_MAX_MS    (15 * 60 * 1000)  // …or this long with any change
+#define ENERGY_PERSIST_CHECK_MS     10000        // checkpoint check period (persist task)
+
 // ============================================================
 // FreeRTOS Task Priorities (higher = more urgent)
 // ============================================================
 #define TASK_PRIORITY_PZEM_READ     9
-#define TASK_PRIORITY_ANOMALY       9
-#define TASK_PRIORITY_RELAY         8
+#define TASK_PRIORITY_ANOMALY       8       // trips happen in the read task, not here
 #define TASK_PRIORITY_WIFI          3
 #define TASK_PRIORITY_HTTP          2
+#define TASK_PRIORITY_ENERGY        1       // flash writes only, never starves the others
 
 // Task stack sizes (in words / 4 bytes each)
 #define TASK_STACK_PZEM_READ        4096
 #define TASK_STACK_ANOMALY          4096
-#define TASK_STACK_RELAY            2048
 #define TASK_STACK_WIFI             4096
 #define TASK_STACK_HTTP             8192
+#define TASK_STACK_ENERGY           3072
 
 // ============================================================
 // Queue Sizes
 // ============================================================
-#define QUEUE_POWER_DATA_SIZE       5
-#define QUEUE_ANOMALY_EVENTS_SIZE   10
+#define QUEUE_POWER_DATA_SIZE       5       // per channel
 #define QUEUE_HTTP_EVENTS_SIZE      20
-#define QUEUE_HTTP_POWER_SIZE       5
+#define QUEUE_HTTP_PQ_SIZE          16
+#define QUEUE_HTTP_MODEL_SIZE       2       // flagged windows awaiting upload
+#define QUEUE_HTTP_NILM_SIZE        16
+#define QUEUE_HTTP_POWER_SIZE       5       // per channel
 
 // ============================================================
 // Logging Levels
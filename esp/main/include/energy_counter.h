@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// ============================================================
+// Monotonic lifetime energy per channel
+//
+// The PZEM's 32-bit Wh register goes back to 0 on an energy reset or when
+// it wraps at 9999.99 kWh, which breaks any MAX−MIN aggregation on the
+// server. energy_counter_update() turns the raw register into a uint64
+// lifetime total that only ever increases:
+//   - rollover near ENERGY_METER_WRAP_WH  → adds the distance to the wrap
+//   - any other decrease (reset/replace)  → adds the new register value
+//   - jump larger than full-scale power could explain → rebaseline, adds nothing
+//
+// Updates are RAM-only and safe to call from the read task. Checkpoints
+// go to a ring of ENERGY_RING_SLOTS NVS blobs per channel (sequence number
+// + CRC), written by energy_counter_persist() from a low-priority task only
+// after ENERGY_CHECKPOINT_WH of new energy or ENERGY_CHECKPOINT_MAX_MS. On
+// boot the newest valid slot is restored and energy the meter counted while
+// the ESP32 was down is folded in on the first reading.
+// ============================================================
+
+/**
+ * @brief Restore every channel's total from its newest valid NVS checkpoint.
+ *        Call after nvs_flash_init().
+ */
+esp_err_t energy_counter_init(void);
+
+/**
+ * @brief Fold a fresh meter register reading into the channel's total.
+ * @param meter_wh Raw PZEM energy register (Wh).
+ * @return Lifetime energy (Wh).
+ */
+uint64_t energy_counter_update(uint8_t channel, uint32_t meter_wh);
+
+/**
+ * @brief Current lifetime energy of a channel (Wh).
+ */
+uint64_t energy_counter_total(uint8_t channel);
+
+/**
+ * @brief Lifetime energy of the whole device — every channel (Wh).
+ */
+uint64_t energy_counter_sum(void);
+
+/**
+ * @brief Write checkpoints that are due (or all dirty ones if force).
+ *        Blocks on flash — never call from the read or anomaly task.
+ */
+void energy_counter_persist(bool force);
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// ============================================================
+// Decimal fixed-point helpers for readings kept in native PZEM register
+// units (0.1 V, mA, 0.1 W, Wh, 0.1 Hz, 0.01 PF). Values are printed with
+// integer division only — no float conversion on the encode path.
+// ============================================================
+
+/**
+ * @brief Print value / 10^decimals as a decimal string, e.g. (2305, 1) → "230.5".
+ * @param decimals 0..3
+ * @return snprintf() result.
+ */
+static inline int fixed_fmt(char *buf, size_t len, uint64_t value, uint8_t decimals)
+{
+    static const uint32_t pow10[] = { 1, 10, 100, 1000 };
+    if (decimals == 0 || decimals > 3) {
+        return snprintf(buf, len, "%llu", (unsigned long long)value);
+    }
+    uint32_t div = pow10[decimals];
+    return snprintf(buf, len, "%llu.%0*lu", (unsigned long long)(value / div),
+                    (int)decimals, (unsigned long)(value % div));
+}
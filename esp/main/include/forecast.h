@@ -0,0 +1,101 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// ============================================================
+// Consumption forecast and budget alerts
+//
+// The device learns its own weekly load profile: one bucket per hour of the
+// week (168, local time), each an EWMA of that hour's mean power in
+// fixed point (FORECAST_Q_BITS fractional bits of a watt, 336 bytes in
+// all). The read task adds each reading to a running sum under a spinlock —
+// O(1), no mutex — and the energy task folds that into the hour every
+// FORECAST_EVAL_MS. Readings taken after the hour ended are kept apart
+// until then, so a late pass does not blur hours. The hour's mean updates
+// its bucket when the hour ends, provided at least
+// FORECAST_MIN_COVERAGE_PCT of it was observed.
+//
+// The server only sends the budget (energy per billing period, warning
+// percentage, period bounds). Projected period energy is
+//
+//     used so far (lifetime energy − energy at period start)
+//   + Σ bucket × hours for the rest of the period
+//
+// computed in O(168) once a minute. Moving to a worse budget state logs
+// and asks for an early sync, which reports used and projected energy.
+// Needs wall-clock time (SNTP, see wifi_manager.c); until then nothing is
+// learned or projected.
+// ============================================================
+
+#define FORECAST_BUCKETS        168     // 7 days × 24 hours
+
+typedef enum {
+    FORECAST_STATE_NONE = 0,    // no budget, no clock, or nothing learned yet
+    FORECAST_STATE_OK,
+    FORECAST_STATE_WARNING,     // projection ≥ warn_pct of the budget
+    FORECAST_STATE_OVER,        // projection > budget
+    FORECAST_STATE_EXCEEDED,    // used > budget
+} forecast_state_t;
+
+typedef struct {
+    uint32_t seq;
+    uint32_t budget_wh;             // 0 = no budget
+    uint8_t  warn_pct;
+    int64_t  period_start;          // Unix seconds
+    int64_t  period_end;
+    int64_t  period_used_wh;        // server's tally for a period we have no anchor for, else -1
+} forecast_budget_t;
+
+typedef struct {
+    forecast_state_t state;
+    uint32_t         seq;
+    int64_t          period_start;  // of the anchored period (0 if none)
+    int64_t          used_wh;
+    int64_t          projected_wh;  // -1 until a projection exists
+    uint8_t          learned;       // buckets with at least one full hour
+} forecast_status_t;
+
+/**
+ * @brief Restore the learned profile, budget and period anchor from NVS.
+ */
+esp_err_t forecast_init(void);
+
+/**
+ * @brief Feed one full reading (read task). power_dw is the device's total
+ *        active power across channels (0.1 W). Only adds to a running sum.
+ */
+void forecast_note_power(uint32_t power_dw);
+
+/**
+ * @brief Fold the readings in, close the hour if it ended and re-evaluate
+ *        the budget. Call every FORECAST_EVAL_MS from the energy task.
+ */
+void forecast_update(void);
+
+/**
+ * @brief Apply a budget from the server (HTTP task).
+ */
+esp_err_t forecast_apply(const forecast_budget_t *budget);
+
+void forecast_get_status(forecast_status_t *out);
+
+/**
+ * @brief Ask for a budget sync ahead of HTTP_BUDGET_POLL_MS (state got
+ *        worse, or the billing period ended).
+ */
+void forecast_request_sync(void);
+
+/**
+ * @brief Return and clear the pending sync request.
+ */
+bool forecast_take_sync_request(void);
+
+/**
+ * @brief Write the profile, budget and anchor to NVS if they changed.
+ *        Blocks on flash — call from the energy persist task only.
+ */
+void forecast_persist(void);
+
+const char *forecast_state_to_string(forecast_state_t state);
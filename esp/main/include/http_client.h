@@ -3,6 +3,10 @@
 #include "esp_err.h"
 #include "pzem_sensor.h"
 #include "anomaly_detector.h"
+#include "blackbox.h"
+#include "power_quality.h"
+#include "anomaly_model.h"
+#include "nilm.h"
 
 /**
  * @brief Initialize HTTP client module.
@@ -14,7 +18,8 @@ void http_client_init(void);
 /**
  * @brief POST PZEM power data to /api/v1/power-data.
  *        JSON: device_id, timestamp, voltage_rms, current_rms, power_real,
- *              power_apparent, power_factor, energy_kwh, frequency.
+ *              power_apparent, power_factor, energy_kwh, frequency,
+ *              modbus_link (per-meter link-quality counters, see modbus_rtu.h).
  */
 esp_err_t http_post_power_data(const pzem_data_t *data);
 
@@ -23,6 +28,37 @@ esp_err_t http_post_power_data(const pzem_data_t *data);
  */
 esp_err_t http_post_anomaly_event(const anomaly_event_t *event);
 
+/**
+ * @brief POST a frozen black-box record to /api/v1/anomaly-events/blackbox.
+ *        Trip records carry the episode_id of their anomaly event.
+ */
+esp_err_t http_post_blackbox(const blackbox_record_t *rec);
+
+/**
+ * @brief POST finished power-quality events of one channel to
+ *        /api/v1/power-quality-events. Start times are sent as age_ms
+ *        (ms before the POST) so they need no synced clock.
+ */
+esp_err_t http_post_pq_events(const pq_event_t *events, uint8_t count);
+
+/**
+ * @brief POST a window flagged by the anomaly model, with its features and
+ *        readings, to /api/v1/anomaly-events/model-flags for review.
+ */
+esp_err_t http_post_model_flag(const anomaly_model_flag_t *flag);
+
+/**
+ * @brief POST appliance on/off edges of one channel to
+ *        /api/v1/appliance-events (times as age_ms, like power-quality).
+ */
+esp_err_t http_post_nilm_events(const nilm_event_t *events, uint8_t count);
+
+/**
+ * @brief POST the signature table and per-appliance energy of one channel
+ *        to /api/v1/appliance-events/summary.
+ */
+esp_err_t http_post_nilm_summary(uint8_t channel);
+
 /**
  * @brief GET /api/v1/health — check if server is reachable.
  */
@@ -43,3 +79,32 @@ esp_err_t http_poll_relay_command(int *out_command_id, char *out_command, size_t
  * @param relay_status  "on", "off", or "tripped" — current relay state after execution.
  */
 esp_err_t http_ack_relay_command(int command_id, const char *relay_status);
+
+/**
+ * @brief Fetch /api/v1/devices/{id}/anomaly-rules and apply it when its
+ *        version differs from the active table (see anomaly_rules.h).
+ * @return ESP_OK when nothing changed or the new table was applied.
+ */
+esp_err_t http_poll_anomaly_rules(void);
+
+/**
+ * @brief Fetch /api/v1/devices/{id}/anomaly-model and apply it when its
+ *        version differs from the active model (see anomaly_model.h).
+ */
+esp_err_t http_poll_anomaly_model(void);
+
+/**
+ * @brief Report the prepaid balance to /api/v1/devices/{id}/credit and
+ *        apply the signed credit document in the reply once its HMAC
+ *        (SHA-256, keyed with the device API key) checks out.
+ * @return ESP_ERR_INVALID_CRC if the signature does not match;
+ *         ESP_ERR_TIMEOUT if the balance could not be read (poll skipped,
+ *         a sync is requested for the next pass).
+ */
+esp_err_t http_poll_credit(void);
+
+/**
+ * @brief Report used and projected period energy to
+ *        /api/v1/devices/{id}/budget and apply the budget in the reply.
+ */
+esp_err_t http_poll_budget(void);
@@ -13,6 +13,12 @@
 #define TAG_WIFI    "WIFI"
 #define TAG_HTTP    "HTTP"
 #define TAG_PROV    "PROV"
+#define TAG_BBOX    "BBOX"
+#define TAG_BENCH   "BENCH"
+#define TAG_PQ      "PQ"
+#define TAG_PREPAID "PREPAID"
+#define TAG_FORECAST "FORECAST"
+#define TAG_NILM    "NILM"
 
 // Level-gated log macros
 #define LOG_DEBUG(tag, fmt, ...) \
@@ -33,6 +39,7 @@
 void log_power_data(const pzem_data_t *data);
 
 /**
- * @brief Log a formatted anomaly event.
+ * @brief Log a formatted anomaly event (onset loudly, updates and clears
+ *        as one-line rollups).
  */
 void log_anomaly_event(const anomaly_event_t *event);
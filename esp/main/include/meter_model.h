@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "pzem_sensor.h"
+
+// ============================================================
+// Modbus meter descriptors
+//
+// Each supported meter model is a const table: which function code and
+// register block to read, and for every pzem_data_t field the register it
+// comes from, its wire type and its scale into the native fixed-point unit.
+// meter_decode() walks the table — the per-type decoder is a function
+// pointer bound when the descriptor is compiled, so a read never branches
+// on the model and one task can poll any mix of meters on the same bus.
+//
+// Three-phase meters are exposed one phase per channel: a channel names
+// (model, address, phase) and per-phase fields are offset by
+// phase × phase_stride registers. All meters on a bus must be configured
+// for PZEM_BAUD_RATE (Eastron SDM meters default to 2400 baud).
+// ============================================================
+
+typedef enum {
+    METER_PZEM004T = 0,     // PZEM-004T v3: u16/u32 input regs, 10 regs
+    METER_SDM120,           // Eastron SDM120: float32 input regs
+    METER_SDM630,           // Eastron SDM630: float32 input regs, 3 phases
+    METER_MODEL_COUNT,
+} meter_model_id_t;
+
+// Decode one value at regs (big-endian register bytes) into native units
+typedef uint32_t (*meter_decode_fn)(const uint8_t *regs, uint32_t scale);
+
+typedef struct {
+    uint16_t        dst_offset;    // offsetof(pzem_data_t, …)
+    uint8_t         dst_size;      // 1, 2 or 4 bytes
+    uint16_t        reg;           // register offset from the block start
+    uint8_t         phase_stride;  // registers between phases (0 = not per-phase)
+    uint8_t         phase_mask;    // bit p set = field present on phase p
+    meter_decode_fn decode;
+    uint32_t        scale;         // multiplier into the native unit
+} meter_field_t;
+
+typedef struct {
+    const char          *name;
+    uint8_t              func;          // 0x03 holding / 0x04 input
+    uint16_t             start;         // first register of the block
+    uint16_t             count;         // registers per full read
+    uint8_t              phases;
+    uint8_t              reset_func;    // energy reset function code (0 = none)
+    uint16_t             alarm_reg;     // power-alarm threshold holding register, W (0 = none)
+    bool                 has_apparent;  // else S = V·I is derived
+    const meter_field_t *current;       // field used for the fast poll
+    const meter_field_t *voltage;       // joined to the fast poll when asked for
+    const meter_field_t *fields;
+    size_t               n_fields;
+} meter_model_t;
+
+// Largest block any descriptor reads (response = 3 + 2·count + 2 bytes)
+#define METER_MAX_BLOCK_REGS    80
+#define METER_MAX_RESP_LEN      (5 + 2 * METER_MAX_BLOCK_REGS)
+
+// Widest current + voltage span of any descriptor (SDM: V at 0, I at 6)
+#define METER_FAST_MAX_REGS     8
+#define METER_FAST_MAX_RESP_LEN (5 + 2 * METER_FAST_MAX_REGS)
+
+/**
+ * @brief Descriptor for a model id (NULL if out of range).
+ */
+const meter_model_t *meter_model_get(meter_model_id_t id);
+
+/**
+ * @brief Decode a full-read block into out (fields named in the descriptor
+ *        only; timestamp/valid/energy_wh are left to the caller).
+ * @param regs  First data byte of the response (response + 3).
+ */
+void meter_decode(const meter_model_t *m, uint8_t phase, const uint8_t *regs, pzem_data_t *out);
+
+/**
+ * @brief First register and count for the fast poll: the current field,
+ *        widened to one contiguous span that also covers the voltage
+ *        field when with_voltage is set.
+ */
+void meter_fast_regs(const meter_model_t *m, uint8_t phase, bool with_voltage,
+                     uint16_t *start, uint16_t *count);
+
+/**
+ * @brief Decode a fast-poll response (regs = response + 3) read with the
+ *        same arguments into out->i_ma and, with_voltage, out->v_dv.
+ */
+void meter_decode_fast(const meter_model_t *m, uint8_t phase, bool with_voltage,
+                       const uint8_t *regs, pzem_data_t *out);
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// ============================================================
+// Modbus RTU CRC16 (polynomial 0xA001 reflected, init 0xFFFF)
+//
+// Table-driven: one lookup + shift + xor per byte instead of eight
+// shift/xor steps. The 512-byte table is placed in DRAM so lookups never
+// stall on a flash-cache miss while the read task is receiving a frame.
+//
+// Incremental use (CRC computed as bytes arrive):
+//     uint16_t crc = MODBUS_CRC16_INIT;
+//     crc = modbus_crc16_update(crc, byte);          // per byte
+//     crc = modbus_crc16_update_buf(crc, chunk, n);  // per received chunk
+//
+// Running the CRC over a complete frame *including* its two trailing CRC
+// bytes (LSB first) yields MODBUS_CRC16_RESIDUE (0) when the frame is intact,
+// so receivers never need a second pass over the payload.
+// ============================================================
+
+#define MODBUS_CRC16_INIT       0xFFFF
+#define MODBUS_CRC16_RESIDUE    0x0000
+
+extern const uint16_t modbus_crc16_table[256];
+
+/**
+ * @brief Feed one byte into a running CRC.
+ */
+static inline uint16_t modbus_crc16_update(uint16_t crc, uint8_t byte)
+{
+    return (crc >> 8) ^ modbus_crc16_table[(crc ^ byte) & 0xFF];
+}
+
+/**
+ * @brief Feed a buffer into a running CRC.
+ * @param crc  Running value (start with MODBUS_CRC16_INIT).
+ * @return Updated CRC.
+ */
+uint16_t modbus_crc16_update_buf(uint16_t crc, const uint8_t *data, size_t len);
+
+/**
+ * @brief One-shot CRC of a complete buffer.
+ */
+uint16_t modbus_crc16(const uint8_t *data, size_t len);
+
+/**
+ * @brief Append the CRC of data[0..len) to data[len], data[len+1] (LSB first).
+ *        The buffer must have room for len + 2 bytes.
+ * @return Total frame length (len + 2).
+ */
+size_t modbus_crc16_append(uint8_t *data, size_t len);
+
+/**
+ * @brief Return true if a complete frame (payload + 2 CRC bytes) is intact.
+ */
+static inline bool modbus_crc16_frame_ok(const uint8_t *frame, size_t len)
+{
+    return len >= 2 && modbus_crc16(frame, len) == MODBUS_CRC16_RESIDUE;
+}
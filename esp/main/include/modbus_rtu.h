@@ -0,0 +1,139 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// ============================================================
+// Modbus RTU transport on PZEM_UART_NUM
+//
+// The UART driver is installed with an event queue and the hardware RX
+// timeout set just above the 3.5-character inter-frame gap. A UART_DATA
+// event with timeout_flag set therefore means "the line went idle" — the
+// frame is complete and is handed back immediately instead of waiting out
+// a fixed read timeout. The frame assembler below is pure logic (no UART,
+// no FreeRTOS) so it can be driven from any byte source.
+// ============================================================
+
+#define MODBUS_EXCEPTION_BIT    0x80
+#define MODBUS_EXCEPTION_LEN    5        // addr + func|0x80 + code + CRC
+
+typedef enum {
+    MODBUS_RX_IN_PROGRESS = 0,  // Need more bytes
+    MODBUS_RX_COMPLETE,         // Full frame, CRC ok
+    MODBUS_RX_EXCEPTION,        // Slave returned an exception frame (CRC ok)
+    MODBUS_RX_CRC_ERROR,        // Full-length frame, CRC residue non-zero
+    MODBUS_RX_SHORT,            // Line went idle before the frame was complete
+    MODBUS_RX_OVERFLOW,         // More bytes than the buffer can hold
+} modbus_rx_status_t;
+
+// Per-slave link-quality statistics (cumulative since boot)
+#define MODBUS_LATENCY_BUCKETS  8
+
+typedef struct {
+    uint8_t  addr;
+    uint32_t frames_ok;        // Complete, CRC-valid replies (incl. exceptions)
+    uint32_t timeouts;         // No byte received before the timeout
+    uint32_t short_frames;     // Line went idle mid-frame
+    uint32_t crc_errors;
+    uint32_t header_errors;    // Valid CRC but wrong addr/func/byte count
+    uint32_t exceptions;       // Modbus exception replies
+    uint32_t overflows;
+    uint32_t reads_ok;         // Successful logical reads (after retries)
+    uint32_t retries;          // Extra attempts spent on successful reads
+    uint32_t srtt_ms;          // Smoothed response latency
+    uint32_t rto_ms;           // Current adaptive timeout
+    uint32_t since_ok_ms;      // Time since last good frame (UINT32_MAX = never)
+    uint32_t latency_hist[MODBUS_LATENCY_BUCKETS];
+} modbus_link_stats_t;
+
+// Upper bucket edges (ms) of latency_hist; the last bucket is open-ended.
+extern const uint16_t modbus_latency_bucket_ms[MODBUS_LATENCY_BUCKETS];
+
+// Incremental frame assembler — CRC is folded in as bytes arrive.
+typedef struct {
+    uint8_t *buf;
+    size_t   cap;
+    size_t   len;
+    size_t   expected;   // 0 = derive from byte count (0x03/0x04) or idle gap
+    uint16_t crc;
+    bool     overflow;
+} modbus_frame_t;
+
+/**
+ * @brief Start assembling a new response frame into buf.
+ * @param expected  Exact frame length if known (echo replies), else 0.
+ */
+void modbus_frame_begin(modbus_frame_t *f, uint8_t *buf, size_t cap, size_t expected);
+
+/**
+ * @brief Append received bytes and update the running CRC.
+ */
+void modbus_frame_feed(modbus_frame_t *f, const uint8_t *data, size_t n);
+
+/**
+ * @brief Classify the frame assembled so far.
+ * @param line_idle true when the RX timeout (inter-frame gap) has fired.
+ */
+modbus_rx_status_t modbus_frame_status(const modbus_frame_t *f, bool line_idle);
+
+/**
+ * @brief Install the UART driver (with event queue), pins and RX timeout.
+ */
+esp_err_t modbus_rtu_init(void);
+
+/**
+ * @brief Response timeout to use for the next request to a slave address.
+ *        RTO = SRTT + 4·RTTVAR learned from measured response latency
+ *        (TCP-style EWMA), doubled per consecutive timeout and clamped to
+ *        [MODBUS_TIMEOUT_MIN_MS, MODBUS_TIMEOUT_MAX_MS]. Addresses that
+ *        have never answered get MODBUS_TIMEOUT_INITIAL_MS.
+ */
+uint32_t modbus_rtu_timeout_ms(uint8_t addr);
+
+/**
+ * @brief Record a reply that passed CRC but failed the caller's header check.
+ */
+void modbus_rtu_note_header_error(uint8_t addr);
+
+/**
+ * @brief Record a successful logical read and how many retries it took.
+ */
+void modbus_rtu_note_read_ok(uint8_t addr, uint32_t retries);
+
+/**
+ * @brief Release the link slot of an address that turned out not to exist
+ *        (bus scans), so probing never crowds out real meters.
+ */
+void modbus_rtu_forget(uint8_t addr);
+
+/**
+ * @brief Snapshot link statistics for a slave address.
+ * @return false if the address has never been addressed.
+ */
+bool modbus_rtu_get_stats(uint8_t addr, modbus_link_stats_t *out);
+
+/**
+ * @brief Send a request (CRC already appended) and wait for the response.
+ *        Returns as soon as a complete frame is received or the line goes
+ *        idle — timeout_ms only bounds the silent-slave case. The measured
+ *        latency (or the timeout) feeds modbus_rtu_timeout_ms() for req[0].
+ * @param expected_len Exact response length if known, else 0.
+ * @param out_len      Bytes received (may be partial on error).
+ * @return ESP_OK                   complete frame, CRC verified
+ *         ESP_ERR_TIMEOUT          nothing / too little received
+ *         ESP_ERR_INVALID_CRC      CRC mismatch
+ *         ESP_ERR_INVALID_RESPONSE exception frame (code in resp[2])
+ *         ESP_ERR_INVALID_SIZE     RX overflow
+ *         ESP_FAIL                 UART write failed
+ */
+esp_err_t modbus_rtu_transact(const uint8_t *req, size_t req_len,
+                              uint8_t *resp, size_t resp_cap, size_t expected_len,
+                              uint32_t timeout_ms, size_t *out_len);
+
+/**
+ * @brief esp_timer time (µs) at which the last complete reply frame was
+ *        recognised — the start of the trip-latency budget. Bus owner only.
+ */
+int64_t modbus_rtu_frame_done_us(void);
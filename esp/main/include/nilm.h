@@ -0,0 +1,106 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "pzem_sensor.h"
+#include "config.h"
+
+// ============================================================
+// Appliance events (step-change NILM)
+//
+// Full reads are segmented into steady levels. A reading that leaves the
+// level by NILM_STEP_MIN_DW (or NILM_STEP_PCT of it) opens a transient; the
+// transient ends once NILM_SETTLE_READS readings agree, and the difference
+// between the two levels is an edge:
+//
+//     ΔP, ΔQ      active / reactive step (Q = √(S² − P²), unsigned)
+//     ΔPF         power-factor step
+//     inrush      peak current during the transient as % of the current
+//                 step — fast-poll samples are included, so a motor or
+//                 compressor start is seen at PZEM_FAST_POLL_INTERVAL_MS
+//     settle      time from the step to the settled level
+//
+// On-edges are clustered into a fixed table of NILM_MAX_APPLIANCES
+// signatures per channel by (ΔP, ΔQ) within NILM_MATCH_PCT; a new step
+// takes a free slot or the least recently seen idle one. Off-edges close
+// the running signature they match. While a signature runs, its step is
+// integrated into its energy total, and a relay trip is charged to every
+// signature running at the time. Dropping below NILM_IDLE_DW turns
+// everything off.
+//
+// Two loads switching within one settle window merge into one edge, and a
+// load whose power keeps moving (a heater on a thermostat ramp, an
+// inverter compressor) never settles and is rebased without an edge after
+// NILM_MAX_TRANSIENT_MS. The table and totals are kept in NVS so signature
+// ids stay stable across reboots.
+// ============================================================
+
+typedef enum {
+    NILM_EDGE_ON = 0,
+    NILM_EDGE_OFF,
+} nilm_edge_t;
+
+#define NILM_FLAG_NEW   0x01    // the on-edge created its signature
+#define NILM_FLAG_IDLE  0x02    // closed by the level dropping to idle, not by its own edge
+
+// One edge (24 bytes)
+typedef struct {
+    uint32_t timestamp;     // first reading off the previous level (ms)
+    int32_t  dp_dw;         // active-power step (0.1 W)
+    int32_t  dq_dvar;       // reactive-power step (0.1 var)
+    uint16_t appliance;     // signature id, 0 = unmatched
+    uint16_t inrush_pct;    // on-edges only
+    uint16_t settle_ms;
+    int8_t   dpf_pct;       // PF after − PF before (0.01)
+    uint8_t  channel;
+    uint8_t  edge;          // nilm_edge_t
+    uint8_t  flags;         // NILM_FLAG_*
+} nilm_event_t;
+
+// One signature and its totals
+typedef struct {
+    uint16_t id;            // 1.., unique per device; 0 = free slot
+    uint16_t inrush_pct;    // centroid
+    int32_t  dp_dw;         // centroid on-step (0.1 W)
+    int32_t  dq_dvar;       // centroid on-step (0.1 var)
+    uint32_t edges;         // on-edges matched
+    uint32_t trips;         // relay trips while running
+    uint32_t last_seq;      // edge sequence of the last match (eviction order)
+    uint64_t energy_mwh;
+    uint64_t run_ms;
+    uint8_t  running;       // instances on now
+} nilm_appliance_t;
+
+/**
+ * @brief Restore the signature tables from NVS and reset segmentation.
+ *        Call once before the anomaly task starts.
+ */
+void nilm_init(void);
+
+/**
+ * @brief Feed one reading (anomaly task only). Fast samples only track the
+ *        transient's peak current.
+ * @param out Receives the edges this reading produced (an idle drop can
+ *            close several signatures; extras beyond max close silently).
+ * @return Number of events written to out.
+ */
+uint8_t nilm_update(const pzem_data_t *data, nilm_event_t *out, uint8_t max);
+
+/**
+ * @brief Charge a relay trip on @p channel to every running signature.
+ */
+void nilm_note_trip(uint8_t channel);
+
+/**
+ * @brief Copy the used signatures of @p channel (any task).
+ * @return Number written to out.
+ */
+uint8_t nilm_get_appliances(uint8_t channel, nilm_appliance_t *out, uint8_t max);
+
+/**
+ * @brief Write the tables to NVS — at once after a new signature, otherwise
+ *        at most every NILM_PERSIST_MS. Call from the energy persist task.
+ */
+void nilm_persist(void);
+
+const char *nilm_edge_to_string(nilm_edge_t edge);
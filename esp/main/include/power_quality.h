@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "pzem_sensor.h"
+#include "config.h"
+
+// ============================================================
+// Power-quality event detector (short/long-duration RMS variations)
+//
+// Runs on every sample the anomaly task sees — the fast poll carries
+// voltage when PZEM_FAST_POLL_VOLTAGE is set, so events are resolved to
+// PZEM_FAST_POLL_INTERVAL_MS — and turns the voltage trace into one record
+// per sag, swell or interruption instead of a stream of per-reading
+// alarms. Duration is measured from the first reading outside the band to
+// the first one back inside it, so it is accurate to one poll period; the
+// IEEE 1159 category follows from it.
+//
+// PZEM path only. The ADC pilot (esp/pilot, per-cycle RMS) is not tracked
+// in this repository — esp/pilot/.gitignore excludes it — and is left out.
+// ============================================================
+
+typedef enum {
+    PQ_KIND_SAG = 0,            // PQ_INTERRUPT_PCT ≤ V < PQ_SAG_PCT
+    PQ_KIND_SWELL,              // V > PQ_SWELL_PCT
+    PQ_KIND_INTERRUPTION,       // V < PQ_INTERRUPT_PCT at any point of the event
+} pq_kind_t;
+
+// IEEE 1159 duration classes (interruptions have no instantaneous class
+// and start at momentary)
+typedef enum {
+    PQ_CAT_INSTANTANEOUS = 0,   // ≤ 30 cycles
+    PQ_CAT_MOMENTARY,           // ≤ 3 s
+    PQ_CAT_TEMPORARY,           // ≤ 1 min
+    PQ_CAT_SUSTAINED,           // > 1 min (under/overvoltage, sustained interruption)
+} pq_category_t;
+
+#define PQ_FLAG_SILENT  0x01    // part of the event was inferred from meter silence
+
+// One finished event (16 bytes)
+typedef struct {
+    uint32_t start_ms;      // timestamp of the first reading outside the band
+    uint32_t duration_ms;
+    uint16_t min_dv;        // lowest RMS voltage seen (0.1 V; 0 while silent)
+    uint16_t max_dv;        // highest RMS voltage seen (0.1 V)
+    uint8_t  channel;
+    uint8_t  kind;          // pq_kind_t
+    uint8_t  category;      // pq_category_t
+    uint8_t  flags;         // PQ_FLAG_*
+} pq_event_t;
+
+/**
+ * @brief Reset per-channel state. Call once before the anomaly task starts.
+ */
+void power_quality_init(void);
+
+/**
+ * @brief Feed one reading (anomaly task only). A failed read
+ *        (data->valid == false, channel and timestamp set) counts towards
+ *        PQ_SILENT_MISSES.
+ * @param out Filled when this reading ends an event.
+ * @return true if out holds a finished event.
+ */
+bool power_quality_update(const pzem_data_t *data, pq_event_t *out);
+
+const char *pq_kind_to_string(pq_kind_t kind);
+const char *pq_category_to_string(pq_category_t category);
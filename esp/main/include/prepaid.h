@@ -0,0 +1,104 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// ============================================================
+// Prepaid energy credit, enforced on the device
+//
+// The server never sends a balance to overwrite. It sends a credit document:
+// the cumulative energy granted by every top-up so far, the tariff and the
+// warning levels, under a sequence number and an HMAC signed with the
+// device's API key (checked in http_client.c before prepaid_apply()). The
+// device owns the balance:
+//
+//     balance_wh = granted_wh − (Σ lifetime energy now − anchor_wh)
+//
+// where anchor_wh is the lifetime energy (energy_counter.h) when credit
+// was first enabled. Consumption therefore survives reboots through the
+// energy checkpoints, a re-sent or replayed document changes nothing, and
+// a top-up takes effect the moment its document arrives.
+//
+// prepaid_update() runs every PREPAID_EVAL_MS from the energy task:
+// crossing a warning level logs and asks for an early sync so the server
+// sees the balance, and a balance at zero opens the relay and holds it open
+// (relay_set_lockout) until credit comes back — with or without a
+// connection to the server. The read task never calls in here; the only
+// credit state it sees is the relay's atomic lockout bit.
+// ============================================================
+
+typedef enum {
+    PREPAID_STATE_DISABLED = 0,     // no credit document, or credit switched off
+    PREPAID_STATE_OK,
+    PREPAID_STATE_LOW,              // balance ≤ warn_low_wh
+    PREPAID_STATE_CRITICAL,         // balance ≤ warn_critical_wh
+    PREPAID_STATE_EXHAUSTED,        // balance ≤ 0 — relay held open
+} prepaid_state_t;
+
+// A verified credit document
+typedef struct {
+    uint32_t seq;                   // increases with every change on the server
+    bool     enabled;
+    int64_t  granted_wh;            // cumulative top-ups
+    uint32_t tariff_milli;          // currency thousandths per kWh (display only)
+    uint32_t warn_low_wh;
+    uint32_t warn_critical_wh;
+} prepaid_doc_t;
+
+typedef struct {
+    prepaid_state_t state;
+    uint32_t        seq;
+    int64_t         balance_wh;
+    int64_t         balance_milli;  // balance_wh at the tariff, currency thousandths
+} prepaid_status_t;
+
+/**
+ * @brief Restore the last applied document and anchor from NVS.
+ *        Call after energy_counter_init() and relay_init().
+ */
+esp_err_t prepaid_init(void);
+
+/**
+ * @brief Apply a verified document (HTTP task). Ignored unless its seq is
+ *        newer than the active one; takes effect immediately, including
+ *        closing a relay that was opened for lack of credit.
+ */
+esp_err_t prepaid_apply(const prepaid_doc_t *doc);
+
+/**
+ * @brief Recompute the balance from the energy totals (energy task, every
+ *        PREPAID_EVAL_MS) and enforce warnings and cutoff.
+ */
+void prepaid_update(void);
+
+/**
+ * @brief Snapshot of the balance for reporting.
+ * @return false if the credit state was busy; @p out is then untouched and
+ *         must not be reported.
+ */
+bool prepaid_get_status(prepaid_status_t *out);
+
+/**
+ * @brief Sequence number of the active document (0 if none).
+ */
+uint32_t prepaid_seq(void);
+
+/**
+ * @brief Ask for a credit sync ahead of HTTP_CREDIT_POLL_MS (warning
+ *        crossed, or the server announced a newer seq).
+ */
+void prepaid_request_sync(void);
+
+/**
+ * @brief Return and clear the pending sync request.
+ */
+bool prepaid_take_sync_request(void);
+
+/**
+ * @brief Write the document and anchor to NVS if they changed.
+ *        Blocks on flash — call from the energy persist task only.
+ */
+void prepaid_persist(void);
+
+const char *prepaid_state_to_string(prepaid_state_t state);
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "pzem_sensor.h"
+
+// ============================================================
+// PZEM-004T v3.0 emulator
+//
+// Speaks the meter's Modbus RTU protocol in-process so the whole read →
+// detect → trip pipeline can run on a bare ESP32 with nothing attached to
+// the UART. Enabled with PZEM_EMULATOR_ENABLED in config.h; modbus_rtu
+// then hands every request to pzem_emulator_respond() instead of the UART
+// and feeds the reply through the normal frame assembler, so CRC checks,
+// timeouts and link statistics behave exactly as on the wire. On a Linux
+// host, esp/test/host builds the same emulator behind a pty (pzem_emu_pty)
+// for tools and tests that open a real serial port.
+//
+// Implemented protocol:
+//   0x04 read input registers 0x0000–0x0009 (V, I, P, E, F, PF, alarm)
+//   0x03 read holding registers 0x0001–0x0002 (power alarm, slave address)
+//   0x06 write single holding register
+//   0x42 reset energy
+//   exception replies 0x01/0x02/0x03; requests with a bad CRC are ignored
+//   0xF8 general address answered by every meter (bus collision if >1)
+// ============================================================
+
+// Scripted load/supply profiles
+typedef enum {
+    PZEM_EMU_STEADY = 0,        // 230 V, ~4.6 A resistive load
+    PZEM_EMU_APPLIANCE_CYCLE,   // base load + 2 kW heater cycling 20 s on/off
+    PZEM_EMU_INRUSH,            // motor start: 60 A for 300 ms, then 8 A
+    PZEM_EMU_OVERLOAD,          // ramps from 10 A to 35 A over 20 s
+    PZEM_EMU_SHORT_CIRCUIT,     // normal for 10 s, then 80 A bolted fault
+    PZEM_EMU_BROWNOUT,          // 10 s normal, 5 s at 185 V, 500 ms interruption
+    PZEM_EMU_THERMAL_RUNAWAY,   // power creeps up 2 %/s from 1.8 kW
+    PZEM_EMU_SCENARIO_COUNT,
+} pzem_emu_scenario_t;
+
+// Fault injection, per emulated meter. Percentages are per request.
+typedef struct {
+    uint8_t  silent_pct;      // no reply at all (dead/unpowered meter)
+    uint8_t  garble_pct;      // one byte of the reply bit-flipped
+    uint8_t  truncate_pct;    // reply cut short (line drops mid-frame)
+    uint16_t extra_delay_ms;  // added response latency (slow meter)
+    uint16_t jitter_ms;       // random 0..jitter_ms on top of the delay
+} pzem_emu_faults_t;
+
+/**
+ * @brief Create one emulated meter per configured channel address.
+ */
+void pzem_emulator_init(void);
+
+/**
+ * @brief Select the load profile of a meter; restarts its script clock.
+ */
+void pzem_emulator_set_scenario(uint8_t channel, pzem_emu_scenario_t scenario);
+
+/**
+ * @brief Set fault injection for a meter (NULL clears all faults).
+ */
+void pzem_emulator_set_faults(uint8_t channel, const pzem_emu_faults_t *faults);
+
+/**
+ * @brief Process one request frame as the meters on the bus would.
+ * @param resp      Reply buffer (≥ 25 bytes).
+ * @param delay_ms  Response latency the caller should wait before the reply.
+ * @return Reply length in bytes; 0 if no meter answers.
+ */
+size_t pzem_emulator_respond(const uint8_t *req, size_t req_len,
+                             uint8_t *resp, size_t resp_cap, uint32_t *delay_ms);
+
+/**
+ * @brief Reading a meter running @p scenario returns @p t_ms into its script,
+ *        without Modbus or wall-clock time — for offline replay (anomaly_bench).
+ *        Available whether or not PZEM_EMULATOR_ENABLED is set.
+ * @param alarm_w  Programmed power alarm threshold (W).
+ * @param rng      Caller's noise state, advanced on every call.
+ * @return false while the scripted supply is too low to power the meter.
+ */
+bool pzem_emulator_synth(pzem_emu_scenario_t scenario, uint32_t t_ms, uint16_t alarm_w,
+                         uint32_t *rng, pzem_data_t *out);
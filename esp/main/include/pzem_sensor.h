@@ -5,16 +5,22 @@
 #include "esp_err.h"
 #include "freertos/FreeRTOS.h"
 
-// Data from a single PZEM-004T v3.0 Modbus read
+// Data from a single PZEM-004T v3.0 Modbus read.
+// Fields keep the meter's native register scaling so no float conversion
+// happens between the UART and the JSON encoder; use fixed_fmt() to print.
 typedef struct {
-    float    v_rms;          // Voltage RMS (V)
-    float    i_rms;          // Current RMS (A)
-    float    power;          // Active power (W)
-    float    power_apparent; // Apparent power S = V * I (VA)
-    float    energy;         // Cumulative energy (Wh)
-    float    frequency;      // AC frequency (Hz)
-    float    power_factor;   // Power factor (0.00–1.00)
+    uint64_t energy_wh;      // Lifetime energy (Wh), monotonic — see energy_counter.h
+    uint32_t meter_wh;       // Raw PZEM energy register (Wh; resets and wraps)
+    uint32_t i_ma;           // Current RMS (mA)
+    uint32_t power_dw;       // Active power (0.1 W)
+    uint32_t apparent_dva;   // Apparent power S = V * I (0.1 VA)
     uint32_t timestamp;      // xTaskGetTickCount * portTICK_PERIOD_MS (ms)
+    uint16_t v_dv;           // Voltage RMS (0.1 V)
+    uint16_t freq_dhz;       // AC frequency (0.1 Hz)
+    uint8_t  pf_pct;         // Power factor (0.01, 0–100)
+    uint8_t  channel;        // Bus channel index (0..PZEM_CHANNEL_COUNT-1)
+    bool     power_alarm;    // Meter's on-chip power alarm (P ≥ programmed threshold)
+    bool     current_only;   // Fast poll sample: only i_ma, v_dv (see PZEM_FAST_POLL_VOLTAGE) and timestamp
     bool     valid;          // true if last read was successful
 } pzem_data_t;
 
@@ -26,6 +32,7 @@ esp_err_t pzem_sensor_init(void);
 
 /**
  * @brief Read all measurements from the PZEM-004T via Modbus RTU.
+ *        Equivalent to pzem_sensor_read_channel(0, out).
  * @param out Pointer to pzem_data_t to populate.
  * @return ESP_OK on success, ESP_ERR_TIMEOUT or ESP_FAIL on error.
  *         out->valid reflects the result.
@@ -33,14 +40,100 @@ esp_err_t pzem_sensor_init(void);
 esp_err_t pzem_sensor_read(pzem_data_t *out);
 
 /**
- * @brief Reset the energy accumulator register on the PZEM-004T.
+ * @brief Read all measurements from the meter on a given bus channel.
+ *        Only the channel's resolved address is used; after
+ *        PZEM_REDISCOVER_AFTER_FAILS consecutive failures a discovery pass
+ *        is scheduled (see pzem_sensor_discover).
+ * @param channel Channel index (0..PZEM_CHANNEL_COUNT-1).
+ * @param out     Populated on success; out->channel is always set.
+ * @return ESP_OK, ESP_ERR_INVALID_ARG, ESP_ERR_TIMEOUT or ESP_FAIL.
+ */
+esp_err_t pzem_sensor_read_channel(uint8_t channel, pzem_data_t *out);
+
+/**
+ * @brief Fast-path poll: read only the current registers — plus the
+ *        voltage register with PZEM_FAST_POLL_VOLTAGE (PZEM: 0x0000–0x0002,
+ *        11-byte response) — for sub-second overcurrent and power-quality
+ *        detection. Single attempt, no address probing, not cached for the
+ *        dashboard.
+ * @param out Populated with i_ma, v_dv and current_only = true on success.
+ */
+esp_err_t pzem_sensor_read_current(uint8_t channel, pzem_data_t *out);
+
+/**
+ * @brief Run one slice of a discovery pass, at most budget_ms of bus time.
+ *        A pass verifies the NVS registry / configured address of every
+ *        channel (plus 0xF8 and 0x01 for a lone meter), then scans
+ *        0x01–0xF7 for channels still missing, probing each address once
+ *        per distinct model among them. The pass resumes where the previous
+ *        slice stopped, so the whole address range is always covered while
+ *        the read cycle keeps running between slices. A complete map that
+ *        differs from the registry is saved to NVS when the pass ends.
+ *        Must run on the task that owns the bus (task_pzem_read).
+ * @return ESP_ERR_TIMEOUT if the slice ended mid-pass (call again),
+ *         ESP_OK if every channel answered, ESP_ERR_NOT_FOUND otherwise.
+ */
+esp_err_t pzem_sensor_discover(uint32_t budget_ms);
+
+/**
+ * @brief Ask the read task to run a discovery pass before its next cycle.
+ */
+void pzem_sensor_request_discovery(void);
+
+/**
+ * @brief True if a discovery pass has been requested (or none has run yet)
+ *        or one is still in progress.
+ */
+bool pzem_sensor_discovery_pending(void);
+
+/**
+ * @brief Set the over-power threshold programmed into every meter that has
+ *        an on-chip power alarm (PZEM-004T holding register 0x0001).
+ *        The write and read-back verification happen on the read task.
+ */
+void pzem_sensor_set_power_alarm(uint32_t watts);
+
+/**
+ * @brief True when meter alarm thresholds need (re)programming.
+ */
+bool pzem_sensor_alarm_sync_pending(void);
+
+/**
+ * @brief Write and verify the power-alarm threshold on every channel that
+ *        supports it. Must run on the task that owns the bus.
+ */
+esp_err_t pzem_sensor_sync_power_alarm(void);
+
+/**
+ * @brief Number of meter channels polled on the bus.
+ */
+uint8_t pzem_sensor_channel_count(void);
+
+/**
+ * @brief Modbus slave address currently used for a channel (0 if invalid).
+ */
+uint8_t pzem_sensor_channel_addr(uint8_t channel);
+
+/**
+ * @brief Reset the energy accumulator register on the PZEM-004T (channel 0).
  * @return ESP_OK on success.
  */
 esp_err_t pzem_reset_energy(void);
 
 /**
- * @brief Return a copy of the most recent successful PZEM reading.
+ * @brief Reset the energy accumulator register of the meter on a channel.
+ * @return ESP_ERR_NOT_SUPPORTED if the channel's meter model has no reset command.
+ */
+esp_err_t pzem_reset_energy_channel(uint8_t channel);
+
+/**
+ * @brief Return a copy of the most recent successful PZEM reading (channel 0).
  *        Thread-safe snapshot — populated after the first successful read.
  * @param out Destination struct; out->valid will be false if no read has succeeded yet.
  */
 void pzem_sensor_get_last(pzem_data_t *out);
+
+/**
+ * @brief Return a copy of the most recent successful reading on a channel.
+ */
+void pzem_sensor_get_last_channel(uint8_t channel, pzem_data_t *out);
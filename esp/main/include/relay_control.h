@@ -11,13 +11,18 @@ typedef enum {
     RELAY_STATE_TRIPPED,   // Emergency cut — requires manual reset
 } relay_state_t;
 
-typedef struct {
-    relay_state_t  state;
-    uint32_t       last_toggle_ms;
-    bool           auto_reset;
-    uint32_t       trip_count;
-    anomaly_type_t last_trip_reason;
-} relay_context_t;
+// ============================================================
+// Relay state machine
+//
+// State and lockout share one word that only changes inside a spinlock
+// (portENTER_CRITICAL) together with the pin write. The critical section
+// is a handful of register writes with no logging or blocking, so the
+// sensing task (see relay_trip) never waits behind a lower-priority holder
+// the way it could on a mutex. A trip racing an ON is ordered wholly
+// before it — the ON sees TRIPPED and is refused — or wholly after it,
+// opening the relay the ON just closed; the pin is never written from a
+// state that has already been replaced. Reads are lock-free.
+// ============================================================
 
 /**
  * @brief Configure the relay GPIO and set to safe OFF state.
@@ -33,13 +38,34 @@ esp_err_t relay_init(void);
 esp_err_t relay_set_state(relay_state_t new_state);
 
 /**
- * @brief Immediately open the relay, bypass cooldown, increment trip counter.
+ * @brief Hold the relay open (prepaid credit exhausted) or release it.
+ *        Locking opens an ON relay; while locked, relay_set_state(ON)
+ *        fails with ESP_ERR_INVALID_STATE. Releasing does not close it.
+ */
+esp_err_t relay_set_lockout(bool locked);
+
+/**
+ * @brief Whether the relay is held open by relay_set_lockout().
+ */
+bool relay_is_locked_out(void);
+
+/**
+ * @brief Trip from the sensing context: open the relay, bypass cooldown,
+ *        increment the trip counter. Never sleeps and never logs; at most
+ *        spins while another task finishes its own pin write.
  * @param reason The anomaly type that triggered the cutoff.
+ * @return esp_timer time (µs) at which the GPIO was written.
+ */
+int64_t relay_trip(anomaly_type_t reason);
+
+/**
+ * @brief relay_trip() plus an error log line — for callers outside the
+ *        sensing path (manual trip from the local dashboard).
  */
 void relay_emergency_cutoff(anomaly_type_t reason);
 
 /**
- * @brief Return current relay state (thread-safe).
+ * @brief Return current relay state (lock-free).
  */
 relay_state_t relay_get_state(void);
 
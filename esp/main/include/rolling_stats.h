@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// ============================================================
+// Sliding-window statistics over the last N integer samples
+//
+// Every update is O(1) regardless of N: sum and sum of squares are kept
+// as running uint64 totals (samples are native fixed-point integers, so
+// the totals are exact and never drift), and min/max come from monotonic
+// deques of sample positions. Storage is supplied by the caller so each
+// detector sizes its own window.
+//
+// Positions run modulo 2·N: every live deque entry is less than N
+// samples old, so ages stay unambiguous and the ring slot is pos % N.
+//
+// Exactness bound: sum_sq reaches N · max² for samples no larger than max,
+// so the sum of squares (and the variance) is exact only while
+// N · max² < 2^64 — samples up to 2^25 at the largest window, about 1.36e9
+// at N = 10, and a full-range uint32 sample only in a window of 1. Sum,
+// mean, min and max are exact for any uint32 samples at any window.
+// Callers check their range with ROLLING_STATS_EXACT().
+// ============================================================
+
+#define ROLLING_STATS_MAX_WINDOW    16383   // 2·N must fit a uint16_t position
+
+// True if a window of `window` samples, each ≤ max_sample, keeps sum_sq exact
+#define ROLLING_STATS_EXACT(window, max_sample) \
+    ((uint64_t)(max_sample) * (uint64_t)(max_sample) <= UINT64_MAX / (uint64_t)(window))
+
+typedef struct {
+    uint32_t *samples;      // ring, window entries
+    uint16_t *min_q;        // positions, values ascending front→back
+    uint16_t *max_q;        // positions, values descending front→back
+    uint16_t  window;
+    uint16_t  count;        // samples currently in the window (≤ window)
+    uint16_t  pos;          // position of the next sample, modulo 2·window
+    uint16_t  min_head, min_len;
+    uint16_t  max_head, max_len;
+    uint64_t  sum;
+    uint64_t  sum_sq;
+} rolling_stats_t;
+
+/**
+ * @brief Bind caller storage (three arrays of `window` entries) and clear.
+ * @param window 1..ROLLING_STATS_MAX_WINDOW
+ */
+void rolling_stats_init(rolling_stats_t *rs, uint32_t *samples,
+                        uint16_t *min_q, uint16_t *max_q, uint16_t window);
+
+/**
+ * @brief Drop all samples, keeping the storage binding.
+ */
+void rolling_stats_clear(rolling_stats_t *rs);
+
+/**
+ * @brief Push a sample, evicting the oldest once the window is full.
+ */
+void rolling_stats_push(rolling_stats_t *rs, uint32_t value);
+
+static inline bool rolling_stats_full(const rolling_stats_t *rs)
+{
+    return rs->count == rs->window;
+}
+
+static inline uint64_t rolling_stats_sum(const rolling_stats_t *rs)
+{
+    return rs->sum;
+}
+
+/**
+ * @brief Mean of the samples in the window, rounded down (0 when empty).
+ */
+uint32_t rolling_stats_mean(const rolling_stats_t *rs);
+
+/**
+ * @brief Population variance in squared sample units, rounded down.
+ *        Exact within the ROLLING_STATS_EXACT() bound only.
+ */
+uint64_t rolling_stats_variance(const rolling_stats_t *rs);
+
+/**
+ * @brief Smallest / largest sample in the window (0 when empty).
+ */
+uint32_t rolling_stats_min(const rolling_stats_t *rs);
+uint32_t rolling_stats_max(const rolling_stats_t *rs);
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+
+// ============================================================
+// Trip-path latency
+//
+// The read task stamps every reading on its way through the trip path
+// with esp_timer (µs):
+//
+//     frame    Modbus reply complete (modbus_rtu_frame_done_us)
+//     decode   reading decoded and folded into the energy totals
+//     detect   anomaly_analyze() returned — the trip decision
+//     open     relay GPIO written (relay_trip), trips only
+//
+// Every reading records frame → detect: the reading-to-decision time any
+// trip on that reading would have had. Each trip also records frame →
+// open. Both go into log-scale histograms (four buckets per octave, so a
+// percentile is at most 25 % high) — O(1) per reading and no per-sample
+// memory. Only the read task records; readers may see a histogram
+// mid-update, which shifts a percentile by one sample at most.
+// ============================================================
+
+typedef struct {
+    uint32_t count;
+    uint32_t p50_us;            // bucket upper bounds
+    uint32_t p99_us;
+    uint32_t max_us;            // exact
+} trip_latency_dist_t;
+
+typedef struct {
+    trip_latency_dist_t decision;       // frame → detect, every reading
+    trip_latency_dist_t open;           // frame → GPIO written, trips
+    uint32_t            decode_max_us;  // worst time per stage
+    uint32_t            detect_max_us;
+    uint32_t            gpio_max_us;
+} trip_latency_report_t;
+
+/**
+ * @brief Record one reading's path up to the trip decision (read task).
+ */
+void trip_latency_note_reading(int64_t frame_us, int64_t decoded_us, int64_t detected_us);
+
+/**
+ * @brief Record a trip (read task).
+ * @return Reading-to-open time, µs.
+ */
+uint32_t trip_latency_note_trip(int64_t frame_us, int64_t detected_us, int64_t open_us);
+
+void trip_latency_get(trip_latency_report_t *out);
@@ -0,0 +1,416 @@
+#include "anomaly_bench.h"
+#include "anomaly_detector.h"
+#include "anomaly_rules.h"
+#include "anomaly_model.h"
+#include "pzem_emulator.h"
+#include "relay_control.h"
+#include "config.h"
+#include "logger.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_MAX_DELAYS    32                  // per type, for the delay distribution
+#define BENCH_ALARM_W       ((uint16_t)MAX_POWER_W)
+#define BENCH_SEED          0x9E3779B9u
+#define BENCH_KERNEL_REPS   256                 // kernel calls timed per scenario
+
+#if PZEM_FAST_POLL_ENABLED
+#define BENCH_STEP_MS       PZEM_FAST_POLL_INTERVAL_MS
+#else
+#define BENCH_STEP_MS       PZEM_READ_INTERVAL_MS
+#endif
+
+#define TYPE_BIT(t)         (1u << (t))
+
+static const char *const scenario_names[PZEM_EMU_SCENARIO_COUNT] = {
+    [PZEM_EMU_STEADY]          = "steady load",
+    [PZEM_EMU_APPLIANCE_CYCLE] = "heater cycling",
+    [PZEM_EMU_INRUSH]          = "motor inrush",
+    [PZEM_EMU_OVERLOAD]        = "overload ramp",
+    [PZEM_EMU_SHORT_CIRCUIT]   = "bolted short",
+    [PZEM_EMU_BROWNOUT]        = "brownout",
+    [PZEM_EMU_THERMAL_RUNAWAY] = "thermal runaway",
+};
+
+// Confusion matrix column headers
+static const char *const type_abbr[ANOMALY_TYPE_COUNT] = {
+    [ANOMALY_NONE]          = "-",
+    [ANOMALY_SHORT_CIRCUIT] = "SC",
+    [ANOMALY_OVERCURRENT]   = "OC",
+    [ANOMALY_OVERPOWER]     = "OP",
+    [ANOMALY_WIRE_FIRE]     = "FIRE",
+    [ANOMALY_OVERVOLTAGE]   = "OV",
+    [ANOMALY_UNDERVOLTAGE]  = "UV",
+    [ANOMALY_LOW_POWER_FACTOR] = "PF",
+    [ANOMALY_FREQUENCY]     = "FREQ",
+};
+
+typedef struct {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t false_onsets;      // outside a labelled episode, or a repeat within one
+    uint32_t false_trips;       // false onsets whose rule opens the relay
+    uint32_t delays[BENCH_MAX_DELAYS];
+    uint8_t  n_delays;
+} bench_type_stats_t;
+
+// One labelled episode of a type within a scenario
+typedef struct {
+    bool     open;              // label true on the current sample
+    bool     pending;           // label ended; a detection until deadline still counts
+    bool     detected;
+    uint32_t start_ms;
+    uint32_t deadline_ms;
+} bench_label_t;
+
+static uint32_t           s_confusion[ANOMALY_TYPE_COUNT][ANOMALY_TYPE_COUNT];
+static bench_type_stats_t s_stats[ANOMALY_TYPE_COUNT];
+
+// ── Ground truth ──────────────────────────────────────────────────────────────
+
+// Types a correct protection should report for this reading. Supply limits
+// hold in every scenario; load faults only in the scenarios that script
+// them, so inrush and heater cycling must stay silent.
+static uint32_t expected_mask(pzem_emu_scenario_t sc, const pzem_data_t *d)
+{
+    float    v    = d->v_dv / 10.0f;
+    float    i    = d->i_ma / 1000.0f;
+    float    p    = d->power_dw / 10.0f;
+    uint32_t mask = 0;
+
+    if (v < VOLTAGE_MIN_V) mask |= TYPE_BIT(ANOMALY_UNDERVOLTAGE);
+    if (v > VOLTAGE_MAX_V) mask |= TYPE_BIT(ANOMALY_OVERVOLTAGE);
+
+    switch (sc) {
+        case PZEM_EMU_SHORT_CIRCUIT:
+            // A short is also an overcurrent; either element may clear it.
+            // At 80 A and PF 0.2 it also draws over MAX_POWER_W.
+            if (i > SHORT_CIRCUIT_THRESHOLD_A) mask |= TYPE_BIT(ANOMALY_SHORT_CIRCUIT);
+            if (i > OVERCURRENT_THRESHOLD_A)   mask |= TYPE_BIT(ANOMALY_OVERCURRENT);
+            if (p > MAX_POWER_W)               mask |= TYPE_BIT(ANOMALY_OVERPOWER);
+            break;
+        case PZEM_EMU_OVERLOAD:
+            if (i > OVERCURRENT_THRESHOLD_A) mask |= TYPE_BIT(ANOMALY_OVERCURRENT);
+            if (p > MAX_POWER_W)             mask |= TYPE_BIT(ANOMALY_OVERPOWER);
+            break;
+        case PZEM_EMU_THERMAL_RUNAWAY:
+            if (p > WIRE_FIRE_MIN_POWER_W)   mask |= TYPE_BIT(ANOMALY_WIRE_FIRE);
+            if (p > MAX_POWER_W)             mask |= TYPE_BIT(ANOMALY_OVERPOWER);
+            break;
+        default:
+            break;
+    }
+    return mask;
+}
+
+// Lowest-numbered type in a mask (matrix row/column), ANOMALY_NONE if empty
+static anomaly_type_t first_type(uint32_t mask)
+{
+    for (uint8_t t = 1; t < ANOMALY_TYPE_COUNT; t++) {
+        if (mask & TYPE_BIT(t)) return (anomaly_type_t)t;
+    }
+    return ANOMALY_NONE;
+}
+
+// ── Scoring ───────────────────────────────────────────────────────────────────
+
+static void label_update(bench_label_t *lbl, bench_type_stats_t *st, bool in, uint32_t t)
+{
+    if (lbl->pending && !in && t > lbl->deadline_ms) {
+        lbl->pending = false;
+        if (!lbl->detected) st->misses++;
+    }
+    if (in && !lbl->open) {
+        if (!lbl->pending) {
+            lbl->start_ms = t;
+            lbl->detected = false;
+        }
+        lbl->open    = true;
+        lbl->pending = false;
+    } else if (!in && lbl->open) {
+        lbl->open        = false;
+        lbl->pending     = true;
+        lbl->deadline_ms = t + ANOMALY_BENCH_GRACE_MS;
+    }
+}
+
+static void score_onset(bench_label_t *lbl, bench_type_stats_t *st,
+                        const anomaly_event_t *ev)
+{
+    if ((lbl->open || lbl->pending) && !lbl->detected) {
+        lbl->detected = true;
+        st->hits++;
+        if (st->n_delays < BENCH_MAX_DELAYS) {
+            st->delays[st->n_delays++] = ev->timestamp - lbl->start_ms;
+        }
+        return;
+    }
+    st->false_onsets++;
+    if (ev->relay_triggered) st->false_trips++;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+// ── Replay ────────────────────────────────────────────────────────────────────
+
+static void run_scenario(pzem_emu_scenario_t sc, uint32_t *readings,
+                         int64_t *cpu_us, int64_t *worst_us)
+{
+    bench_label_t   labels[ANOMALY_TYPE_COUNT] = {0};
+    anomaly_event_t events[ANOMALY_TYPE_COUNT];
+    uint32_t        active = 0;        // types with an open episode
+    uint32_t        rng    = BENCH_SEED;
+    uint32_t        n_read = 0, onsets = 0, false_before = 0;
+
+    for (uint8_t t = 0; t < ANOMALY_TYPE_COUNT; t++) false_before += s_stats[t].false_onsets;
+
+    anomaly_detector_init();
+
+    for (uint32_t t = BENCH_STEP_MS; t <= ANOMALY_BENCH_SCENARIO_MS; t += BENCH_STEP_MS) {
+        pzem_data_t truth;
+        if (!pzem_emulator_synth(sc, t, BENCH_ALARM_W, &rng, &truth)) continue;  // meter unpowered
+
+        pzem_data_t d = truth;
+        if (t % PZEM_READ_INTERVAL_MS != 0) {
+            // Fast poll: the meter was only asked for current
+            memset(&d, 0, sizeof(d));
+            d.i_ma         = truth.i_ma;
+            d.timestamp    = t;
+            d.current_only = true;
+            d.valid        = true;
+        }
+
+        uint32_t mask = expected_mask(sc, &truth);
+        for (uint8_t k = 1; k < ANOMALY_TYPE_COUNT; k++) {
+            label_update(&labels[k], &s_stats[k], (mask & TYPE_BIT(k)) != 0, t);
+        }
+
+        int64_t t0 = esp_timer_get_time();
+        uint8_t n  = anomaly_analyze(&d, events, ANOMALY_TYPE_COUNT);
+        int64_t dt = esp_timer_get_time() - t0;
+        *cpu_us += dt;
+        if (dt > *worst_us) *worst_us = dt;
+        n_read++;
+
+        for (uint8_t e = 0; e < n; e++) {
+            anomaly_type_t type = events[e].type;
+            if (events[e].phase == ANOMALY_PHASE_ONSET) {
+                active |= TYPE_BIT(type);
+                onsets++;
+                score_onset(&labels[type], &s_stats[type], &events[e]);
+            } else if (events[e].phase == ANOMALY_PHASE_CLEAR) {
+                active &= ~TYPE_BIT(type);
+            }
+        }
+
+        s_confusion[first_type(mask)][first_type(active)]++;
+    }
+
+    // Episodes still labelled (or in grace) at the end of the script
+    for (uint8_t k = 1; k < ANOMALY_TYPE_COUNT; k++) {
+        if ((labels[k].open || labels[k].pending) && !labels[k].detected) s_stats[k].misses++;
+    }
+
+    uint32_t false_after = 0;
+    for (uint8_t t = 0; t < ANOMALY_TYPE_COUNT; t++) false_after += s_stats[t].false_onsets;
+    ESP_LOGI(TAG_BENCH, "  %-16s %6lu readings  %3lu onsets  %3lu false",
+             scenario_names[sc], (unsigned long)n_read, (unsigned long)onsets,
+             (unsigned long)(false_after - false_before));
+    *readings += n_read;
+}
+
+// ── Learned scorer ────────────────────────────────────────────────────────────
+
+#if ANOMALY_MODEL_ENABLED
+// Worst-case dimensions with arbitrary weights: the kernel has no
+// data-dependent work, so this times any real model of the same size
+static void synthetic_model(anomaly_model_t *m)
+{
+    uint32_t rng = BENCH_SEED;
+
+    memset(m, 0, sizeof(*m));
+    m->version   = 1;
+    m->n_hidden  = ANOMALY_MODEL_MAX_HIDDEN;
+    m->shift1    = 7;
+    m->shift2    = 7;
+    m->confirm   = 1;
+    m->threshold = UINT32_MAX;
+    for (uint8_t k = 0; k < ANOMALY_MODEL_FEATURES; k++) {
+        m->mult[k] = 1 << 12;
+        for (uint8_t j = 0; j < ANOMALY_MODEL_MAX_HIDDEN; j++) {
+            rng = rng * 1664525u + 1013904223u;
+            m->w1[j][k] = (int8_t)(rng >> 24);
+            m->w2[k][j] = (int8_t)(rng >> 16);
+        }
+    }
+}
+
+// Full reads of every scenario through the scorer: flagged windows under
+// the active model (if any), per-reading cost, and kernel cost per window
+static void run_model(void)
+{
+    static anomaly_model_t synth;
+    uint32_t readings = 0, windows = 0;
+    int64_t  upd_us = 0, upd_worst = 0, kern_us = 0, kern_worst = 0;
+    uint32_t version = anomaly_model_version();
+
+    synthetic_model(&synth);
+    ESP_LOGI(TAG_BENCH, "Anomaly model: %s, %d-read windows",
+             version ? "active model scored" : "none loaded, flags not counted",
+             ANOMALY_MODEL_WINDOW);
+
+    for (uint8_t sc = 0; sc < PZEM_EMU_SCENARIO_COUNT; sc++) {
+        anomaly_model_flag_t flag;
+        uint32_t             rng     = BENCH_SEED;
+        uint32_t             flagged = 0, n_read = 0;
+        int32_t              f[ANOMALY_MODEL_FEATURES] = {0};
+
+        anomaly_model_init();   // fresh windows and holdoffs
+        for (uint32_t t = PZEM_READ_INTERVAL_MS; t <= ANOMALY_BENCH_SCENARIO_MS;
+             t += PZEM_READ_INTERVAL_MS) {
+            pzem_data_t d;
+            if (!pzem_emulator_synth((pzem_emu_scenario_t)sc, t, BENCH_ALARM_W, &rng, &d)) continue;
+
+            int64_t t0 = esp_timer_get_time();
+            if (anomaly_model_update(&d, &flag)) flagged++;
+            int64_t dt = esp_timer_get_time() - t0;
+            upd_us += dt;
+            if (dt > upd_worst) upd_worst = dt;
+            n_read++;
+
+            f[AMODEL_F_V_MEAN] = d.v_dv;
+            f[AMODEL_F_I_MEAN] = (int32_t)d.i_ma;
+            f[AMODEL_F_P_MEAN] = (int32_t)d.power_dw;
+        }
+
+        volatile uint32_t sink = 0;
+        for (uint16_t r = 0; r < BENCH_KERNEL_REPS; r++) {
+            int64_t t0 = esp_timer_get_time();
+            sink += anomaly_model_score(&synth, f);
+            int64_t dt = esp_timer_get_time() - t0;
+            kern_us += dt;
+            if (dt > kern_worst) kern_worst = dt;
+        }
+        (void)sink;
+
+        ESP_LOGI(TAG_BENCH, "  %-16s %4lu windows  %3lu flagged", scenario_names[sc],
+                 (unsigned long)(n_read / ANOMALY_MODEL_WINDOW), (unsigned long)flagged);
+        readings += n_read;
+        windows  += n_read / ANOMALY_MODEL_WINDOW;
+    }
+    anomaly_model_init();
+
+    uint32_t reps = BENCH_KERNEL_REPS * PZEM_EMU_SCENARIO_COUNT;
+    ESP_LOGI(TAG_BENCH, "Model kernel: %u MACs, %lu ns/window mean, %lu us worst",
+             2 * ANOMALY_MODEL_FEATURES * ANOMALY_MODEL_MAX_HIDDEN,
+             (unsigned long)(kern_us * 1000 / reps), (unsigned long)kern_worst);
+    ESP_LOGI(TAG_BENCH, "Model update: %lu readings, %lu windows, %lu ns/reading mean, %lu us worst",
+             (unsigned long)readings, (unsigned long)windows,
+             (unsigned long)(readings ? upd_us * 1000 / readings : 0), (unsigned long)upd_worst);
+    ESP_LOGI(TAG_BENCH, "Model memory: %u B static (%u B model), %u B per queued flag",
+             (unsigned)anomaly_model_ram_bytes(), (unsigned)sizeof(anomaly_model_t),
+             (unsigned)sizeof(anomaly_model_flag_t));
+}
+#endif
+
+// ── Report ────────────────────────────────────────────────────────────────────
+
+static void report_confusion(void)
+{
+    char line[96];
+    int  len = snprintf(line, sizeof(line), "  %-5s", "exp\\det");
+    for (uint8_t c = 0; c < ANOMALY_TYPE_COUNT; c++) {
+        len += snprintf(line + len, sizeof(line) - len, " %6s", type_abbr[c]);
+    }
+    ESP_LOGI(TAG_BENCH, "Sample confusion matrix:");
+    ESP_LOGI(TAG_BENCH, "%s", line);
+
+    for (uint8_t r = 0; r < ANOMALY_TYPE_COUNT; r++) {
+        len = snprintf(line, sizeof(line), "  %-7s", type_abbr[r]);
+        for (uint8_t c = 0; c < ANOMALY_TYPE_COUNT; c++) {
+            len += snprintf(line + len, sizeof(line) - len, " %6lu",
+                            (unsigned long)s_confusion[r][c]);
+        }
+        ESP_LOGI(TAG_BENCH, "%s", line);
+    }
+}
+
+static void report_types(void)
+{
+    ESP_LOGI(TAG_BENCH, "Episodes and detection delay (ms):");
+    for (uint8_t t = 1; t < ANOMALY_TYPE_COUNT; t++) {
+        bench_type_stats_t *st = &s_stats[t];
+        if (!st->hits && !st->misses && !st->false_onsets) continue;
+
+        char delay[64] = "-";
+        if (st->n_delays) {
+            qsort(st->delays, st->n_delays, sizeof(st->delays[0]), cmp_u32);
+            snprintf(delay, sizeof(delay), "min %lu  med %lu  p95 %lu  max %lu",
+                     (unsigned long)st->delays[0],
+                     (unsigned long)st->delays[st->n_delays / 2],
+                     (unsigned long)st->delays[(st->n_delays * 95 - 1) / 100],
+                     (unsigned long)st->delays[st->n_delays - 1]);
+        }
+        ESP_LOGI(TAG_BENCH, "  %-14s hit %lu  miss %lu  false %lu (trips %lu)  %s",
+                 anomaly_type_to_string((anomaly_type_t)t),
+                 (unsigned long)st->hits, (unsigned long)st->misses,
+                 (unsigned long)st->false_onsets, (unsigned long)st->false_trips, delay);
+    }
+}
+
+bool anomaly_bench_run(void)
+{
+    memset(s_confusion, 0, sizeof(s_confusion));
+    memset(s_stats,     0, sizeof(s_stats));
+
+    uint32_t readings = 0;
+    int64_t  cpu_us   = 0;
+    int64_t  worst_us = 0;
+
+    ESP_LOGW(TAG_BENCH, "Detector benchmark: rules v%lu, %d s per scenario, %d ms cadence",
+             (unsigned long)anomaly_rules_version(), ANOMALY_BENCH_SCENARIO_MS / 1000,
+             BENCH_STEP_MS);
+
+    // The detector's own info logs would swamp the report
+    esp_log_level_set(TAG_ANOMALY, ESP_LOG_WARN);
+    for (uint8_t sc = 0; sc < PZEM_EMU_SCENARIO_COUNT; sc++) {
+        run_scenario((pzem_emu_scenario_t)sc, &readings, &cpu_us, &worst_us);
+    }
+    anomaly_detector_init();
+    esp_log_level_set(TAG_ANOMALY, ESP_LOG_INFO);
+
+    report_confusion();
+    report_types();
+    ESP_LOGI(TAG_BENCH, "CPU: %lu readings, %lu ns/reading mean, %lu us worst",
+             (unsigned long)readings,
+             (unsigned long)(readings ? cpu_us * 1000 / readings : 0),
+             (unsigned long)worst_us);
+
+    uint32_t misses = 0, false_trips = 0;
+    for (uint8_t t = 1; t < ANOMALY_TYPE_COUNT; t++) {
+        misses      += s_stats[t].misses;
+        false_trips += s_stats[t].false_trips;
+    }
+    if (misses || false_trips) {
+        ESP_LOGW(TAG_BENCH, "Verdict: %lu missed episode(s), %lu false trip(s)",
+                 (unsigned long)misses, (unsigned long)false_trips);
+    } else {
+        ESP_LOGI(TAG_BENCH, "Verdict: every labelled episode detected, no false trips");
+    }
+
+#if ANOMALY_MODEL_ENABLED
+    esp_log_level_set(TAG_ANOMALY, ESP_LOG_ERROR);
+    run_model();
+    esp_log_level_set(TAG_ANOMALY, ESP_LOG_INFO);
+#endif
+    return !misses && !false_trips;
+}
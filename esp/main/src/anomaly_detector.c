@@ -1,132 +1,578 @@
 #include "anomaly_detector.h"
+#include "anomaly_rules.h"
+#include "relay_control.h"
 #include "config.h"
 #include "logger.h"
 
 #include "esp_log.h"
+#include "esp_random.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
-#include <math.h>
+#include <stdatomic.h>
 #include <string.h>
 
-static overcurrent_state_t  oc_state;
-static fire_detector_state_t fire_state;
+#define FIRE_BASELINE_MIN_DW        10      // 1 W — below this there is no baseline
+#define THERMAL_MAX_STEP_MS         5000    // longest gap integrated as one step
+
+// One detector state per bus channel — meters on a shared bus are
+// independent circuits and must not share confirm timers or baselines.
+static rule_confirm_state_t  rule_state[PZEM_CHANNEL_COUNT][ANOMALY_MAX_RULES];
+static fire_detector_state_t fire_state[PZEM_CHANNEL_COUNT];
+static pzem_data_t           last_full[PZEM_CHANNEL_COUNT];  // for fast-sample events
+static anomaly_episode_t     episodes[PZEM_CHANNEL_COUNT][ANOMALY_TYPE_COUNT];
+static uint32_t              trips_due[PZEM_CHANNEL_COUNT];   // see anomaly_detector_trips_due
+static uint32_t              episode_seq;   // seeded per boot so IDs do not repeat
+static atomic_bool           reset_requested;
+
+// Table the per-rule state was built against. A swap keeps the state of
+// rules that did not change (see rebind_rule_state).
+static const anomaly_ruleset_t *bound_set = NULL;
+static uint32_t                 bound_gen;
+static uint8_t                  bound_count;
+static anomaly_rule_t           bound_rules[ANOMALY_MAX_RULES];
+
+static const char *const metric_names[RULE_METRIC_COUNT] = {
+    [RULE_METRIC_CURRENT]     = "I (mA)",
+    [RULE_METRIC_VOLTAGE]     = "V (0.1 V)",
+    [RULE_METRIC_POWER]       = "P (0.1 W)",
+    [RULE_METRIC_POWER_ALARM] = "meter alarm (W)",
+    [RULE_METRIC_POWER_RISE]  = "P/baseline (x100)",
+    [RULE_METRIC_THERMAL]     = "I2t, rated (mA)",
+    [RULE_METRIC_POWER_FACTOR] = "PF (x100)",
+    [RULE_METRIC_FREQUENCY]   = "f (0.1 Hz)",
+    [RULE_METRIC_ROCOF]       = "df/dt (0.01 Hz/s)",
+};
 
 void anomaly_detector_init(void)
 {
-    memset(&oc_state,   0, sizeof(oc_state));
-    memset(&fire_state, 0, sizeof(fire_state));
-    oc_state.threshold = OVERCURRENT_CONFIRM_COUNT;
+    memset(rule_state, 0, sizeof(rule_state));
+    memset(fire_state, 0, sizeof(fire_state));
+    memset(last_full,  0, sizeof(last_full));
+    memset(episodes,   0, sizeof(episodes));
+    memset(trips_due,  0, sizeof(trips_due));
+    bound_set   = NULL;
+    episode_seq = esp_random();
+    atomic_store(&reset_requested, false);
+    for (uint8_t ch = 0; ch < PZEM_CHANNEL_COUNT; ch++) {
+        fire_detector_state_t *fs = &fire_state[ch];
+        rolling_stats_init(&fs->window, fs->samples, fs->min_q, fs->max_q, FIRE_HISTORY_SIZE);
+    }
 
-    ESP_LOGI(TAG_ANOMALY, "Anomaly detector initialized");
-    ESP_LOGI(TAG_ANOMALY, "  Short circuit:  I > %.0f A (instant)", SHORT_CIRCUIT_THRESHOLD_A);
-    ESP_LOGI(TAG_ANOMALY, "  Overcurrent:    I > %.0f A (x%d sustained)", OVERCURRENT_THRESHOLD_A, OVERCURRENT_CONFIRM_COUNT);
-    ESP_LOGI(TAG_ANOMALY, "  Wire fire:      Power > %.1fx baseline AND > %.0f W", WIRE_FIRE_POWER_RATIO, WIRE_FIRE_MIN_POWER_W);
-    ESP_LOGI(TAG_ANOMALY, "  Voltage range:  %.0f–%.0f V", VOLTAGE_MIN_V, VOLTAGE_MAX_V);
+    const anomaly_ruleset_t *set = anomaly_rules_acquire();
+    ESP_LOGI(TAG_ANOMALY, "Anomaly detector initialized (rules v%lu)", (unsigned long)set->version);
+    for (uint8_t i = 0; i < set->count; i++) {
+        const anomaly_rule_t *r = &set->rules[i];
+        ESP_LOGI(TAG_ANOMALY, "  %-14s %s %c %lu  confirm %u ms  %s",
+                 anomaly_type_to_string((anomaly_type_t)r->type), metric_names[r->metric],
+                 r->cmp == RULE_CMP_LT ? '<' : '>', (unsigned long)r->threshold,
+                 r->confirm_ms, r->action == RULE_ACTION_TRIP ? "trip" : "log");
+    }
+    anomaly_rules_release();
 }
 
-static bool detect_short_circuit(float i_rms)
+// ── Derived metrics ───────────────────────────────────────────────────────────
+
+// Power samples are clamped to 100 kW, far above any supported meter's full
+// scale, so a garbage register cannot push the window past its exact range.
+#define FIRE_SAMPLE_MAX_DW  1000000u
+
+_Static_assert(ROLLING_STATS_EXACT(FIRE_HISTORY_SIZE, FIRE_SAMPLE_MAX_DW),
+               "FIRE_HISTORY_SIZE too long for exact power-window statistics");
+
+// Feed the power window. Returns true once a baseline exists and sets the
+// window mean; the first full window only establishes the baseline. A
+// step of more than FIRE_STEP_PCT since the last read restarts both.
+static bool update_power_window(fire_detector_state_t *fs, uint32_t power_dw, uint32_t *avg_dw)
 {
-    return i_rms > SHORT_CIRCUIT_THRESHOLD_A;
+    uint32_t p    = power_dw < FIRE_SAMPLE_MAX_DW ? power_dw : FIRE_SAMPLE_MAX_DW;
+    uint32_t step = p > fs->last_dw ? p - fs->last_dw : fs->last_dw - p;
+    if (fs->last_dw && (uint64_t)step * 100 > (uint64_t)fs->last_dw * FIRE_STEP_PCT) {
+        rolling_stats_clear(&fs->window);
+        fs->baseline_dw = 0;
+    }
+    fs->last_dw = p;
+    rolling_stats_push(&fs->window, p);
+
+    // Not enough history yet
+    if (!rolling_stats_full(&fs->window)) {
+        return false;
+    }
+
+    *avg_dw = rolling_stats_mean(&fs->window);
+
+    // Establish baseline on first full window
+    if (fs->baseline_dw < FIRE_BASELINE_MIN_DW) {
+        fs->baseline_dw = *avg_dw;
+        ESP_LOGD(TAG_ANOMALY, "Wire fire baseline set: %lu.%lu W",
+                 (unsigned long)(*avg_dw / 10), (unsigned long)(*avg_dw % 10));
+        return false;
+    }
+    return true;
 }
 
-static bool detect_overcurrent(float i_rms)
+// Steady load: the window spread is within FIRE_FLAT_PCT of its mean
+static bool power_window_flat(const fire_detector_state_t *fs, uint32_t avg_dw)
 {
-    if (i_rms > OVERCURRENT_THRESHOLD_A) {
-        oc_state.count++;
-        if (oc_state.count >= oc_state.threshold) {
-            return true;
-        }
-    } else {
-        oc_state.count = 0;
+    uint32_t spread = rolling_stats_max(&fs->window) - rolling_stats_min(&fs->window);
+    return (uint64_t)spread * 100 <= (uint64_t)avg_dw * FIRE_FLAT_PCT;
+}
+
+// Inverse-time overcurrent: heat rises by (I² − Ir²)·dt above the rated
+// current and decays exponentially (τ = arg2) at or below it. Returns the
+// heat as a percentage of the trip constant K (arg, A²s).
+static uint32_t thermal_update(rule_confirm_state_t *st, const anomaly_rule_t *r,
+                               uint32_t i_ma, uint32_t now_ms)
+{
+    uint32_t dt = st->last_ms ? now_ms - st->last_ms : 0;
+    if (dt > THERMAL_MAX_STEP_MS) dt = THERMAL_MAX_STEP_MS;
+    st->last_ms = now_ms ? now_ms : 1;
+
+    uint64_t i2   = (uint64_t)i_ma * i_ma;
+    uint64_t ir2  = (uint64_t)r->threshold * r->threshold;
+    uint64_t trip = (uint64_t)r->arg * 1000000000ULL;    // A²s → mA²·ms
+    if (i2 > ir2) {
+        st->heat += (i2 - ir2) * dt;
+        if (st->heat > trip) st->heat = trip;           // cooling starts from "just tripped"
+    } else if (dt) {
+        st->heat -= dt >= r->arg2 ? st->heat : st->heat / r->arg2 * dt;
     }
-    return false;
+    return (uint32_t)(st->heat / (trip / 100));
 }
 
-static bool detect_wire_fire(float power)
+// Rate of change of frequency across a window of at least arg ms, in
+// 0.01 Hz/s. Between windows the last rate is held so the confirm timer
+// sees a steady value; a gap longer than four windows restarts it.
+static uint32_t rocof_update(rule_confirm_state_t *st, const anomaly_rule_t *r,
+                             uint16_t f_dhz, uint32_t now_ms)
 {
-    // Store in circular history
-    fire_state.history[fire_state.head] = power;
-    fire_state.head = (fire_state.head + 1) % FIRE_HISTORY_SIZE;
-    if (fire_state.count < FIRE_HISTORY_SIZE) {
-        fire_state.count++;
+    uint32_t dt = now_ms - st->last_ms;
+    if (!st->last_ms || dt > 4 * r->arg) {
+        st->last_ms = now_ms ? now_ms : 1;
+        st->ref_dhz = f_dhz;
+        st->rate    = 0;
+        return 0;
     }
+    if (dt < r->arg) return st->rate;
 
-    // Not enough history yet
-    if (fire_state.count < FIRE_HISTORY_SIZE) {
-        return false;
+    uint32_t df = f_dhz > st->ref_dhz ? f_dhz - st->ref_dhz : st->ref_dhz - f_dhz;
+    st->rate    = df * 10000 / dt;      // 0.1 Hz per ms → 0.01 Hz per s
+    st->last_ms = now_ms;
+    st->ref_dhz = f_dhz;
+    return st->rate;
+}
+
+// Value of the rule's metric for this sample; false when the sample does
+// not carry it (fast polls have current only, power_rise needs a baseline,
+// a meter that measured no frequency reports 0).
+static bool metric_value(const anomaly_rule_t *r, const pzem_data_t *d,
+                         bool have_rise, uint32_t rise_x100, uint32_t *value)
+{
+    if (d->current_only && r->metric != RULE_METRIC_CURRENT &&
+        r->metric != RULE_METRIC_THERMAL) return false;
+
+    switch (r->metric) {
+        case RULE_METRIC_CURRENT:     *value = d->i_ma;       return true;
+        case RULE_METRIC_VOLTAGE:     *value = d->v_dv;       return true;
+        case RULE_METRIC_POWER:       *value = d->power_dw;   return true;
+        case RULE_METRIC_POWER_ALARM: *value = d->power_alarm; return true;
+        case RULE_METRIC_POWER_RISE:  *value = rise_x100;     return have_rise;
+        case RULE_METRIC_THERMAL:     *value = d->i_ma;       return true;
+        case RULE_METRIC_POWER_FACTOR: *value = d->pf_pct;    return true;
+        case RULE_METRIC_FREQUENCY:
+        case RULE_METRIC_ROCOF:       *value = d->freq_dhz;   return d->freq_dhz != 0;
+        default:                      return false;
     }
+}
 
-    // Rolling average
-    float sum = 0.0f;
-    for (uint8_t i = 0; i < FIRE_HISTORY_SIZE; i++) {
-        sum += fire_state.history[i];
+// relaxed: the rule owns an open episode, so the threshold is moved
+// ANOMALY_CLEAR_MARGIN_PCT towards normal. Alarm and thermal rules carry
+// their own memory and are not relaxed. gate is the load the rule needs
+// before its metric means anything: the window mean (0.1 W) for
+// power_rise, the current (mA) for power_factor.
+static bool rule_condition(const anomaly_rule_t *r, uint32_t value, uint32_t gate, bool relaxed)
+{
+    switch (r->metric) {
+        case RULE_METRIC_POWER_ALARM:
+            // The meter already compared P against the programmed threshold
+            return value != 0;
+        case RULE_METRIC_POWER_RISE:
+            if (gate <= r->arg) return false;
+            break;
+        case RULE_METRIC_POWER_FACTOR:
+            if (gate < r->arg) return false;
+            break;
+        case RULE_METRIC_THERMAL:
+            // value is heat in % of K (see thermal_update)
+            return value >= 100;
+        default:
+            break;
     }
-    float avg_power = sum / (float)FIRE_HISTORY_SIZE;
+    uint32_t thr    = r->threshold;
+    uint32_t margin = relaxed ? (uint32_t)((uint64_t)thr * ANOMALY_CLEAR_MARGIN_PCT / 100) : 0;
+    // 2 % of 60 Hz would span the whole normal band; one meter count instead
+    if (relaxed && r->metric == RULE_METRIC_FREQUENCY) margin = 1;
+    return r->cmp == RULE_CMP_LT ? value < thr + margin : value > thr - margin;
+}
 
-    // Establish baseline on first full window
-    if (fire_state.baseline_power < 1.0f) {
-        fire_state.baseline_power = avg_power;
-        ESP_LOGI(TAG_ANOMALY, "Wire fire baseline set: %.1f W", fire_state.baseline_power);
+static bool rule_confirmed(rule_confirm_state_t *st, bool cond, uint32_t now_ms, uint16_t confirm_ms)
+{
+    if (!cond) {
+        st->above = false;
         return false;
     }
+    if (!st->above) {
+        st->above          = true;
+        st->above_since_ms = now_ms;
+    }
+    return now_ms - st->above_since_ms >= confirm_ms;
+}
+
+// ── Episodes ──────────────────────────────────────────────────────────────────
+
+static uint32_t next_episode_id(void)
+{
+    if (++episode_seq == 0) ++episode_seq;
+    return episode_seq;
+}
+
+static bool rule_unchanged(const anomaly_ruleset_t *set, uint8_t i)
+{
+    if (i >= bound_count) return false;
+    const anomaly_rule_t *r = &set->rules[i];
+    const anomaly_rule_t *o = &bound_rules[i];
+    return r->type == o->type && r->metric == o->metric && r->cmp == o->cmp &&
+           r->severity == o->severity && r->action == o->action &&
+           r->confirm_ms == o->confirm_ms && r->threshold == o->threshold &&
+           r->arg == o->arg && r->arg2 == o->arg2;
+}
+
+// A new table keeps the state of every rule whose slot holds the same rule
+// as before. A thermal rule with the same rated current and K also keeps
+// its heat — a cooling-time or severity edit must not forget how hot the
+// wiring already is. Any other rule starts over.
+static void rebind_rule_state(const anomaly_ruleset_t *set)
+{
+    for (uint8_t i = 0; i < ANOMALY_MAX_RULES; i++) {
+        if (i < set->count && rule_unchanged(set, i)) continue;
 
-    // Detect sudden power increase
-    bool fire_detected = (avg_power > WIRE_FIRE_MIN_POWER_W) &&
-                         (fire_state.baseline_power > 1.0f) &&
-                         (avg_power / fire_state.baseline_power > WIRE_FIRE_POWER_RATIO);
+        const anomaly_rule_t *r = &set->rules[i];
+        const anomaly_rule_t *o = &bound_rules[i];
+        bool keep_heat = i < set->count && i < bound_count &&
+                         r->metric == RULE_METRIC_THERMAL && o->metric == RULE_METRIC_THERMAL &&
+                         r->threshold == o->threshold && r->arg == o->arg;
 
-    // Slow-moving baseline adaptation (not during fire event)
-    if (!fire_detected) {
-        fire_state.baseline_power = 0.9f * fire_state.baseline_power + 0.1f * avg_power;
+        for (uint8_t ch = 0; ch < PZEM_CHANNEL_COUNT; ch++) {
+            rule_confirm_state_t *st = &rule_state[ch][i];
+            rule_confirm_state_t  old = *st;
+            memset(st, 0, sizeof(*st));
+            if (keep_heat) {
+                st->heat    = old.heat;
+                st->last_ms = old.last_ms;
+            }
+        }
     }
+}
 
-    return fire_detected;
+// A new table keeps open episodes: an episode whose rule is unchanged stays
+// with it, any other moves to the first rule of its type in the new table,
+// or is orphaned (rule = ANOMALY_MAX_RULES) and clears.
+static void rebind_episodes(const anomaly_ruleset_t *set)
+{
+    for (uint8_t ch = 0; ch < PZEM_CHANNEL_COUNT; ch++) {
+        for (uint8_t t = 0; t < ANOMALY_TYPE_COUNT; t++) {
+            anomaly_episode_t *ep = &episodes[ch][t];
+            if (!ep->active) continue;
+            if (ep->rule < set->count && rule_unchanged(set, ep->rule)) continue;
+            ep->rule = ANOMALY_MAX_RULES;
+            for (uint8_t i = 0; i < set->count; i++) {
+                if (set->rules[i].type == t) {
+                    ep->rule = i;
+                    break;
+                }
+            }
+        }
+    }
 }
 
-static anomaly_type_t detect_voltage_anomaly(float v_rms)
+static void episode_open(anomaly_episode_t *ep, uint8_t idx, const anomaly_rule_t *r,
+                         uint32_t onset_ms, uint32_t value, uint32_t now_ms)
 {
-    if (v_rms > VOLTAGE_MAX_V) return ANOMALY_OVERVOLTAGE;
-    if (v_rms < VOLTAGE_MIN_V) return ANOMALY_UNDERVOLTAGE;
-    return ANOMALY_NONE;
+    memset(ep, 0, sizeof(*ep));
+    ep->active    = true;
+    ep->rule      = idx;
+    ep->metric    = r->metric;
+    ep->severity  = r->severity;
+    ep->trip      = r->action == RULE_ACTION_TRIP;
+    ep->id        = next_episode_id();
+    ep->onset_ms  = onset_ms;
+    ep->last_ms   = now_ms;
+    ep->report_ms = now_ms;
+    ep->peak      = value;
+    ep->min       = value;
+    ep->relay_trips = relay_get_trip_count();
 }
 
-bool anomaly_analyze(const pzem_data_t *data, anomaly_event_t *event)
+// A trip rule confirmed while a log-only rule of the same type owns the
+// episode: the trip rule takes the episode over in place (same id and
+// onset) and the rollup restarts in its metric.
+static void episode_escalate(anomaly_episode_t *ep, uint8_t idx, const anomaly_rule_t *r,
+                             uint32_t value, uint32_t now_ms)
 {
-    if (!data || !data->valid || !event) return false;
+    ep->rule      = idx;
+    ep->metric    = r->metric;
+    ep->trip      = true;
+    if (r->severity > ep->severity) ep->severity = r->severity;
+    ep->clearing  = false;
+    ep->last_ms   = now_ms;
+    ep->report_ms = now_ms;
+    ep->peak      = value;
+    ep->min       = value;
+    ep->integral  = 0;
+}
 
-    anomaly_type_t type = ANOMALY_NONE;
+// Fold one sample into the rollup; only samples meeting the (relaxed)
+// condition count towards peak, min and the integral.
+static void episode_fold(anomaly_episode_t *ep, uint32_t value, bool cond, uint32_t now_ms)
+{
+    uint32_t dt = now_ms - ep->last_ms;
+    ep->last_ms = now_ms;
+    if (!cond) return;
+    ep->integral += (uint64_t)value * dt;
+    if (value > ep->peak) ep->peak = value;
+    if (value < ep->min)  ep->min  = value;
+}
+
+// Advance the clear hold. Returns the transition due on this sample, or -1.
+// The caller commits it (emit_event) only if there is room to report it.
+static int episode_step(anomaly_episode_t *ep, bool cond, uint32_t now_ms)
+{
+    if (cond) {
+        ep->clearing = false;
+    } else if (!ep->clearing) {
+        ep->clearing       = true;
+        ep->clear_since_ms = now_ms;
+    } else if (now_ms - ep->clear_since_ms >= ANOMALY_CLEAR_HOLD_MS) {
+        return ANOMALY_PHASE_CLEAR;
+    }
+    if (now_ms - ep->report_ms >= ANOMALY_ROLLUP_MS) {
+        return ANOMALY_PHASE_UPDATE;
+    }
+    return -1;
+}
 
-    // Check in priority order
-    if (detect_short_circuit(data->i_rms)) {
-        type = ANOMALY_SHORT_CIRCUIT;
-    } else if (detect_overcurrent(data->i_rms)) {
-        type = ANOMALY_OVERCURRENT;
-    } else if (detect_wire_fire(data->power)) {
-        type = ANOMALY_WIRE_FIRE;
+static void emit_event(anomaly_event_t *event, anomaly_episode_t *ep, anomaly_type_t type,
+                       anomaly_phase_t phase, const pzem_data_t *data)
+{
+    uint8_t  ch  = data->channel;
+    uint32_t now = data->timestamp;
+    uint32_t end = phase == ANOMALY_PHASE_CLEAR ? ep->clear_since_ms : now;
+
+    event->type            = type;
+    event->i_ma            = data->i_ma;
+    event->v_dv            = data->current_only ? last_full[ch].v_dv     : data->v_dv;
+    event->power_dw        = data->current_only ? last_full[ch].power_dw : data->power_dw;
+    event->timestamp       = now;
+    event->channel         = ch;
+    event->severity        = ep->severity;
+    event->relay_triggered = ep->trip;
+    event->phase           = phase;
+    event->metric          = ep->metric;
+    event->episode_id      = ep->id;
+    event->duration_ms     = end - ep->onset_ms;
+    event->peak            = ep->peak;
+    event->min             = ep->min;
+    event->integral        = ep->integral;
+    event->trip_latency_us = 0;             // stamped by the caller that trips
+
+    if (phase == ANOMALY_PHASE_CLEAR) {
+        ep->active = false;
     } else {
-        type = detect_voltage_anomaly(data->v_rms);
+        ep->report_ms = now;
     }
+}
 
-    if (type == ANOMALY_NONE) {
-        return false;
+// ── Evaluation ────────────────────────────────────────────────────────────────
+
+uint8_t anomaly_analyze(const pzem_data_t *data, anomaly_event_t *events, uint8_t max_events)
+{
+    if (!data || !data->valid || !events) return 0;
+    if (data->channel >= PZEM_CHANNEL_COUNT) return 0;
+
+    // Reset asked for by another task: done here, so it never races a pass
+    if (atomic_exchange(&reset_requested, false)) anomaly_detector_reset();
+
+    uint8_t                ch  = data->channel;
+    uint32_t               now = data->timestamp;
+    fire_detector_state_t *fs  = &fire_state[ch];
+    anomaly_episode_t     *eps = episodes[ch];
+
+    uint32_t                 gen = anomaly_rules_generation();
+    const anomaly_ruleset_t *set = anomaly_rules_acquire();
+    if (set != bound_set || gen != bound_gen) {
+        rebind_rule_state(set);
+        rebind_episodes(set);
+        bound_set   = set;
+        bound_gen   = gen;
+        bound_count = set->count;
+        memcpy(bound_rules, set->rules, sizeof(bound_rules));
     }
 
-    event->type      = type;
-    event->i_rms     = data->i_rms;
-    event->v_rms     = data->v_rms;
-    event->power     = data->power;
-    event->timestamp = data->timestamp;
-    event->relay_triggered = (type == ANOMALY_SHORT_CIRCUIT ||
-                              type == ANOMALY_OVERCURRENT   ||
-                              type == ANOMALY_WIRE_FIRE);
+    uint32_t avg_dw    = 0;
+    uint32_t rise_x100 = 0;
+    bool     have_rise = false;
+    if (!data->current_only) {
+        have_rise = update_power_window(fs, data->power_dw, &avg_dw);
+        if (have_rise) {
+            rise_x100 = (uint32_t)((uint64_t)avg_dw * 100 / fs->baseline_dw);
+        }
+    }
 
-    return true;
+    // Pass 1: every rule's confirm timer advances on every sample it
+    // applies to. Per type, note the first confirmed rule and the first
+    // confirmed trip rule.
+    uint32_t value[ANOMALY_MAX_RULES];
+    bool     cond[ANOMALY_MAX_RULES];
+    bool     applies[ANOMALY_MAX_RULES] = {0};
+    uint8_t  first_rule[ANOMALY_TYPE_COUNT];
+    uint8_t  trip_rule[ANOMALY_TYPE_COUNT];
+    bool     rise_high = false;
+    memset(first_rule, ANOMALY_MAX_RULES, sizeof(first_rule));
+    memset(trip_rule,  ANOMALY_MAX_RULES, sizeof(trip_rule));
+
+    for (uint8_t i = 0; i < set->count; i++) {
+        const anomaly_rule_t *r    = &set->rules[i];
+        bool                  owns = eps[r->type].active && eps[r->type].rule == i;
+        if (!metric_value(r, data, have_rise, rise_x100, &value[i])) continue;
+        if (r->metric == RULE_METRIC_THERMAL) {
+            value[i] = thermal_update(&rule_state[ch][i], r, value[i], now);
+        } else if (r->metric == RULE_METRIC_ROCOF) {
+            value[i] = rocof_update(&rule_state[ch][i], r, (uint16_t)value[i], now);
+        }
+
+        uint32_t gate = r->metric == RULE_METRIC_POWER_FACTOR ? data->i_ma : avg_dw;
+        applies[i] = true;
+        // Past its current ceiling a power rise is an overload, not a wire fire
+        bool over  = r->metric == RULE_METRIC_POWER_RISE && r->arg2 && data->i_ma > r->arg2;
+        cond[i]    = !over && rule_condition(r, value[i], gate, owns);
+        if (cond[i] && r->metric == RULE_METRIC_POWER_RISE) rise_high = true;
+        if (!rule_confirmed(&rule_state[ch][i], cond[i], now, r->confirm_ms)) continue;
+
+        if (first_rule[r->type] == ANOMALY_MAX_RULES) first_rule[r->type] = i;
+        if (r->action == RULE_ACTION_TRIP && trip_rule[r->type] == ANOMALY_MAX_RULES) {
+            trip_rule[r->type] = i;
+        }
+    }
+
+    uint32_t due = 0;
+    for (uint8_t t = 0; t < ANOMALY_TYPE_COUNT; t++) {
+        if (trip_rule[t] != ANOMALY_MAX_RULES) due |= 1u << t;
+    }
+    trips_due[ch] = due;
+
+    // Pass 2: an open episode whose type has a confirmed trip rule re-sends
+    // its onset with relay_triggered. A log-only episode is escalated first
+    // — the log rule having fired first must not disarm protection for the
+    // rest of the episode. A trip episode re-sends once per relay trip, when
+    // the relay was closed again (reset within the clear hold) into a fault
+    // that never cleared, so the trip is reported like the first one.
+    uint8_t       n           = 0;
+    uint32_t      emitted     = 0;  // bit per anomaly type: one transition per reading
+    relay_state_t relay       = relay_get_state();
+    uint32_t      relay_trips = relay_get_trip_count();
+    for (uint8_t t = 0; t < ANOMALY_TYPE_COUNT; t++) {
+        anomaly_episode_t *ep = &eps[t];
+        uint8_t            i  = trip_rule[t];
+        if (!ep->active || i == ANOMALY_MAX_RULES || n >= max_events) continue;
+        if (!ep->trip) {
+            episode_escalate(ep, i, &set->rules[i], value[i], now);
+        } else if (relay == RELAY_STATE_TRIPPED || ep->relay_trips == relay_trips) {
+            continue;
+        }
+        ep->relay_trips = relay_trips;
+        emit_event(&events[n++], ep, (anomaly_type_t)t, ANOMALY_PHASE_ONSET, data);
+        emitted |= 1u << t;
+    }
+
+    // Pass 3: owners fold and step their episodes; a type with no episode
+    // opens one with its trip rule if one confirmed, else its first
+    // confirmed rule in table order.
+    for (uint8_t i = 0; i < set->count; i++) {
+        const anomaly_rule_t *r   = &set->rules[i];
+        anomaly_episode_t    *ep  = &eps[r->type];
+        uint32_t              bit = 1u << r->type;
+        if (!applies[i] || (emitted & bit)) continue;
+
+        if (ep->active && ep->rule == i) {
+            episode_fold(ep, value[i], cond[i], now);
+            int phase = episode_step(ep, cond[i], now);
+            if (phase >= 0 && n < max_events) {
+                emit_event(&events[n++], ep, (anomaly_type_t)r->type, (anomaly_phase_t)phase, data);
+                emitted |= bit;
+            }
+        } else if (!ep->active && n < max_events &&
+                   i == (trip_rule[r->type] != ANOMALY_MAX_RULES ? trip_rule[r->type]
+                                                                 : first_rule[r->type])) {
+            episode_open(ep, i, r, rule_state[ch][i].above_since_ms, value[i], now);
+            emit_event(&events[n++], ep, (anomaly_type_t)r->type, ANOMALY_PHASE_ONSET, data);
+            emitted |= bit;
+        }
+    }
+
+    // Episodes whose type left the table run out their clear hold
+    for (uint8_t t = 0; t < ANOMALY_TYPE_COUNT; t++) {
+        anomaly_episode_t *ep = &eps[t];
+        if (!ep->active || ep->rule < set->count) continue;
+        int phase = episode_step(ep, false, now);
+        if (phase >= 0 && n < max_events) {
+            emit_event(&events[n++], ep, (anomaly_type_t)t, (anomaly_phase_t)phase, data);
+        }
+    }
+    anomaly_rules_release();
+
+    // Slow-moving baseline adaptation (steady load only, never during a rise event)
+    if (have_rise && !rise_high && power_window_flat(fs, avg_dw)) {
+        fs->baseline_dw = (9 * fs->baseline_dw + avg_dw) / 10;
+    }
+
+    if (!data->current_only) {
+        last_full[ch] = *data;
+    }
+
+    return n;
 }
 
 void anomaly_detector_reset(void)
 {
-    oc_state.count = 0;
-    memset(&fire_state, 0, sizeof(fire_state));
+    // Confirm timers start over; thermal rules keep their heat the way
+    // rebind_rule_state does — the relay is about to close onto the same
+    // wiring, which has not cooled because someone pressed reset
+    for (uint8_t i = 0; i < ANOMALY_MAX_RULES; i++) {
+        bool keep_heat = i < bound_count && bound_rules[i].metric == RULE_METRIC_THERMAL;
+        for (uint8_t ch = 0; ch < PZEM_CHANNEL_COUNT; ch++) {
+            rule_confirm_state_t *st  = &rule_state[ch][i];
+            rule_confirm_state_t  old = *st;
+            memset(st, 0, sizeof(*st));
+            if (keep_heat) {
+                st->heat    = old.heat;
+                st->last_ms = old.last_ms;
+            }
+        }
+    }
+    for (uint8_t ch = 0; ch < PZEM_CHANNEL_COUNT; ch++) {
+        rolling_stats_clear(&fire_state[ch].window);
+        fire_state[ch].baseline_dw = 0;
+        fire_state[ch].last_dw     = 0;
+    }
     ESP_LOGI(TAG_ANOMALY, "Anomaly detector state reset");
 }
+
+uint32_t anomaly_detector_trips_due(uint8_t channel)
+{
+    return channel < PZEM_CHANNEL_COUNT ? trips_due[channel] : 0;
+}
+
+void anomaly_detector_request_reset(void)
+{
+    atomic_store(&reset_requested, true);
+}
@@ -0,0 +1,409 @@
+#include "anomaly_model.h"
+#include "config.h"
+#include "logger.h"
+
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "nvs.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#define MODEL_NVS_KEY       "anom_model"
+#define MODEL_MAX_SHIFT     24
+#define SOURCE_Z_LIMIT_MOHM 10000000    // ±10 Ω — beyond that the fit is noise
+
+// dt_ms of a window's rows must fit a uint16_t
+_Static_assert(ANOMALY_MODEL_WINDOW >= 2 && ANOMALY_MODEL_WINDOW * PZEM_READ_INTERVAL_MS <= 60000,
+               "ANOMALY_MODEL_WINDOW must be 2 or more reads and at most 60 s");
+
+typedef struct {
+    anomaly_model_t model;
+    uint32_t        crc;        // CRC32 over model
+} model_blob_t;
+
+// Window accumulators of one channel. Sums are exact integers in native
+// units, so features come out the same on every device and in training.
+typedef struct {
+    uint8_t  n;
+    uint8_t  over;              // consecutive windows at or above threshold
+    bool     flagged;           // last_flag_ms is valid
+    uint32_t start_ms;
+    uint32_t last_ms;
+    uint32_t last_flag_ms;
+    int64_t  sum_v, sum_i, sum_p, sum_pf, sum_f;
+    int64_t  sum_vi;
+    uint64_t sum_ii;
+    uint32_t min_v, max_v, min_i, max_i, min_p, max_p;
+    uint32_t max_di, max_dp;
+    uint32_t last_i, last_p;
+    uint8_t  min_pf;
+    anomaly_model_sample_t rows[ANOMALY_MODEL_WINDOW];
+} window_state_t;
+
+static anomaly_model_t   s_model;       // version 0 = none loaded
+static window_state_t    s_win[PZEM_CHANNEL_COUNT];
+static SemaphoreHandle_t s_mutex = NULL;
+
+// ── Kernel ────────────────────────────────────────────────────────────────────
+
+static inline int32_t clamp_i8(int64_t v, int32_t lo)
+{
+    return v > 127 ? 127 : (v < lo ? lo : (int32_t)v);
+}
+
+uint32_t anomaly_model_score(const anomaly_model_t *m,
+                             const int32_t features[ANOMALY_MODEL_FEATURES])
+{
+    int8_t q[ANOMALY_MODEL_FEATURES];
+    int8_t h[ANOMALY_MODEL_MAX_HIDDEN];
+
+    for (uint8_t k = 0; k < ANOMALY_MODEL_FEATURES; k++) {
+        int64_t x = ((int64_t)features[k] - m->center[k]) * m->mult[k];
+        q[k] = (int8_t)clamp_i8(x >> 16, -127);
+    }
+
+    for (uint8_t j = 0; j < m->n_hidden; j++) {
+        int32_t acc = m->b1[j];
+        for (uint8_t k = 0; k < ANOMALY_MODEL_FEATURES; k++) acc += m->w1[j][k] * q[k];
+        h[j] = (int8_t)clamp_i8(acc > 0 ? acc >> m->shift1 : 0, 0);
+    }
+
+    uint32_t score = 0;
+    for (uint8_t k = 0; k < ANOMALY_MODEL_FEATURES; k++) {
+        int32_t acc = m->b2[k];
+        for (uint8_t j = 0; j < m->n_hidden; j++) acc += m->w2[k][j] * h[j];
+        int32_t e = q[k] - clamp_i8(acc >> m->shift2, -127);
+        score += (uint32_t)(e * e);
+    }
+    return score;
+}
+
+// ── Windows ───────────────────────────────────────────────────────────────────
+
+static void window_start(window_state_t *w, const pzem_data_t *d)
+{
+    uint8_t  over      = w->over;
+    bool     flagged   = w->flagged;
+    uint32_t last_flag = w->last_flag_ms;
+
+    memset(w, 0, offsetof(window_state_t, rows));
+    w->over         = over;
+    w->flagged      = flagged;
+    w->last_flag_ms = last_flag;
+    w->start_ms     = d->timestamp;
+    w->min_v = w->min_i = w->min_p = UINT32_MAX;
+    w->min_pf = UINT8_MAX;
+}
+
+static void window_add(window_state_t *w, const pzem_data_t *d)
+{
+    uint32_t v = d->v_dv, i = d->i_ma, p = d->power_dw;
+
+    if (w->n > 0) {
+        uint32_t di = i > w->last_i ? i - w->last_i : w->last_i - i;
+        uint32_t dp = p > w->last_p ? p - w->last_p : w->last_p - p;
+        if (di > w->max_di) w->max_di = di;
+        if (dp > w->max_dp) w->max_dp = dp;
+    }
+
+    w->sum_v  += v;
+    w->sum_i  += i;
+    w->sum_p  += p;
+    w->sum_pf += d->pf_pct;
+    w->sum_f  += d->freq_dhz;
+    w->sum_vi += (int64_t)v * i;
+    w->sum_ii += (uint64_t)i * i;
+    if (v < w->min_v) w->min_v = v;
+    if (v > w->max_v) w->max_v = v;
+    if (i < w->min_i) w->min_i = i;
+    if (i > w->max_i) w->max_i = i;
+    if (p < w->min_p) w->min_p = p;
+    if (p > w->max_p) w->max_p = p;
+    if (d->pf_pct < w->min_pf) w->min_pf = d->pf_pct;
+
+    anomaly_model_sample_t *row = &w->rows[w->n];
+    row->i_ma     = i;
+    row->power_dw = p;
+    row->v_dv     = d->v_dv;
+    row->freq_dhz = d->freq_dhz;
+    row->pf_pct   = d->pf_pct;
+    row->dt_ms    = (uint16_t)(d->timestamp - w->start_ms);
+
+    w->last_i  = i;
+    w->last_p  = p;
+    w->last_ms = d->timestamp;
+    w->n++;
+}
+
+// Least-squares slope of V against I, negated: how far the voltage sags
+// per amp drawn. Only meaningful when the current actually moved.
+static int32_t source_z_mohm(const window_state_t *w)
+{
+    if (w->max_i - w->min_i < ANOMALY_MODEL_Z_MIN_SPREAD_MA) return 0;
+
+    int64_t n   = w->n;
+    int64_t cov = n * w->sum_vi - w->sum_v * w->sum_i;                  // 0.1 V·mA·n²
+    int64_t var = n * (int64_t)w->sum_ii - w->sum_i * w->sum_i;         // mA²·n²
+    if (var <= 0) return 0;
+
+    int64_t z = -cov * 100000 / var;                                    // 0.1 V/mA = 10⁵ mΩ
+    if (z >  SOURCE_Z_LIMIT_MOHM) z =  SOURCE_Z_LIMIT_MOHM;
+    if (z < -SOURCE_Z_LIMIT_MOHM) z = -SOURCE_Z_LIMIT_MOHM;
+    return (int32_t)z;
+}
+
+static void window_features(const window_state_t *w, int32_t f[ANOMALY_MODEL_FEATURES])
+{
+    f[AMODEL_F_V_MEAN]   = (int32_t)(w->sum_v  / w->n);
+    f[AMODEL_F_V_SPREAD] = (int32_t)(w->max_v - w->min_v);
+    f[AMODEL_F_I_MEAN]   = (int32_t)(w->sum_i  / w->n);
+    f[AMODEL_F_I_SPREAD] = (int32_t)(w->max_i - w->min_i);
+    f[AMODEL_F_P_MEAN]   = (int32_t)(w->sum_p  / w->n);
+    f[AMODEL_F_P_SPREAD] = (int32_t)(w->max_p - w->min_p);
+    f[AMODEL_F_PF_MEAN]  = (int32_t)(w->sum_pf / w->n);
+    f[AMODEL_F_PF_MIN]   = w->min_pf;
+    f[AMODEL_F_F_MEAN]   = (int32_t)(w->sum_f  / w->n);
+    f[AMODEL_F_I_STEP]   = (int32_t)w->max_di;
+    f[AMODEL_F_P_STEP]   = (int32_t)w->max_dp;
+    f[AMODEL_F_SOURCE_Z] = source_z_mohm(w);
+}
+
+// Score a full window. Caller fills *out only when this returns true.
+static bool window_close(window_state_t *w, uint8_t channel, anomaly_model_flag_t *out)
+{
+    int32_t  f[ANOMALY_MODEL_FEATURES];
+    uint32_t version, threshold, score;
+    uint8_t  confirm;
+
+    window_features(w, f);
+
+    // The HTTP task only holds the mutex to copy a new model in
+    if (xSemaphoreTake(s_mutex, pdMS_TO_TICKS(5)) != pdTRUE) return false;
+    version   = s_model.version;
+    threshold = s_model.threshold;
+    confirm   = s_model.confirm;
+    score     = version ? anomaly_model_score(&s_model, f) : 0;
+    xSemaphoreGive(s_mutex);
+
+    if (!version) return false;
+
+    if (score < threshold) {
+        w->over = 0;
+        return false;
+    }
+    if (w->over < UINT8_MAX) w->over++;
+    if (w->over < confirm) return false;
+    if (w->flagged && (w->last_ms - w->last_flag_ms) < ANOMALY_MODEL_HOLDOFF_MS) return false;
+
+    w->flagged      = true;
+    w->last_flag_ms = w->last_ms;
+
+    out->model_version = version;
+    out->score         = score;
+    out->threshold     = threshold;
+    out->start_ms      = w->start_ms;
+    out->channel       = channel;
+    out->count         = w->n;
+    memcpy(out->features, f, sizeof(f));
+    memcpy(out->samples, w->rows, w->n * sizeof(w->rows[0]));
+
+    LOG_WARN(TAG_ANOMALY, "CH%u window scored %lu (model v%lu, threshold %lu) — flagged for review",
+             channel, (unsigned long)score, (unsigned long)version, (unsigned long)threshold);
+    return true;
+}
+
+bool anomaly_model_update(const pzem_data_t *data, anomaly_model_flag_t *out)
+{
+    if (!data || !data->valid || data->current_only) return false;
+    if (data->channel >= PZEM_CHANNEL_COUNT || !s_mutex) return false;
+
+    window_state_t *w = &s_win[data->channel];
+
+    // A missed read leaves a hole the features would hide; start over
+    if (w->n > 0 && (data->timestamp - w->last_ms) > 2 * PZEM_READ_INTERVAL_MS) w->n = 0;
+    if (w->n == 0) window_start(w, data);
+
+    window_add(w, data);
+    if (w->n < ANOMALY_MODEL_WINDOW) return false;
+
+    bool flagged = window_close(w, data->channel, out);
+    w->n = 0;
+    return flagged;
+}
+
+// ── Model ─────────────────────────────────────────────────────────────────────
+
+static bool model_valid(const anomaly_model_t *m)
+{
+    return m->version > 0 &&
+           m->n_hidden >= 1 && m->n_hidden <= ANOMALY_MODEL_MAX_HIDDEN &&
+           m->shift1 <= MODEL_MAX_SHIFT && m->shift2 <= MODEL_MAX_SHIFT &&
+           m->confirm >= 1 && m->threshold > 0;
+}
+
+static uint32_t blob_crc(const model_blob_t *b)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)&b->model, sizeof(b->model));
+}
+
+void anomaly_model_init(void)
+{
+    memset(s_win, 0, sizeof(s_win));
+    if (!s_mutex) s_mutex = xSemaphoreCreateMutex();
+
+    // Restore only into an empty slot, so re-running init after the
+    // benchmark keeps a model applied in the meantime
+    if (s_model.version) return;
+
+    nvs_handle_t h;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &h) == ESP_OK) {
+        static model_blob_t b;  // 800 B: keep it off the caller's stack
+        size_t              len = sizeof(b);
+        if (nvs_get_blob(h, MODEL_NVS_KEY, &b, &len) == ESP_OK && len == sizeof(b)) {
+            if (b.crc == blob_crc(&b) && model_valid(&b.model)) {
+                s_model = b.model;
+            } else {
+                ESP_LOGW(TAG_ANOMALY, "Stored anomaly model corrupt — waiting for the server");
+            }
+        }
+        nvs_close(h);
+    }
+
+    if (s_model.version) {
+        ESP_LOGI(TAG_ANOMALY, "Anomaly model v%lu: %u hidden, threshold %lu, %d-read windows",
+                 (unsigned long)s_model.version, s_model.n_hidden,
+                 (unsigned long)s_model.threshold, ANOMALY_MODEL_WINDOW);
+    } else {
+        ESP_LOGI(TAG_ANOMALY, "Anomaly model: none");
+    }
+}
+
+uint32_t anomaly_model_version(void)
+{
+    return s_model.version;
+}
+
+esp_err_t anomaly_model_apply(const anomaly_model_t *model)
+{
+    if (!model || !model_valid(model)) return ESP_ERR_INVALID_ARG;
+    if (!s_mutex) return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    s_model = *model;
+    xSemaphoreGive(s_mutex);
+
+    // Persist after publishing: a slow flash write must not hold the mutex
+    static model_blob_t b;
+    b.model = *model;
+    b.crc   = blob_crc(&b);
+
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &h);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(h, MODEL_NVS_KEY, &b, sizeof(b));
+        if (err == ESP_OK) err = nvs_commit(h);
+        nvs_close(h);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG_ANOMALY, "Anomaly model v%lu active but not saved: %s",
+                 (unsigned long)model->version, esp_err_to_name(err));
+    }
+
+    ESP_LOGI(TAG_ANOMALY, "Anomaly model v%lu applied (%u hidden, threshold %lu)",
+             (unsigned long)model->version, model->n_hidden, (unsigned long)model->threshold);
+    return ESP_OK;
+}
+
+// ── Server document ───────────────────────────────────────────────────────────
+
+// Copy a JSON array of exactly n integers within [lo, hi]
+static bool json_ints(const cJSON *obj, const char *key, int n, double lo, double hi,
+                      int32_t *out)
+{
+    const cJSON *arr = cJSON_GetObjectItem(obj, key);
+    if (!cJSON_IsArray(arr) || cJSON_GetArraySize(arr) != n) return false;
+
+    int          k = 0;
+    const cJSON *item;
+    cJSON_ArrayForEach(item, arr) {
+        if (!cJSON_IsNumber(item)) return false;
+        double v = item->valuedouble;
+        if (v < lo || v > hi || v != (double)(int64_t)v) return false;
+        out[k++] = (int32_t)v;
+    }
+    return true;
+}
+
+// Copy a row-major rows × cols JSON array of int8 weights into a matrix
+// whose rows are `stride` entries apart
+static bool json_weights(const cJSON *obj, const char *key, int rows, int cols, int stride,
+                         int8_t *out)
+{
+    const cJSON *arr = cJSON_GetObjectItem(obj, key);
+    if (!cJSON_IsArray(arr) || cJSON_GetArraySize(arr) != rows * cols) return false;
+
+    int          k = 0;
+    const cJSON *item;
+    cJSON_ArrayForEach(item, arr) {
+        if (!cJSON_IsNumber(item)) return false;
+        double v = item->valuedouble;
+        if (v < -128 || v > 127 || v != (double)(int)v) return false;
+        out[(k / cols) * stride + k % cols] = (int8_t)v;
+        k++;
+    }
+    return true;
+}
+
+static bool json_small(const cJSON *obj, const char *key, double lo, double hi, double *out)
+{
+    const cJSON *item = cJSON_GetObjectItem(obj, key);
+    if (!cJSON_IsNumber(item) || item->valuedouble < lo || item->valuedouble > hi) return false;
+    *out = item->valuedouble;
+    return true;
+}
+
+esp_err_t anomaly_model_from_json(const cJSON *doc, anomaly_model_t *out)
+{
+    const cJSON *version = cJSON_GetObjectItem(doc, "version");
+    const cJSON *m       = cJSON_GetObjectItem(doc, "model");
+    if (!cJSON_IsNumber(version) || version->valuedouble < 1 || !cJSON_IsObject(m)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(out, 0, sizeof(*out));
+    out->version = (uint32_t)version->valuedouble;
+
+    double features, hidden, shift1, shift2, threshold, confirm;
+    if (!json_small(m, "features",  ANOMALY_MODEL_FEATURES, ANOMALY_MODEL_FEATURES, &features) ||
+        !json_small(m, "n_hidden",  1, ANOMALY_MODEL_MAX_HIDDEN, &hidden) ||
+        !json_small(m, "shift1",    0, MODEL_MAX_SHIFT, &shift1) ||
+        !json_small(m, "shift2",    0, MODEL_MAX_SHIFT, &shift2) ||
+        !json_small(m, "threshold", 1, UINT32_MAX, &threshold) ||
+        !json_small(m, "confirm",   1, UINT8_MAX, &confirm)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    out->n_hidden  = (uint8_t)hidden;
+    out->shift1    = (uint8_t)shift1;
+    out->shift2    = (uint8_t)shift2;
+    out->threshold = (uint32_t)threshold;
+    out->confirm   = (uint8_t)confirm;
+
+    const int F = ANOMALY_MODEL_FEATURES, H = out->n_hidden;
+    if (!json_ints(m, "center", F, INT32_MIN, INT32_MAX, out->center) ||
+        !json_ints(m, "mult",   F, INT32_MIN, INT32_MAX, out->mult) ||
+        !json_weights(m, "w1", H, F, ANOMALY_MODEL_FEATURES, &out->w1[0][0]) ||
+        !json_ints(m, "b1",     H, INT32_MIN / 2, INT32_MAX / 2, out->b1) ||
+        !json_weights(m, "w2", F, H, ANOMALY_MODEL_MAX_HIDDEN, &out->w2[0][0]) ||
+        !json_ints(m, "b2",     F, INT32_MIN / 2, INT32_MAX / 2, out->b2)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+size_t anomaly_model_ram_bytes(void)
+{
+    return sizeof(s_model) + sizeof(s_win);
+}
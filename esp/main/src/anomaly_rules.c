@@ -0,0 +1,323 @@
+#include "anomaly_rules.h"
+#include "anomaly_detector.h"
+#include "relay_control.h"
+#include "pzem_sensor.h"
+#include "config.h"
+#include "logger.h"
+
+#include "esp_log.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include <stdatomic.h>
+#include <string.h>
+#include <strings.h>
+
+#define RULES_NVS_KEY   "anom_rules"
+
+// Compiled defaults, converted once to the native units carried in
+// pzem_data_t so every comparison in the evaluator is integer.
+static const anomaly_rule_t s_default_rules[] = {
+    { ANOMALY_SHORT_CIRCUIT, RULE_METRIC_CURRENT,     RULE_CMP_GT, RULE_SEVERITY_CRITICAL, RULE_ACTION_TRIP,
+      SHORT_CIRCUIT_CONFIRM_MS, (uint32_t)(SHORT_CIRCUIT_THRESHOLD_A * 1000.0f), 0, 0 },
+    { ANOMALY_OVERCURRENT,   RULE_METRIC_THERMAL,     RULE_CMP_GT, RULE_SEVERITY_HIGH,     RULE_ACTION_TRIP,
+      0,                      (uint32_t)(OVERCURRENT_THRESHOLD_A * 1000.0f),   OVERCURRENT_TRIP_K_A2S,
+      OVERCURRENT_COOL_TAU_MS },
+    { ANOMALY_OVERPOWER,     RULE_METRIC_POWER_ALARM, RULE_CMP_GT, RULE_SEVERITY_HIGH,     RULE_ACTION_TRIP,
+      OVERPOWER_CONFIRM_MS,   (uint32_t)MAX_POWER_W,                           0, 0 },
+    { ANOMALY_WIRE_FIRE,     RULE_METRIC_POWER_RISE,  RULE_CMP_GT, RULE_SEVERITY_CRITICAL, RULE_ACTION_TRIP,
+      0,                      (uint32_t)(WIRE_FIRE_POWER_RATIO * 100.0f),      (uint32_t)(WIRE_FIRE_MIN_POWER_W * 10.0f),
+      (uint32_t)(OVERCURRENT_THRESHOLD_A * 1000.0f) },
+    { ANOMALY_OVERVOLTAGE,   RULE_METRIC_VOLTAGE,     RULE_CMP_GT, RULE_SEVERITY_MEDIUM,   RULE_ACTION_LOG,
+      0,                      (uint32_t)(VOLTAGE_MAX_V * 10.0f),               0, 0 },
+    { ANOMALY_UNDERVOLTAGE,  RULE_METRIC_VOLTAGE,     RULE_CMP_LT, RULE_SEVERITY_MEDIUM,   RULE_ACTION_LOG,
+      0,                      (uint32_t)(VOLTAGE_MIN_V * 10.0f),               0, 0 },
+    { ANOMALY_FREQUENCY,     RULE_METRIC_ROCOF,       RULE_CMP_GT, RULE_SEVERITY_HIGH,     RULE_ACTION_LOG,
+      ROCOF_CONFIRM_MS,       (uint32_t)(ROCOF_MAX_HZ_S * 100.0f),             ROCOF_WINDOW_MS, 0 },
+    { ANOMALY_FREQUENCY,     RULE_METRIC_FREQUENCY,   RULE_CMP_GT, RULE_SEVERITY_MEDIUM,   RULE_ACTION_LOG,
+      FREQUENCY_CONFIRM_MS,   (uint32_t)(FREQUENCY_MAX_HZ * 10.0f + 0.5f),     0, 0 },
+    { ANOMALY_FREQUENCY,     RULE_METRIC_FREQUENCY,   RULE_CMP_LT, RULE_SEVERITY_MEDIUM,   RULE_ACTION_LOG,
+      FREQUENCY_CONFIRM_MS,   (uint32_t)(FREQUENCY_MIN_HZ * 10.0f + 0.5f),     0, 0 },
+    { ANOMALY_LOW_POWER_FACTOR, RULE_METRIC_POWER_FACTOR, RULE_CMP_LT, RULE_SEVERITY_LOW,  RULE_ACTION_LOG,
+      PF_CONFIRM_MS,          (uint32_t)(POWER_FACTOR_MIN * 100.0f + 0.5f),    (uint32_t)(PF_MIN_CURRENT_A * 1000.0f), 0 },
+};
+
+_Static_assert(sizeof(s_default_rules) / sizeof(s_default_rules[0]) <= ANOMALY_MAX_RULES,
+               "default rule table exceeds ANOMALY_MAX_RULES");
+
+// Two buffers: the active one and a spare the next update is built in
+static anomaly_ruleset_t                  s_sets[2];
+static _Atomic(const anomaly_ruleset_t *) s_active;
+static atomic_uint                        s_readers;
+static atomic_uint                        s_generation;
+static SemaphoreHandle_t                  s_write_mutex = NULL;
+
+// ── Validation ────────────────────────────────────────────────────────────────
+
+static bool rule_valid(const anomaly_rule_t *r)
+{
+    return r->type > ANOMALY_NONE && r->type < ANOMALY_TYPE_COUNT &&
+           r->metric < RULE_METRIC_COUNT &&
+           r->cmp <= RULE_CMP_LT &&
+           r->severity <= RULE_SEVERITY_CRITICAL &&
+           r->action <= RULE_ACTION_TRIP &&
+           (r->metric != RULE_METRIC_THERMAL || (r->arg > 0 && r->arg2 > 0)) &&
+           (r->metric != RULE_METRIC_ROCOF || r->arg > 0);
+}
+
+static bool ruleset_valid(const anomaly_ruleset_t *set)
+{
+    if (set->count == 0 || set->count > ANOMALY_MAX_RULES) return false;
+    for (uint8_t i = 0; i < set->count; i++) {
+        if (!rule_valid(&set->rules[i])) return false;
+    }
+    return true;
+}
+
+// The meter alarm threshold lives in the table too; keep the meter in step.
+static void sync_power_alarm(const anomaly_ruleset_t *set)
+{
+    for (uint8_t i = 0; i < set->count; i++) {
+        if (set->rules[i].metric == RULE_METRIC_POWER_ALARM) {
+            pzem_sensor_set_power_alarm(set->rules[i].threshold);
+            return;
+        }
+    }
+}
+
+// ── Publication ───────────────────────────────────────────────────────────────
+
+const anomaly_ruleset_t *anomaly_rules_acquire(void)
+{
+    atomic_fetch_add(&s_readers, 1);
+    return atomic_load(&s_active);
+}
+
+void anomaly_rules_release(void)
+{
+    atomic_fetch_sub(&s_readers, 1);
+}
+
+uint32_t anomaly_rules_version(void)
+{
+    const anomaly_ruleset_t *set = anomaly_rules_acquire();
+    uint32_t version = set->version;
+    anomaly_rules_release();
+    return version;
+}
+
+uint32_t anomaly_rules_generation(void)
+{
+    return atomic_load(&s_generation);
+}
+
+// Caller holds s_write_mutex. Copies into the spare buffer, swaps it in,
+// then waits out any reader still on the old one so it can be the next spare.
+// With two buffers, two swaps bring the same pointer back; the generation,
+// bumped after the pointer, tells a reader the contents changed.
+static void publish(const anomaly_ruleset_t *set)
+{
+    anomaly_ruleset_t *spare = (atomic_load(&s_active) == &s_sets[0]) ? &s_sets[1] : &s_sets[0];
+    *spare = *set;
+    atomic_store(&s_active, spare);
+    atomic_fetch_add(&s_generation, 1);
+    while (atomic_load(&s_readers) != 0) {
+        vTaskDelay(1);
+    }
+}
+
+void anomaly_rules_init(void)
+{
+    anomaly_ruleset_t set = { .version = 0 };
+
+    s_write_mutex = xSemaphoreCreateMutex();
+
+    nvs_handle_t h;
+    size_t       len    = sizeof(set);
+    bool         loaded = false;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &h) == ESP_OK) {
+        loaded = nvs_get_blob(h, RULES_NVS_KEY, &set, &len) == ESP_OK &&
+                 len == sizeof(set) && ruleset_valid(&set);
+        nvs_close(h);
+    }
+
+    if (!loaded) {
+        memset(&set, 0, sizeof(set));
+        set.count = sizeof(s_default_rules) / sizeof(s_default_rules[0]);
+        memcpy(set.rules, s_default_rules, sizeof(s_default_rules));
+    }
+
+    s_sets[0] = set;
+    atomic_store(&s_active, &s_sets[0]);
+    sync_power_alarm(&set);
+
+    ESP_LOGI(TAG_ANOMALY, "Anomaly rules: %u rule(s), %s (v%lu)", set.count,
+             loaded ? "restored from NVS" : "compiled defaults", (unsigned long)set.version);
+}
+
+esp_err_t anomaly_rules_apply(const anomaly_ruleset_t *set)
+{
+    if (!set || !ruleset_valid(set)) return ESP_ERR_INVALID_ARG;
+    if (!s_write_mutex) return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(s_write_mutex, portMAX_DELAY);
+    publish(set);
+    xSemaphoreGive(s_write_mutex);
+    sync_power_alarm(set);
+
+    // Persist after publishing: a slow flash write must not delay the swap
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &h);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(h, RULES_NVS_KEY, set, sizeof(*set));
+        if (err == ESP_OK) err = nvs_commit(h);
+        nvs_close(h);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG_ANOMALY, "Anomaly rules v%lu active but not saved: %s",
+                 (unsigned long)set->version, esp_err_to_name(err));
+    }
+
+    ESP_LOGI(TAG_ANOMALY, "Anomaly rules v%lu applied (%u rule(s))",
+             (unsigned long)set->version, set->count);
+    return ESP_OK;
+}
+
+// ── Server document ───────────────────────────────────────────────────────────
+
+static const char *const s_metric_names[RULE_METRIC_COUNT] = {
+    [RULE_METRIC_CURRENT]     = "current",
+    [RULE_METRIC_VOLTAGE]     = "voltage",
+    [RULE_METRIC_POWER]       = "power",
+    [RULE_METRIC_POWER_ALARM] = "power_alarm",
+    [RULE_METRIC_POWER_RISE]  = "power_rise",
+    [RULE_METRIC_THERMAL]     = "thermal",
+    [RULE_METRIC_POWER_FACTOR] = "power_factor",
+    [RULE_METRIC_FREQUENCY]   = "frequency",
+    [RULE_METRIC_ROCOF]       = "rocof",
+};
+
+// Human unit → native unit multiplier, per metric
+static const float s_metric_scale[RULE_METRIC_COUNT] = {
+    [RULE_METRIC_CURRENT]     = 1000.0f,   // A → mA
+    [RULE_METRIC_VOLTAGE]     = 10.0f,     // V → 0.1 V
+    [RULE_METRIC_POWER]       = 10.0f,     // W → 0.1 W
+    [RULE_METRIC_POWER_ALARM] = 1.0f,      // W
+    [RULE_METRIC_POWER_RISE]  = 100.0f,    // ratio → ×100
+    [RULE_METRIC_THERMAL]     = 1000.0f,   // rated A → mA
+    [RULE_METRIC_POWER_FACTOR] = 100.0f,   // → 0.01
+    [RULE_METRIC_FREQUENCY]   = 10.0f,     // Hz → 0.1 Hz
+    [RULE_METRIC_ROCOF]       = 100.0f,    // Hz/s → 0.01 Hz/s
+};
+
+// Decimal places of the evaluated value (thermal evaluates to heat %)
+static const uint8_t s_metric_decimals[RULE_METRIC_COUNT] = {
+    [RULE_METRIC_CURRENT]     = 3,
+    [RULE_METRIC_VOLTAGE]     = 1,
+    [RULE_METRIC_POWER]       = 1,
+    [RULE_METRIC_POWER_ALARM] = 0,
+    [RULE_METRIC_POWER_RISE]  = 2,
+    [RULE_METRIC_THERMAL]     = 0,
+    [RULE_METRIC_POWER_FACTOR] = 2,
+    [RULE_METRIC_FREQUENCY]   = 1,
+    [RULE_METRIC_ROCOF]       = 2,
+};
+
+const char *anomaly_rules_metric_name(uint8_t metric)
+{
+    return metric < RULE_METRIC_COUNT ? s_metric_names[metric] : "unknown";
+}
+
+uint8_t anomaly_rules_metric_decimals(uint8_t metric)
+{
+    return metric < RULE_METRIC_COUNT ? s_metric_decimals[metric] : 0;
+}
+
+static const char *const s_severity_names[] = { "low", "medium", "high", "critical" };
+
+static int lookup(const char *s, const char *const *names, int n)
+{
+    if (!s) return -1;
+    for (int i = 0; i < n; i++) {
+        if (names[i] && strcasecmp(s, names[i]) == 0) return i;
+    }
+    return -1;
+}
+
+static uint32_t to_native(double v, float scale)
+{
+    double n = v * scale + 0.5;
+    if (!(n > 0)) return 0;
+    return n >= 4294967295.0 ? UINT32_MAX : (uint32_t)n;
+}
+
+esp_err_t anomaly_rules_from_json(const cJSON *doc, anomaly_ruleset_t *out)
+{
+    const cJSON *version = cJSON_GetObjectItem(doc, "version");
+    const cJSON *rules   = cJSON_GetObjectItem(doc, "rules");
+    if (!cJSON_IsNumber(version) || !cJSON_IsArray(rules)) return ESP_ERR_INVALID_ARG;
+
+    memset(out, 0, sizeof(*out));
+    out->version = (uint32_t)version->valuedouble;
+
+    const cJSON *item;
+    cJSON_ArrayForEach(item, rules) {
+        if (out->count == ANOMALY_MAX_RULES) {
+            ESP_LOGW(TAG_ANOMALY, "Rule document has more than %d rules", ANOMALY_MAX_RULES);
+            return ESP_ERR_INVALID_SIZE;
+        }
+
+        const cJSON *threshold = cJSON_GetObjectItem(item, "threshold");
+        const cJSON *confirm   = cJSON_GetObjectItem(item, "confirm_ms");
+        const cJSON *min_power = cJSON_GetObjectItem(item, "min_power");
+        const cJSON *k         = cJSON_GetObjectItem(item, "k");
+        const cJSON *cool      = cJSON_GetObjectItem(item, "cool_ms");
+        const cJSON *min_cur   = cJSON_GetObjectItem(item, "min_current");
+        const cJSON *max_cur   = cJSON_GetObjectItem(item, "max_current");
+        const cJSON *window    = cJSON_GetObjectItem(item, "window_ms");
+        const char  *op        = cJSON_GetStringValue(cJSON_GetObjectItem(item, "op"));
+        const char  *action    = cJSON_GetStringValue(cJSON_GetObjectItem(item, "action"));
+        int metric   = lookup(cJSON_GetStringValue(cJSON_GetObjectItem(item, "metric")),
+                              s_metric_names, RULE_METRIC_COUNT);
+        int severity = lookup(cJSON_GetStringValue(cJSON_GetObjectItem(item, "severity")),
+                              s_severity_names, 4);
+        int type     = ANOMALY_NONE;
+        const char *type_name = cJSON_GetStringValue(cJSON_GetObjectItem(item, "type"));
+        for (int t = ANOMALY_NONE + 1; type_name && t < ANOMALY_TYPE_COUNT; t++) {
+            if (strcasecmp(type_name, anomaly_type_to_string((anomaly_type_t)t)) == 0) type = t;
+        }
+
+        if (metric < 0 || type == ANOMALY_NONE || !cJSON_IsNumber(threshold) || !op) {
+            ESP_LOGW(TAG_ANOMALY, "Rule %u malformed — document rejected", out->count);
+            return ESP_ERR_INVALID_ARG;
+        }
+
+        anomaly_rule_t *r = &out->rules[out->count++];
+        r->type       = (uint8_t)type;
+        r->metric     = (uint8_t)metric;
+        r->cmp        = (op[0] == '<') ? RULE_CMP_LT : RULE_CMP_GT;
+        r->severity   = severity < 0 ? RULE_SEVERITY_MEDIUM : (uint8_t)severity;
+        r->action     = (action && strcasecmp(action, "trip") == 0) ? RULE_ACTION_TRIP : RULE_ACTION_LOG;
+        r->threshold  = to_native(threshold->valuedouble, s_metric_scale[metric]);
+        r->confirm_ms = cJSON_IsNumber(confirm) ?
+                        (uint16_t)(confirm->valuedouble > UINT16_MAX ? UINT16_MAX :
+                                   confirm->valuedouble < 0 ? 0 : confirm->valuedouble) : 0;
+        if (metric == RULE_METRIC_THERMAL) {
+            r->arg  = cJSON_IsNumber(k)    ? to_native(k->valuedouble, 1.0f)    : OVERCURRENT_TRIP_K_A2S;
+            r->arg2 = cJSON_IsNumber(cool) ? to_native(cool->valuedouble, 1.0f) : OVERCURRENT_COOL_TAU_MS;
+        } else if (metric == RULE_METRIC_POWER_FACTOR) {
+            r->arg  = to_native(cJSON_IsNumber(min_cur) ? min_cur->valuedouble : PF_MIN_CURRENT_A, 1000.0f);
+        } else if (metric == RULE_METRIC_POWER_RISE) {
+            r->arg  = cJSON_IsNumber(min_power) ? to_native(min_power->valuedouble, 10.0f) : 0;
+            r->arg2 = cJSON_IsNumber(max_cur) ? to_native(max_cur->valuedouble, 1000.0f) : 0;
+        } else if (metric == RULE_METRIC_ROCOF) {
+            r->arg  = cJSON_IsNumber(window) ? to_native(window->valuedouble, 1.0f) : ROCOF_WINDOW_MS;
+        } else {
+            r->arg  = cJSON_IsNumber(min_power) ? to_native(min_power->valuedouble, 10.0f) : 0;
+        }
+    }
+
+    return ruleset_valid(out) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
@@ -0,0 +1,167 @@
+#include "blackbox.h"
+#include "logger.h"
+#include "relay_control.h"
+
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "esp_system.h"
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <string.h>
+
+#define BLACKBOX_RING_MAGIC     0x42425247u     // "BBRG"
+#define BLACKBOX_RECORD_MAGIC   0x42425243u     // "BBRC"
+
+typedef struct {
+    uint32_t          magic;
+    uint16_t          pos;          // next slot to write
+    uint16_t          count;        // valid samples, ≤ BLACKBOX_SAMPLES
+    blackbox_sample_t ring[BLACKBOX_SAMPLES];
+} blackbox_ring_t;
+
+// ESP32 RTC slow memory is 8 KB and shared with the rest of the firmware
+_Static_assert(sizeof(blackbox_ring_t) + sizeof(blackbox_record_t) <= 4096,
+               "black box too large for RTC memory — shorten BLACKBOX_WINDOW_MS");
+
+// Recorder state: only the anomaly task moves IDLE → PENDING → READY,
+// only the HTTP task moves READY → IDLE.
+enum {
+    BB_IDLE = 0,
+    BB_FREEZE_PENDING,
+    BB_READY,
+};
+
+static RTC_NOINIT_ATTR blackbox_ring_t   s_ring;
+static RTC_NOINIT_ATTR blackbox_record_t s_record;
+static atomic_uint                       s_state;
+
+// Trip captured by blackbox_freeze() for the deferred copy
+static uint8_t  s_trip_type;
+static uint8_t  s_trip_channel;
+static uint32_t s_trip_episode;
+static uint32_t s_trip_ms;
+
+static uint32_t record_crc(const blackbox_record_t *r)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)r, offsetof(blackbox_record_t, crc));
+}
+
+static bool ring_valid(void)
+{
+    return s_ring.magic == BLACKBOX_RING_MAGIC &&
+           s_ring.pos < BLACKBOX_SAMPLES && s_ring.count <= BLACKBOX_SAMPLES;
+}
+
+// Copy the ring, oldest first, into the frozen record
+static void snapshot(uint8_t reason, uint8_t type, uint8_t channel, uint8_t reset_reason,
+                     uint32_t episode_id, uint32_t trip_ms)
+{
+    memset(&s_record, 0, sizeof(s_record));
+    s_record.reason       = reason;
+    s_record.anomaly_type = type;
+    s_record.channel      = channel;
+    s_record.reset_reason = reset_reason;
+    s_record.episode_id   = episode_id;
+    s_record.trip_ms      = trip_ms;
+    s_record.count        = s_ring.count;
+
+    uint16_t start = (s_ring.pos + BLACKBOX_SAMPLES - s_ring.count) % BLACKBOX_SAMPLES;
+    for (uint16_t k = 0; k < s_ring.count; k++) {
+        s_record.samples[k] = s_ring.ring[(start + k) % BLACKBOX_SAMPLES];
+    }
+    s_record.magic = BLACKBOX_RECORD_MAGIC;
+    s_record.crc   = record_crc(&s_record);
+}
+
+static bool abnormal_reset(esp_reset_reason_t why)
+{
+    switch (why) {
+        case ESP_RST_PANIC:
+        case ESP_RST_INT_WDT:
+        case ESP_RST_TASK_WDT:
+        case ESP_RST_WDT:
+        case ESP_RST_BROWNOUT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// ── Boot ──────────────────────────────────────────────────────────────────────
+
+void blackbox_init(void)
+{
+    esp_reset_reason_t why = esp_reset_reason();
+
+    if (s_record.magic == BLACKBOX_RECORD_MAGIC && s_record.crc == record_crc(&s_record)) {
+        ESP_LOGI(TAG_BBOX, "Record from before reset (%u samples) awaiting upload",
+                 s_record.count);
+        atomic_store(&s_state, BB_READY);
+    } else if (ring_valid() && s_ring.count > 0 && abnormal_reset(why)) {
+        uint32_t last_ms = s_ring.ring[(s_ring.pos + BLACKBOX_SAMPLES - 1) % BLACKBOX_SAMPLES].t_ms;
+        snapshot(BLACKBOX_REASON_RESET, ANOMALY_NONE, 0, (uint8_t)why, 0, last_ms);
+        LOG_WARN(TAG_BBOX, "Abnormal reset (reason %d) — kept last %u samples",
+                 (int)why, s_record.count);
+        atomic_store(&s_state, BB_READY);
+    } else {
+        atomic_store(&s_state, BB_IDLE);
+    }
+
+    s_ring.magic = BLACKBOX_RING_MAGIC;
+    s_ring.pos   = 0;
+    s_ring.count = 0;
+}
+
+// ── Writer (anomaly task) ─────────────────────────────────────────────────────
+
+void blackbox_record(const pzem_data_t *data)
+{
+    if (atomic_load(&s_state) == BB_FREEZE_PENDING) {
+        snapshot(BLACKBOX_REASON_TRIP, s_trip_type, s_trip_channel, 0, s_trip_episode, s_trip_ms);
+        atomic_store(&s_state, BB_READY);
+        LOG_INFO(TAG_BBOX, "Froze %u samples for %s",
+                 s_record.count, anomaly_type_to_string((anomaly_type_t)s_trip_type));
+    }
+    if (!data || !data->valid) return;
+
+    blackbox_sample_t *s = &s_ring.ring[s_ring.pos];
+    s->t_ms     = data->timestamp;
+    s->i_ma     = data->i_ma;
+    s->power_dw = data->current_only ? 0 : data->power_dw;
+    s->v_dv     = data->v_dv;      // 0 on fast samples without PZEM_FAST_POLL_VOLTAGE
+    s->channel  = data->channel;
+    s->flags    = data->current_only ? BLACKBOX_FLAG_CURRENT_ONLY : 0;
+
+    s_ring.pos = (s_ring.pos + 1) % BLACKBOX_SAMPLES;
+    if (s_ring.count < BLACKBOX_SAMPLES) s_ring.count++;
+}
+
+void blackbox_freeze(const anomaly_event_t *event)
+{
+    if (!event) return;
+    if (atomic_load(&s_state) != BB_IDLE) {
+        LOG_WARN(TAG_BBOX, "Previous record not uploaded — %s trip not recorded",
+                 anomaly_type_to_string(event->type));
+        return;
+    }
+    s_trip_type    = (uint8_t)event->type;
+    s_trip_channel = event->channel;
+    s_trip_episode = event->episode_id;
+    s_trip_ms      = event->timestamp;
+    atomic_store(&s_state, BB_FREEZE_PENDING);
+}
+
+// ── Reader (HTTP task) ────────────────────────────────────────────────────────
+
+const blackbox_record_t *blackbox_pending(void)
+{
+    return atomic_load(&s_state) == BB_READY ? &s_record : NULL;
+}
+
+void blackbox_release(void)
+{
+    s_record.magic = 0;     // not re-uploaded after a reset
+    atomic_store(&s_state, BB_IDLE);
+}
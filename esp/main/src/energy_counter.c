@@ -0,0 +1,236 @@
+#include "energy_counter.h"
+#include "config.h"
+#include "logger.h"
+
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "nvs.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+// On-flash checkpoint, one per ring slot
+typedef struct {
+    uint32_t seq;           // monotonically increasing; highest valid wins
+    uint32_t meter_wh;      // register value the total was taken at
+    uint64_t total_wh;
+    uint32_t crc;           // CRC32 over the fields above
+} energy_ckpt_t;
+
+typedef struct {
+    uint64_t total_wh;
+    uint32_t meter_wh;      // last register value seen
+    uint32_t last_read_ms;
+    bool     have_meter;    // meter_wh is a live baseline
+    bool     restored;      // meter_wh came from a checkpoint, not a read
+    // Persistence bookkeeping
+    uint64_t saved_total_wh;
+    uint32_t saved_ms;
+    uint32_t seq;
+    uint8_t  next_slot;
+} energy_channel_t;
+
+static energy_channel_t s_ch[PZEM_CHANNEL_COUNT];
+static portMUX_TYPE     s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static uint32_t now_ms(void)
+{
+    return xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
+
+static uint32_t ckpt_crc(const energy_ckpt_t *c)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)c, offsetof(energy_ckpt_t, crc));
+}
+
+static void slot_key(char *key, size_t len, uint8_t ch, uint8_t slot)
+{
+    snprintf(key, len, "en%u_%u", ch, slot);
+}
+
+// ── Boot restore ──────────────────────────────────────────────────────────────
+
+esp_err_t energy_counter_init(void)
+{
+    memset(s_ch, 0, sizeof(s_ch));
+
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &h);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        ESP_LOGI(TAG_PZEM, "Energy counter: no checkpoints yet");
+        return ESP_OK;
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG_PZEM, "Energy counter: NVS open failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    for (uint8_t ch = 0; ch < PZEM_CHANNEL_COUNT; ch++) {
+        energy_channel_t *c     = &s_ch[ch];
+        bool              found = false;
+
+        for (uint8_t slot = 0; slot < ENERGY_RING_SLOTS; slot++) {
+            char          key[16];
+            energy_ckpt_t ck;
+            size_t        len = sizeof(ck);
+            slot_key(key, sizeof(key), ch, slot);
+            if (nvs_get_blob(h, key, &ck, &len) != ESP_OK || len != sizeof(ck)) continue;
+            if (ck.crc != ckpt_crc(&ck)) {
+                ESP_LOGW(TAG_PZEM, "Energy CH%u slot %u corrupt — ignored", ch, slot);
+                continue;
+            }
+            if (!found || ck.seq > c->seq) {
+                c->seq       = ck.seq;
+                c->total_wh  = ck.total_wh;
+                c->meter_wh  = ck.meter_wh;
+                c->next_slot = (slot + 1) % ENERGY_RING_SLOTS;
+                found        = true;
+            }
+        }
+
+        if (found) {
+            c->have_meter     = true;
+            c->restored       = true;
+            c->saved_total_wh = c->total_wh;
+            ESP_LOGI(TAG_PZEM, "Energy CH%u restored: %llu Wh (seq %lu)",
+                     ch, (unsigned long long)c->total_wh, (unsigned long)c->seq);
+        }
+    }
+    nvs_close(h);
+    return ESP_OK;
+}
+
+// ── Accumulation ──────────────────────────────────────────────────────────────
+
+uint64_t energy_counter_update(uint8_t channel, uint32_t meter_wh)
+{
+    if (channel >= PZEM_CHANNEL_COUNT) return 0;
+
+    uint32_t now    = now_ms();
+    uint32_t glitch = 0;
+    uint32_t gap_ms = 0;
+    uint64_t total;
+
+    portENTER_CRITICAL(&s_lock);
+    energy_channel_t *c = &s_ch[channel];
+
+    if (!c->have_meter) {
+        // First reading ever: adopt the register as the lifetime total so the
+        // series continues from what the server has already seen.
+        c->total_wh = meter_wh;
+    } else if (meter_wh >= c->meter_wh) {
+        uint32_t delta = meter_wh - c->meter_wh;
+        // Energy counted while we were not reading is bounded by full-scale
+        // power over the gap. After a reboot the gap is unknown, so any
+        // forward step from the checkpoint is accepted.
+        gap_ms = now - c->last_read_ms;
+        uint64_t limit = ENERGY_STEP_SLACK_WH + (uint64_t)gap_ms * ENERGY_MAX_POWER_W / 3600000ULL;
+        if (c->restored || delta <= limit) {
+            c->total_wh += delta;
+        } else {
+            glitch = delta;
+        }
+    } else if (c->meter_wh >= ENERGY_METER_WRAP_WH - ENERGY_WRAP_MARGIN_WH &&
+               meter_wh < ENERGY_WRAP_MARGIN_WH) {
+        c->total_wh += (ENERGY_METER_WRAP_WH - c->meter_wh) + meter_wh;
+    } else {
+        // Register reset (pzem_reset_energy, meter swapped): everything on
+        // it now was consumed since the reset.
+        c->total_wh += meter_wh;
+    }
+
+    c->meter_wh     = meter_wh;
+    c->last_read_ms = now;
+    c->have_meter   = true;
+    c->restored     = false;
+    total           = c->total_wh;
+    portEXIT_CRITICAL(&s_lock);
+
+    if (glitch) {
+        ESP_LOGW(TAG_PZEM, "Energy CH%u jumped %lu Wh in %lu ms — rebaselined",
+                 channel, (unsigned long)glitch, (unsigned long)gap_ms);
+    }
+    return total;
+}
+
+uint64_t energy_counter_total(uint8_t channel)
+{
+    if (channel >= PZEM_CHANNEL_COUNT) return 0;
+
+    portENTER_CRITICAL(&s_lock);
+    uint64_t total = s_ch[channel].total_wh;
+    portEXIT_CRITICAL(&s_lock);
+    return total;
+}
+
+uint64_t energy_counter_sum(void)
+{
+    uint64_t sum = 0;
+    portENTER_CRITICAL(&s_lock);
+    for (uint8_t ch = 0; ch < PZEM_CHANNEL_COUNT; ch++) sum += s_ch[ch].total_wh;
+    portEXIT_CRITICAL(&s_lock);
+    return sum;
+}
+
+// ── Checkpointing ─────────────────────────────────────────────────────────────
+
+void energy_counter_persist(bool force)
+{
+    uint32_t     now = now_ms();
+    nvs_handle_t h;
+    bool         open = false;
+
+    for (uint8_t ch = 0; ch < PZEM_CHANNEL_COUNT; ch++) {
+        energy_ckpt_t ck   = {0};
+        uint8_t       slot = 0;
+
+        portENTER_CRITICAL(&s_lock);
+        energy_channel_t *c     = &s_ch[ch];
+        uint64_t          fresh = c->total_wh - c->saved_total_wh;
+        bool due = c->have_meter && !c->restored && fresh > 0 &&
+                   (force || fresh >= ENERGY_CHECKPOINT_WH ||
+                    now - c->saved_ms >= ENERGY_CHECKPOINT_MAX_MS);
+        if (due) {
+            ck.seq      = c->seq + 1;
+            ck.meter_wh = c->meter_wh;
+            ck.total_wh = c->total_wh;
+            slot        = c->next_slot;
+        }
+        portEXIT_CRITICAL(&s_lock);
+
+        if (!due) continue;
+
+        if (!open) {
+            if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &h) != ESP_OK) {
+                ESP_LOGE(TAG_PZEM, "Energy checkpoint: NVS open failed");
+                return;
+            }
+            open = true;
+        }
+
+        char key[16];
+        slot_key(key, sizeof(key), ch, slot);
+        ck.crc = ckpt_crc(&ck);
+        esp_err_t err = nvs_set_blob(h, key, &ck, sizeof(ck));
+        if (err == ESP_OK) err = nvs_commit(h);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG_PZEM, "Energy CH%u checkpoint failed: %s", ch, esp_err_to_name(err));
+            continue;
+        }
+
+        portENTER_CRITICAL(&s_lock);
+        s_ch[ch].seq            = ck.seq;
+        s_ch[ch].saved_total_wh = ck.total_wh;
+        s_ch[ch].saved_ms       = now;
+        s_ch[ch].next_slot      = (slot + 1) % ENERGY_RING_SLOTS;
+        portEXIT_CRITICAL(&s_lock);
+
+        LOG_DEBUG(TAG_PZEM, "Energy CH%u checkpoint %llu Wh → slot %u (seq %lu)",
+                  ch, (unsigned long long)ck.total_wh, slot, (unsigned long)ck.seq);
+    }
+
+    if (open) nvs_close(h);
+}
@@ -0,0 +1,398 @@
+#include "forecast.h"
+#include "config.h"
+#include "logger.h"
+#include "energy_counter.h"
+
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "nvs.h"
+
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+
+#define FORECAST_NVS_KEY    "forecast"
+
+// Readings an hour needs before it may update its bucket
+#define MIN_HOUR_SAMPLES    ((3600000 / PZEM_READ_INTERVAL_MS) * FORECAST_MIN_COVERAGE_PCT / 100)
+
+// On-flash model: profile, budget and the period anchor
+typedef struct {
+    uint16_t          bucket[FORECAST_BUCKETS];     // mean W per hour of week (fixed point)
+    uint8_t           seeded[FORECAST_BUCKETS / 8]; // bucket has seen a full hour
+    forecast_budget_t budget;
+    bool              have_budget;
+    int64_t           anchor_period;    // period_start the anchor belongs to (0 = none)
+    int64_t           anchor_wh;        // lifetime energy at that period start
+    uint32_t          crc;              // CRC32 over the fields above
+} forecast_blob_t;
+
+typedef struct {
+    forecast_blob_t  saved;
+    // Current hour
+    int16_t          how;               // hour of week, -1 before the first reading
+    int64_t          hour_end;          // Unix seconds
+    uint64_t         sum_dw;
+    uint32_t         samples;
+    // Latest evaluation
+    forecast_state_t state;
+    int64_t          used_wh;
+    int64_t          projected_wh;
+    int64_t          end_reported;      // period_end a sync was already requested for
+    uint32_t         gen;               // bumped on every change that needs persisting
+    uint32_t         saved_gen;
+} forecast_ctx_t;
+
+// Readings not yet folded in by forecast_update(), split at the hour end
+typedef struct {
+    uint64_t sum_dw;
+    uint32_t samples;
+} forecast_acc_t;
+
+static forecast_ctx_t    s_fc;
+static SemaphoreHandle_t s_mutex = NULL;
+static volatile bool     s_sync_requested;
+
+// Read task → energy task; s_acc_lock is held for a few adds only
+static portMUX_TYPE      s_acc_lock = portMUX_INITIALIZER_UNLOCKED;
+static forecast_acc_t    s_acc_cur;         // before s_acc_hour_end
+static forecast_acc_t    s_acc_next;        // at or after it
+static int64_t           s_acc_hour_end;    // 0 until the first hour opens
+
+static uint32_t blob_crc(const forecast_blob_t *b)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)b, offsetof(forecast_blob_t, crc));
+}
+
+static bool is_seeded(int i)
+{
+    return s_fc.saved.seeded[i / 8] & (1u << (i % 8));
+}
+
+static uint8_t learned_count(void)
+{
+    uint8_t n = 0;
+    for (int i = 0; i < FORECAST_BUCKETS; i++) n += is_seeded(i);
+    return n;
+}
+
+// ── Profile ───────────────────────────────────────────────────────────────────
+
+// Hour of week of `now` and the Unix second that hour ends
+static void hour_of(int64_t now, int16_t *how, int64_t *end)
+{
+    time_t    t = (time_t)now;
+    struct tm tm;
+    localtime_r(&t, &tm);
+    *how = tm.tm_wday * 24 + tm.tm_hour;
+    *end = now - tm.tm_min * 60 - tm.tm_sec + 3600;
+}
+
+// Fold the finished hour's mean into its bucket (EWMA, α = 2^-FORECAST_EWMA_SHIFT)
+static void close_hour(void)
+{
+    if (s_fc.how < 0 || s_fc.samples < MIN_HOUR_SAMPLES) return;
+
+    uint64_t mean = (s_fc.sum_dw << FORECAST_Q_BITS) / ((uint64_t)s_fc.samples * 10);
+    if (mean > UINT16_MAX) mean = UINT16_MAX;
+
+    int i = s_fc.how;
+    if (!is_seeded(i)) {
+        s_fc.saved.bucket[i]     = (uint16_t)mean;
+        s_fc.saved.seeded[i / 8] |= 1u << (i % 8);
+    } else {
+        int32_t diff = (int32_t)mean - s_fc.saved.bucket[i];
+        int32_t half = 1 << (FORECAST_EWMA_SHIFT - 1);
+        s_fc.saved.bucket[i] += (diff + (diff >= 0 ? half : -half)) / (1 << FORECAST_EWMA_SHIFT);
+    }
+    s_fc.gen++;
+}
+
+// ── Projection ────────────────────────────────────────────────────────────────
+
+// Energy expected between now and the end of the period (Wh), -1 if there
+// is nothing to go on. Unlearned hours use the mean of the learned ones,
+// and with none learned yet, the current hour so far.
+static int64_t project_rest(int64_t now, int64_t period_end)
+{
+    if (now >= period_end) return 0;
+
+    uint32_t fill = 0;
+    uint8_t  n    = learned_count();
+    if (n > 0) {
+        uint32_t sum = 0;
+        for (int i = 0; i < FORECAST_BUCKETS; i++) if (is_seeded(i)) sum += s_fc.saved.bucket[i];
+        fill = sum / n;
+    } else if (s_fc.samples > 0) {
+        fill = (uint32_t)((s_fc.sum_dw << FORECAST_Q_BITS) / ((uint64_t)s_fc.samples * 10));
+    } else {
+        return -1;
+    }
+
+    uint32_t b[FORECAST_BUCKETS];
+    uint64_t week = 0;
+    for (int i = 0; i < FORECAST_BUCKETS; i++) {
+        b[i]  = is_seeded(i) ? s_fc.saved.bucket[i] : fill;
+        week += b[i];
+    }
+
+    // Rest of this hour, whole weeks, leftover whole hours, final part-hour.
+    // The hour may have ended a pass ago; its overrun is counted from hour_end.
+    int64_t  first = (s_fc.hour_end < period_end ? s_fc.hour_end : period_end) - now;
+    if (first < 0) first = 0;
+    uint64_t acc   = (uint64_t)b[s_fc.how] * first;
+    int64_t  rest  = period_end - s_fc.hour_end;
+    if (rest > 0) {
+        uint64_t hours = (uint64_t)rest / 3600;
+        acc += (hours / FORECAST_BUCKETS) * week * 3600;
+        uint32_t k = 1;
+        for (; k <= hours % FORECAST_BUCKETS; k++) {
+            acc += (uint64_t)b[(s_fc.how + k) % FORECAST_BUCKETS] * 3600;
+        }
+        acc += (uint64_t)b[(s_fc.how + k) % FORECAST_BUCKETS] * ((uint64_t)rest % 3600);
+    }
+    return (int64_t)(acc / (3600ULL << FORECAST_Q_BITS));
+}
+
+static forecast_state_t classify(const forecast_budget_t *b, int64_t used, int64_t projected)
+{
+    if (used > (int64_t)b->budget_wh)                            return FORECAST_STATE_EXCEEDED;
+    if (projected < 0)                                           return FORECAST_STATE_NONE;
+    if (projected > (int64_t)b->budget_wh)                       return FORECAST_STATE_OVER;
+    if (projected * 100 >= (int64_t)b->budget_wh * b->warn_pct) return FORECAST_STATE_WARNING;
+    return FORECAST_STATE_OK;
+}
+
+// Caller holds s_mutex and has checked the clock
+static void evaluate(int64_t now)
+{
+    const forecast_budget_t *b   = &s_fc.saved.budget;
+    forecast_state_t         old = s_fc.state;
+
+    s_fc.state        = FORECAST_STATE_NONE;
+    s_fc.used_wh      = 0;
+    s_fc.projected_wh = -1;
+
+    if (!s_fc.saved.have_budget || b->budget_wh == 0 || now < b->period_start) return;
+
+    // The server announces the next period; until then there is nothing to judge
+    if (now >= b->period_end) {
+        if (s_fc.end_reported != b->period_end) {
+            s_fc.end_reported = b->period_end;
+            s_sync_requested  = true;
+        }
+        return;
+    }
+
+    if (s_fc.saved.anchor_period != b->period_start) {
+        // Joining mid-period: what the server has seen so far counts as used
+        s_fc.saved.anchor_period = b->period_start;
+        s_fc.saved.anchor_wh     = (int64_t)energy_counter_sum() -
+                                   (b->period_used_wh > 0 ? b->period_used_wh : 0);
+        s_fc.gen++;
+    }
+
+    s_fc.used_wh = (int64_t)energy_counter_sum() - s_fc.saved.anchor_wh;
+    if (s_fc.used_wh < 0) s_fc.used_wh = 0;
+    int64_t rest = project_rest(now, b->period_end);
+    s_fc.projected_wh = rest < 0 ? -1 : s_fc.used_wh + rest;
+    s_fc.state        = classify(b, s_fc.used_wh, s_fc.projected_wh);
+
+    if (s_fc.state > old && s_fc.state >= FORECAST_STATE_WARNING) {
+        LOG_WARN(TAG_FORECAST, "Budget %s: used %lld Wh, projected %lld of %lu Wh",
+                 forecast_state_to_string(s_fc.state), (long long)s_fc.used_wh,
+                 (long long)s_fc.projected_wh, (unsigned long)b->budget_wh);
+        s_sync_requested = true;
+    } else if (s_fc.state != old) {
+        LOG_INFO(TAG_FORECAST, "Budget %s: projected %lld of %lu Wh",
+                 forecast_state_to_string(s_fc.state), (long long)s_fc.projected_wh,
+                 (unsigned long)b->budget_wh);
+    }
+}
+
+// ── Public API ────────────────────────────────────────────────────────────────
+
+esp_err_t forecast_init(void)
+{
+    memset(&s_fc, 0, sizeof(s_fc));
+    s_fc.how          = -1;
+    s_fc.projected_wh = -1;
+    portENTER_CRITICAL(&s_acc_lock);
+    memset(&s_acc_cur,  0, sizeof(s_acc_cur));
+    memset(&s_acc_next, 0, sizeof(s_acc_next));
+    s_acc_hour_end = 0;
+    portEXIT_CRITICAL(&s_acc_lock);
+    s_mutex  = xSemaphoreCreateMutex();
+    if (!s_mutex) return ESP_ERR_NO_MEM;
+
+    nvs_handle_t h;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &h) == ESP_OK) {
+        forecast_blob_t b;
+        size_t          len = sizeof(b);
+        if (nvs_get_blob(h, FORECAST_NVS_KEY, &b, &len) == ESP_OK && len == sizeof(b)) {
+            if (b.crc == blob_crc(&b)) {
+                s_fc.saved = b;
+            } else {
+                ESP_LOGW(TAG_FORECAST, "Stored load profile corrupt — relearning");
+            }
+        }
+        nvs_close(h);
+    }
+
+    ESP_LOGI(TAG_FORECAST, "Load profile: %u/%d hours learned, budget %lu Wh",
+             learned_count(), FORECAST_BUCKETS,
+             (unsigned long)(s_fc.saved.have_budget ? s_fc.saved.budget.budget_wh : 0));
+    return ESP_OK;
+}
+
+void forecast_note_power(uint32_t power_dw)
+{
+    int64_t now = (int64_t)time(NULL);
+    if (now < CLOCK_VALID_AFTER) return;   // not synced yet
+
+    portENTER_CRITICAL(&s_acc_lock);
+    forecast_acc_t *acc = now >= s_acc_hour_end ? &s_acc_next : &s_acc_cur;
+    acc->sum_dw += power_dw;
+    acc->samples++;
+    portEXIT_CRITICAL(&s_acc_lock);
+}
+
+void forecast_update(void)
+{
+    int64_t now = (int64_t)time(NULL);
+    if (now < CLOCK_VALID_AFTER) return;
+    if (!s_mutex || xSemaphoreTake(s_mutex, pdMS_TO_TICKS(100)) != pdTRUE) return;
+
+    // Work the next hour out first so the swap below is a few stores
+    bool    roll = s_fc.how < 0 || now >= s_fc.hour_end;
+    int16_t how  = s_fc.how;
+    int64_t end  = s_fc.hour_end;
+    if (roll) hour_of(now, &how, &end);
+
+    forecast_acc_t cur, next;
+    portENTER_CRITICAL(&s_acc_lock);
+    cur  = s_acc_cur;
+    next = s_acc_next;
+    memset(&s_acc_cur,  0, sizeof(s_acc_cur));
+    memset(&s_acc_next, 0, sizeof(s_acc_next));
+    s_acc_hour_end = end;
+    portEXIT_CRITICAL(&s_acc_lock);
+
+    s_fc.sum_dw  += cur.sum_dw;
+    s_fc.samples += cur.samples;
+    if (roll) {
+        close_hour();
+        s_fc.how      = how;
+        s_fc.hour_end = end;
+        s_fc.sum_dw   = 0;
+        s_fc.samples  = 0;
+    }
+    // Without a roll `next` holds at most a reading or two that raced the
+    // hour end; they stay in this hour
+    s_fc.sum_dw  += next.sum_dw;
+    s_fc.samples += next.samples;
+
+    evaluate(now);
+    xSemaphoreGive(s_mutex);
+}
+
+esp_err_t forecast_apply(const forecast_budget_t *budget)
+{
+    if (!budget || !s_mutex) return ESP_ERR_INVALID_ARG;
+    if (budget->period_end <= budget->period_start || budget->warn_pct > 100) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (xSemaphoreTake(s_mutex, pdMS_TO_TICKS(500)) != pdTRUE) return ESP_ERR_TIMEOUT;
+
+    const forecast_budget_t *cur = &s_fc.saved.budget;
+    if (s_fc.saved.have_budget && cur->seq == budget->seq && cur->budget_wh == budget->budget_wh &&
+        cur->warn_pct == budget->warn_pct && cur->period_start == budget->period_start &&
+        cur->period_end == budget->period_end) {
+        xSemaphoreGive(s_mutex);
+        return ESP_OK;
+    }
+
+    s_fc.saved.budget      = *budget;
+    s_fc.saved.have_budget = true;
+    s_fc.gen++;
+    LOG_INFO(TAG_FORECAST, "Budget seq %lu: %lu Wh, warn at %u%%",
+             (unsigned long)budget->seq, (unsigned long)budget->budget_wh, budget->warn_pct);
+
+    int64_t now = (int64_t)time(NULL);
+    if (now >= CLOCK_VALID_AFTER && s_fc.how >= 0) evaluate(now);
+
+    xSemaphoreGive(s_mutex);
+    return ESP_OK;
+}
+
+void forecast_get_status(forecast_status_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    out->projected_wh = -1;
+    if (!s_mutex || xSemaphoreTake(s_mutex, pdMS_TO_TICKS(100)) != pdTRUE) return;
+    out->state        = s_fc.state;
+    out->seq          = s_fc.saved.have_budget ? s_fc.saved.budget.seq : 0;
+    out->period_start = s_fc.saved.anchor_period;
+    out->used_wh      = s_fc.used_wh;
+    out->projected_wh = s_fc.projected_wh;
+    out->learned      = learned_count();
+    xSemaphoreGive(s_mutex);
+}
+
+void forecast_request_sync(void)
+{
+    s_sync_requested = true;
+}
+
+bool forecast_take_sync_request(void)
+{
+    bool due = s_sync_requested;
+    s_sync_requested = false;
+    return due;
+}
+
+void forecast_persist(void)
+{
+    if (!s_mutex || xSemaphoreTake(s_mutex, pdMS_TO_TICKS(100)) != pdTRUE) return;
+    bool            due = s_fc.gen != s_fc.saved_gen;
+    forecast_blob_t b   = s_fc.saved;
+    uint32_t        gen = s_fc.gen;
+    xSemaphoreGive(s_mutex);
+
+    if (!due) return;
+
+    nvs_handle_t h;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &h) != ESP_OK) {
+        ESP_LOGE(TAG_FORECAST, "Profile persist: NVS open failed");
+        return;
+    }
+    b.crc = blob_crc(&b);
+    esp_err_t err = nvs_set_blob(h, FORECAST_NVS_KEY, &b, sizeof(b));
+    if (err == ESP_OK) err = nvs_commit(h);
+    nvs_close(h);
+
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG_FORECAST, "Profile persist failed: %s", esp_err_to_name(err));
+        return;
+    }
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    s_fc.saved_gen = gen;
+    xSemaphoreGive(s_mutex);
+}
+
+const char *forecast_state_to_string(forecast_state_t state)
+{
+    switch (state) {
+        case FORECAST_STATE_NONE:     return "none";
+        case FORECAST_STATE_OK:       return "ok";
+        case FORECAST_STATE_WARNING:  return "warning";
+        case FORECAST_STATE_OVER:     return "over";
+        case FORECAST_STATE_EXCEEDED: return "exceeded";
+        default:                      return "unknown";
+    }
+}
@@ -4,11 +4,18 @@
 #include "relay_control.h"
 #include "wifi_manager.h"
 #include "led_status.h"
+#include "modbus_rtu.h"
+#include "fixed_point.h"
+#include "anomaly_rules.h"
+#include "anomaly_model.h"
+#include "prepaid.h"
+#include "forecast.h"
 
 #include "esp_http_client.h"
 #include "esp_crt_bundle.h"
 #include "esp_log.h"
 #include "cJSON.h"
+#include "mbedtls/md.h"
 #include "nvs_flash.h"
 #include "nvs.h"
 
@@ -20,6 +27,16 @@ static char s_server_url[160] = HTTP_SERVER_URL;
 static char s_api_key[80]     = HTTP_API_KEY;
 static char s_device_id[80]   = HTTP_DEVICE_ID;
 
+// Per-channel device IDs for multi-meter buses. Channel 0 is s_device_id;
+// channel n loads NVS "device_id<n>" or defaults to "<device_id>-ch<n>".
+static char s_channel_ids[PZEM_CHANNEL_COUNT][80];
+
+static const char *device_id_for_channel(uint8_t channel)
+{
+    if (channel == 0 || channel >= PZEM_CHANNEL_COUNT) return s_device_id;
+    return s_channel_ids[channel];
+}
+
 void http_client_init(void)
 {
     // Load server URL and API key from NVS (set via the Settings tab in the dashboard)
@@ -33,6 +50,19 @@ void http_client_init(void)
         nvs_get_str(handle, "device_id",  s_device_id,  &id_len);
         nvs_close(handle);
     }
+
+    bool have_nvs = (nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle) == ESP_OK);
+    for (uint8_t ch = 1; ch < PZEM_CHANNEL_COUNT; ch++) {
+        char   key[16];
+        size_t len = sizeof(s_channel_ids[ch]);
+        snprintf(key, sizeof(key), "device_id%u", ch);
+        if (!have_nvs || nvs_get_str(handle, key, s_channel_ids[ch], &len) != ESP_OK) {
+            snprintf(s_channel_ids[ch], sizeof(s_channel_ids[ch]), "%.70s-ch%u", s_device_id, ch);
+        }
+        ESP_LOGI(TAG_HTTP, "Channel %u device: %s", ch, s_channel_ids[ch]);
+    }
+    if (have_nvs) nvs_close(handle);
+
     ESP_LOGI(TAG_HTTP, "HTTP client initialized, server: %s  device: %s  key_len: %d  key_prefix: %.8s",
              s_server_url, s_device_id, (int)strlen(s_api_key), s_api_key);
 }
@@ -76,6 +106,50 @@ static esp_err_t perform_post(const char *url, const char *json_str)
     return err;
 }
 
+// Attach Modbus link-quality counters for the meter that produced a reading,
+// so a noisy optocoupler can be told apart from a dead meter fleet-wide.
+static void add_link_stats(cJSON *root, uint8_t addr)
+{
+    modbus_link_stats_t st;
+    if (!modbus_rtu_get_stats(addr, &st)) return;
+
+    cJSON *link = cJSON_AddObjectToObject(root, "modbus_link");
+    if (!link) return;
+    cJSON_AddNumberToObject(link, "addr",          st.addr);
+    cJSON_AddNumberToObject(link, "frames_ok",     st.frames_ok);
+    cJSON_AddNumberToObject(link, "reads_ok",      st.reads_ok);
+    cJSON_AddNumberToObject(link, "retries",       st.retries);
+    cJSON_AddNumberToObject(link, "timeouts",      st.timeouts);
+    cJSON_AddNumberToObject(link, "short_frames",  st.short_frames);
+    cJSON_AddNumberToObject(link, "crc_errors",    st.crc_errors);
+    cJSON_AddNumberToObject(link, "header_errors", st.header_errors);
+    cJSON_AddNumberToObject(link, "exceptions",    st.exceptions);
+    cJSON_AddNumberToObject(link, "srtt_ms",       st.srtt_ms);
+    cJSON_AddNumberToObject(link, "rto_ms",        st.rto_ms);
+    cJSON_AddNumberToObject(link, "since_ok_ms",   st.since_ok_ms);
+
+    cJSON *hist = cJSON_AddArrayToObject(link, "latency_hist");
+    for (int b = 0; hist && b < MODBUS_LATENCY_BUCKETS; b++) {
+        cJSON_AddItemToArray(hist, cJSON_CreateNumber(st.latency_hist[b]));
+    }
+}
+
+// Emit a fixed-point reading as a JSON number without going through double
+static void add_fixed(cJSON *obj, const char *key, uint64_t value, uint8_t decimals)
+{
+    char num[24];
+    fixed_fmt(num, sizeof(num), value, decimals);
+    cJSON_AddRawToObject(obj, key, num);
+}
+
+static void add_signed_fixed(cJSON *obj, const char *key, int64_t value, uint8_t decimals)
+{
+    char num[24] = "-";
+    uint64_t mag = value < 0 ? -(uint64_t)value : (uint64_t)value;
+    fixed_fmt(num + (value < 0), sizeof(num) - 1, mag, decimals);
+    cJSON_AddRawToObject(obj, key, num);
+}
+
 esp_err_t http_post_power_data(const pzem_data_t *data)
 {
     if (!wifi_is_connected()) {
@@ -85,15 +159,16 @@ esp_err_t http_post_power_data(const pzem_data_t *data)
     if (!data || !data->valid) return ESP_ERR_INVALID_ARG;
 
     cJSON *root = cJSON_CreateObject();
-    cJSON_AddStringToObject(root, "device_id",      s_device_id);
+    cJSON_AddStringToObject(root, "device_id",      device_id_for_channel(data->channel));
     cJSON_AddNumberToObject(root, "timestamp",      data->timestamp);
-    cJSON_AddNumberToObject(root, "voltage_rms",    (double)data->v_rms);
-    cJSON_AddNumberToObject(root, "current_rms",    (double)data->i_rms);
-    cJSON_AddNumberToObject(root, "power_real",     (double)data->power);
-    cJSON_AddNumberToObject(root, "power_apparent", (double)data->power_apparent);
-    cJSON_AddNumberToObject(root, "power_factor",   (double)data->power_factor);
-    cJSON_AddNumberToObject(root, "energy_kwh",     (double)(data->energy / 1000.0f));
-    cJSON_AddNumberToObject(root, "frequency",      (double)data->frequency);
+    add_fixed(root, "voltage_rms",    data->v_dv,         1);
+    add_fixed(root, "current_rms",    data->i_ma,         3);
+    add_fixed(root, "power_real",     data->power_dw,     1);
+    add_fixed(root, "power_apparent", data->apparent_dva, 1);
+    add_fixed(root, "power_factor",   data->pf_pct,       2);
+    add_fixed(root, "energy_kwh",     data->energy_wh,    3);
+    add_fixed(root, "frequency",      data->freq_dhz,     1);
+    add_link_stats(root, pzem_sensor_channel_addr(data->channel));
 
     char *json_str = cJSON_PrintUnformatted(root);
     cJSON_Delete(root);
@@ -117,13 +192,31 @@ esp_err_t http_post_anomaly_event(const anomaly_event_t *event)
     if (!event) return ESP_ERR_INVALID_ARG;
 
     cJSON *root = cJSON_CreateObject();
-    cJSON_AddStringToObject(root, "device_id",    s_device_id);
+    cJSON_AddStringToObject(root, "device_id",    device_id_for_channel(event->channel));
     cJSON_AddNumberToObject(root, "timestamp",    event->timestamp);
     cJSON_AddStringToObject(root, "anomaly_type", anomaly_type_to_string(event->type));
-    cJSON_AddNumberToObject(root, "current",      (double)event->i_rms);
-    cJSON_AddNumberToObject(root, "voltage",      (double)event->v_rms);
-    cJSON_AddNumberToObject(root, "power",        (double)event->power);
+    add_fixed(root, "current",      event->i_ma,     3);
+    add_fixed(root, "voltage",      event->v_dv,     1);
+    add_fixed(root, "power",        event->power_dw, 1);
     cJSON_AddBoolToObject(root,   "relay_tripped", event->relay_triggered);
+    if (event->trip_latency_us) {
+        cJSON_AddNumberToObject(root, "trip_latency_us", event->trip_latency_us);
+    }
+    static const char *const severity[] = { "low", "medium", "high", "critical" };
+    if (event->severity <= RULE_SEVERITY_CRITICAL) {
+        cJSON_AddStringToObject(root, "severity", severity[event->severity]);
+    }
+
+    // Episode rollup; integral is sent in unit·s
+    static const char *const phase[] = { "onset", "update", "clear" };
+    uint8_t dp = anomaly_rules_metric_decimals(event->metric);
+    cJSON_AddNumberToObject(root, "episode_id",  event->episode_id);
+    cJSON_AddStringToObject(root, "phase",       phase[event->phase <= ANOMALY_PHASE_CLEAR ? event->phase : 0]);
+    cJSON_AddStringToObject(root, "metric",      anomaly_rules_metric_name(event->metric));
+    cJSON_AddNumberToObject(root, "duration_ms", event->duration_ms);
+    add_fixed(root, "peak",     event->peak,            dp);
+    add_fixed(root, "min",      event->min,             dp);
+    add_fixed(root, "integral", event->integral / 1000, dp);
 
     char *json_str = cJSON_PrintUnformatted(root);
     cJSON_Delete(root);
@@ -138,6 +231,203 @@ esp_err_t http_post_anomaly_event(const anomaly_event_t *event)
     return err;
 }
 
+esp_err_t http_post_blackbox(const blackbox_record_t *rec)
+{
+    if (!wifi_is_connected()) return ESP_ERR_INVALID_STATE;
+    if (!rec) return ESP_ERR_INVALID_ARG;
+
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "device_id", device_id_for_channel(rec->channel));
+    if (rec->reason == BLACKBOX_REASON_RESET) {
+        cJSON_AddStringToObject(root, "reason",       "reset");
+        cJSON_AddNumberToObject(root, "reset_reason", rec->reset_reason);
+    } else {
+        cJSON_AddStringToObject(root, "reason",       "trip");
+        cJSON_AddNumberToObject(root, "episode_id",   rec->episode_id);
+        cJSON_AddStringToObject(root, "anomaly_type", anomaly_type_to_string((anomaly_type_t)rec->anomaly_type));
+    }
+
+    // Rows: [ms relative to the trip, channel, mA, 0.1 V, 0.1 W];
+    // fast samples stop after 0.1 V (after mA without PZEM_FAST_POLL_VOLTAGE).
+    cJSON *rows = cJSON_AddArrayToObject(root, "samples");
+    for (uint16_t k = 0; k < rec->count; k++) {
+        const blackbox_sample_t *s = &rec->samples[k];
+        int row[5] = {
+            (int32_t)(s->t_ms - rec->trip_ms), s->channel,
+            (int)s->i_ma, s->v_dv, (int)s->power_dw,
+        };
+        cJSON_AddItemToArray(rows, cJSON_CreateIntArray(row,
+                             (s->flags & BLACKBOX_FLAG_CURRENT_ONLY) ? 3 + PZEM_FAST_POLL_VOLTAGE : 5));
+    }
+
+    char *json_str = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+
+    if (!json_str) return ESP_ERR_NO_MEM;
+
+    char url[256];
+    snprintf(url, sizeof(url), "%s/api/v1/anomaly-events/blackbox", s_server_url);
+    esp_err_t err = perform_post(url, json_str);
+
+    free(json_str);
+    return err;
+}
+
+esp_err_t http_post_pq_events(const pq_event_t *events, uint8_t count)
+{
+    if (!wifi_is_connected()) {
+        LOG_DEBUG(TAG_HTTP, "WiFi not connected, skipping power-quality POST");
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!events || count == 0) return ESP_ERR_INVALID_ARG;
+
+    uint32_t now_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "device_id", device_id_for_channel(events[0].channel));
+    cJSON *list = cJSON_AddArrayToObject(root, "events");
+    for (uint8_t k = 0; k < count; k++) {
+        const pq_event_t *e   = &events[k];
+        cJSON            *obj = cJSON_CreateObject();
+        cJSON_AddStringToObject(obj, "kind",        pq_kind_to_string((pq_kind_t)e->kind));
+        cJSON_AddStringToObject(obj, "category",    pq_category_to_string((pq_category_t)e->category));
+        cJSON_AddNumberToObject(obj, "age_ms",      now_ms - e->start_ms);
+        cJSON_AddNumberToObject(obj, "duration_ms", e->duration_ms);
+        add_fixed(obj, "min_voltage", e->min_dv, 1);
+        add_fixed(obj, "max_voltage", e->max_dv, 1);
+        cJSON_AddBoolToObject(obj,   "meter_silent", (e->flags & PQ_FLAG_SILENT) != 0);
+        cJSON_AddItemToArray(list, obj);
+    }
+
+    char *json_str = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+
+    if (!json_str) return ESP_ERR_NO_MEM;
+
+    char url[256];
+    snprintf(url, sizeof(url), "%s/api/v1/power-quality-events", s_server_url);
+    esp_err_t err = perform_post(url, json_str);
+
+    free(json_str);
+    return err;
+}
+
+esp_err_t http_post_model_flag(const anomaly_model_flag_t *flag)
+{
+    if (!wifi_is_connected()) return ESP_ERR_INVALID_STATE;
+    if (!flag) return ESP_ERR_INVALID_ARG;
+
+    uint32_t now_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "device_id",     device_id_for_channel(flag->channel));
+    cJSON_AddNumberToObject(root, "model_version", flag->model_version);
+    cJSON_AddNumberToObject(root, "score",         flag->score);
+    cJSON_AddNumberToObject(root, "threshold",     flag->threshold);
+    cJSON_AddNumberToObject(root, "age_ms",        now_ms - flag->start_ms);
+    int features[ANOMALY_MODEL_FEATURES];
+    for (uint8_t k = 0; k < ANOMALY_MODEL_FEATURES; k++) features[k] = (int)flag->features[k];
+    cJSON_AddItemToObject(root, "features", cJSON_CreateIntArray(features, ANOMALY_MODEL_FEATURES));
+
+    // Rows: [ms from the window start, 0.1 V, mA, 0.1 W, 0.01 PF, 0.1 Hz]
+    cJSON *rows = cJSON_AddArrayToObject(root, "samples");
+    for (uint8_t k = 0; k < flag->count; k++) {
+        const anomaly_model_sample_t *s = &flag->samples[k];
+        int row[6] = { s->dt_ms, s->v_dv, (int)s->i_ma, (int)s->power_dw, s->pf_pct, s->freq_dhz };
+        cJSON_AddItemToArray(rows, cJSON_CreateIntArray(row, 6));
+    }
+
+    char *json_str = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+
+    if (!json_str) return ESP_ERR_NO_MEM;
+
+    char url[256];
+    snprintf(url, sizeof(url), "%s/api/v1/anomaly-events/model-flags", s_server_url);
+    esp_err_t err = perform_post(url, json_str);
+
+    free(json_str);
+    return err;
+}
+
+esp_err_t http_post_nilm_events(const nilm_event_t *events, uint8_t count)
+{
+    if (!wifi_is_connected()) return ESP_ERR_INVALID_STATE;
+    if (!events || count == 0) return ESP_ERR_INVALID_ARG;
+
+    uint32_t now_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "device_id", device_id_for_channel(events[0].channel));
+    cJSON *list = cJSON_AddArrayToObject(root, "events");
+    for (uint8_t k = 0; k < count; k++) {
+        const nilm_event_t *e   = &events[k];
+        cJSON              *obj = cJSON_CreateObject();
+        cJSON_AddNumberToObject(obj, "appliance_id", e->appliance);
+        cJSON_AddStringToObject(obj, "edge",         nilm_edge_to_string((nilm_edge_t)e->edge));
+        cJSON_AddNumberToObject(obj, "age_ms",       now_ms - e->timestamp);
+        add_signed_fixed(obj, "power_step",    e->dp_dw,   1);
+        add_signed_fixed(obj, "reactive_step", e->dq_dvar, 1);
+        add_signed_fixed(obj, "pf_step",       e->dpf_pct, 2);
+        cJSON_AddNumberToObject(obj, "inrush_pct",   e->inrush_pct);
+        cJSON_AddNumberToObject(obj, "settle_ms",    e->settle_ms);
+        cJSON_AddBoolToObject(obj,   "new_signature", (e->flags & NILM_FLAG_NEW) != 0);
+        cJSON_AddBoolToObject(obj,   "at_idle",       (e->flags & NILM_FLAG_IDLE) != 0);
+        cJSON_AddItemToArray(list, obj);
+    }
+
+    char *json_str = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+
+    if (!json_str) return ESP_ERR_NO_MEM;
+
+    char url[256];
+    snprintf(url, sizeof(url), "%s/api/v1/appliance-events", s_server_url);
+    esp_err_t err = perform_post(url, json_str);
+
+    free(json_str);
+    return err;
+}
+
+esp_err_t http_post_nilm_summary(uint8_t channel)
+{
+    if (!wifi_is_connected()) return ESP_ERR_INVALID_STATE;
+
+    nilm_appliance_t app[NILM_MAX_APPLIANCES];
+    uint8_t          n = nilm_get_appliances(channel, app, NILM_MAX_APPLIANCES);
+    if (n == 0) return ESP_OK;      // nothing learned yet
+
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "device_id", device_id_for_channel(channel));
+    cJSON *list = cJSON_AddArrayToObject(root, "appliances");
+    for (uint8_t k = 0; k < n; k++) {
+        const nilm_appliance_t *a   = &app[k];
+        cJSON                  *obj = cJSON_CreateObject();
+        cJSON_AddNumberToObject(obj, "appliance_id", a->id);
+        add_signed_fixed(obj, "power_step",    a->dp_dw,   1);
+        add_signed_fixed(obj, "reactive_step", a->dq_dvar, 1);
+        cJSON_AddNumberToObject(obj, "inrush_pct",  a->inrush_pct);
+        cJSON_AddNumberToObject(obj, "edges",       a->edges);
+        cJSON_AddNumberToObject(obj, "trips",       a->trips);
+        cJSON_AddNumberToObject(obj, "running",     a->running);
+        add_fixed(obj, "energy_wh",   a->energy_mwh, 3);
+        cJSON_AddNumberToObject(obj, "run_seconds", (double)(a->run_ms / 1000));
+        cJSON_AddItemToArray(list, obj);
+    }
+
+    char *json_str = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+
+    if (!json_str) return ESP_ERR_NO_MEM;
+
+    char url[256];
+    snprintf(url, sizeof(url), "%s/api/v1/appliance-events/summary", s_server_url);
+    esp_err_t err = perform_post(url, json_str);
+
+    free(json_str);
+    return err;
+}
+
 bool http_server_available(void)
 {
     if (!wifi_is_connected()) return false;
@@ -164,19 +454,20 @@ bool http_server_available(void)
 // ── Relay command polling ─────────────────────────────────────────────────────
 
 // Event handler accumulates chunked/non-chunked body into user_data buffer.
-// user_data points to a relay_poll_ctx_t (see below).
+// user_data points to a body_ctx_t (see below).
 typedef struct {
-    char  buf[256];
+    char *buf;
+    int   cap;
     int   len;
-} relay_poll_ctx_t;
+} body_ctx_t;
 
-static esp_err_t relay_poll_event_handler(esp_http_client_event_t *evt)
+static esp_err_t body_event_handler(esp_http_client_event_t *evt)
 {
-    relay_poll_ctx_t *ctx = (relay_poll_ctx_t *)evt->user_data;
+    body_ctx_t *ctx = (body_ctx_t *)evt->user_data;
     if (evt->event_id == HTTP_EVENT_ON_DATA && ctx) {
         int copy = evt->data_len;
-        if (ctx->len + copy >= (int)sizeof(ctx->buf) - 1)
-            copy = (int)sizeof(ctx->buf) - 1 - ctx->len;
+        if (ctx->len + copy >= ctx->cap - 1)
+            copy = ctx->cap - 1 - ctx->len;
         if (copy > 0) {
             memcpy(ctx->buf + ctx->len, evt->data, copy);
             ctx->len += copy;
@@ -194,13 +485,14 @@ esp_err_t http_poll_relay_command(int *out_command_id, char *out_command, size_t
     char url[320];
     snprintf(url, sizeof(url), "%s/api/v1/devices/%s/relay-command", s_server_url, s_device_id);
 
-    relay_poll_ctx_t ctx = { .buf = {0}, .len = 0 };
+    char       body[256];
+    body_ctx_t ctx = { .buf = body, .cap = sizeof(body), .len = 0 };
 
     esp_http_client_config_t cfg = {
         .url               = url,
         .method            = HTTP_METHOD_GET,
         .timeout_ms        = HTTP_TIMEOUT_MS,
-        .event_handler     = relay_poll_event_handler,
+        .event_handler     = body_event_handler,
         .user_data         = &ctx,
         .crt_bundle_attach = esp_crt_bundle_attach,
     };
@@ -239,6 +531,7 @@ esp_err_t http_poll_relay_command(int *out_command_id, char *out_command, size_t
     cJSON *data    = cJSON_GetObjectItem(root, "data");
     cJSON *cmd_obj = data ? cJSON_GetObjectItem(data, "command")    : NULL;
     cJSON *id_obj  = data ? cJSON_GetObjectItem(data, "command_id") : NULL;
+    cJSON *seq_obj = data ? cJSON_GetObjectItem(data, "credit_seq") : NULL;
 
     if (cmd_obj && cJSON_IsString(cmd_obj)) {
         strncpy(out_command, cmd_obj->valuestring, cmd_len - 1);
@@ -247,6 +540,11 @@ esp_err_t http_poll_relay_command(int *out_command_id, char *out_command, size_t
     if (id_obj && cJSON_IsNumber(id_obj)) {
         *out_command_id = (int)id_obj->valuedouble;
     }
+    // A top-up on the server shows up here first; fetch it now rather
+    // than at the next credit poll
+    if (cJSON_IsNumber(seq_obj) && (uint32_t)seq_obj->valuedouble > prepaid_seq()) {
+        prepaid_request_sync();
+    }
 
     cJSON_Delete(root);
     return ESP_OK;
@@ -288,3 +586,356 @@ esp_err_t http_ack_relay_command(int command_id, const char *relay_status)
     LOG_DEBUG(TAG_HTTP, "ACK relay command %d -> %s", command_id, esp_err_to_name(err));
     return err;
 }
+
+// ── Anomaly rule polling ──────────────────────────────────────────────────────
+
+esp_err_t http_poll_anomaly_rules(void)
+{
+    if (!wifi_is_connected()) return ESP_ERR_INVALID_STATE;
+
+    char url[320];
+    snprintf(url, sizeof(url), "%s/api/v1/devices/%s/anomaly-rules", s_server_url, s_device_id);
+
+    body_ctx_t ctx = { .buf = malloc(HTTP_RULES_MAX_BODY), .cap = HTTP_RULES_MAX_BODY, .len = 0 };
+    if (!ctx.buf) return ESP_ERR_NO_MEM;
+
+    esp_http_client_config_t cfg = {
+        .url               = url,
+        .method            = HTTP_METHOD_GET,
+        .timeout_ms        = HTTP_TIMEOUT_MS,
+        .event_handler     = body_event_handler,
+        .user_data         = &ctx,
+        .crt_bundle_attach = esp_crt_bundle_attach,
+    };
+
+    esp_http_client_handle_t client = esp_http_client_init(&cfg);
+    if (!client) { free(ctx.buf); return ESP_FAIL; }
+
+    esp_http_client_set_header(client, "X-API-Key", s_api_key);
+
+    esp_err_t err = esp_http_client_perform(client);
+    int status    = esp_http_client_get_status_code(client);
+    esp_http_client_cleanup(client);
+
+    if (err != ESP_OK || status != 200 || ctx.len == 0) {
+        LOG_DEBUG(TAG_HTTP, "Rules poll: err=%s HTTP %d", esp_err_to_name(err), status);
+        free(ctx.buf);
+        return err != ESP_OK ? err : ESP_FAIL;
+    }
+    ctx.buf[ctx.len] = '\0';
+
+    // {"success":true,"data":{"version":3,"rules":[…]}}
+    // or {"success":true,"data":{"version":null,"rules":null}} when unset
+    cJSON *root = cJSON_Parse(ctx.buf);
+    free(ctx.buf);
+    if (!root) {
+        ESP_LOGW(TAG_HTTP, "Rules poll: JSON parse failed");
+        return ESP_FAIL;
+    }
+
+    cJSON       *data    = cJSON_GetObjectItem(root, "data");
+    const cJSON *version = data ? cJSON_GetObjectItem(data, "version") : NULL;
+    err = ESP_OK;
+    if (cJSON_IsNumber(version) && (uint32_t)version->valuedouble != anomaly_rules_version()) {
+        anomaly_ruleset_t *set = malloc(sizeof(*set));
+        if (!set) {
+            err = ESP_ERR_NO_MEM;
+        } else {
+            err = anomaly_rules_from_json(data, set);
+            if (err == ESP_OK) err = anomaly_rules_apply(set);
+            if (err != ESP_OK) {
+                ESP_LOGW(TAG_HTTP, "Rules v%lu rejected: %s",
+                         (unsigned long)version->valuedouble, esp_err_to_name(err));
+            }
+            free(set);
+        }
+    }
+
+    cJSON_Delete(root);
+    return err;
+}
+
+// ── Anomaly model polling ─────────────────────────────────────────────────────
+
+esp_err_t http_poll_anomaly_model(void)
+{
+    if (!wifi_is_connected()) return ESP_ERR_INVALID_STATE;
+
+    char url[320];
+    snprintf(url, sizeof(url), "%s/api/v1/devices/%s/anomaly-model", s_server_url, s_device_id);
+
+    body_ctx_t ctx = { .buf = malloc(HTTP_MODEL_MAX_BODY), .cap = HTTP_MODEL_MAX_BODY, .len = 0 };
+    if (!ctx.buf) return ESP_ERR_NO_MEM;
+
+    esp_http_client_config_t cfg = {
+        .url               = url,
+        .method            = HTTP_METHOD_GET,
+        .timeout_ms        = HTTP_TIMEOUT_MS,
+        .event_handler     = body_event_handler,
+        .user_data         = &ctx,
+        .crt_bundle_attach = esp_crt_bundle_attach,
+    };
+
+    esp_http_client_handle_t client = esp_http_client_init(&cfg);
+    if (!client) { free(ctx.buf); return ESP_FAIL; }
+
+    esp_http_client_set_header(client, "X-API-Key", s_api_key);
+
+    esp_err_t err = esp_http_client_perform(client);
+    int status    = esp_http_client_get_status_code(client);
+    esp_http_client_cleanup(client);
+
+    if (err != ESP_OK || status != 200 || ctx.len == 0) {
+        LOG_DEBUG(TAG_HTTP, "Model poll: err=%s HTTP %d", esp_err_to_name(err), status);
+        free(ctx.buf);
+        return err != ESP_OK ? err : ESP_FAIL;
+    }
+    ctx.buf[ctx.len] = '\0';
+
+    // {"success":true,"data":{"version":2,"model":{…}}}
+    // or {"success":true,"data":{"version":null,"model":null}} when unset
+    cJSON *root = cJSON_Parse(ctx.buf);
+    free(ctx.buf);
+    if (!root) {
+        ESP_LOGW(TAG_HTTP, "Model poll: JSON parse failed");
+        return ESP_FAIL;
+    }
+
+    cJSON       *data    = cJSON_GetObjectItem(root, "data");
+    const cJSON *version = data ? cJSON_GetObjectItem(data, "version") : NULL;
+    err = ESP_OK;
+    if (cJSON_IsNumber(version) && (uint32_t)version->valuedouble != anomaly_model_version()) {
+        anomaly_model_t *model = malloc(sizeof(*model));
+        if (!model) {
+            err = ESP_ERR_NO_MEM;
+        } else {
+            err = anomaly_model_from_json(data, model);
+            if (err == ESP_OK) err = anomaly_model_apply(model);
+            if (err != ESP_OK) {
+                ESP_LOGW(TAG_HTTP, "Anomaly model v%lu rejected: %s",
+                         (unsigned long)version->valuedouble, esp_err_to_name(err));
+            }
+            free(model);
+        }
+    }
+
+    cJSON_Delete(root);
+    return err;
+}
+
+// ── Prepaid credit ────────────────────────────────────────────────────────────
+
+// Hex HMAC-SHA256 of the document's canonical form, keyed with the API key.
+// Must match signCreditDocument() in server/src/services/credit.service.ts.
+static bool credit_sig_valid(const prepaid_doc_t *doc, const char *sig)
+{
+    char msg[192];
+    int  n = snprintf(msg, sizeof(msg), "%s|%lu|%d|%lld|%lu|%lu|%lu",
+                      s_device_id, (unsigned long)doc->seq, doc->enabled ? 1 : 0,
+                      (long long)doc->granted_wh, (unsigned long)doc->tariff_milli,
+                      (unsigned long)doc->warn_low_wh, (unsigned long)doc->warn_critical_wh);
+    if (n <= 0 || n >= (int)sizeof(msg) || strlen(sig) != 64) return false;
+
+    uint8_t mac[32];
+    if (mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256),
+                        (const uint8_t *)s_api_key, strlen(s_api_key),
+                        (const uint8_t *)msg, n, mac) != 0) {
+        return false;
+    }
+
+    // Constant-time compare against the hex string
+    static const char hex[] = "0123456789abcdef";
+    uint8_t diff = 0;
+    for (int i = 0; i < 32; i++) {
+        diff |= (uint8_t)(sig[2 * i]     ^ hex[mac[i] >> 4]);
+        diff |= (uint8_t)(sig[2 * i + 1] ^ hex[mac[i] & 0x0F]);
+    }
+    return diff == 0;
+}
+
+static bool json_uint(const cJSON *obj, const char *key, double max, double *out)
+{
+    const cJSON *item = cJSON_GetObjectItem(obj, key);
+    if (!cJSON_IsNumber(item) || item->valuedouble < 0 || item->valuedouble > max) return false;
+    *out = item->valuedouble;
+    return true;
+}
+
+esp_err_t http_poll_credit(void)
+{
+    if (!wifi_is_connected()) return ESP_ERR_INVALID_STATE;
+
+    // A zeroed status would report seq 0 and a disabled account; skip
+    // this poll and ask for another once the credit state is free
+    prepaid_status_t st;
+    if (!prepaid_get_status(&st)) {
+        prepaid_request_sync();
+        return ESP_ERR_TIMEOUT;
+    }
+
+    char url[384];
+    snprintf(url, sizeof(url), "%s/api/v1/devices/%s/credit?seq=%lu&state=%s&balance_wh=%lld",
+             s_server_url, s_device_id, (unsigned long)st.seq,
+             prepaid_state_to_string(st.state), (long long)st.balance_wh);
+
+    char       body[HTTP_CREDIT_MAX_BODY];
+    body_ctx_t ctx = { .buf = body, .cap = sizeof(body), .len = 0 };
+
+    esp_http_client_config_t cfg = {
+        .url               = url,
+        .method            = HTTP_METHOD_GET,
+        .timeout_ms        = HTTP_TIMEOUT_MS,
+        .event_handler     = body_event_handler,
+        .user_data         = &ctx,
+        .crt_bundle_attach = esp_crt_bundle_attach,
+    };
+
+    esp_http_client_handle_t client = esp_http_client_init(&cfg);
+    if (!client) return ESP_FAIL;
+
+    esp_http_client_set_header(client, "X-API-Key", s_api_key);
+
+    esp_err_t err = esp_http_client_perform(client);
+    int status    = esp_http_client_get_status_code(client);
+    esp_http_client_cleanup(client);
+
+    if (err != ESP_OK || status != 200 || ctx.len == 0) {
+        LOG_DEBUG(TAG_HTTP, "Credit poll: err=%s HTTP %d", esp_err_to_name(err), status);
+        return err != ESP_OK ? err : ESP_FAIL;
+    }
+    ctx.buf[ctx.len] = '\0';
+
+    // {"success":true,"data":{"credit":{"seq":7,"enabled":true,"granted_wh":120000,
+    //   "tariff_milli":11500,"warn_low_wh":5000,"warn_critical_wh":1000,"sig":"…"}}}
+    // or {"success":true,"data":{"credit":null}} for a device without prepaid
+    cJSON *root = cJSON_Parse(ctx.buf);
+    if (!root) {
+        ESP_LOGW(TAG_HTTP, "Credit poll: JSON parse failed");
+        return ESP_FAIL;
+    }
+
+    cJSON       *data   = cJSON_GetObjectItem(root, "data");
+    cJSON       *credit = data ? cJSON_GetObjectItem(data, "credit") : NULL;
+    const cJSON *sig    = credit ? cJSON_GetObjectItem(credit, "sig") : NULL;
+    if (!cJSON_IsObject(credit)) {
+        cJSON_Delete(root);
+        return ESP_OK;
+    }
+
+    prepaid_doc_t doc = { .enabled = cJSON_IsTrue(cJSON_GetObjectItem(credit, "enabled")) };
+    double seq, granted, tariff, low, crit;
+    if (!json_uint(credit, "seq", UINT32_MAX, &seq) ||
+        !json_uint(credit, "granted_wh", 9007199254740991.0, &granted) ||
+        !json_uint(credit, "tariff_milli", UINT32_MAX, &tariff) ||
+        !json_uint(credit, "warn_low_wh", UINT32_MAX, &low) ||
+        !json_uint(credit, "warn_critical_wh", UINT32_MAX, &crit) || !cJSON_IsString(sig)) {
+        ESP_LOGW(TAG_HTTP, "Credit poll: malformed document");
+        cJSON_Delete(root);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    doc.seq              = (uint32_t)seq;
+    doc.granted_wh       = (int64_t)granted;
+    doc.tariff_milli     = (uint32_t)tariff;
+    doc.warn_low_wh      = (uint32_t)low;
+    doc.warn_critical_wh = (uint32_t)crit;
+
+    if (!credit_sig_valid(&doc, sig->valuestring)) {
+        ESP_LOGE(TAG_HTTP, "Credit seq %lu: bad signature — ignored", (unsigned long)doc.seq);
+        err = ESP_ERR_INVALID_CRC;
+    } else {
+        err = prepaid_apply(&doc);
+    }
+
+    cJSON_Delete(root);
+    return err;
+}
+
+// ── Consumption budget ────────────────────────────────────────────────────────
+
+esp_err_t http_poll_budget(void)
+{
+    if (!wifi_is_connected()) return ESP_ERR_INVALID_STATE;
+
+    forecast_status_t st;
+    forecast_get_status(&st);
+
+    char url[384];
+    snprintf(url, sizeof(url),
+             "%s/api/v1/devices/%s/budget?period_start=%lld&state=%s&used_wh=%lld"
+             "&projected_wh=%lld&learned=%u",
+             s_server_url, s_device_id, (long long)st.period_start,
+             forecast_state_to_string(st.state), (long long)st.used_wh,
+             (long long)st.projected_wh, st.learned);
+
+    char       body[HTTP_BUDGET_MAX_BODY];
+    body_ctx_t ctx = { .buf = body, .cap = sizeof(body), .len = 0 };
+
+    esp_http_client_config_t cfg = {
+        .url               = url,
+        .method            = HTTP_METHOD_GET,
+        .timeout_ms        = HTTP_TIMEOUT_MS,
+        .event_handler     = body_event_handler,
+        .user_data         = &ctx,
+        .crt_bundle_attach = esp_crt_bundle_attach,
+    };
+
+    esp_http_client_handle_t client = esp_http_client_init(&cfg);
+    if (!client) return ESP_FAIL;
+
+    esp_http_client_set_header(client, "X-API-Key", s_api_key);
+
+    esp_err_t err = esp_http_client_perform(client);
+    int status    = esp_http_client_get_status_code(client);
+    esp_http_client_cleanup(client);
+
+    if (err != ESP_OK || status != 200 || ctx.len == 0) {
+        LOG_DEBUG(TAG_HTTP, "Budget poll: err=%s HTTP %d", esp_err_to_name(err), status);
+        return err != ESP_OK ? err : ESP_FAIL;
+    }
+    ctx.buf[ctx.len] = '\0';
+
+    // {"success":true,"data":{"budget":{"seq":2,"budget_wh":150000,"warn_pct":80,
+    //   "period_start":1767196800,"period_end":1769875200,"period_used_wh":null}}}
+    // or {"success":true,"data":{"budget":null}}. period_used_wh is only
+    // filled in while our anchor is for another period.
+    cJSON *root = cJSON_Parse(ctx.buf);
+    if (!root) {
+        ESP_LOGW(TAG_HTTP, "Budget poll: JSON parse failed");
+        return ESP_FAIL;
+    }
+
+    cJSON *data   = cJSON_GetObjectItem(root, "data");
+    cJSON *budget = data ? cJSON_GetObjectItem(data, "budget") : NULL;
+    if (!cJSON_IsObject(budget)) {
+        cJSON_Delete(root);
+        return ESP_OK;
+    }
+
+    const cJSON *used_wh = cJSON_GetObjectItem(budget, "period_used_wh");
+    double seq, budget_wh, warn_pct, p_start, p_end;
+    if (!json_uint(budget, "seq", UINT32_MAX, &seq) ||
+        !json_uint(budget, "budget_wh", UINT32_MAX, &budget_wh) ||
+        !json_uint(budget, "warn_pct", 100, &warn_pct) ||
+        !json_uint(budget, "period_start", 9007199254740991.0, &p_start) ||
+        !json_uint(budget, "period_end", 9007199254740991.0, &p_end)) {
+        ESP_LOGW(TAG_HTTP, "Budget poll: malformed budget");
+        cJSON_Delete(root);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    forecast_budget_t b = {
+        .seq             = (uint32_t)seq,
+        .budget_wh       = (uint32_t)budget_wh,
+        .warn_pct        = (uint8_t)warn_pct,
+        .period_start    = (int64_t)p_start,
+        .period_end      = (int64_t)p_end,
+        .period_used_wh  = cJSON_IsNumber(used_wh) ? (int64_t)used_wh->valuedouble : -1,
+    };
+    err = forecast_apply(&b);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG_HTTP, "Budget seq %lu rejected: %s", (unsigned long)b.seq, esp_err_to_name(err));
+    }
+
+    cJSON_Delete(root);
+    return err;
+}
@@ -1,30 +1,46 @@
 #include "logger.h"
 #include "relay_control.h"
+#include "anomaly_rules.h"
 #include "esp_log.h"
 
 void log_power_data(const pzem_data_t *data)
 {
     if (!data || !data->valid) return;
     ESP_LOGI(TAG_PZEM,
-             "V=%.1fV  I=%.3fA  P=%.1fW  S=%.1fVA  PF=%.2f  E=%.0fWh  F=%.1fHz",
-             data->v_rms,
-             data->i_rms,
-             data->power,
-             data->power_apparent,
-             data->power_factor,
-             data->energy,
-             data->frequency);
+             "CH%u  V=%u.%uV  I=%lu.%03luA  P=%lu.%luW  S=%lu.%luVA  PF=%u.%02u  E=%lluWh  F=%u.%uHz",
+             data->channel,
+             data->v_dv / 10, data->v_dv % 10,
+             (unsigned long)(data->i_ma / 1000), (unsigned long)(data->i_ma % 1000),
+             (unsigned long)(data->power_dw / 10), (unsigned long)(data->power_dw % 10),
+             (unsigned long)(data->apparent_dva / 10), (unsigned long)(data->apparent_dva % 10),
+             data->pf_pct / 100, data->pf_pct % 100,
+             (unsigned long long)data->energy_wh,
+             data->freq_dhz / 10, data->freq_dhz % 10);
 }
 
 void log_anomaly_event(const anomaly_event_t *event)
 {
     if (!event) return;
+    if (event->phase != ANOMALY_PHASE_ONSET) {
+        // Rollup values are in the rule metric's native unit
+        ESP_LOGW(TAG_ANOMALY,
+                 "ANOMALY %s: %-15s  CH%u  #%08lx  %lu ms  %s peak=%lu min=%lu",
+                 event->phase == ANOMALY_PHASE_CLEAR ? "cleared" : "ongoing",
+                 anomaly_type_to_string(event->type),
+                 event->channel,
+                 (unsigned long)event->episode_id,
+                 (unsigned long)event->duration_ms,
+                 anomaly_rules_metric_name(event->metric),
+                 (unsigned long)event->peak, (unsigned long)event->min);
+        return;
+    }
     ESP_LOGE(TAG_ANOMALY,
-             "!!! ANOMALY: %-15s  I=%.2fA  V=%.1fV  P=%.1fW  Relay=%s  t=%lums",
+             "!!! ANOMALY: %-15s  CH%u  I=%lu.%03luA  V=%u.%uV  P=%lu.%luW  Relay=%s  t=%lums",
              anomaly_type_to_string(event->type),
-             event->i_rms,
-             event->v_rms,
-             event->power,
+             event->channel,
+             (unsigned long)(event->i_ma / 1000), (unsigned long)(event->i_ma % 1000),
+             event->v_dv / 10, event->v_dv % 10,
+             (unsigned long)(event->power_dw / 10), (unsigned long)(event->power_dw % 10),
              event->relay_triggered ? "TRIPPED" : "ok",
              (unsigned long)event->timestamp);
 }
@@ -1,8 +1,19 @@
 #include "config.h"
 #include "logger.h"
 #include "pzem_sensor.h"
+#include "energy_counter.h"
 #include "anomaly_detector.h"
+#include "anomaly_rules.h"
+#include "anomaly_model.h"
+#include "nilm.h"
+#include "anomaly_bench.h"
+#include "blackbox.h"
+#include "power_quality.h"
 #include "relay_control.h"
+#include "trip_latency.h"
+#include "modbus_rtu.h"
+#include "prepaid.h"
+#include "forecast.h"
 #include "http_client.h"
 #include "wifi_manager.h"
 #include "wifi_provisioning.h"
@@ -12,110 +23,255 @@
 #include "freertos/task.h"
 #include "freertos/queue.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "nvs_flash.h"
 #include "nvs.h"
 
 // ── Queue handles ─────────────────────────────────────────────────────────────
-static QueueHandle_t queue_power_data     = NULL;  // PZEM read → anomaly detect
-static QueueHandle_t queue_anomaly_events = NULL;  // anomaly detect → relay
+static QueueHandle_t queue_power_data     = NULL;  // PZEM read → anomaly detect (sensed_sample_t)
 static QueueHandle_t queue_http_events    = NULL;  // anomaly detect → http
 static QueueHandle_t queue_http_power     = NULL;  // PZEM read → http
+static QueueHandle_t queue_http_pq        = NULL;  // anomaly detect → http (power quality)
+static QueueHandle_t queue_http_model     = NULL;  // anomaly detect → http (model flags)
+static QueueHandle_t queue_http_nilm      = NULL;  // anomaly detect → http (appliance edges)
 
 // ─────────────────────────────────────────────────────────────────────────────
 // Task 1: PZEM Read (highest priority)
-// Reads PZEM-004T every PZEM_READ_INTERVAL_MS and fans out to queues
+// Two-tier polling: every PZEM_FAST_POLL_INTERVAL_MS each channel gets a
+// fast read of current (and voltage, PZEM_FAST_POLL_VOLTAGE); every
+// PZEM_READ_INTERVAL_MS a full 10-register read replaces it. Channels are
+// read back-to-back (the next request goes out as soon as the previous
+// response is in), so the bus never idles mid-cycle; the remainder of the
+// period is slept in vTaskDelayUntil.
+//
+// Every sample is run through the detector here, and a confirmed trip rule
+// opens the relay before the sample is queued: the trip path is frame →
+// decode → detect → GPIO in one task, with no queue hop or lock on the way.
+// Each stage is timestamped into trip_latency.
 // ─────────────────────────────────────────────────────────────────────────────
+#if PZEM_FAST_POLL_ENABLED
+_Static_assert(PZEM_READ_INTERVAL_MS % PZEM_FAST_POLL_INTERVAL_MS == 0,
+               "PZEM_READ_INTERVAL_MS must be a multiple of PZEM_FAST_POLL_INTERVAL_MS");
+#define PZEM_POLL_PERIOD_MS     PZEM_FAST_POLL_INTERVAL_MS
+#else
+#define PZEM_POLL_PERIOD_MS     PZEM_READ_INTERVAL_MS
+#endif
+#define PZEM_FULL_READ_EVERY    (PZEM_READ_INTERVAL_MS / PZEM_POLL_PERIOD_MS)
+
+// Appliance edges and energy carry what the dense series was for; billing
+// only needs the cumulative energy_kwh, which every snapshot still has
+#if NILM_ENABLED
+#define POWER_POST_INTERVAL     HTTP_POWER_INTERVAL_NILM
+#else
+#define POWER_POST_INTERVAL     HTTP_POWER_INTERVAL
+#endif
+
+// A sample and the episode transitions it produced, read task → anomaly task
+typedef struct {
+    pzem_data_t     data;
+    uint8_t         n;
+    anomaly_event_t events[ANOMALY_TYPE_COUNT];
+} sensed_sample_t;
+
+// Detect, trip, then hand the sample on. @p read_ok: the reading came off
+// the bus just now, so the Modbus frame time belongs to it.
+static void sense_and_queue(sensed_sample_t *s, bool read_ok, int64_t decoded_us)
+{
+    int64_t frame_us = modbus_rtu_frame_done_us();
+
+    s->n = anomaly_analyze(&s->data, s->events, ANOMALY_TYPE_COUNT);
+    int64_t detected_us = esp_timer_get_time();
+
+    // Trip on every sample with a confirmed trip rule, not only on onsets:
+    // a relay switched back on into a fault that never cleared opens again.
+    // The lowest type is the reason (short circuit before overcurrent).
+    uint32_t due = anomaly_detector_trips_due(s->data.channel);
+    if (due && relay_get_state() != RELAY_STATE_TRIPPED) {
+        int64_t open_us = relay_trip((anomaly_type_t)__builtin_ctz(due));
+        if (read_ok) {
+            uint32_t latency_us = trip_latency_note_trip(frame_us, detected_us, open_us);
+            for (uint8_t i = 0; i < s->n; i++) {
+                anomaly_event_t *ev = &s->events[i];
+                if (ev->phase == ANOMALY_PHASE_ONSET && ev->relay_triggered &&
+                    (due & (1u << ev->type))) {
+                    ev->trip_latency_us = latency_us;
+                }
+            }
+        }
+    }
+    if (read_ok) trip_latency_note_reading(frame_us, decoded_us, detected_us);
+
+    if (xQueueSend(queue_power_data, s, 0) != pdTRUE) {
+        LOG_WARN(TAG_MAIN, "Anomaly queue full — CH%u %s dropped", s->data.channel,
+                 s->data.current_only ? "fast sample" : "reading");
+    }
+}
+
 static void task_pzem_read(void *pvParam)
 {
-    pzem_data_t data;
+    static sensed_sample_t sample;      // ~750 B, kept off the task stack
+    pzem_data_t *data = &sample.data;
     TickType_t  last_wake  = xTaskGetTickCount();
-    uint32_t    read_count = 0;
+    uint32_t    cycle      = 0;
+    uint32_t    read_count[PZEM_CHANNEL_COUNT] = {0};
 
-    ESP_LOGI(TAG_MAIN, "task_pzem_read started");
+    ESP_LOGI(TAG_MAIN, "task_pzem_read started (%u channel%s, poll %d ms, full read every %d)",
+             pzem_sensor_channel_count(), pzem_sensor_channel_count() == 1 ? "" : "s",
+             PZEM_POLL_PERIOD_MS, PZEM_FULL_READ_EVERY);
     // Give PZEM-004T time to boot its measurement IC after AC is applied.
     // Without this, the first 1-2 reads often return garbage or time out.
     vTaskDelay(pdMS_TO_TICKS(2000));
 
     while (1) {
-        esp_err_t err = pzem_sensor_read(&data);
+        // Boot, on demand, or after a channel kept failing. Runs here because
+        // this task owns the bus, one slice per cycle until the pass ends;
+        // the schedule resumes on the next period.
+        if (pzem_sensor_discovery_pending()) {
+            pzem_sensor_discover(PZEM_DISCOVERY_SLICE_MS);
+            last_wake = xTaskGetTickCount();
+        }
+        if (pzem_sensor_alarm_sync_pending()) {
+            pzem_sensor_sync_power_alarm();
+            last_wake = xTaskGetTickCount();
+        }
 
-        if (err == ESP_OK && data.valid) {
-            read_count++;
+        bool full_read = (cycle++ % PZEM_FULL_READ_EVERY) == 0;
+        bool     any_valid = false;
+        uint32_t total_dw  = 0;
+
+        for (uint8_t ch = 0; ch < PZEM_CHANNEL_COUNT; ch++) {
+            if (!full_read) {
+                // Fast path: detector and anomaly task, nothing else.
+                // Failed reads go too: a silent meter is how a supply
+                // interruption shows up (see power_quality.h).
+                bool ok = pzem_sensor_read_current(ch, data) == ESP_OK;
+                int64_t decoded_us = esp_timer_get_time();
+                if (!ok) {
+                    data->timestamp = xTaskGetTickCount() * portTICK_PERIOD_MS;
+                }
+                sense_and_queue(&sample, ok, decoded_us);
+                continue;
+            }
 
-            // Always overwrite so anomaly task sees the latest reading
-            xQueueOverwrite(queue_power_data, &data);
+            esp_err_t err = pzem_sensor_read_channel(ch, data);
+            int64_t decoded_us = esp_timer_get_time();
 
-            // POST power data every HTTP_POWER_INTERVAL reads (~10 s)
-            if (read_count % HTTP_POWER_INTERVAL == 0) {
-                xQueueSend(queue_http_power, &data, 0);
-            }
+            if (err == ESP_OK && data->valid) {
+                read_count[ch]++;
+                any_valid = true;
+                total_dw += data->power_dw;
 
-            log_power_data(&data);
-        } else {
-            LOG_WARN(TAG_MAIN, "PZEM read failed (%s)", esp_err_to_name(err));
+                sense_and_queue(&sample, true, decoded_us);
+
+                // POST power data every POWER_POST_INTERVAL reads; channels
+                // are staggered so posts spread across the interval.
+                if ((read_count[ch] + ch) % POWER_POST_INTERVAL == 0) {
+                    xQueueSend(queue_http_power, data, 0);
+                }
+
+                log_power_data(data);
+            } else {
+                LOG_WARN(TAG_MAIN, "PZEM CH%u read failed (%s)", ch, esp_err_to_name(err));
+                data->valid     = false;
+                data->timestamp = xTaskGetTickCount() * portTICK_PERIOD_MS;
+                sense_and_queue(&sample, false, decoded_us);
+            }
         }
 
-        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(PZEM_READ_INTERVAL_MS));
+#if FORECAST_ENABLED
+        if (any_valid) forecast_note_power(total_dw);
+#endif
+
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(PZEM_POLL_PERIOD_MS));
     }
 }
 
 // ─────────────────────────────────────────────────────────────────────────────
-// Task 2: Anomaly Detection
-// Watches power data queue and checks all anomaly conditions
+// Task 2: Anomaly Reporting
+// Takes each sample with the episode transitions the read task found for it
+// (the relay has already acted on them) and sends every transition to the
+// server. Every sample is kept in the black box; a tripping onset
+// freezes it. Voltage readings also feed the power-quality detector, whose
+// finished sag/swell/interruption records go to the server in batches, and
+// full reads feed the learned scorer, whose flagged windows go up for review.
+// The appliance detector turns steps in the same stream into on/off edges;
+// a trip is charged to whatever was running.
 // ─────────────────────────────────────────────────────────────────────────────
 static void task_anomaly_detection(void *pvParam)
 {
-    pzem_data_t     data;
-    anomaly_event_t event;
+    static sensed_sample_t sample;      // ~750 B, kept off the task stack
+    const pzem_data_t     *data   = &sample.data;
+    const anomaly_event_t *events = sample.events;
+    pq_event_t      pq;
+#if ANOMALY_MODEL_ENABLED
+    static anomaly_model_flag_t flag;   // ~250 B, kept off the task stack
+#endif
+#if NILM_ENABLED
+    nilm_event_t    edges[NILM_MAX_EVENTS_PER_POST];
+#endif
 
     ESP_LOGI(TAG_MAIN, "task_anomaly_detection started");
 
     while (1) {
-        if (xQueueReceive(queue_power_data, &data, pdMS_TO_TICKS(2000)) == pdTRUE) {
-            if (anomaly_analyze(&data, &event)) {
-                log_anomaly_event(&event);
-                xQueueSend(queue_anomaly_events, &event, pdMS_TO_TICKS(50));
-                xQueueSend(queue_http_events,    &event, pdMS_TO_TICKS(50));
+        if (xQueueReceive(queue_power_data, &sample, pdMS_TO_TICKS(2000)) == pdTRUE) {
+            uint8_t n = sample.n;
+
+            blackbox_record(data);
+            for (uint8_t i = 0; i < n; i++) {
+                if (events[i].phase == ANOMALY_PHASE_ONSET && events[i].relay_triggered) {
+                    ESP_LOGE(TAG_MAIN, "EMERGENCY CUTOFF on CH%u: %s — relay open %lu us "
+                             "after the reading | Trip #%lu",
+                             events[i].channel, anomaly_type_to_string(events[i].type),
+                             (unsigned long)events[i].trip_latency_us,
+                             (unsigned long)relay_get_trip_count());
+                    if (events[i].trip_latency_us > TRIP_LATENCY_BUDGET_US) {
+                        LOG_WARN(TAG_MAIN, "Trip latency over budget (%d us)",
+                                 TRIP_LATENCY_BUDGET_US);
+                    }
+                    blackbox_freeze(&events[i]);
+#if NILM_ENABLED
+                    nilm_note_trip(data->channel);
+#endif
+                } else if (events[i].phase == ANOMALY_PHASE_ONSET) {
+                    LOG_WARN(TAG_MAIN, "Anomaly on CH%u: %s (%u.%uV) — relay unchanged",
+                             events[i].channel, anomaly_type_to_string(events[i].type),
+                             events[i].v_dv / 10, events[i].v_dv % 10);
+                }
+                log_anomaly_event(&events[i]);
+                xQueueSend(queue_http_events, &events[i], pdMS_TO_TICKS(50));
             }
-        }
-    }
-}
 
-// ─────────────────────────────────────────────────────────────────────────────
-// Task 3: Relay Control
-// Executes emergency cutoff on critical anomalies
-// ─────────────────────────────────────────────────────────────────────────────
-static void task_relay_control(void *pvParam)
-{
-    anomaly_event_t event;
+#if PQ_ENABLED
+            if (power_quality_update(data, &pq) &&
+                xQueueSend(queue_http_pq, &pq, 0) != pdTRUE) {
+                LOG_WARN(TAG_MAIN, "PQ queue full — CH%u %s record dropped",
+                         pq.channel, pq_kind_to_string((pq_kind_t)pq.kind));
+            }
+#endif
 
-    ESP_LOGI(TAG_MAIN, "task_relay_control started");
+#if ANOMALY_MODEL_ENABLED
+            if (anomaly_model_update(data, &flag) &&
+                xQueueSend(queue_http_model, &flag, 0) != pdTRUE) {
+                LOG_WARN(TAG_MAIN, "Model flag queue full — CH%u window dropped", flag.channel);
+            }
+#endif
 
-    while (1) {
-        if (xQueueReceive(queue_anomaly_events, &event, portMAX_DELAY) == pdTRUE) {
-            switch (event.type) {
-                case ANOMALY_SHORT_CIRCUIT:
-                case ANOMALY_OVERCURRENT:
-                case ANOMALY_WIRE_FIRE:
-                    relay_emergency_cutoff(event.type);
-                    break;
-
-                case ANOMALY_OVERVOLTAGE:
-                case ANOMALY_UNDERVOLTAGE:
-                    // Voltage anomalies: log only, relay unchanged
-                    LOG_WARN(TAG_MAIN, "Voltage anomaly: %s (%.1fV)",
-                             anomaly_type_to_string(event.type), event.v_rms);
-                    break;
-
-                default:
-                    break;
+#if NILM_ENABLED
+            uint8_t ne = nilm_update(data, edges, NILM_MAX_EVENTS_PER_POST);
+            for (uint8_t i = 0; i < ne; i++) {
+                if (xQueueSend(queue_http_nilm, &edges[i], 0) != pdTRUE) {
+                    LOG_WARN(TAG_MAIN, "Appliance queue full — CH%u edge dropped", edges[i].channel);
+                }
             }
+#endif
+        } else {
+            blackbox_record(NULL);  // finish a pending freeze on a quiet bus
         }
     }
 }
 
 // ─────────────────────────────────────────────────────────────────────────────
-// Task 4: WiFi Manager
+// Task 3: WiFi Manager
 // Maintains connectivity; falls back to provisioning AP on repeated failure.
 // Opens the local dashboard server immediately after every successful connect.
 // ─────────────────────────────────────────────────────────────────────────────
@@ -183,15 +339,42 @@ static void task_wifi_manager(void *pvParam)
 }
 
 // ─────────────────────────────────────────────────────────────────────────────
-// Task 5: HTTP Client (lowest priority)
-// Anomaly events are sent immediately; power data batched every 10 reads.
-// Also polls the server every 5 seconds for pending relay commands.
+// Task 4: HTTP Client
+// Anomaly events are sent immediately; power data every POWER_POST_INTERVAL reads.
+// Also polls the server every 5 seconds for pending relay commands and
+// every HTTP_RULES_POLL_MS for a new anomaly rule table (HTTP_MODEL_POLL_MS
+// for a new anomaly model). A frozen black-box record is uploaded after the
+// anomaly events ahead of it; windows flagged by the model go up as they
+// come. Prepaid credit syncs every HTTP_CREDIT_POLL_MS, or at once when a
+// top-up is announced or a warning level is crossed; the consumption
+// budget likewise every HTTP_BUDGET_POLL_MS or when the forecast moves to
+// a worse state.
+// Appliance edges are batched per channel like power-quality records, and
+// the per-appliance energy table goes up every HTTP_NILM_SUMMARY_MS.
 // ─────────────────────────────────────────────────────────────────────────────
 static void task_http_client(void *pvParam)
 {
     anomaly_event_t event;
     pzem_data_t     power;
-    uint32_t        last_relay_poll_ms = 0;
+    pq_event_t      pq[PQ_MAX_EVENTS_PER_POST];
+    uint32_t        last_relay_poll_ms  = 0;
+    uint32_t        last_rules_poll_ms  = 0;
+    uint32_t        last_model_poll_ms  = 0;
+    uint32_t        last_blackbox_ms    = 0;
+    uint32_t        last_credit_poll_ms = 0;
+    uint32_t        last_budget_poll_ms = 0;
+    uint32_t        last_summary_ms     = 0;
+    bool            rules_polled        = false;
+    bool            model_polled        = false;
+    bool            credit_polled       = false;
+    bool            budget_polled       = false;
+
+#if ANOMALY_MODEL_ENABLED
+    static anomaly_model_flag_t flag;
+#endif
+#if NILM_ENABLED
+    nilm_event_t    edges[NILM_MAX_EVENTS_PER_POST];
+#endif
 
     ESP_LOGI(TAG_MAIN, "task_http_client started");
 
@@ -201,6 +384,35 @@ static void task_http_client(void *pvParam)
             http_post_anomaly_event(&event);
         }
 
+        // Power-quality records: one POST per channel's run of queued records
+        if (xQueueReceive(queue_http_pq, &pq[0], 0) == pdTRUE) {
+            uint8_t n = 1;
+            while (n < PQ_MAX_EVENTS_PER_POST &&
+                   xQueuePeek(queue_http_pq, &pq[n], 0) == pdTRUE &&
+                   pq[n].channel == pq[0].channel) {
+                xQueueReceive(queue_http_pq, &pq[n++], 0);
+            }
+            http_post_pq_events(pq, n);
+        }
+
+#if ANOMALY_MODEL_ENABLED
+        if (xQueueReceive(queue_http_model, &flag, 0) == pdTRUE) {
+            http_post_model_flag(&flag);
+        }
+#endif
+
+#if NILM_ENABLED
+        if (xQueueReceive(queue_http_nilm, &edges[0], 0) == pdTRUE) {
+            uint8_t n = 1;
+            while (n < NILM_MAX_EVENTS_PER_POST &&
+                   xQueuePeek(queue_http_nilm, &edges[n], 0) == pdTRUE &&
+                   edges[n].channel == edges[0].channel) {
+                xQueueReceive(queue_http_nilm, &edges[n++], 0);
+            }
+            http_post_nilm_events(edges, n);
+        }
+#endif
+
         // Then try power data (100 ms wait allows anomaly events to arrive)
         if (xQueueReceive(queue_http_power, &power, pdMS_TO_TICKS(100)) == pdTRUE) {
             http_post_power_data(&power);
@@ -224,10 +436,15 @@ static void task_http_client(void *pvParam)
                     relay_err = relay_set_state(RELAY_STATE_OFF);
                 } else if (strcmp(cmd, "reset") == 0) {
                     relay_err = relay_set_state(RELAY_STATE_OFF);
-                    if (relay_err == ESP_OK) anomaly_detector_reset();
+                    if (relay_err == ESP_OK) anomaly_detector_request_reset();
                 }
 
-                if (relay_err != ESP_OK) {
+                if (relay_err == ESP_ERR_INVALID_STATE && relay_is_locked_out()) {
+                    // No credit: retrying would only repeat the refusal, so
+                    // ACK with the relay still off and let the user top up
+                    ESP_LOGW(TAG_MAIN, "Relay command '%s' refused — prepaid credit exhausted", cmd);
+                    http_ack_relay_command(cmd_id, "off");
+                } else if (relay_err != ESP_OK) {
                     ESP_LOGW(TAG_MAIN, "relay_set_state failed for cmd '%s': %s — will retry next poll",
                              cmd, esp_err_to_name(relay_err));
                     // Do NOT ACK — leave command pending so it retries in 5 s
@@ -240,6 +457,112 @@ static void task_http_client(void *pvParam)
                 }
             }
         }
+
+        if ((!rules_polled || (now_ms - last_rules_poll_ms) >= HTTP_RULES_POLL_MS) &&
+            wifi_is_connected()) {
+            last_rules_poll_ms = now_ms;
+            rules_polled       = true;
+            http_poll_anomaly_rules();
+        }
+
+#if ANOMALY_MODEL_ENABLED
+        if ((!model_polled || (now_ms - last_model_poll_ms) >= HTTP_MODEL_POLL_MS) &&
+            wifi_is_connected()) {
+            last_model_poll_ms = now_ms;
+            model_polled       = true;
+            http_poll_anomaly_model();
+        }
+#endif
+
+#if PREPAID_ENABLED
+        if (wifi_is_connected() &&
+            (prepaid_take_sync_request() || !credit_polled ||
+             (now_ms - last_credit_poll_ms) >= HTTP_CREDIT_POLL_MS)) {
+            last_credit_poll_ms = now_ms;
+            credit_polled       = true;
+            http_poll_credit();
+        }
+#endif
+
+#if FORECAST_ENABLED
+        if (wifi_is_connected() &&
+            (forecast_take_sync_request() || !budget_polled ||
+             (now_ms - last_budget_poll_ms) >= HTTP_BUDGET_POLL_MS)) {
+            last_budget_poll_ms = now_ms;
+            budget_polled       = true;
+            http_poll_budget();
+        }
+#endif
+
+#if NILM_ENABLED
+        if ((now_ms - last_summary_ms) >= HTTP_NILM_SUMMARY_MS && wifi_is_connected()) {
+            last_summary_ms = now_ms;
+            for (uint8_t ch = 0; ch < PZEM_CHANNEL_COUNT; ch++) http_post_nilm_summary(ch);
+        }
+#endif
+
+        // Black box follows its anomaly event, so wait for the event queue to drain
+        const blackbox_record_t *bb = blackbox_pending();
+        if (bb && uxQueueMessagesWaiting(queue_http_events) == 0 &&
+            (now_ms - last_blackbox_ms) >= HTTP_BLACKBOX_RETRY_MS && wifi_is_connected()) {
+            last_blackbox_ms = now_ms;
+            if (http_post_blackbox(bb) == ESP_OK) {
+                blackbox_release();
+            }
+        }
+    }
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Task 5: Energy checkpoints (lowest priority)
+// Flash writes can stall for tens of ms while NVS erases a page, so they
+// never happen in the read task — this task only wakes periodically and
+// writes whichever channel's checkpoint is due, plus a changed credit
+// document, load profile or appliance table. It also charges prepaid
+// credit against the energy totals every PREPAID_EVAL_MS, and closes the
+// forecast hour and re-projects the budget every FORECAST_EVAL_MS.
+// ─────────────────────────────────────────────────────────────────────────────
+#if PREPAID_ENABLED
+#define ENERGY_TASK_WAKE_MS     PREPAID_EVAL_MS
+#else
+#define ENERGY_TASK_WAKE_MS     ENERGY_PERSIST_CHECK_MS
+#endif
+
+static void task_energy_persist(void *pvParam)
+{
+    uint32_t since_persist_ms  = 0;
+#if FORECAST_ENABLED
+    uint32_t since_forecast_ms = 0;
+#endif
+
+    ESP_LOGI(TAG_MAIN, "task_energy_persist started");
+
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(ENERGY_TASK_WAKE_MS));
+#if PREPAID_ENABLED
+        prepaid_update();
+#endif
+#if FORECAST_ENABLED
+        since_forecast_ms += ENERGY_TASK_WAKE_MS;
+        if (since_forecast_ms >= FORECAST_EVAL_MS) {
+            since_forecast_ms = 0;
+            forecast_update();
+        }
+#endif
+        since_persist_ms += ENERGY_TASK_WAKE_MS;
+        if (since_persist_ms < ENERGY_PERSIST_CHECK_MS) continue;
+        since_persist_ms = 0;
+
+        energy_counter_persist(false);
+#if PREPAID_ENABLED
+        prepaid_persist();
+#endif
+#if FORECAST_ENABLED
+        forecast_persist();
+#endif
+#if NILM_ENABLED
+        nilm_persist();
+#endif
     }
 }
 
@@ -263,20 +586,45 @@ void app_main(void)
 
     // ── Module init ────────────────────────────────────────────────────────
     led_status_init();
+    energy_counter_init();   // non-fatal: totals start from the meter register
     ESP_ERROR_CHECK(pzem_sensor_init());
     ESP_ERROR_CHECK(relay_init());
+#if PREPAID_ENABLED
+    prepaid_init();          // after the energy totals and relay; may lock the relay out
+#endif
+#if FORECAST_ENABLED
+    forecast_init();
+#endif
+    anomaly_rules_init();    // NVS copy, else compiled defaults
     anomaly_detector_init();
+#if ANOMALY_MODEL_ENABLED
+    anomaly_model_init();    // NVS copy, else scoring stays off until the server sends one
+#endif
+#if ANOMALY_BENCH_ENABLED
+    anomaly_bench_run();     // before any task feeds the detector
+#endif
+    blackbox_init();         // before the anomaly task writes the ring
+    power_quality_init();
+#if NILM_ENABLED
+    nilm_init();             // signature table from NVS
+#endif
     http_client_init();
     ESP_ERROR_CHECK(wifi_init());
 
     // ── Queues ─────────────────────────────────────────────────────────────
-    queue_power_data     = xQueueCreate(1,                         sizeof(pzem_data_t));
-    queue_anomaly_events = xQueueCreate(QUEUE_ANOMALY_EVENTS_SIZE, sizeof(anomaly_event_t));
+    // Fast and full samples share one FIFO so no full read is ever
+    // overwritten by a fast sample before the anomaly task sees it.
+    queue_power_data     = xQueueCreate(QUEUE_POWER_DATA_SIZE * PZEM_CHANNEL_COUNT,
+                                        sizeof(sensed_sample_t));
     queue_http_events    = xQueueCreate(QUEUE_HTTP_EVENTS_SIZE,    sizeof(anomaly_event_t));
-    queue_http_power     = xQueueCreate(QUEUE_HTTP_POWER_SIZE,     sizeof(pzem_data_t));
-
-    if (!queue_power_data || !queue_anomaly_events ||
-        !queue_http_events || !queue_http_power) {
+    queue_http_power     = xQueueCreate(QUEUE_HTTP_POWER_SIZE * PZEM_CHANNEL_COUNT,
+                                        sizeof(pzem_data_t));
+    queue_http_pq        = xQueueCreate(QUEUE_HTTP_PQ_SIZE,        sizeof(pq_event_t));
+    queue_http_model     = xQueueCreate(QUEUE_HTTP_MODEL_SIZE,     sizeof(anomaly_model_flag_t));
+    queue_http_nilm      = xQueueCreate(QUEUE_HTTP_NILM_SIZE,      sizeof(nilm_event_t));
+
+    if (!queue_power_data || !queue_http_events ||
+        !queue_http_power || !queue_http_pq || !queue_http_model || !queue_http_nilm) {
         ESP_LOGE(TAG_MAIN, "Queue creation failed — halting");
         while (1) vTaskDelay(portMAX_DELAY);
     }
@@ -288,23 +636,28 @@ void app_main(void)
     xTaskCreate(task_anomaly_detection, "anomaly_det", TASK_STACK_ANOMALY,
                 NULL, TASK_PRIORITY_ANOMALY,   NULL);
 
-    xTaskCreate(task_relay_control,     "relay_ctrl",  TASK_STACK_RELAY,
-                NULL, TASK_PRIORITY_RELAY,     NULL);
-
     xTaskCreate(task_wifi_manager,      "wifi_mgr",    TASK_STACK_WIFI,
                 NULL, TASK_PRIORITY_WIFI,      NULL);
 
     xTaskCreate(task_http_client,       "http_client", TASK_STACK_HTTP,
                 NULL, TASK_PRIORITY_HTTP,      NULL);
 
+    xTaskCreate(task_energy_persist,    "energy_ckpt", TASK_STACK_ENERGY,
+                NULL, TASK_PRIORITY_ENERGY,    NULL);
+
     ESP_LOGI(TAG_MAIN, "All 5 tasks running");
 
     // ── Watchdog heartbeat ─────────────────────────────────────────────────
     while (1) {
         vTaskDelay(pdMS_TO_TICKS(60000));
+        trip_latency_report_t lat;
+        trip_latency_get(&lat);
         ESP_LOGI(TAG_MAIN, "Uptime=%lus  Trips=%lu  WiFi=%s",
                  (unsigned long)(xTaskGetTickCount() * portTICK_PERIOD_MS / 1000),
                  (unsigned long)relay_get_trip_count(),
                  wifi_is_connected() ? wifi_get_ip() : "disconnected");
+        ESP_LOGI(TAG_MAIN, "Trip path: decision p50=%luus p99=%luus max=%luus  open max=%luus",
+                 (unsigned long)lat.decision.p50_us, (unsigned long)lat.decision.p99_us,
+                 (unsigned long)lat.decision.max_us, (unsigned long)lat.open.max_us);
     }
 }
@@ -0,0 +1,185 @@
+#include "meter_model.h"
+
+#include <math.h>
+#include <string.h>
+
+// ── Wire-type decoders ────────────────────────────────────────────────────────
+
+static inline uint16_t be16(const uint8_t *p)
+{
+    return (uint16_t)p[0] << 8 | p[1];
+}
+
+static uint32_t dec_u16(const uint8_t *regs, uint32_t scale)
+{
+    return be16(regs) * scale;
+}
+
+// PZEM 32-bit values: low word in the first register
+static uint32_t dec_u32_lsw(const uint8_t *regs, uint32_t scale)
+{
+    return ((uint32_t)be16(regs + 2) << 16 | be16(regs)) * scale;
+}
+
+// Alarm status register: 0xFFFF = alarm, 0x0000 = clear
+static uint32_t dec_flag(const uint8_t *regs, uint32_t scale)
+{
+    (void)scale;
+    return be16(regs) != 0;
+}
+
+// IEEE-754 float32, high word first (Eastron). Signed quantities (export
+// power, leading PF) are stored as magnitudes.
+static uint32_t dec_f32(const uint8_t *regs, uint32_t scale)
+{
+    uint32_t bits = (uint32_t)be16(regs) << 16 | be16(regs + 2);
+    float    f;
+    memcpy(&f, &bits, sizeof(f));
+    f = fabsf(f) * (float)scale;
+    if (!(f < 4294967040.0f)) return f != f ? 0 : UINT32_MAX;   // NaN → 0, overflow saturates
+    return (uint32_t)(f + 0.5f);
+}
+
+// ── Descriptors ───────────────────────────────────────────────────────────────
+
+#define ALL_PHASES  0xFF
+#define FIELD(member, reg, stride, mask, fn, scale) \
+    { offsetof(pzem_data_t, member), sizeof(((pzem_data_t *)0)->member), \
+      (reg), (stride), (mask), (fn), (scale) }
+
+static const meter_field_t s_pzem004t_fields[] = {
+    FIELD(v_dv,        0x0000, 0, ALL_PHASES, dec_u16,     1),
+    FIELD(i_ma,        0x0001, 0, ALL_PHASES, dec_u32_lsw, 1),
+    FIELD(power_dw,    0x0003, 0, ALL_PHASES, dec_u32_lsw, 1),
+    FIELD(meter_wh,    0x0005, 0, ALL_PHASES, dec_u32_lsw, 1),
+    FIELD(freq_dhz,    0x0007, 0, ALL_PHASES, dec_u16,     1),
+    FIELD(pf_pct,      0x0008, 0, ALL_PHASES, dec_u16,     1),
+    FIELD(power_alarm, 0x0009, 0, ALL_PHASES, dec_flag,    1),
+};
+
+// SDM120 and SDM630 share the Eastron input-register map; the SDM120 is
+// the L1 column of it.
+static const meter_field_t s_sdm120_fields[] = {
+    FIELD(v_dv,         0x0000, 0, ALL_PHASES, dec_f32, 10),
+    FIELD(i_ma,         0x0006, 0, ALL_PHASES, dec_f32, 1000),
+    FIELD(power_dw,     0x000C, 0, ALL_PHASES, dec_f32, 10),
+    FIELD(apparent_dva, 0x0012, 0, ALL_PHASES, dec_f32, 10),
+    FIELD(pf_pct,       0x001E, 0, ALL_PHASES, dec_f32, 100),
+    FIELD(freq_dhz,     0x0046, 0, ALL_PHASES, dec_f32, 10),
+    FIELD(meter_wh,     0x0048, 0, ALL_PHASES, dec_f32, 1000),   // import kWh
+};
+
+static const meter_field_t s_sdm630_fields[] = {
+    FIELD(v_dv,         0x0000, 2, ALL_PHASES, dec_f32, 10),
+    FIELD(i_ma,         0x0006, 2, ALL_PHASES, dec_f32, 1000),
+    FIELD(power_dw,     0x000C, 2, ALL_PHASES, dec_f32, 10),
+    FIELD(apparent_dva, 0x0012, 2, ALL_PHASES, dec_f32, 10),
+    FIELD(pf_pct,       0x001E, 2, ALL_PHASES, dec_f32, 100),
+    FIELD(freq_dhz,     0x0046, 0, ALL_PHASES, dec_f32, 10),
+    // Per-phase energy lives at 0x015A+, outside a single 125-register
+    // read; the meter total is reported on the L1 channel only so server
+    // aggregation does not count it three times.
+    FIELD(meter_wh,     0x0048, 0, 0x01,       dec_f32, 1000),
+};
+
+static const meter_model_t s_models[METER_MODEL_COUNT] = {
+    [METER_PZEM004T] = {
+        .name = "PZEM-004T", .func = 0x04, .start = 0x0000, .count = 10, .phases = 1,
+        .reset_func = 0x42, .alarm_reg = 0x0001, .has_apparent = false,
+        .current = &s_pzem004t_fields[1], .voltage = &s_pzem004t_fields[0],
+        .fields = s_pzem004t_fields, .n_fields = sizeof(s_pzem004t_fields) / sizeof(s_pzem004t_fields[0]),
+    },
+    [METER_SDM120] = {
+        .name = "SDM120", .func = 0x04, .start = 0x0000, .count = 0x4A, .phases = 1,
+        .reset_func = 0, .has_apparent = true,
+        .current = &s_sdm120_fields[1], .voltage = &s_sdm120_fields[0],
+        .fields = s_sdm120_fields, .n_fields = sizeof(s_sdm120_fields) / sizeof(s_sdm120_fields[0]),
+    },
+    [METER_SDM630] = {
+        .name = "SDM630", .func = 0x04, .start = 0x0000, .count = 0x4A, .phases = 3,
+        .reset_func = 0, .has_apparent = true,
+        .current = &s_sdm630_fields[1], .voltage = &s_sdm630_fields[0],
+        .fields = s_sdm630_fields, .n_fields = sizeof(s_sdm630_fields) / sizeof(s_sdm630_fields[0]),
+    },
+};
+
+_Static_assert(0x4A <= METER_MAX_BLOCK_REGS, "descriptor block exceeds METER_MAX_BLOCK_REGS");
+
+// ── Decoding ──────────────────────────────────────────────────────────────────
+
+const meter_model_t *meter_model_get(meter_model_id_t id)
+{
+    return (unsigned)id < METER_MODEL_COUNT ? &s_models[id] : NULL;
+}
+
+void meter_decode(const meter_model_t *m, uint8_t phase, const uint8_t *regs, pzem_data_t *out)
+{
+    for (size_t i = 0; i < m->n_fields; i++) {
+        const meter_field_t *f = &m->fields[i];
+        if (!(f->phase_mask & (1u << phase))) continue;
+
+        uint32_t v   = f->decode(regs + 2u * (f->reg + phase * f->phase_stride), f->scale);
+        uint8_t *dst = (uint8_t *)out + f->dst_offset;
+        if (f->dst_size == 1) {
+            *dst = v > UINT8_MAX ? UINT8_MAX : (uint8_t)v;
+        } else if (f->dst_size == 2) {
+            uint16_t v16 = v > UINT16_MAX ? UINT16_MAX : (uint16_t)v;
+            memcpy(dst, &v16, sizeof(v16));
+        } else {
+            memcpy(dst, &v, sizeof(v));
+        }
+    }
+
+    if (!m->has_apparent) {
+        // 0.1 V × 1 mA = 1e-4 VA → /1000 gives 0.1 VA
+        out->apparent_dva = (uint32_t)(((uint64_t)out->v_dv * out->i_ma) / 1000);
+    }
+    if (out->pf_pct > 100) out->pf_pct = 100;
+}
+
+// Registers a field occupies on the wire
+static uint16_t field_width(const meter_field_t *f)
+{
+    return (f->decode == dec_u16 || f->decode == dec_flag) ? 1 : 2;
+}
+
+static uint16_t field_reg(const meter_field_t *f, uint8_t phase)
+{
+    return f->reg + phase * f->phase_stride;
+}
+
+static void fast_span(const meter_model_t *m, uint8_t phase, bool with_voltage,
+                      uint16_t *first, uint16_t *end)
+{
+    *first = field_reg(m->current, phase);
+    *end   = *first + field_width(m->current);
+    if (with_voltage && m->voltage) {
+        uint16_t v = field_reg(m->voltage, phase);
+        if (v < *first) *first = v;
+        if (v + field_width(m->voltage) > *end) *end = v + field_width(m->voltage);
+    }
+}
+
+void meter_fast_regs(const meter_model_t *m, uint8_t phase, bool with_voltage,
+                     uint16_t *start, uint16_t *count)
+{
+    uint16_t first, end;
+    fast_span(m, phase, with_voltage, &first, &end);
+    *start = m->start + first;
+    *count = end - first;
+}
+
+void meter_decode_fast(const meter_model_t *m, uint8_t phase, bool with_voltage,
+                       const uint8_t *regs, pzem_data_t *out)
+{
+    uint16_t first, end;
+    fast_span(m, phase, with_voltage, &first, &end);
+
+    const meter_field_t *c = m->current;
+    out->i_ma = c->decode(regs + 2u * (field_reg(c, phase) - first), c->scale);
+    if (with_voltage && m->voltage) {
+        const meter_field_t *v  = m->voltage;
+        uint32_t             dv = v->decode(regs + 2u * (field_reg(v, phase) - first), v->scale);
+        out->v_dv = dv > UINT16_MAX ? UINT16_MAX : (uint16_t)dv;
+    }
+}
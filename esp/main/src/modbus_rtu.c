@@ -0,0 +1,429 @@
+#include "modbus_rtu.h"
+#include "modbus_crc.h"
+#include "pzem_emulator.h"
+#include "config.h"
+#include "logger.h"
+
+#include "driver/uart.h"
+#include "driver/gpio.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+#include <string.h>
+
+static QueueHandle_t s_uart_events = NULL;
+
+// Per-slave link state. Latency estimator in fixed point, as in RFC 6298:
+// srtt_x8 = 8·SRTT, rttvar_x4 = 4·RTTVAR (ms), so updates are shifts only.
+typedef struct {
+    uint8_t  addr;          // 0 = free slot
+    bool     measured;      // at least one response timed
+    uint8_t  backoff;       // consecutive timeouts (RTO doubles each, max 2)
+    uint32_t srtt_x8;
+    uint32_t rttvar_x4;
+    uint32_t last_ok_ms;    // tick time of last good frame
+    modbus_link_stats_t stats;
+} modbus_link_t;
+
+const uint16_t modbus_latency_bucket_ms[MODBUS_LATENCY_BUCKETS] = {
+    30, 40, 50, 75, 100, 150, 250, UINT16_MAX,
+};
+
+#define MODBUS_MAX_LINKS    (PZEM_MAX_CHANNELS + 4)  // channels + fallback probes
+
+static modbus_link_t s_links[MODBUS_MAX_LINKS];
+static portMUX_TYPE  s_links_lock = portMUX_INITIALIZER_UNLOCKED;
+static int64_t       s_frame_done_us;   // last complete reply (bus owner only)
+
+// ── Frame assembler ───────────────────────────────────────────────────────────
+
+void modbus_frame_begin(modbus_frame_t *f, uint8_t *buf, size_t cap, size_t expected)
+{
+    f->buf      = buf;
+    f->cap      = cap;
+    f->len      = 0;
+    f->expected = expected;
+    f->crc      = MODBUS_CRC16_INIT;
+    f->overflow = false;
+}
+
+void modbus_frame_feed(modbus_frame_t *f, const uint8_t *data, size_t n)
+{
+    if (n > f->cap - f->len) {
+        n = f->cap - f->len;
+        f->overflow = true;
+    }
+    memcpy(f->buf + f->len, data, n);
+    f->crc  = modbus_crc16_update_buf(f->crc, data, n);
+    f->len += n;
+}
+
+// Length of the frame being received, or 0 if it cannot be known yet.
+static size_t frame_needed_len(const modbus_frame_t *f)
+{
+    if (f->len >= 2 && (f->buf[1] & MODBUS_EXCEPTION_BIT)) {
+        return MODBUS_EXCEPTION_LEN;
+    }
+    if (f->expected) {
+        return f->expected;
+    }
+    if (f->len >= 3 && (f->buf[1] == 0x03 || f->buf[1] == 0x04)) {
+        return 3 + (size_t)f->buf[2] + 2;  // header + byte count + CRC
+    }
+    return 0;
+}
+
+modbus_rx_status_t modbus_frame_status(const modbus_frame_t *f, bool line_idle)
+{
+    if (f->overflow) return MODBUS_RX_OVERFLOW;
+
+    size_t need = frame_needed_len(f);
+    if (need && f->len >= need) {
+        // Trailing noise after a full frame must not poison the residue
+        uint16_t crc = (f->len == need) ? f->crc : modbus_crc16(f->buf, need);
+        if (crc != MODBUS_CRC16_RESIDUE) return MODBUS_RX_CRC_ERROR;
+        return (f->buf[1] & MODBUS_EXCEPTION_BIT) ? MODBUS_RX_EXCEPTION : MODBUS_RX_COMPLETE;
+    }
+
+    if (!line_idle) return MODBUS_RX_IN_PROGRESS;
+
+    // Gap seen: a frame of unknown length ends here
+    if (!need && f->len >= 4) {
+        return f->crc == MODBUS_CRC16_RESIDUE ? MODBUS_RX_COMPLETE : MODBUS_RX_CRC_ERROR;
+    }
+    return MODBUS_RX_SHORT;
+}
+
+// ── Adaptive timeouts ─────────────────────────────────────────────────────────
+
+// Find the slot for addr, claiming a free one if needed. Caller holds lock.
+static modbus_link_t *link_for(uint8_t addr)
+{
+    modbus_link_t *free_slot = NULL;
+    for (size_t i = 0; i < MODBUS_MAX_LINKS; i++) {
+        if (s_links[i].addr == addr) return &s_links[i];
+        if (!free_slot && s_links[i].addr == 0) free_slot = &s_links[i];
+    }
+    if (free_slot) {
+        memset(free_slot, 0, sizeof(*free_slot));
+        free_slot->addr = addr;
+    }
+    return free_slot;
+}
+
+static uint32_t link_rto_ms(const modbus_link_t *l)
+{
+    uint32_t rto = MODBUS_TIMEOUT_INITIAL_MS;
+    if (l && l->measured) {
+        rto = (l->srtt_x8 >> 3) + l->rttvar_x4;   // SRTT + 4·RTTVAR
+        rto <<= l->backoff;
+    }
+    if (rto < MODBUS_TIMEOUT_MIN_MS) rto = MODBUS_TIMEOUT_MIN_MS;
+    if (rto > MODBUS_TIMEOUT_MAX_MS) rto = MODBUS_TIMEOUT_MAX_MS;
+    return rto;
+}
+
+uint32_t modbus_rtu_timeout_ms(uint8_t addr)
+{
+    portENTER_CRITICAL(&s_links_lock);
+    uint32_t rto = link_rto_ms(link_for(addr));
+    portEXIT_CRITICAL(&s_links_lock);
+    return rto;
+}
+
+// Fold one transaction outcome into the slave's estimator and counters.
+static void link_record(uint8_t addr, modbus_rx_status_t status, size_t rx_len, uint32_t rtt_ms)
+{
+    uint32_t now_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+
+    portENTER_CRITICAL(&s_links_lock);
+    modbus_link_t *l = link_for(addr);
+    if (!l) {
+        portEXIT_CRITICAL(&s_links_lock);
+        return;
+    }
+
+    switch (status) {
+        case MODBUS_RX_COMPLETE:
+        case MODBUS_RX_EXCEPTION:
+            // Any well-formed reply (including an exception) times the slave
+            if (!l->measured) {
+                l->srtt_x8   = rtt_ms << 3;
+                l->rttvar_x4 = rtt_ms << 1;            // RTTVAR = RTT/2
+                l->measured  = true;
+            } else {
+                int32_t err = (int32_t)rtt_ms - (int32_t)(l->srtt_x8 >> 3);
+                l->srtt_x8 += err;                     // SRTT += err/8
+                if (err < 0) err = -err;
+                l->rttvar_x4 += err - (int32_t)(l->rttvar_x4 >> 2);  // RTTVAR += (|err|-RTTVAR)/4
+            }
+            l->backoff    = 0;
+            l->last_ok_ms = now_ms;
+            l->stats.frames_ok++;
+            if (status == MODBUS_RX_EXCEPTION) l->stats.exceptions++;
+
+            size_t b = 0;
+            while (b < MODBUS_LATENCY_BUCKETS - 1 && rtt_ms > modbus_latency_bucket_ms[b]) b++;
+            l->stats.latency_hist[b]++;
+            break;
+        case MODBUS_RX_CRC_ERROR:
+            l->stats.crc_errors++;
+            break;
+        case MODBUS_RX_OVERFLOW:
+            l->stats.overflows++;
+            break;
+        default:
+            if (rx_len == 0) {
+                if (l->backoff < 2) l->backoff++;
+                l->stats.timeouts++;
+            } else {
+                l->stats.short_frames++;
+            }
+            break;
+    }
+    portEXIT_CRITICAL(&s_links_lock);
+}
+
+void modbus_rtu_note_header_error(uint8_t addr)
+{
+    portENTER_CRITICAL(&s_links_lock);
+    modbus_link_t *l = link_for(addr);
+    if (l) l->stats.header_errors++;
+    portEXIT_CRITICAL(&s_links_lock);
+}
+
+void modbus_rtu_note_read_ok(uint8_t addr, uint32_t retries)
+{
+    portENTER_CRITICAL(&s_links_lock);
+    modbus_link_t *l = link_for(addr);
+    if (l) {
+        l->stats.reads_ok++;
+        l->stats.retries += retries;
+    }
+    portEXIT_CRITICAL(&s_links_lock);
+}
+
+void modbus_rtu_forget(uint8_t addr)
+{
+    portENTER_CRITICAL(&s_links_lock);
+    for (size_t i = 0; i < MODBUS_MAX_LINKS; i++) {
+        if (s_links[i].addr == addr) {
+            memset(&s_links[i], 0, sizeof(s_links[i]));
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_links_lock);
+}
+
+int64_t modbus_rtu_frame_done_us(void)
+{
+    return s_frame_done_us;
+}
+
+bool modbus_rtu_get_stats(uint8_t addr, modbus_link_stats_t *out)
+{
+    if (!out) return false;
+    uint32_t now_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    bool     found  = false;
+
+    portENTER_CRITICAL(&s_links_lock);
+    for (size_t i = 0; i < MODBUS_MAX_LINKS; i++) {
+        const modbus_link_t *l = &s_links[i];
+        if (l->addr != addr) continue;
+        *out             = l->stats;
+        out->addr        = addr;
+        out->srtt_ms     = l->measured ? (l->srtt_x8 >> 3) : 0;
+        out->rto_ms      = link_rto_ms(l);
+        out->since_ok_ms = l->stats.frames_ok ? now_ms - l->last_ok_ms : UINT32_MAX;
+        found = true;
+        break;
+    }
+    portEXIT_CRITICAL(&s_links_lock);
+    return found;
+}
+
+// ── UART transport ────────────────────────────────────────────────────────────
+
+static esp_err_t rx_status_to_err(modbus_rx_status_t status)
+{
+    switch (status) {
+        case MODBUS_RX_COMPLETE:  return ESP_OK;
+        case MODBUS_RX_EXCEPTION: return ESP_ERR_INVALID_RESPONSE;
+        case MODBUS_RX_CRC_ERROR: return ESP_ERR_INVALID_CRC;
+        case MODBUS_RX_OVERFLOW:  return ESP_ERR_INVALID_SIZE;
+        default:                  return ESP_ERR_TIMEOUT;
+    }
+}
+
+#if PZEM_EMULATOR_ENABLED
+// Same contract as the UART path, but the bytes come from the emulated
+// meters. The reply still goes through the frame assembler and link_record
+// so CRC checks, timeouts and adaptive RTO see exactly what they would on
+// the wire.
+static esp_err_t emulated_transact(const uint8_t *req, size_t req_len,
+                                   uint8_t *resp, size_t resp_cap, size_t expected_len,
+                                   uint32_t timeout_ms, size_t *out_len)
+{
+    uint8_t  reply[PZEM_UART_BUF_SIZE];
+    uint32_t delay_ms = 0;
+    int64_t  start_us = esp_timer_get_time();
+    size_t   n        = pzem_emulator_respond(req, req_len, reply, sizeof(reply), &delay_ms);
+
+    modbus_frame_t frame;
+    modbus_frame_begin(&frame, resp, resp_cap, expected_len);
+
+    modbus_rx_status_t status = MODBUS_RX_SHORT;
+    if (n == 0 || delay_ms >= timeout_ms) {
+        vTaskDelay(pdMS_TO_TICKS(timeout_ms));   // silent (or too slow) meter
+    } else {
+        vTaskDelay(pdMS_TO_TICKS(delay_ms));
+        modbus_frame_feed(&frame, reply, n);
+        status = modbus_frame_status(&frame, true);
+        if (status == MODBUS_RX_COMPLETE) s_frame_done_us = esp_timer_get_time();
+    }
+
+    *out_len = frame.len;
+    link_record(req[0], status, frame.len,
+                (uint32_t)((esp_timer_get_time() - start_us) / 1000));
+    return rx_status_to_err(status);
+}
+#endif
+
+esp_err_t modbus_rtu_init(void)
+{
+#if PZEM_EMULATOR_ENABLED
+    pzem_emulator_init();
+    return ESP_OK;
+#endif
+
+    uart_config_t uart_cfg = {
+        .baud_rate  = PZEM_BAUD_RATE,
+        .data_bits  = UART_DATA_8_BITS,
+        .parity     = UART_PARITY_DISABLE,
+        .stop_bits  = UART_STOP_BITS_1,
+        .flow_ctrl  = UART_HW_FLOWCTRL_DISABLE,
+        .source_clk = UART_SCLK_DEFAULT,
+    };
+
+    esp_err_t err = uart_driver_install(PZEM_UART_NUM, PZEM_UART_BUF_SIZE * 2,
+                                        PZEM_UART_BUF_SIZE * 2, MODBUS_EVENT_QUEUE_LEN,
+                                        &s_uart_events, 0);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG_PZEM, "UART driver install failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    err = uart_param_config(PZEM_UART_NUM, &uart_cfg);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG_PZEM, "UART param config failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    // Physical wiring in this project is RX->RX and TX->TX.
+    // We map UART pins so ESP TX still drives the PZEM RX path and vice versa.
+    err = uart_set_pin(PZEM_UART_NUM, PZEM_TX_PIN, PZEM_RX_PIN,
+                       UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG_PZEM, "UART set pins failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    // RX timeout in character times: fires once the line has been quiet a
+    // little longer than the Modbus 3.5-character inter-frame gap.
+    err = uart_set_rx_timeout(PZEM_UART_NUM, MODBUS_RX_TOUT_CHARS);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG_PZEM, "UART set RX timeout failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    // The PZEM-004T RX optocoupler is biased from 5V — a push-pull 3.3V HIGH
+    // lets ~0.5 mA leak through the optocoupler LED, garbling every byte.
+    // Open-drain + internal 45 kΩ pull-up to 3.3V limits HIGH-state current
+    // to ~10 µA (well below activation threshold), so the optocoupler fully
+    // turns off between bits — no external resistor required.
+    // gpio_set_direction only changes the pad drive mode; it does NOT disturb
+    // the GPIO-matrix routing that uart_set_pin configured.
+    gpio_set_direction(PZEM_TX_PIN, GPIO_MODE_OUTPUT_OD);
+    gpio_pullup_en(PZEM_TX_PIN);
+
+    return ESP_OK;
+}
+
+esp_err_t modbus_rtu_transact(const uint8_t *req, size_t req_len,
+                              uint8_t *resp, size_t resp_cap, size_t expected_len,
+                              uint32_t timeout_ms, size_t *out_len)
+{
+#if PZEM_EMULATOR_ENABLED
+    if (!req || !resp || !out_len) return ESP_ERR_INVALID_ARG;
+    return emulated_transact(req, req_len, resp, resp_cap, expected_len, timeout_ms, out_len);
+#endif
+
+    if (!req || !resp || !out_len || !s_uart_events) return ESP_ERR_INVALID_ARG;
+    *out_len = 0;
+
+    // Clear only the RX buffer (uart_flush_input, not the deprecated uart_flush
+    // which also clears TX and can cancel bytes still in the FIFO), and drop
+    // any stale events left over from a previous garbled frame.
+    uart_flush_input(PZEM_UART_NUM);
+    xQueueReset(s_uart_events);
+
+    int written = uart_write_bytes(PZEM_UART_NUM, (const char *)req, req_len);
+    if (written != (int)req_len) {
+        return ESP_FAIL;
+    }
+    // Ensure all request bytes have left the FIFO before we start reading
+    uart_wait_tx_done(PZEM_UART_NUM, pdMS_TO_TICKS(50));
+    int64_t tx_done_us = esp_timer_get_time();
+
+    modbus_frame_t     frame;
+    modbus_rx_status_t status = MODBUS_RX_IN_PROGRESS;
+    TickType_t         start  = xTaskGetTickCount();
+    TickType_t         limit  = pdMS_TO_TICKS(timeout_ms);
+    modbus_frame_begin(&frame, resp, resp_cap, expected_len);
+
+    while (status == MODBUS_RX_IN_PROGRESS) {
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= limit) break;
+
+        uart_event_t ev;
+        if (xQueueReceive(s_uart_events, &ev, limit - elapsed) != pdTRUE) break;
+
+        switch (ev.type) {
+            case UART_DATA: {
+                uint8_t chunk[32];
+                size_t  pending = ev.size;
+                while (pending > 0) {
+                    size_t want = pending < sizeof(chunk) ? pending : sizeof(chunk);
+                    int    got  = uart_read_bytes(PZEM_UART_NUM, chunk, want, 0);
+                    if (got <= 0) break;
+                    modbus_frame_feed(&frame, chunk, (size_t)got);
+                    pending -= (size_t)got;
+                }
+                status = modbus_frame_status(&frame, ev.timeout_flag);
+                if (status == MODBUS_RX_COMPLETE) s_frame_done_us = esp_timer_get_time();
+                break;
+            }
+            case UART_FIFO_OVF:
+            case UART_BUFFER_FULL:
+                status = MODBUS_RX_OVERFLOW;
+                break;
+            default:
+                // Framing/parity errors show up as a CRC failure on the frame
+                break;
+        }
+    }
+
+    *out_len = frame.len;
+
+    link_record(req[0], status, frame.len,
+                (uint32_t)((esp_timer_get_time() - tx_done_us) / 1000));
+
+    if (status != MODBUS_RX_COMPLETE && status != MODBUS_RX_EXCEPTION) {
+        uart_flush_input(PZEM_UART_NUM);      // discard corrupted/partial frame
+        if (status == MODBUS_RX_OVERFLOW) xQueueReset(s_uart_events);
+    }
+    return rx_status_to_err(status);
+}
@@ -0,0 +1,533 @@
+#include "nilm.h"
+#include "config.h"
+#include "logger.h"
+
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "nvs.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NILM_NVS_KEY        "nilm"
+
+// A gap longer than this between full reads restarts segmentation
+#define GAP_MS              (3 * PZEM_READ_INTERVAL_MS)
+
+// Steady level tracks slow drift as an EWMA with α = 1/LEVEL_DIV
+#define LEVEL_DIV           4
+
+#define INRUSH_MAX_PCT      2000
+
+#define MWH_DWMS            36000u      // 0.1 W·ms per mWh
+
+typedef enum {
+    SEG_NONE = 0,           // no level yet (boot or after a gap)
+    SEG_STEADY,
+    SEG_TRANSIENT,
+} seg_t;
+
+typedef struct {
+    int32_t  p_dw;
+    int32_t  q_dvar;
+    uint32_t i_ma;
+    uint32_t ts;
+    uint8_t  pf_pct;
+} level_t;
+
+// Segmentation state, anomaly task only
+typedef struct {
+    seg_t    seg;
+    level_t  level;                         // current steady level
+    level_t  pre;                           // level the transient left
+    uint32_t last_ms;                       // last full read
+    uint32_t peak_i;                        // highest current in the transient
+    uint32_t fast_peak_i;                   // highest fast-poll current since the last full read
+    uint8_t  n;                             // readings in ring[]
+    uint8_t  head;
+    level_t  ring[NILM_SETTLE_READS];       // latest transient readings
+} seg_ctx_t;
+
+// A signature plus what only lives in RAM
+typedef struct {
+    nilm_appliance_t a;
+    int32_t          run_dw;                // sum of the running instances' steps
+    uint32_t         rem_dwms;              // energy below 1 mWh
+} slot_t;
+
+// On-flash tables
+typedef struct {
+    nilm_appliance_t app[PZEM_CHANNEL_COUNT][NILM_MAX_APPLIANCES];
+    uint32_t         seq;
+    uint16_t         next_id;
+    uint32_t         crc;                   // CRC32 over the fields above
+} nilm_blob_t;
+
+static seg_ctx_t         s_seg[PZEM_CHANNEL_COUNT];
+static slot_t            s_slot[PZEM_CHANNEL_COUNT][NILM_MAX_APPLIANCES];
+static uint32_t          s_seq;             // edge sequence, for eviction order
+static uint16_t          s_next_id = 1;
+static uint32_t          s_gen;             // bumped on every change that needs persisting
+static uint32_t          s_saved_gen;
+static uint32_t          s_saved_ms;
+static bool              s_urgent;          // a new id was handed out
+static SemaphoreHandle_t s_mutex = NULL;
+
+static uint32_t blob_crc(const nilm_blob_t *b)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)b, offsetof(nilm_blob_t, crc));
+}
+
+static int32_t max_i32(int32_t a, int32_t b) { return a > b ? a : b; }
+
+static uint32_t isqrt64(uint64_t x)
+{
+    uint64_t r = 0, bit = 1ULL << 62;
+    while (bit > x) bit >>= 2;
+    while (bit) {
+        if (x >= r + bit) {
+            x -= r + bit;
+            r  = (r >> 1) + bit;
+        } else {
+            r >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)r;
+}
+
+// Smallest step that counts as an edge at this level
+static int32_t step_min(int32_t level_dw)
+{
+    return max_i32(NILM_STEP_MIN_DW, abs(level_dw) * NILM_STEP_PCT / 100);
+}
+
+// ── Signature table (caller holds s_mutex) ───────────────────────────────────
+
+// Distance of a step to a signature in tolerance units (×100); -1 if outside
+static int32_t match_cost(const nilm_appliance_t *a, int32_t dp, int32_t dq)
+{
+    int32_t tol_p = max_i32(NILM_MATCH_MIN_DW, abs(a->dp_dw)   * NILM_MATCH_PCT / 100);
+    int32_t tol_q = max_i32(NILM_MATCH_MIN_DW, abs(a->dq_dvar) * NILM_MATCH_PCT / 100);
+    int32_t ep    = abs(dp - a->dp_dw);
+    int32_t eq    = abs(dq - a->dq_dvar);
+    if (ep > tol_p || eq > tol_q) return -1;
+    return ep * 100 / tol_p + eq * 100 / tol_q;
+}
+
+// Running mean for the first 2^SHIFT edges, then an EWMA
+static void centroid(int32_t *c, int32_t x, uint32_t edges)
+{
+    uint32_t k = edges < (1u << NILM_CENTROID_SHIFT) ? edges : (1u << NILM_CENTROID_SHIFT);
+    *c += (x - *c) / (int32_t)k;
+}
+
+static int best_match(uint8_t ch, int32_t dp, int32_t dq, bool running_only)
+{
+    int     best      = -1;
+    int32_t best_cost = INT32_MAX;
+    for (int k = 0; k < NILM_MAX_APPLIANCES; k++) {
+        const nilm_appliance_t *a = &s_slot[ch][k].a;
+        if (a->id == 0 || (running_only && a->running == 0)) continue;
+        int32_t cost = match_cost(a, dp, dq);
+        if (cost >= 0 && cost < best_cost) {
+            best      = k;
+            best_cost = cost;
+        }
+    }
+    return best;
+}
+
+// Free slot, else the least recently seen idle signature; -1 if all run
+static int claim_slot(uint8_t ch)
+{
+    int victim = -1;
+    for (int k = 0; k < NILM_MAX_APPLIANCES; k++) {
+        const nilm_appliance_t *a = &s_slot[ch][k].a;
+        if (a->id == 0) return k;
+        if (a->running == 0 && (victim < 0 || a->last_seq < s_slot[ch][victim].a.last_seq)) {
+            victim = k;
+        }
+    }
+    if (victim >= 0) {
+        ESP_LOGI(TAG_NILM, "CH%u: signature #%u (%ld edges) evicted", ch,
+                 s_slot[ch][victim].a.id, (long)s_slot[ch][victim].a.edges);
+    }
+    return victim;
+}
+
+static void stop_one(slot_t *s)
+{
+    s->run_dw -= s->run_dw / s->a.running;
+    if (--s->a.running == 0) s->run_dw = 0;
+    s->a.last_seq = ++s_seq;
+}
+
+static void on_edge(uint8_t ch, nilm_event_t *e)
+{
+    int k = best_match(ch, e->dp_dw, e->dq_dvar, false);
+
+    if (k >= 0) {
+        nilm_appliance_t *a = &s_slot[ch][k].a;
+        a->edges++;
+        centroid(&a->dp_dw,   e->dp_dw,   a->edges);
+        centroid(&a->dq_dvar, e->dq_dvar, a->edges);
+        int32_t inrush = a->inrush_pct;
+        centroid(&inrush, e->inrush_pct, a->edges);
+        a->inrush_pct = (uint16_t)inrush;
+    } else if ((k = claim_slot(ch)) >= 0) {
+        slot_t *s = &s_slot[ch][k];
+        memset(s, 0, sizeof(*s));
+        s->a.id         = s_next_id;
+        s->a.dp_dw      = e->dp_dw;
+        s->a.dq_dvar    = e->dq_dvar;
+        s->a.inrush_pct = e->inrush_pct;
+        s->a.edges      = 1;
+        if (++s_next_id == 0) s_next_id = 1;
+        s_urgent  = true;
+        e->flags |= NILM_FLAG_NEW;
+    } else {
+        return;     // every slot is running: report the edge unmatched
+    }
+
+    slot_t *s = &s_slot[ch][k];
+    s->a.running++;
+    s->a.last_seq = ++s_seq;
+    s->run_dw    += e->dp_dw;
+    e->appliance  = s->a.id;
+}
+
+static void off_edge(uint8_t ch, nilm_event_t *e)
+{
+    int k = best_match(ch, -e->dp_dw, -e->dq_dvar, true);
+    if (k < 0) return;
+    stop_one(&s_slot[ch][k]);
+    e->appliance = s_slot[ch][k].a.id;
+}
+
+// Close everything still running; an event per signature while out has room
+static uint8_t all_off(uint8_t ch, uint32_t ts, nilm_event_t *out, uint8_t max)
+{
+    uint8_t n = 0;
+    for (int k = 0; k < NILM_MAX_APPLIANCES; k++) {
+        slot_t *s = &s_slot[ch][k];
+        if (s->a.id == 0 || s->a.running == 0) continue;
+        if (n < max) {
+            nilm_event_t *e = &out[n++];
+            memset(e, 0, sizeof(*e));
+            e->timestamp = ts;
+            e->dp_dw     = -s->run_dw;
+            e->dq_dvar   = -s->a.dq_dvar * s->a.running;
+            e->appliance = s->a.id;
+            e->channel   = ch;
+            e->edge      = NILM_EDGE_OFF;
+            e->flags     = NILM_FLAG_IDLE;
+        }
+        while (s->a.running) stop_one(s);
+    }
+    return n;
+}
+
+// Charge the interval since the previous full read to running signatures
+static void integrate(uint8_t ch, uint32_t dt_ms)
+{
+    for (int k = 0; k < NILM_MAX_APPLIANCES; k++) {
+        slot_t *s = &s_slot[ch][k];
+        if (s->a.running == 0 || s->run_dw <= 0) continue;
+        uint64_t dwms = (uint64_t)s->run_dw * dt_ms + s->rem_dwms;
+        s->a.energy_mwh += dwms / MWH_DWMS;
+        s->a.run_ms     += dt_ms;
+        s->rem_dwms      = (uint32_t)(dwms % MWH_DWMS);
+    }
+}
+
+// ── Segmentation (anomaly task) ──────────────────────────────────────────────
+
+static level_t reading_level(const pzem_data_t *d)
+{
+    uint64_t s2 = (uint64_t)d->apparent_dva * d->apparent_dva;
+    uint64_t p2 = (uint64_t)d->power_dw * d->power_dw;
+    level_t  l  = {
+        .p_dw   = (int32_t)d->power_dw,
+        .q_dvar = s2 > p2 ? (int32_t)isqrt64(s2 - p2) : 0,
+        .i_ma   = d->i_ma,
+        .ts     = d->timestamp,
+        .pf_pct = d->pf_pct,
+    };
+    return l;
+}
+
+// Mean of the settle ring if its readings agree, else false
+static bool settled(const seg_ctx_t *c, level_t *out)
+{
+    if (c->n < NILM_SETTLE_READS) return false;
+
+    int64_t  sp = 0, sq = 0, si = 0, spf = 0;
+    int32_t  lo = INT32_MAX, hi = INT32_MIN;
+    for (int k = 0; k < NILM_SETTLE_READS; k++) {
+        const level_t *r = &c->ring[k];
+        sp  += r->p_dw;
+        sq  += r->q_dvar;
+        si  += r->i_ma;
+        spf += r->pf_pct;
+        if (r->p_dw < lo) lo = r->p_dw;
+        if (r->p_dw > hi) hi = r->p_dw;
+    }
+    int32_t mean = (int32_t)(sp / NILM_SETTLE_READS);
+    if (hi - lo > max_i32(NILM_SETTLE_TOL_DW, mean * NILM_SETTLE_PCT / 100)) return false;
+
+    out->p_dw   = mean;
+    out->q_dvar = (int32_t)(sq / NILM_SETTLE_READS);
+    out->i_ma   = (uint32_t)(si / NILM_SETTLE_READS);
+    out->pf_pct = (uint8_t)(spf / NILM_SETTLE_READS);
+    out->ts     = c->ring[c->head].ts;    // oldest: where the new level began
+    return true;
+}
+
+static void push(seg_ctx_t *c, const level_t *r)
+{
+    c->ring[c->head] = *r;
+    c->head = (uint8_t)((c->head + 1) % NILM_SETTLE_READS);
+    if (c->n < NILM_SETTLE_READS) c->n++;
+}
+
+// The transient settled at @p now: turn the level change into an edge
+static uint8_t close_transient(uint8_t ch, seg_ctx_t *c, const level_t *now,
+                               uint32_t start_ms, nilm_event_t *out, uint8_t max)
+{
+    int32_t dp = now->p_dw - c->pre.p_dw;
+    uint8_t n  = 0;
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    if (abs(dp) >= step_min(c->pre.p_dw) && max > 0) {
+        nilm_event_t *e = &out[n++];
+        memset(e, 0, sizeof(*e));
+        e->timestamp = start_ms;
+        e->dp_dw     = dp;
+        e->dq_dvar   = now->q_dvar - c->pre.q_dvar;
+        e->dpf_pct   = (int8_t)((int)now->pf_pct - (int)c->pre.pf_pct);
+        e->settle_ms = (uint16_t)((now->ts - start_ms) > UINT16_MAX ? UINT16_MAX
+                                                                     : now->ts - start_ms);
+        e->channel   = ch;
+        if (dp > 0) {
+            int32_t di  = max_i32((int32_t)(now->i_ma - c->pre.i_ma), 1);
+            int32_t pct = (int32_t)(c->peak_i - c->pre.i_ma) * 100 / di;
+            e->inrush_pct = (uint16_t)(pct < 100 ? 100 : pct > INRUSH_MAX_PCT ? INRUSH_MAX_PCT : pct);
+            e->edge       = NILM_EDGE_ON;
+            on_edge(ch, e);
+        } else {
+            e->edge = NILM_EDGE_OFF;
+            off_edge(ch, e);
+        }
+        s_gen++;
+
+        LOG_INFO(TAG_NILM, "CH%u %-3s %+ld W  %+ld var  inrush %u%%  → #%u%s", ch,
+                 e->edge == NILM_EDGE_ON ? "on" : "off", (long)(dp / 10),
+                 (long)(e->dq_dvar / 10), e->inrush_pct, e->appliance,
+                 (e->flags & NILM_FLAG_NEW) ? " (new)" : "");
+    }
+    if (now->p_dw < NILM_IDLE_DW) {
+        n += all_off(ch, start_ms, out + n, (uint8_t)(max - n));
+        s_gen++;
+    }
+    xSemaphoreGive(s_mutex);
+
+    return n;
+}
+
+// ── Public API ───────────────────────────────────────────────────────────────
+
+void nilm_init(void)
+{
+    memset(s_seg, 0, sizeof(s_seg));
+    if (s_mutex) return;    // tables already restored
+
+    s_mutex = xSemaphoreCreateMutex();
+
+    nvs_handle_t h;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &h) == ESP_OK) {
+        static nilm_blob_t b;
+        size_t             len = sizeof(b);
+        if (nvs_get_blob(h, NILM_NVS_KEY, &b, &len) == ESP_OK && len == sizeof(b)) {
+            if (b.crc == blob_crc(&b)) {
+                for (int ch = 0; ch < PZEM_CHANNEL_COUNT; ch++) {
+                    for (int k = 0; k < NILM_MAX_APPLIANCES; k++) {
+                        s_slot[ch][k].a         = b.app[ch][k];
+                        s_slot[ch][k].a.running = 0;
+                    }
+                }
+                s_seq     = b.seq;
+                s_next_id = b.next_id ? b.next_id : 1;
+            } else {
+                ESP_LOGW(TAG_NILM, "Stored appliance signatures corrupt — relearning");
+            }
+        }
+        nvs_close(h);
+    }
+
+    int used = 0;
+    for (int ch = 0; ch < PZEM_CHANNEL_COUNT; ch++) {
+        for (int k = 0; k < NILM_MAX_APPLIANCES; k++) used += s_slot[ch][k].a.id != 0;
+    }
+    ESP_LOGI(TAG_NILM, "Appliance signatures: %d/%d restored", used,
+             PZEM_CHANNEL_COUNT * NILM_MAX_APPLIANCES);
+}
+
+uint8_t nilm_update(const pzem_data_t *data, nilm_event_t *out, uint8_t max)
+{
+    if (!data || data->channel >= PZEM_CHANNEL_COUNT || !data->valid || !s_mutex) return 0;
+
+    uint8_t    ch = data->channel;
+    seg_ctx_t *c  = &s_seg[ch];
+
+    if (data->current_only) {
+        if (data->i_ma > c->fast_peak_i) c->fast_peak_i = data->i_ma;
+        return 0;
+    }
+
+    level_t  r    = reading_level(data);
+    uint32_t fast = c->fast_peak_i;
+    uint32_t dt   = r.ts - c->last_ms;
+    c->fast_peak_i = 0;
+    c->last_ms     = r.ts;
+
+    if (c->seg == SEG_NONE || dt > GAP_MS) {
+        // No edge can be placed across a gap; a load that went away
+        // meanwhile is closed by the idle check
+        c->seg   = SEG_STEADY;
+        c->level = r;
+        if (r.p_dw < NILM_IDLE_DW) {
+            xSemaphoreTake(s_mutex, portMAX_DELAY);
+            all_off(ch, r.ts, out, 0);
+            xSemaphoreGive(s_mutex);
+        }
+        return 0;
+    }
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    integrate(ch, dt);
+    s_gen++;
+    xSemaphoreGive(s_mutex);
+
+    if (c->seg == SEG_STEADY) {
+        if (abs(r.p_dw - c->level.p_dw) < step_min(c->level.p_dw)) {
+            c->level.p_dw   += (r.p_dw - c->level.p_dw) / LEVEL_DIV;
+            c->level.q_dvar += (r.q_dvar - c->level.q_dvar) / LEVEL_DIV;
+            c->level.i_ma    = r.i_ma;
+            c->level.pf_pct  = r.pf_pct;
+            return 0;
+        }
+        c->seg     = SEG_TRANSIENT;
+        c->pre     = c->level;
+        c->pre.ts  = r.ts;      // the step is dated by its first reading
+        c->peak_i  = fast > r.i_ma ? fast : r.i_ma;
+        c->n       = 0;
+        c->head    = 0;
+        push(c, &r);
+        return 0;
+    }
+
+    // SEG_TRANSIENT
+    if (fast   > c->peak_i) c->peak_i = fast;
+    if (r.i_ma > c->peak_i) c->peak_i = r.i_ma;
+    push(c, &r);
+
+    level_t now;
+    if (settled(c, &now)) {
+        uint32_t start_ms = c->pre.ts;
+        c->seg   = SEG_STEADY;
+        c->level = now;
+        return close_transient(ch, c, &now, start_ms, out, max);
+    }
+    if (r.ts - c->pre.ts > NILM_MAX_TRANSIENT_MS) {
+        LOG_DEBUG(TAG_NILM, "CH%u: load did not settle in %d ms — rebased", ch,
+                  NILM_MAX_TRANSIENT_MS);
+        c->seg   = SEG_STEADY;
+        c->level = r;
+    }
+    return 0;
+}
+
+void nilm_note_trip(uint8_t channel)
+{
+    if (channel >= PZEM_CHANNEL_COUNT || !s_mutex) return;
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    for (int k = 0; k < NILM_MAX_APPLIANCES; k++) {
+        nilm_appliance_t *a = &s_slot[channel][k].a;
+        if (a->id == 0 || a->running == 0) continue;
+        a->trips++;
+        ESP_LOGW(TAG_NILM, "CH%u: trip while #%u was running (%lu trips)", channel, a->id,
+                 (unsigned long)a->trips);
+    }
+    s_gen++;
+    xSemaphoreGive(s_mutex);
+}
+
+uint8_t nilm_get_appliances(uint8_t channel, nilm_appliance_t *out, uint8_t max)
+{
+    if (channel >= PZEM_CHANNEL_COUNT || !out || !s_mutex) return 0;
+
+    uint8_t n = 0;
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    for (int k = 0; k < NILM_MAX_APPLIANCES && n < max; k++) {
+        if (s_slot[channel][k].a.id != 0) out[n++] = s_slot[channel][k].a;
+    }
+    xSemaphoreGive(s_mutex);
+    return n;
+}
+
+void nilm_persist(void)
+{
+    static nilm_blob_t b;   // ~1 KB: too much for the persist task's stack
+
+    if (!s_mutex || xSemaphoreTake(s_mutex, pdMS_TO_TICKS(100)) != pdTRUE) return;
+    uint32_t now_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    bool     due    = s_gen != s_saved_gen &&
+                      (s_urgent || now_ms - s_saved_ms >= NILM_PERSIST_MS);
+    if (due) {
+        for (int ch = 0; ch < PZEM_CHANNEL_COUNT; ch++) {
+            for (int k = 0; k < NILM_MAX_APPLIANCES; k++) b.app[ch][k] = s_slot[ch][k].a;
+        }
+        b.seq     = s_seq;
+        b.next_id = s_next_id;
+    }
+    uint32_t gen = s_gen;
+    s_urgent     = false;
+    xSemaphoreGive(s_mutex);
+
+    if (!due) return;
+
+    nvs_handle_t h;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &h) != ESP_OK) {
+        ESP_LOGE(TAG_NILM, "Signature persist: NVS open failed");
+        return;
+    }
+    b.crc = blob_crc(&b);
+    esp_err_t err = nvs_set_blob(h, NILM_NVS_KEY, &b, sizeof(b));
+    if (err == ESP_OK) err = nvs_commit(h);
+    nvs_close(h);
+
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG_NILM, "Signature persist failed: %s", esp_err_to_name(err));
+        return;
+    }
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    s_saved_gen = gen;
+    s_saved_ms  = now_ms;
+    xSemaphoreGive(s_mutex);
+}
+
+const char *nilm_edge_to_string(nilm_edge_t edge)
+{
+    switch (edge) {
+        case NILM_EDGE_ON:  return "on";
+        case NILM_EDGE_OFF: return "off";
+        default:            return "unknown";
+    }
+}
@@ -0,0 +1,144 @@
+#include "power_quality.h"
+#include "logger.h"
+
+#include "esp_log.h"
+
+#include <string.h>
+
+// Band edges in 0.1 V
+#define NOMINAL_DV      ((uint32_t)(NOMINAL_VOLTAGE_V * 10.0f + 0.5f))
+#define PCT_DV(p)       (NOMINAL_DV * (p) / 100)
+
+// IEEE 1159 duration class boundaries
+#define INSTANT_MAX_MS  ((uint32_t)(30 * 1000 / NOMINAL_FREQUENCY_HZ))
+#define MOMENTARY_MAX_MS    3000
+#define TEMPORARY_MAX_MS    60000
+
+typedef struct {
+    bool     open;
+    uint8_t  kind;
+    uint8_t  flags;
+    uint8_t  misses;            // consecutive failed reads
+    uint32_t first_miss_ms;
+    uint32_t start_ms;
+    uint16_t min_dv;
+    uint16_t max_dv;
+} pq_state_t;
+
+static pq_state_t s_state[PZEM_CHANNEL_COUNT];
+
+void power_quality_init(void)
+{
+    memset(s_state, 0, sizeof(s_state));
+    LOG_INFO(TAG_PQ, "Power quality: sag <%d%%, swell >%d%%, interruption <%d%% of %u.%u V",
+             PQ_SAG_PCT, PQ_SWELL_PCT, PQ_INTERRUPT_PCT,
+             (unsigned)(NOMINAL_DV / 10), (unsigned)(NOMINAL_DV % 10));
+}
+
+static pq_category_t categorize(pq_kind_t kind, uint32_t duration_ms)
+{
+    if (duration_ms <= INSTANT_MAX_MS && kind != PQ_KIND_INTERRUPTION) return PQ_CAT_INSTANTANEOUS;
+    if (duration_ms <= MOMENTARY_MAX_MS) return PQ_CAT_MOMENTARY;
+    if (duration_ms <= TEMPORARY_MAX_MS) return PQ_CAT_TEMPORARY;
+    return PQ_CAT_SUSTAINED;
+}
+
+static bool close_event(pq_state_t *st, uint8_t ch, uint32_t t_ms, pq_event_t *out)
+{
+    st->open = false;
+
+    out->start_ms    = st->start_ms;
+    out->duration_ms = t_ms - st->start_ms;
+    out->min_dv      = st->min_dv;
+    out->max_dv      = st->max_dv;
+    out->channel     = ch;
+    out->kind        = st->kind;
+    out->category    = categorize((pq_kind_t)st->kind, out->duration_ms);
+    out->flags       = st->flags;
+
+    LOG_WARN(TAG_PQ, "CH%u %s %s: %lu ms, %u.%u–%u.%u V%s",
+             ch, pq_category_to_string((pq_category_t)out->category),
+             pq_kind_to_string((pq_kind_t)out->kind), (unsigned long)out->duration_ms,
+             out->min_dv / 10, out->min_dv % 10, out->max_dv / 10, out->max_dv % 10,
+             (out->flags & PQ_FLAG_SILENT) ? " (meter silent)" : "");
+    return true;
+}
+
+// One voltage reading. An open event continues while the voltage stays
+// outside the band widened by the hysteresis; a reading that ends it may
+// open the opposite kind straight away.
+static bool feed(uint8_t ch, uint32_t t_ms, uint16_t v_dv, uint8_t flags, pq_event_t *out)
+{
+    pq_state_t *st     = &s_state[ch];
+    bool        closed = false;
+
+    if (st->open) {
+        bool inside = st->kind == PQ_KIND_SWELL
+                    ? v_dv > PCT_DV(PQ_SWELL_PCT - PQ_HYSTERESIS_PCT)
+                    : v_dv < PCT_DV(PQ_SAG_PCT + PQ_HYSTERESIS_PCT);
+        if (inside) {
+            if (v_dv < st->min_dv) st->min_dv = v_dv;
+            if (v_dv > st->max_dv) st->max_dv = v_dv;
+            if (v_dv < PCT_DV(PQ_INTERRUPT_PCT)) st->kind = PQ_KIND_INTERRUPTION;
+            st->flags |= flags;
+            return false;
+        }
+        closed = close_event(st, ch, t_ms, out);
+    }
+
+    pq_kind_t kind;
+    if (v_dv < PCT_DV(PQ_INTERRUPT_PCT))  kind = PQ_KIND_INTERRUPTION;
+    else if (v_dv < PCT_DV(PQ_SAG_PCT))   kind = PQ_KIND_SAG;
+    else if (v_dv > PCT_DV(PQ_SWELL_PCT)) kind = PQ_KIND_SWELL;
+    else return closed;
+
+    st->open     = true;
+    st->kind     = kind;
+    st->flags    = flags;
+    st->start_ms = t_ms;
+    st->min_dv   = v_dv;
+    st->max_dv   = v_dv;
+    return closed;
+}
+
+bool power_quality_update(const pzem_data_t *data, pq_event_t *out)
+{
+    if (!data || !out || data->channel >= PZEM_CHANNEL_COUNT) return false;
+    pq_state_t *st = &s_state[data->channel];
+
+    if (!data->valid) {
+        if (PQ_SILENT_MISSES == 0) return false;
+        if (st->misses == 0) st->first_miss_ms = data->timestamp;
+        if (st->misses < UINT8_MAX) st->misses++;
+        if (st->misses < PQ_SILENT_MISSES) return false;
+        // The threshold miss backdates the interruption to the first one
+        uint32_t t_ms = st->misses == PQ_SILENT_MISSES ? st->first_miss_ms : data->timestamp;
+        return feed(data->channel, t_ms, 0, PQ_FLAG_SILENT, out);
+    }
+    st->misses = 0;
+
+    // Fast samples carry voltage only when the poll was widened for it
+    if (data->current_only && !PZEM_FAST_POLL_VOLTAGE) return false;
+    return feed(data->channel, data->timestamp, data->v_dv, 0, out);
+}
+
+const char *pq_kind_to_string(pq_kind_t kind)
+{
+    switch (kind) {
+        case PQ_KIND_SAG:          return "sag";
+        case PQ_KIND_SWELL:        return "swell";
+        case PQ_KIND_INTERRUPTION: return "interruption";
+        default:                   return "unknown";
+    }
+}
+
+const char *pq_category_to_string(pq_category_t category)
+{
+    switch (category) {
+        case PQ_CAT_INSTANTANEOUS: return "instantaneous";
+        case PQ_CAT_MOMENTARY:     return "momentary";
+        case PQ_CAT_TEMPORARY:     return "temporary";
+        case PQ_CAT_SUSTAINED:     return "sustained";
+        default:                   return "unknown";
+    }
+}
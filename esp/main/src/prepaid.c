@@ -0,0 +1,265 @@
+#include "prepaid.h"
+#include "config.h"
+#include "logger.h"
+#include "energy_counter.h"
+#include "relay_control.h"
+
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "nvs.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#define PREPAID_NVS_KEY     "prepaid"
+
+// On-flash copy of the active document and the consumption bookkeeping
+typedef struct {
+    prepaid_doc_t doc;
+    int64_t       spent_wh;     // consumption folded in while credit was disabled
+    uint64_t      anchor_wh;    // Σ lifetime energy consumption is counted from
+    bool          anchored;
+    uint32_t      crc;          // CRC32 over the fields above
+} prepaid_blob_t;
+
+typedef struct {
+    prepaid_blob_t  saved;
+    bool            have_doc;
+    prepaid_state_t state;
+    int64_t         balance_wh;
+    bool            cut_relay;  // relay was ON when credit ran out; close it on top-up
+    uint32_t        gen;        // bumped on every change that needs persisting
+    uint32_t        saved_gen;
+} prepaid_ctx_t;
+
+static prepaid_ctx_t     s_pp;
+static SemaphoreHandle_t s_mutex = NULL;
+static volatile bool     s_sync_requested;
+
+static uint32_t blob_crc(const prepaid_blob_t *b)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)b, offsetof(prepaid_blob_t, crc));
+}
+
+static bool credit_enabled(void)
+{
+    return s_pp.have_doc && s_pp.saved.doc.enabled;
+}
+
+// Energy used since credit was first enabled
+static int64_t consumed_wh(uint64_t sum)
+{
+    int64_t used = s_pp.saved.spent_wh;
+    if (s_pp.saved.anchored && sum > s_pp.saved.anchor_wh) used += sum - s_pp.saved.anchor_wh;
+    return used;
+}
+
+static prepaid_state_t classify(int64_t balance_wh)
+{
+    const prepaid_doc_t *d = &s_pp.saved.doc;
+    if (balance_wh <= 0)                            return PREPAID_STATE_EXHAUSTED;
+    if (balance_wh <= (int64_t)d->warn_critical_wh) return PREPAID_STATE_CRITICAL;
+    if (balance_wh <= (int64_t)d->warn_low_wh)      return PREPAID_STATE_LOW;
+    return PREPAID_STATE_OK;
+}
+
+// Recompute the balance and drive the relay to match. Level-triggered, so a
+// relay call that was refused is simply retried on the next evaluation.
+// Caller holds s_mutex.
+static void evaluate(bool may_anchor)
+{
+    uint64_t        sum = energy_counter_sum();
+    prepaid_state_t old = s_pp.state;
+
+    if (!credit_enabled()) {
+        s_pp.state = PREPAID_STATE_DISABLED;
+    } else {
+        if (!s_pp.saved.anchored && may_anchor) {
+            s_pp.saved.anchor_wh = sum;
+            s_pp.saved.anchored  = true;
+            s_pp.gen++;
+        }
+        s_pp.balance_wh = s_pp.saved.doc.granted_wh - consumed_wh(sum);
+        s_pp.state      = classify(s_pp.balance_wh);
+    }
+
+    if (s_pp.state != old) {
+        if (s_pp.state > old && s_pp.state >= PREPAID_STATE_LOW) {
+            LOG_WARN(TAG_PREPAID, "Credit %s: %lld Wh left",
+                     prepaid_state_to_string(s_pp.state), (long long)s_pp.balance_wh);
+            s_sync_requested = true;
+        } else {
+            LOG_INFO(TAG_PREPAID, "Credit %s: %lld Wh",
+                     prepaid_state_to_string(s_pp.state), (long long)s_pp.balance_wh);
+        }
+    }
+
+    bool lock = s_pp.state == PREPAID_STATE_EXHAUSTED;
+    if (relay_is_locked_out() != lock) {
+        bool was_on = relay_get_state() == RELAY_STATE_ON;
+        if (relay_set_lockout(lock) == ESP_OK && lock) s_pp.cut_relay = was_on;
+    }
+
+    // Top-up (or credit switched off) after a cutoff: reconnect the load.
+    // Cooldown refusals retry on the next evaluation; a trip since then wins.
+    if (!lock && s_pp.cut_relay) {
+        relay_state_t rs = relay_get_state();
+        if (rs == RELAY_STATE_TRIPPED || relay_set_state(RELAY_STATE_ON) == ESP_OK) {
+            s_pp.cut_relay = false;
+        }
+    }
+}
+
+esp_err_t prepaid_init(void)
+{
+    memset(&s_pp, 0, sizeof(s_pp));
+    s_mutex = xSemaphoreCreateMutex();
+    if (!s_mutex) return ESP_ERR_NO_MEM;
+
+    nvs_handle_t h;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &h) == ESP_OK) {
+        prepaid_blob_t b;
+        size_t         len = sizeof(b);
+        if (nvs_get_blob(h, PREPAID_NVS_KEY, &b, &len) == ESP_OK && len == sizeof(b)) {
+            if (b.crc == blob_crc(&b)) {
+                s_pp.saved    = b;
+                s_pp.have_doc = true;
+            } else {
+                ESP_LOGW(TAG_PREPAID, "Stored credit corrupt — waiting for the server");
+            }
+        }
+        nvs_close(h);
+    }
+
+    if (!s_pp.have_doc) {
+        ESP_LOGI(TAG_PREPAID, "Prepaid credit: none");
+        return ESP_OK;
+    }
+
+    // Energy totals are the restored checkpoints at this point, so an
+    // exhausted account locks the relay before any command can close it
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    evaluate(false);
+    s_pp.saved_gen = s_pp.gen;
+    ESP_LOGI(TAG_PREPAID, "Prepaid credit seq %lu: %s, %lld Wh",
+             (unsigned long)s_pp.saved.doc.seq, prepaid_state_to_string(s_pp.state),
+             (long long)s_pp.balance_wh);
+    xSemaphoreGive(s_mutex);
+    return ESP_OK;
+}
+
+esp_err_t prepaid_apply(const prepaid_doc_t *doc)
+{
+    if (!doc || !s_mutex) return ESP_ERR_INVALID_ARG;
+    if (doc->warn_critical_wh > doc->warn_low_wh) return ESP_ERR_INVALID_ARG;
+
+    if (xSemaphoreTake(s_mutex, pdMS_TO_TICKS(500)) != pdTRUE) return ESP_ERR_TIMEOUT;
+
+    // Replays and rollbacks change nothing
+    if (s_pp.have_doc && doc->seq <= s_pp.saved.doc.seq) {
+        xSemaphoreGive(s_mutex);
+        return ESP_OK;
+    }
+
+    // Switching credit off banks what was used so far; switching it back
+    // on starts counting from the energy total at that moment
+    if (credit_enabled() && !doc->enabled) {
+        s_pp.saved.spent_wh = consumed_wh(energy_counter_sum());
+        s_pp.saved.anchored = false;
+    }
+
+    int64_t added = doc->granted_wh - (s_pp.have_doc ? s_pp.saved.doc.granted_wh : 0);
+    s_pp.saved.doc = *doc;
+    s_pp.have_doc  = true;
+    s_pp.gen++;
+
+    evaluate(false);
+    LOG_INFO(TAG_PREPAID, "Credit seq %lu applied: %+lld Wh granted, balance %lld Wh (%s)",
+             (unsigned long)doc->seq, (long long)added, (long long)s_pp.balance_wh,
+             prepaid_state_to_string(s_pp.state));
+
+    xSemaphoreGive(s_mutex);
+    return ESP_OK;
+}
+
+void prepaid_update(void)
+{
+    // A busy mutex means the HTTP task is applying a document, which
+    // evaluates it itself; the next period catches up either way
+    if (!s_mutex || xSemaphoreTake(s_mutex, pdMS_TO_TICKS(100)) != pdTRUE) return;
+    if (s_pp.have_doc) evaluate(true);
+    xSemaphoreGive(s_mutex);
+}
+
+bool prepaid_get_status(prepaid_status_t *out)
+{
+    if (!s_mutex || xSemaphoreTake(s_mutex, pdMS_TO_TICKS(100)) != pdTRUE) return false;
+    out->state         = s_pp.state;
+    out->seq           = s_pp.have_doc ? s_pp.saved.doc.seq : 0;
+    out->balance_wh    = s_pp.balance_wh;
+    out->balance_milli = s_pp.balance_wh * (int64_t)s_pp.saved.doc.tariff_milli / 1000;
+    xSemaphoreGive(s_mutex);
+    return true;
+}
+
+uint32_t prepaid_seq(void)
+{
+    return s_pp.have_doc ? s_pp.saved.doc.seq : 0;
+}
+
+void prepaid_request_sync(void)
+{
+    s_sync_requested = true;
+}
+
+bool prepaid_take_sync_request(void)
+{
+    bool due = s_sync_requested;
+    s_sync_requested = false;
+    return due;
+}
+
+void prepaid_persist(void)
+{
+    if (!s_mutex || xSemaphoreTake(s_mutex, pdMS_TO_TICKS(100)) != pdTRUE) return;
+    bool           due = s_pp.have_doc && s_pp.gen != s_pp.saved_gen;
+    prepaid_blob_t b   = s_pp.saved;
+    uint32_t       gen = s_pp.gen;
+    xSemaphoreGive(s_mutex);
+
+    if (!due) return;
+
+    nvs_handle_t h;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &h) != ESP_OK) {
+        ESP_LOGE(TAG_PREPAID, "Credit persist: NVS open failed");
+        return;
+    }
+    b.crc = blob_crc(&b);
+    esp_err_t err = nvs_set_blob(h, PREPAID_NVS_KEY, &b, sizeof(b));
+    if (err == ESP_OK) err = nvs_commit(h);
+    nvs_close(h);
+
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG_PREPAID, "Credit persist failed: %s", esp_err_to_name(err));
+        return;
+    }
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    s_pp.saved_gen = gen;
+    xSemaphoreGive(s_mutex);
+    LOG_DEBUG(TAG_PREPAID, "Credit seq %lu saved", (unsigned long)b.doc.seq);
+}
+
+const char *prepaid_state_to_string(prepaid_state_t state)
+{
+    switch (state) {
+        case PREPAID_STATE_DISABLED:  return "disabled";
+        case PREPAID_STATE_OK:        return "ok";
+        case PREPAID_STATE_LOW:       return "low";
+        case PREPAID_STATE_CRITICAL:  return "critical";
+        case PREPAID_STATE_EXHAUSTED: return "exhausted";
+        default:                      return "unknown";
+    }
+}
@@ -0,0 +1,386 @@
+#include "pzem_emulator.h"
+#include "modbus_crc.h"
+#include "config.h"
+#include "logger.h"
+
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include <math.h>
+#include <string.h>
+
+#define EMU_GENERAL_ADDR    0xF8
+#define EMU_DEFAULT_ADDR    0x01     // factory slave address
+#define EMU_INPUT_REGS      10
+#define EMU_MAX_KWH_WH      10000000ULL  // energy register wraps at 9999.99 kWh
+#define EMU_DWMS_PER_WH     36000000ULL  // 0.1 W · ms per Wh
+
+#define EMU_EXC_ILLEGAL_FUNC    0x01
+#define EMU_EXC_ILLEGAL_ADDR    0x02
+#define EMU_EXC_ILLEGAL_DATA    0x03
+
+typedef struct {
+    uint8_t             addr;
+    pzem_emu_scenario_t scenario;
+    pzem_emu_faults_t   faults;
+    uint32_t            t0_ms;          // scenario start
+    uint32_t            last_ms;        // last energy integration
+    uint64_t            energy_dwms;    // accumulated energy, 0.1 W · ms
+    uint16_t            alarm_w;        // holding reg 0x0001
+    uint32_t            rng;
+} emu_meter_t;
+
+// One sample of the scripted electrical state
+typedef struct {
+    float v;
+    float i;
+    float pf;
+} emu_sample_t;
+
+static const uint8_t s_channel_addr[PZEM_CHANNEL_COUNT] = PZEM_CHANNEL_ADDRS;
+static emu_meter_t   s_meters[PZEM_CHANNEL_COUNT];
+static portMUX_TYPE  s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static uint32_t now_ms(void)
+{
+    return xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
+
+// xorshift32 — deterministic per meter so a run can be replayed
+static uint32_t emu_rand(emu_meter_t *m)
+{
+    uint32_t x = m->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return m->rng = x;
+}
+
+static bool emu_chance(emu_meter_t *m, uint8_t pct)
+{
+    return pct && (emu_rand(m) % 100) < pct;
+}
+
+// ±0.2 % measurement noise
+static float emu_noise(emu_meter_t *m, float x)
+{
+    return x * (1.0f + ((float)(emu_rand(m) % 401) - 200.0f) * 1e-5f);
+}
+
+// ── Load profiles ─────────────────────────────────────────────────────────────
+
+static emu_sample_t scenario_sample(pzem_emu_scenario_t sc, uint32_t t)
+{
+    emu_sample_t s = { .v = NOMINAL_VOLTAGE_V, .i = 4.6f, .pf = 1.0f };
+
+    switch (sc) {
+        case PZEM_EMU_APPLIANCE_CYCLE: {
+            // 1.2 A base at PF 0.9 plus an 8.7 A resistive heater 20 s on / 20 s off
+            float p = s.v * 1.2f * 0.9f;
+            float i = 1.2f;
+            if ((t / 20000) % 2 == 0) {
+                p += s.v * 8.7f;
+                i += 8.7f;
+            }
+            s.i  = i;
+            s.pf = p / (s.v * i);
+            break;
+        }
+        case PZEM_EMU_INRUSH: {
+            uint32_t c = t % 30000;
+            if (c < 300)        { s.i = 60.0f; s.pf = 0.3f; }
+            else if (c < 15000) { s.i = 8.0f;  s.pf = 0.8f; }
+            else                { s.i = 0.2f;  s.pf = 0.5f; }
+            break;
+        }
+        case PZEM_EMU_OVERLOAD: {
+            uint32_t r = t < 20000 ? t : 20000;
+            s.i  = 10.0f + 25.0f * (float)r / 20000.0f;
+            s.pf = 0.95f;
+            break;
+        }
+        case PZEM_EMU_SHORT_CIRCUIT:
+            if (t >= 10000) {
+                s.v  = 200.0f;   // supply sags under the fault current
+                s.i  = 80.0f;
+                s.pf = 0.2f;
+            }
+            break;
+        case PZEM_EMU_BROWNOUT: {
+            uint32_t c = t % 20000;
+            if (c >= 10000 && c < 15000)      s.v = 185.0f;
+            else if (c >= 15000 && c < 15500) { s.v = 0.0f; s.i = 0.0f; }
+            break;
+        }
+        case PZEM_EMU_THERMAL_RUNAWAY: {
+            float p = 1800.0f * powf(1.02f, (float)t / 1000.0f);
+            if (p > 6000.0f) p = 6000.0f;
+            s.pf = 0.98f;
+            s.i  = p / (s.v * s.pf);
+            break;
+        }
+        case PZEM_EMU_STEADY:
+        default:
+            break;
+    }
+    return s;
+}
+
+// Quantized meter measurement of one scripted sample
+typedef struct {
+    uint32_t v_dv;
+    uint32_t i_ma;
+    uint32_t p_dw;
+    uint32_t pf_pct;
+} emu_measure_t;
+
+static emu_measure_t emu_measure(emu_meter_t *m, const emu_sample_t *s)
+{
+    float v = emu_noise(m, s->v);
+    float i = emu_noise(m, s->i);
+    if (i > 100.0f) i = 100.0f;                   // PZEM-004T 100 A range
+    return (emu_measure_t){
+        .v_dv   = (uint32_t)(v * 10.0f + 0.5f),
+        .i_ma   = (uint32_t)(i * 1000.0f + 0.5f),
+        .p_dw   = (uint32_t)(v * i * s->pf * 10.0f + 0.5f),
+        .pf_pct = (uint32_t)(s->pf * 100.0f + 0.5f),
+    };
+}
+
+// The PZEM is powered from the measured side — no mains, no reply
+static bool emu_powered(const emu_sample_t *s)
+{
+    return s->v >= 80.0f;
+}
+
+// Fill the ten input registers for the meter's current state. Caller holds lock.
+static void meter_input_regs(emu_meter_t *m, uint16_t regs[EMU_INPUT_REGS], bool *powered)
+{
+    uint32_t      now  = now_ms();
+    emu_sample_t  s    = scenario_sample(m->scenario, now - m->t0_ms);
+    emu_measure_t meas = emu_measure(m, &s);
+
+    *powered = emu_powered(&s);
+
+    uint32_t v_dv   = meas.v_dv;
+    uint32_t i_ma   = meas.i_ma;
+    uint32_t p_dw   = meas.p_dw;
+    uint32_t pf_pct = meas.pf_pct;
+
+    m->energy_dwms += (uint64_t)p_dw * (now - m->last_ms);
+    m->last_ms      = now;
+    uint32_t e_wh   = (uint32_t)((m->energy_dwms / EMU_DWMS_PER_WH) % EMU_MAX_KWH_WH);
+
+    regs[0] = (uint16_t)v_dv;
+    regs[1] = (uint16_t)(i_ma & 0xFFFF);
+    regs[2] = (uint16_t)(i_ma >> 16);
+    regs[3] = (uint16_t)(p_dw & 0xFFFF);
+    regs[4] = (uint16_t)(p_dw >> 16);
+    regs[5] = (uint16_t)(e_wh & 0xFFFF);
+    regs[6] = (uint16_t)(e_wh >> 16);
+    regs[7] = (uint16_t)(NOMINAL_FREQUENCY_HZ * 10.0f) + (emu_rand(m) % 3) - 1;
+    regs[8] = (uint16_t)pf_pct;
+    regs[9] = (p_dw / 10 >= m->alarm_w) ? 0xFFFF : 0x0000;
+}
+
+// ── Protocol ──────────────────────────────────────────────────────────────────
+
+static size_t reply_exception(uint8_t *resp, uint8_t addr, uint8_t func, uint8_t code)
+{
+    resp[0] = addr;
+    resp[1] = func | 0x80;
+    resp[2] = code;
+    return modbus_crc16_append(resp, 3);
+}
+
+static size_t put_regs(uint8_t *resp, uint8_t addr, uint8_t func,
+                       const uint16_t *regs, uint16_t count)
+{
+    resp[0] = addr;
+    resp[1] = func;
+    resp[2] = (uint8_t)(count * 2);
+    for (uint16_t r = 0; r < count; r++) {
+        resp[3 + 2 * r] = (uint8_t)(regs[r] >> 8);
+        resp[4 + 2 * r] = (uint8_t)(regs[r] & 0xFF);
+    }
+    return modbus_crc16_append(resp, 3 + (size_t)count * 2);
+}
+
+// Build one meter's reply (before fault injection). Caller holds lock.
+static size_t meter_handle(emu_meter_t *m, const uint8_t *req, size_t req_len,
+                           uint8_t *resp, bool *powered)
+{
+    uint8_t  addr  = req[0];
+    uint8_t  func  = req[1];
+    uint16_t regs[EMU_INPUT_REGS];
+
+    // Power state and energy integration advance on every request
+    meter_input_regs(m, regs, powered);
+
+    switch (func) {
+        case 0x04: {
+            if (req_len != 8) return 0;
+            uint16_t start = (uint16_t)(req[2] << 8 | req[3]);
+            uint16_t count = (uint16_t)(req[4] << 8 | req[5]);
+            if (count == 0 || start + count > EMU_INPUT_REGS) {
+                return reply_exception(resp, addr, func, EMU_EXC_ILLEGAL_ADDR);
+            }
+            return put_regs(resp, addr, func, &regs[start], count);
+        }
+        case 0x03: {
+            if (req_len != 8) return 0;
+            uint16_t start = (uint16_t)(req[2] << 8 | req[3]);
+            uint16_t count = (uint16_t)(req[4] << 8 | req[5]);
+            uint16_t hold[3] = { 0, m->alarm_w, m->addr };
+            if (count == 0 || start < 1 || start + count > 3) {
+                return reply_exception(resp, addr, func, EMU_EXC_ILLEGAL_ADDR);
+            }
+            return put_regs(resp, addr, func, &hold[start], count);
+        }
+        case 0x06: {
+            if (req_len != 8) return 0;
+            uint16_t reg = (uint16_t)(req[2] << 8 | req[3]);
+            uint16_t val = (uint16_t)(req[4] << 8 | req[5]);
+            if (reg == 0x0001) {
+                m->alarm_w = val;
+            } else if (reg == 0x0002) {
+                if (val < 0x01 || val > 0xF7) {
+                    return reply_exception(resp, addr, func, EMU_EXC_ILLEGAL_DATA);
+                }
+                m->addr = (uint8_t)val;     // takes effect after this reply
+            } else {
+                return reply_exception(resp, addr, func, EMU_EXC_ILLEGAL_ADDR);
+            }
+            memcpy(resp, req, 8);           // echo
+            return 8;
+        }
+        case 0x42:
+            if (req_len != 4) return 0;
+            m->energy_dwms = 0;
+            memcpy(resp, req, 4);
+            return 4;
+        default:
+            return reply_exception(resp, addr, func, EMU_EXC_ILLEGAL_FUNC);
+    }
+}
+
+// ── Public API ────────────────────────────────────────────────────────────────
+
+void pzem_emulator_init(void)
+{
+    uint32_t now = now_ms();
+
+    portENTER_CRITICAL(&s_lock);
+    for (size_t ch = 0; ch < PZEM_CHANNEL_COUNT; ch++) {
+        emu_meter_t *m = &s_meters[ch];
+        memset(m, 0, sizeof(*m));
+        // A meter configured as 0xF8 still has a real slave address
+        m->addr     = s_channel_addr[ch] == EMU_GENERAL_ADDR ? EMU_DEFAULT_ADDR : s_channel_addr[ch];
+        m->scenario = (pzem_emu_scenario_t)PZEM_EMULATOR_SCENARIO;
+        m->t0_ms    = now;
+        m->last_ms  = now;
+        m->alarm_w  = 23000;
+        m->rng      = 0x9E3779B9u ^ (uint32_t)(ch + 1);
+        m->faults.silent_pct = PZEM_EMULATOR_SILENT_PCT;
+        m->faults.garble_pct = PZEM_EMULATOR_GARBLE_PCT;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    ESP_LOGW(TAG_PZEM, "PZEM EMULATOR ACTIVE — %d emulated meter(s), scenario %d, UART unused",
+             PZEM_CHANNEL_COUNT, PZEM_EMULATOR_SCENARIO);
+}
+
+void pzem_emulator_set_scenario(uint8_t channel, pzem_emu_scenario_t scenario)
+{
+    if (channel >= PZEM_CHANNEL_COUNT || scenario >= PZEM_EMU_SCENARIO_COUNT) return;
+
+    portENTER_CRITICAL(&s_lock);
+    s_meters[channel].scenario = scenario;
+    s_meters[channel].t0_ms    = now_ms();
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void pzem_emulator_set_faults(uint8_t channel, const pzem_emu_faults_t *faults)
+{
+    if (channel >= PZEM_CHANNEL_COUNT) return;
+
+    portENTER_CRITICAL(&s_lock);
+    if (faults) {
+        s_meters[channel].faults = *faults;
+    } else {
+        memset(&s_meters[channel].faults, 0, sizeof(s_meters[channel].faults));
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+size_t pzem_emulator_respond(const uint8_t *req, size_t req_len,
+                             uint8_t *resp, size_t resp_cap, uint32_t *delay_ms)
+{
+    *delay_ms = 0;
+    // A meter ignores anything it cannot parse or that fails CRC
+    if (!req || req_len < 4 || resp_cap < 25 || !modbus_crc16_frame_ok(req, req_len)) return 0;
+
+    size_t   n         = 0;
+    int      answering = 0;
+    uint32_t extra_ms  = 0;
+
+    portENTER_CRITICAL(&s_lock);
+    for (size_t ch = 0; ch < PZEM_CHANNEL_COUNT; ch++) {
+        emu_meter_t *m = &s_meters[ch];
+        if (req[0] != m->addr && req[0] != EMU_GENERAL_ADDR) continue;
+
+        uint8_t buf[25];
+        bool    powered = true;
+        size_t  len     = meter_handle(m, req, req_len, buf, &powered);
+        if (!powered || len == 0 || emu_chance(m, m->faults.silent_pct)) continue;
+
+        if (emu_chance(m, m->faults.truncate_pct)) {
+            len = len / 2;
+        }
+        if (emu_chance(m, m->faults.garble_pct)) {
+            buf[emu_rand(m) % len] ^= (uint8_t)(1u << (emu_rand(m) % 8));
+        }
+        extra_ms = m->faults.extra_delay_ms;
+        if (m->faults.jitter_ms) extra_ms += emu_rand(m) % (m->faults.jitter_ms + 1u);
+
+        memcpy(resp, buf, len);
+        n = len;
+        answering++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (answering > 1) {
+        // Several meters answered the general address at once: the frames
+        // collide on the wire and the master sees garbage.
+        resp[n / 2] ^= 0x5A;
+    }
+
+    // Turnaround + request and reply on the wire (10 bits per byte)
+    *delay_ms = PZEM_EMULATOR_TURNAROUND_MS + extra_ms +
+                (uint32_t)((req_len + n) * 10u * 1000u / PZEM_BAUD_RATE);
+    return n;
+}
+
+bool pzem_emulator_synth(pzem_emu_scenario_t scenario, uint32_t t_ms, uint16_t alarm_w,
+                         uint32_t *rng, pzem_data_t *out)
+{
+    emu_meter_t  m = { .rng = *rng ? *rng : 0x9E3779B9u };
+    emu_sample_t s = scenario_sample(scenario, t_ms);
+    if (!emu_powered(&s)) return false;
+
+    emu_measure_t meas = emu_measure(&m, &s);
+    *rng = m.rng;
+
+    memset(out, 0, sizeof(*out));
+    out->v_dv         = (uint16_t)meas.v_dv;
+    out->i_ma         = meas.i_ma;
+    out->power_dw     = meas.p_dw;
+    out->apparent_dva = (uint32_t)((uint64_t)meas.v_dv * meas.i_ma / 1000);
+    out->pf_pct       = (uint8_t)meas.pf_pct;
+    out->freq_dhz     = (uint16_t)(NOMINAL_FREQUENCY_HZ * 10.0f);
+    out->power_alarm  = meas.p_dw / 10 >= alarm_w;
+    out->timestamp    = t_ms;
+    out->valid        = true;
+    return true;
+}
@@ -1,52 +1,350 @@
 #include "pzem_sensor.h"
+#include "modbus_crc.h"
+#include "modbus_rtu.h"
+#include "meter_model.h"
+#include "energy_counter.h"
 #include "config.h"
 #include "logger.h"
 
-#include "driver/uart.h"
-#include "driver/gpio.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
 
 #include <string.h>
-#include <math.h>
 
-// Cached last successful reading (thread-safe via mutex)
-static pzem_data_t       s_last_reading = {.valid = false};
+_Static_assert(PZEM_CHANNEL_COUNT >= 1 && PZEM_CHANNEL_COUNT <= PZEM_MAX_CHANNELS,
+               "PZEM_CHANNEL_COUNT must be 1..PZEM_MAX_CHANNELS");
+_Static_assert(PZEM_DISCOVERY_SLICE_MS >= 4 * PZEM_PROBE_TIMEOUT_MS,
+               "a discovery slice must fit one channel's four address candidates");
+
+// Cached last successful reading per channel (thread-safe via mutex)
+static pzem_data_t       s_last_reading[PZEM_CHANNEL_COUNT];
 static SemaphoreHandle_t s_last_mutex   = NULL;
-static uint8_t           s_pzem_addr    = PZEM_DEVICE_ADDR;
+static uint8_t           s_channel_addr[PZEM_CHANNEL_COUNT] = PZEM_CHANNEL_ADDRS;
+static const uint8_t     s_config_addr[PZEM_CHANNEL_COUNT]  = PZEM_CHANNEL_ADDRS;
+static uint8_t           s_fail_count[PZEM_CHANNEL_COUNT];  // consecutive full-read failures
+static volatile bool     s_discovery_pending = true;         // first pass runs at task start
+
+// Over-power alarm threshold programmed into meters that have one
+static volatile uint16_t s_alarm_w            = (uint16_t)MAX_POWER_W;
+static volatile bool     s_alarm_sync_pending = true;
+static int64_t           s_alarm_retry_us;                   // next attempt after a failure
+
+// Register layout per channel, resolved once in pzem_sensor_init
+static const meter_model_id_t s_config_model[PZEM_CHANNEL_COUNT] = PZEM_CHANNEL_MODELS;
+static const uint8_t          s_channel_phase[PZEM_CHANNEL_COUNT] = PZEM_CHANNEL_PHASES;
+static const meter_model_t   *s_channel_model[PZEM_CHANNEL_COUNT];
 
 // Modbus RTU constants
-#define PZEM_FUNC_READ_INPUT    0x04
-#define PZEM_REG_START          0x0000
-#define PZEM_REG_COUNT          0x000A  // 10 registers
-#define PZEM_RESPONSE_LEN       25      // addr + func + bytecount + 20 data + 2 CRC
-#define PZEM_RESET_FUNC         0x42
 #define PZEM_RESET_LEN          4       // request + CRC
+#define PZEM_WRITE_LEN          8       // write-single-register request / echo
 
-// Probe order for modules that may respond on different default addresses.
+// Extra candidates for a lone meter, which may sit on either default address.
+// Never probed on a shared bus: 0xF8 would make every meter answer at once.
 #define PZEM_ADDR_FALLBACK_1    0xF8
 #define PZEM_ADDR_FALLBACK_2    0x01
+#define PZEM_SCAN_FIRST         0x01
+#define PZEM_SCAN_LAST          0xF7
+#define PZEM_REGISTRY_KEY       "meter_map"
+
+static esp_err_t pzem_read_regs(uint8_t addr, uint8_t func, uint16_t start, uint16_t count,
+                                uint8_t *response, size_t resp_len,
+                                int attempts, int64_t deadline_us);
+static esp_err_t pzem_sensor_read_with_addr(uint8_t addr, pzem_data_t *out, int64_t deadline_us);
+static esp_err_t pzem_reset_energy_with_addr(uint8_t addr, uint8_t func, int64_t deadline_us);
+static esp_err_t pzem_write_reg(uint8_t addr, uint16_t reg, uint16_t value, int64_t deadline_us);
+
+static int64_t deadline_after_ms(uint32_t ms)
+{
+    return esp_timer_get_time() + (int64_t)ms * 1000;
+}
+
+// Timeout for the next attempt: the slave's learned RTO, clipped to what is
+// left of the budget. Returns 0 when the budget cannot fit another attempt.
+static uint32_t attempt_timeout_ms(uint8_t addr, int64_t deadline_us)
+{
+    int64_t remaining_ms = (deadline_us - esp_timer_get_time()) / 1000;
+    if (remaining_ms < MODBUS_TIMEOUT_MIN_MS) return 0;
+
+    uint32_t rto = modbus_rtu_timeout_ms(addr);
+    return (int64_t)rto < remaining_ms ? rto : (uint32_t)remaining_ms;
+}
+
+// ── Address registry (NVS) ────────────────────────────────────────────────────
+
+typedef struct {
+    uint8_t count;                      // PZEM_CHANNEL_COUNT when written
+    uint8_t addr[PZEM_MAX_CHANNELS];
+} pzem_registry_t;
+
+static bool registry_load(uint8_t *addrs)
+{
+    nvs_handle_t    h;
+    pzem_registry_t reg;
+    size_t          len = sizeof(reg);
+    bool            ok  = false;
+
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &h) != ESP_OK) return false;
+    if (nvs_get_blob(h, PZEM_REGISTRY_KEY, &reg, &len) == ESP_OK &&
+        len == sizeof(reg) && reg.count == PZEM_CHANNEL_COUNT) {
+        memcpy(addrs, reg.addr, PZEM_CHANNEL_COUNT);
+        ok = true;
+    }
+    nvs_close(h);
+    return ok;
+}
+
+static void registry_save(const uint8_t *addrs)
+{
+    nvs_handle_t    h;
+    pzem_registry_t reg = { .count = PZEM_CHANNEL_COUNT };
+    memcpy(reg.addr, addrs, PZEM_CHANNEL_COUNT);
+
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &h) != ESP_OK) {
+        ESP_LOGW(TAG_PZEM, "Meter registry: NVS open failed");
+        return;
+    }
+    if (nvs_set_blob(h, PZEM_REGISTRY_KEY, &reg, sizeof(reg)) != ESP_OK || nvs_commit(h) != ESP_OK) {
+        ESP_LOGW(TAG_PZEM, "Meter registry: save failed");
+    }
+    nvs_close(h);
+}
+
+// ── Discovery ─────────────────────────────────────────────────────────────────
+
+// One-register read with a fixed short timeout. Link state of an address
+// that does not answer is released so a scan leaves no trace.
+static bool probe_addr(uint8_t addr, const meter_model_t *m)
+{
+    uint8_t request[8] = { addr, m->func, m->start >> 8, m->start & 0xFF, 0, 1 };
+    uint8_t response[7];
+    size_t  received = 0;
+    modbus_crc16_append(request, 6);
+
+    esp_err_t err = modbus_rtu_transact(request, sizeof(request), response, sizeof(response),
+                                        sizeof(response), PZEM_PROBE_TIMEOUT_MS, &received);
+    if (err == ESP_OK && response[0] == addr && response[1] == m->func) return true;
+
+    modbus_rtu_forget(addr);
+    return false;
+}
+
+static bool addr_taken(const uint8_t *addrs, const bool *resolved, uint8_t addr)
+{
+    for (uint8_t ch = 0; ch < PZEM_CHANNEL_COUNT; ch++) {
+        if (resolved[ch] && addrs[ch] == addr) return true;
+    }
+    return false;
+}
+
+// A pass spans as many read cycles as it needs: each pzem_sensor_discover()
+// call spends one slice and leaves a cursor here. Read task only.
+typedef enum {
+    DISC_IDLE = 0,
+    DISC_VERIFY,            // known addresses, one channel at a time
+    DISC_SCAN,              // 0x01–0xF7 for channels still missing
+} disc_phase_t;
+
+static struct {
+    disc_phase_t phase;
+    uint8_t      addrs[PZEM_CHANNEL_COUNT];
+    bool         resolved[PZEM_CHANNEL_COUNT];
+    uint8_t      missing;
+    uint8_t      verify_ch;
+    uint16_t     scan_addr;
+    uint16_t     slices;
+    int64_t      start_us;
+} s_disc;
+
+// Try the known candidates of one channel. Returns false if the slice ran
+// out first (the channel is retried from scratch next slice).
+static bool disc_verify_channel(uint8_t ch, int64_t deadline_us)
+{
+    uint8_t cand[4] = { s_channel_addr[ch], s_config_addr[ch] };
+    size_t  n       = 2;
+    if (PZEM_CHANNEL_COUNT == 1) {
+        cand[n++] = PZEM_ADDR_FALLBACK_1;
+        cand[n++] = PZEM_ADDR_FALLBACK_2;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (i > 0 && memchr(cand, cand[i], i)) continue;   // already tried
+        if (addr_taken(s_disc.addrs, s_disc.resolved, cand[i])) continue;
+        if (esp_timer_get_time() >= deadline_us) return false;
+        if (probe_addr(cand[i], s_channel_model[ch])) {
+            s_disc.addrs[ch]    = cand[i];
+            s_disc.resolved[ch] = true;
+            return true;
+        }
+    }
+    s_disc.missing++;
+    return true;
+}
+
+// Probe one address with the register layout of every model that still
+// has a channel missing; a reply goes to the first such channel.
+static void disc_scan_addr(uint8_t addr)
+{
+    const meter_model_t *tried[PZEM_CHANNEL_COUNT] = { NULL };
+    size_t n_tried = 0;
+
+    for (uint8_t ch = 0; ch < PZEM_CHANNEL_COUNT; ch++) {
+        if (s_disc.resolved[ch]) continue;
+
+        const meter_model_t *m = s_channel_model[ch];
+        bool seen = false;
+        for (size_t i = 0; i < n_tried; i++) seen |= tried[i] == m;
+        if (seen) continue;         // an earlier channel of this model got no answer here
+        tried[n_tried++] = m;
+
+        if (probe_addr(addr, m)) {
+            ESP_LOGI(TAG_PZEM, "Discovery: meter at 0x%02X assigned to CH%u", addr, ch);
+            s_disc.addrs[ch]    = addr;
+            s_disc.resolved[ch] = true;
+            s_disc.missing--;
+            return;                 // one meter per address
+        }
+    }
+}
+
+static void disc_finish(void)
+{
+    const uint8_t *addrs   = s_disc.addrs;
+    bool           changed = memcmp(addrs, s_channel_addr, sizeof(s_channel_addr)) != 0;
+
+    memcpy(s_channel_addr, addrs, sizeof(s_channel_addr));
+    for (uint8_t ch = 0; ch < PZEM_CHANNEL_COUNT; ch++) {
+        if (s_disc.resolved[ch]) {
+            s_fail_count[ch] = 0;
+        } else {
+            ESP_LOGE(TAG_PZEM, "Discovery: CH%u not found — keeping 0x%02X", ch, addrs[ch]);
+        }
+    }
+    if (changed && s_disc.missing == 0) registry_save(addrs);
+    s_alarm_sync_pending = true;   // a replaced meter comes up with its own threshold
+    s_alarm_retry_us     = 0;
+
+    ESP_LOGI(TAG_PZEM, "Discovery done in %lld ms (%u slice%s): %u/%d channel(s) found%s",
+             (long long)((esp_timer_get_time() - s_disc.start_us) / 1000),
+             s_disc.slices, s_disc.slices == 1 ? "" : "s",
+             (unsigned)(PZEM_CHANNEL_COUNT - s_disc.missing), PZEM_CHANNEL_COUNT,
+             changed ? ", registry updated" : "");
+    s_disc.phase = DISC_IDLE;
+}
+
+esp_err_t pzem_sensor_discover(uint32_t budget_ms)
+{
+    int64_t deadline_us = deadline_after_ms(budget_ms);
+
+    if (s_disc.phase == DISC_IDLE) {
+        // A request made while a pass runs is served by that pass
+        s_discovery_pending = false;
+        memset(&s_disc, 0, sizeof(s_disc));
+        memcpy(s_disc.addrs, s_channel_addr, sizeof(s_disc.addrs));
+        s_disc.phase     = DISC_VERIFY;
+        s_disc.scan_addr = PZEM_SCAN_FIRST;
+        s_disc.start_us  = esp_timer_get_time();
+    }
+    s_disc.slices++;
+
+    // 1. Known addresses: registry/current first, then the configured one
+    while (s_disc.phase == DISC_VERIFY) {
+        if (s_disc.verify_ch == PZEM_CHANNEL_COUNT) {
+            s_disc.phase = DISC_SCAN;
+            break;
+        }
+        if (!disc_verify_channel(s_disc.verify_ch, deadline_us)) return ESP_ERR_TIMEOUT;
+        s_disc.verify_ch++;
+    }
+
+    // 2. Scan the bus for whatever is still missing, resuming where the
+    //    previous slice stopped
+    while (s_disc.missing && s_disc.scan_addr <= PZEM_SCAN_LAST) {
+        if (esp_timer_get_time() >= deadline_us) return ESP_ERR_TIMEOUT;
+        uint8_t a = (uint8_t)s_disc.scan_addr++;
+        if (!addr_taken(s_disc.addrs, s_disc.resolved, a)) disc_scan_addr(a);
+    }
+
+    bool found_all = s_disc.missing == 0;
+    disc_finish();
+    return found_all ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
 
-static esp_err_t pzem_sensor_read_with_addr(uint8_t addr, pzem_data_t *out);
-static esp_err_t pzem_reset_energy_with_addr(uint8_t addr);
+void pzem_sensor_request_discovery(void)
+{
+    s_discovery_pending = true;
+}
 
-// CRC16 Modbus (polynomial 0xA001)
-static uint16_t crc16(const uint8_t *data, uint16_t len)
+bool pzem_sensor_discovery_pending(void)
 {
-    uint16_t crc = 0xFFFF;
-    for (uint16_t i = 0; i < len; i++) {
-        crc ^= data[i];
-        for (uint8_t j = 0; j < 8; j++) {
-            if (crc & 0x0001) {
-                crc = (crc >> 1) ^ 0xA001;
-            } else {
-                crc >>= 1;
+    return s_discovery_pending || s_disc.phase != DISC_IDLE;
+}
+
+// ── Power alarm ───────────────────────────────────────────────────────────────
+
+void pzem_sensor_set_power_alarm(uint32_t watts)
+{
+    uint16_t w = watts > UINT16_MAX ? UINT16_MAX : (uint16_t)watts;
+    if (w == s_alarm_w && !s_alarm_sync_pending) return;
+    s_alarm_w            = w;
+    s_alarm_retry_us     = 0;
+    s_alarm_sync_pending = true;
+}
+
+bool pzem_sensor_alarm_sync_pending(void)
+{
+    return s_alarm_sync_pending && esp_timer_get_time() >= s_alarm_retry_us;
+}
+
+esp_err_t pzem_sensor_sync_power_alarm(void)
+{
+    uint16_t  target = s_alarm_w;
+    esp_err_t result = ESP_OK;
+
+    s_alarm_sync_pending = false;
+
+    for (uint8_t ch = 0; ch < PZEM_CHANNEL_COUNT; ch++) {
+        const meter_model_t *m    = s_channel_model[ch];
+        uint8_t              addr = s_channel_addr[ch];
+        if (m->alarm_reg == 0) continue;
+
+        // Three-phase meters share one address across channels
+        bool done = false;
+        for (uint8_t prev = 0; prev < ch; prev++) {
+            if (s_channel_addr[prev] == addr) done = true;
+        }
+        if (done) continue;
+
+        int64_t   deadline_us = deadline_after_ms(PZEM_READ_BUDGET_MS);
+        uint8_t   response[7];   // 1 register
+        esp_err_t err = pzem_write_reg(addr, m->alarm_reg, target, deadline_us);
+        if (err == ESP_OK) {
+            err = pzem_read_regs(addr, 0x03, m->alarm_reg, 1, response, sizeof(response),
+                                 2, deadline_us);
+        }
+        if (err == ESP_OK) {
+            uint16_t got = (uint16_t)response[3] << 8 | response[4];
+            if (got != target) {
+                ESP_LOGW(TAG_PZEM, "CH%u power alarm read back %u W, wrote %u W", ch, got, target);
+                err = ESP_ERR_INVALID_RESPONSE;
             }
         }
+
+        if (err == ESP_OK) {
+            ESP_LOGI(TAG_PZEM, "CH%u power alarm set to %u W (addr=0x%02X)", ch, target, addr);
+        } else {
+            ESP_LOGW(TAG_PZEM, "CH%u power alarm sync failed: %s", ch, esp_err_to_name(err));
+            result = err;
+        }
+    }
+
+    if (result != ESP_OK) {
+        s_alarm_retry_us     = deadline_after_ms(POWER_ALARM_RETRY_MS);
+        s_alarm_sync_pending = true;
     }
-    return crc;
+    return result;
 }
 
 esp_err_t pzem_sensor_init(void)
@@ -57,213 +355,231 @@ esp_err_t pzem_sensor_init(void)
         return ESP_ERR_NO_MEM;
     }
 
-    uart_config_t uart_cfg = {
-        .baud_rate  = PZEM_BAUD_RATE,
-        .data_bits  = UART_DATA_8_BITS,
-        .parity     = UART_PARITY_DISABLE,
-        .stop_bits  = UART_STOP_BITS_1,
-        .flow_ctrl  = UART_HW_FLOWCTRL_DISABLE,
-        .source_clk = UART_SCLK_DEFAULT,
-    };
-
-    esp_err_t err = uart_driver_install(PZEM_UART_NUM, PZEM_UART_BUF_SIZE * 2,
-                                        PZEM_UART_BUF_SIZE * 2, 0, NULL, 0);
+    esp_err_t err = modbus_rtu_init();
     if (err != ESP_OK) {
-        ESP_LOGE(TAG_PZEM, "UART driver install failed: %s", esp_err_to_name(err));
         return err;
     }
 
-    err = uart_param_config(PZEM_UART_NUM, &uart_cfg);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG_PZEM, "UART param config failed: %s", esp_err_to_name(err));
-        return err;
+    for (uint8_t ch = 0; ch < PZEM_CHANNEL_COUNT; ch++) {
+        s_channel_model[ch] = meter_model_get(s_config_model[ch]);
+        if (!s_channel_model[ch] || s_channel_phase[ch] >= s_channel_model[ch]->phases) {
+            ESP_LOGE(TAG_PZEM, "CH%u: invalid meter model %d / phase %u",
+                     ch, (int)s_config_model[ch], s_channel_phase[ch]);
+            return ESP_ERR_INVALID_ARG;
+        }
+        s_channel_addr[ch]         = s_config_addr[ch];
+        s_fail_count[ch]           = 0;
+        s_last_reading[ch].valid   = false;
+        s_last_reading[ch].channel = ch;
     }
-
-    // Physical wiring in this project is RX->RX and TX->TX.
-    // We map UART pins so ESP TX still drives the PZEM RX path and vice versa.
-    err = uart_set_pin(PZEM_UART_NUM, PZEM_TX_PIN, PZEM_RX_PIN,
-                       UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG_PZEM, "UART set pins failed: %s", esp_err_to_name(err));
-        return err;
+    if (registry_load(s_channel_addr)) {
+        ESP_LOGI(TAG_PZEM, "Meter addresses restored from registry");
     }
 
-    // The PZEM-004T RX optocoupler is biased from 5V — a push-pull 3.3V HIGH
-    // lets ~0.5 mA leak through the optocoupler LED, garbling every byte.
-    // Open-drain + internal 45 kΩ pull-up to 3.3V limits HIGH-state current
-    // to ~10 µA (well below activation threshold), so the optocoupler fully
-    // turns off between bits — no external resistor required.
-    // gpio_set_direction only changes the pad drive mode; it does NOT disturb
-    // the GPIO-matrix routing that uart_set_pin configured.
-    gpio_set_direction(PZEM_TX_PIN, GPIO_MODE_OUTPUT_OD);
-    gpio_pullup_en(PZEM_TX_PIN);
-
-    s_pzem_addr = PZEM_DEVICE_ADDR;
-    ESP_LOGI(TAG_PZEM, "PZEM initialized on UART%d (TX=GPIO%d RX=GPIO%d, addr=0x%02X)",
-             PZEM_UART_NUM, PZEM_TX_PIN, PZEM_RX_PIN, s_pzem_addr);
+    ESP_LOGI(TAG_PZEM, "PZEM initialized on UART%d (TX=GPIO%d RX=GPIO%d, %d channel%s, addr=0x%02X)",
+             PZEM_UART_NUM, PZEM_TX_PIN, PZEM_RX_PIN, PZEM_CHANNEL_COUNT,
+             PZEM_CHANNEL_COUNT == 1 ? "" : "s", s_channel_addr[0]);
+    for (uint8_t ch = 0; ch < PZEM_CHANNEL_COUNT; ch++) {
+        ESP_LOGI(TAG_PZEM, "  CH%u: %s addr=0x%02X phase L%u",
+                 ch, s_channel_model[ch]->name, s_channel_addr[ch], s_channel_phase[ch] + 1);
+    }
     return ESP_OK;
 }
 
 esp_err_t pzem_sensor_read(pzem_data_t *out)
 {
-    if (!out) return ESP_ERR_INVALID_ARG;
-    out->valid = false;
-
-    const uint8_t probe_addrs[] = {s_pzem_addr, PZEM_ADDR_FALLBACK_1, PZEM_ADDR_FALLBACK_2};
-    esp_err_t last_err = ESP_FAIL;
+    return pzem_sensor_read_channel(0, out);
+}
 
-    for (size_t i = 0; i < sizeof(probe_addrs); i++) {
-        uint8_t addr = probe_addrs[i];
-        bool duplicate = false;
+esp_err_t pzem_sensor_read_channel(uint8_t channel, pzem_data_t *out)
+{
+    if (!out || channel >= PZEM_CHANNEL_COUNT) return ESP_ERR_INVALID_ARG;
+    out->valid   = false;
+    out->channel = channel;
 
-        for (size_t j = 0; j < i; j++) {
-            if (probe_addrs[j] == addr) {
-                duplicate = true;
-                break;
-            }
+    esp_err_t err = pzem_sensor_read_with_addr(s_channel_addr[channel], out,
+                                               deadline_after_ms(PZEM_READ_BUDGET_MS));
+    if (err != ESP_OK) {
+        // A meter that stays silent has likely been re-addressed or swapped:
+        // hand it to discovery instead of probing from the read path.
+        if (++s_fail_count[channel] == PZEM_REDISCOVER_AFTER_FAILS) {
+            ESP_LOGW(TAG_PZEM, "CH%u failed %d reads in a row — scheduling discovery",
+                     channel, PZEM_REDISCOVER_AFTER_FAILS);
+            s_discovery_pending = true;
         }
-        if (duplicate) continue;
+        return err;
+    }
+    s_fail_count[channel] = 0;
 
-        esp_err_t err = pzem_sensor_read_with_addr(addr, out);
-        if (err == ESP_OK) {
-            if (s_pzem_addr != addr) {
-                ESP_LOGI(TAG_PZEM, "PZEM address detected: 0x%02X (previous 0x%02X)",
-                         addr, s_pzem_addr);
-            }
-            s_pzem_addr = addr;
-            return ESP_OK;
-        }
+    out->energy_wh = energy_counter_update(channel, out->meter_wh);
 
-        last_err = err;
+    // Cache for web dashboard
+    if (s_last_mutex && xSemaphoreTake(s_last_mutex, pdMS_TO_TICKS(10)) == pdTRUE) {
+        s_last_reading[channel] = *out;
+        xSemaphoreGive(s_last_mutex);
     }
+    return ESP_OK;
+}
 
-    return last_err;
+esp_err_t pzem_sensor_read_current(uint8_t channel, pzem_data_t *out)
+{
+    if (!out || channel >= PZEM_CHANNEL_COUNT) return ESP_ERR_INVALID_ARG;
+    out->valid   = false;
+    out->channel = channel;
+
+    // Single attempt, short timeout: the next fast poll is only
+    // PZEM_FAST_POLL_INTERVAL_MS away, so retrying would only add latency.
+    const meter_model_t *m     = s_channel_model[channel];
+    uint8_t              phase = s_channel_phase[channel];
+    uint16_t             start, count;
+    meter_fast_regs(m, phase, PZEM_FAST_POLL_VOLTAGE, &start, &count);
+    if (count > METER_FAST_MAX_REGS) return ESP_ERR_INVALID_SIZE;
+
+    uint8_t   response[METER_FAST_MAX_RESP_LEN];
+    esp_err_t err = pzem_read_regs(s_channel_addr[channel], m->func, start, count,
+                                   response, 5u + 2u * count,
+                                   1, deadline_after_ms(PZEM_FAST_READ_TIMEOUT_MS));
+    if (err != ESP_OK) return err;
+
+    memset(out, 0, sizeof(*out));
+    meter_decode_fast(m, phase, PZEM_FAST_POLL_VOLTAGE, &response[3], out);
+    out->timestamp    = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    out->channel      = channel;
+    out->current_only = true;
+    out->valid        = true;
+    return ESP_OK;
+}
+
+uint8_t pzem_sensor_channel_count(void)
+{
+    return PZEM_CHANNEL_COUNT;
 }
 
-static esp_err_t pzem_sensor_read_with_addr(uint8_t addr, pzem_data_t *out)
+uint8_t pzem_sensor_channel_addr(uint8_t channel)
 {
-    // Build Modbus RTU read-input-registers request
+    return channel < PZEM_CHANNEL_COUNT ? s_channel_addr[channel] : 0;
+}
+
+// Read `count` registers (function 0x03 or 0x04) starting at `start` into
+// response (3 + 2*count + 2 bytes), retrying up to `attempts` times while
+// the budget (deadline_us, esp_timer time) still fits another attempt.
+static esp_err_t pzem_read_regs(uint8_t addr, uint8_t func, uint16_t start, uint16_t count,
+                                uint8_t *response, size_t resp_len,
+                                int attempts, int64_t deadline_us)
+{
+    // Build Modbus RTU read-registers request
     uint8_t request[8];
     request[0] = addr;
-    request[1] = PZEM_FUNC_READ_INPUT;
-    request[2] = (PZEM_REG_START >> 8) & 0xFF;
-    request[3] = PZEM_REG_START & 0xFF;
-    request[4] = (PZEM_REG_COUNT >> 8) & 0xFF;
-    request[5] = PZEM_REG_COUNT & 0xFF;
-    uint16_t crc = crc16(request, 6);
-    request[6] = crc & 0xFF;          // CRC LSB first (Modbus)
-    request[7] = (crc >> 8) & 0xFF;
-
-    uint8_t response[PZEM_RESPONSE_LEN];
-    esp_err_t last_err = ESP_FAIL;
+    request[1] = func;
+    request[2] = (start >> 8) & 0xFF;
+    request[3] = start & 0xFF;
+    request[4] = (count >> 8) & 0xFF;
+    request[5] = count & 0xFF;
+    modbus_crc16_append(request, 6);
 
-    // 3-attempt retry loop — standard Modbus RTU practice
-    for (int attempt = 0; attempt < 3; attempt++) {
+    esp_err_t last_err = ESP_ERR_TIMEOUT;
+
+    for (int attempt = 0; attempt < attempts; attempt++) {
         if (attempt > 0) {
-            vTaskDelay(pdMS_TO_TICKS(100));  // brief recovery gap before retry
+            vTaskDelay(pdMS_TO_TICKS(MODBUS_RETRY_GAP_MS));  // brief recovery gap before retry
         }
 
-        // Clear only the RX buffer (uart_flush_input, not the deprecated uart_flush
-        // which also clears TX and can cancel bytes still in the FIFO)
-        uart_flush_input(PZEM_UART_NUM);
+        uint32_t timeout_ms = attempt_timeout_ms(addr, deadline_us);
+        if (timeout_ms == 0) {
+            LOG_DEBUG(TAG_PZEM, "Read budget spent for 0x%02X after %d attempt(s)", addr, attempt);
+            break;
+        }
 
-        int written = uart_write_bytes(PZEM_UART_NUM, (const char *)request, sizeof(request));
-        if (written != (int)sizeof(request)) {
-            ESP_LOGW(TAG_PZEM, "UART write incomplete for 0x%02X (%d/%d) attempt %d",
-                     addr, written, (int)sizeof(request), attempt + 1);
+        // The transport returns as soon as the line goes idle after the
+        // response; timeout_ms only bounds a silent meter.
+        size_t    received = 0;
+        esp_err_t err = modbus_rtu_transact(request, sizeof(request),
+                                            response, resp_len, resp_len,
+                                            timeout_ms, &received);
+        if (err == ESP_FAIL) {
+            ESP_LOGW(TAG_PZEM, "UART write incomplete for 0x%02X attempt %d", addr, attempt + 1);
             last_err = ESP_FAIL;
             continue;
         }
-
-        // Ensure all request bytes have left the FIFO before we start reading
-        uart_wait_tx_done(PZEM_UART_NUM, pdMS_TO_TICKS(50));
-
-        // Wait for response
-        int received = uart_read_bytes(PZEM_UART_NUM, response, PZEM_RESPONSE_LEN,
-                                       pdMS_TO_TICKS(PZEM_READ_TIMEOUT_MS));
-
-        if (received < PZEM_RESPONSE_LEN) {
-            ESP_LOGW(TAG_PZEM, "UART timeout/short read for 0x%02X (%d/%d bytes) attempt %d",
-                     addr, received, PZEM_RESPONSE_LEN, attempt + 1);
-            uart_flush_input(PZEM_UART_NUM);  // discard partial frame
-            last_err = ESP_ERR_TIMEOUT;
+        if (err == ESP_ERR_INVALID_CRC) {
+            ESP_LOGW(TAG_PZEM, "CRC mismatch for 0x%02X (%u bytes) attempt %d",
+                     addr, (unsigned)received, attempt + 1);
+            last_err = ESP_FAIL;
             continue;
         }
-
-        // Validate CRC (last 2 bytes, LSB first)
-        uint16_t recv_crc = (uint16_t)response[PZEM_RESPONSE_LEN - 1] << 8 |
-                            (uint16_t)response[PZEM_RESPONSE_LEN - 2];
-        uint16_t calc_crc = crc16(response, PZEM_RESPONSE_LEN - 2);
-        if (recv_crc != calc_crc) {
-            ESP_LOGW(TAG_PZEM, "CRC mismatch for 0x%02X: recv=0x%04X calc=0x%04X attempt %d",
-                     addr, recv_crc, calc_crc, attempt + 1);
-            uart_flush_input(PZEM_UART_NUM);  // discard corrupted frame
+        if (err == ESP_ERR_INVALID_RESPONSE) {
+            ESP_LOGW(TAG_PZEM, "Modbus exception 0x%02X from 0x%02X attempt %d",
+                     response[2], addr, attempt + 1);
             last_err = ESP_FAIL;
             continue;
         }
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG_PZEM, "UART timeout/short read for 0x%02X (%u/%u bytes) attempt %d",
+                     addr, (unsigned)received, (unsigned)resp_len, attempt + 1);
+            last_err = ESP_ERR_TIMEOUT;
+            continue;
+        }
 
         // Validate address, function code, and byte count.
-        if (response[0] != addr || response[1] != PZEM_FUNC_READ_INPUT ||
-            response[2] != (PZEM_REG_COUNT * 2)) {
+        if (response[0] != addr || response[1] != func ||
+            response[2] != (count * 2)) {
             ESP_LOGW(TAG_PZEM, "Unexpected header for 0x%02X: addr=0x%02X func=0x%02X bytes=%u attempt %d",
                      addr, response[0], response[1], (unsigned)response[2], attempt + 1);
-            uart_flush_input(PZEM_UART_NUM);
+            modbus_rtu_note_header_error(addr);
             last_err = ESP_FAIL;
             continue;
         }
 
-        // All checks passed — fall through to parse below
-        last_err = ESP_OK;
-        break;
+        // All checks passed
+        modbus_rtu_note_read_ok(addr, (uint32_t)attempt);
+        return ESP_OK;
     }
 
-    if (last_err != ESP_OK) {
-        return last_err;
-    }
+    return last_err;
+}
 
-    // Parse register values (big-endian, starting at byte 3)
-    uint16_t v_raw  = (uint16_t)response[3]  << 8 | response[4];
-    uint16_t i_low  = (uint16_t)response[5]  << 8 | response[6];
-    uint16_t i_high = (uint16_t)response[7]  << 8 | response[8];
-    uint16_t p_low  = (uint16_t)response[9]  << 8 | response[10];
-    uint16_t p_high = (uint16_t)response[11] << 8 | response[12];
-    uint16_t e_low  = (uint16_t)response[13] << 8 | response[14];
-    uint16_t e_high = (uint16_t)response[15] << 8 | response[16];
-    uint16_t f_raw  = (uint16_t)response[17] << 8 | response[18];
-    uint16_t pf_raw = (uint16_t)response[19] << 8 | response[20];
+static esp_err_t pzem_sensor_read_with_addr(uint8_t addr, pzem_data_t *out, int64_t deadline_us)
+{
+    const meter_model_t *m     = s_channel_model[out->channel];
+    uint8_t              phase = s_channel_phase[out->channel];
+    uint8_t              response[METER_MAX_RESP_LEN];
 
-    uint32_t i_raw = ((uint32_t)i_high << 16) | i_low;
-    uint32_t p_raw = ((uint32_t)p_high << 16) | p_low;
-    uint32_t e_raw = ((uint32_t)e_high << 16) | e_low;
+    // 3-attempt retry loop — standard Modbus RTU practice
+    esp_err_t err = pzem_read_regs(addr, m->func, m->start, m->count,
+                                   response, 5 + 2 * (size_t)m->count, 3, deadline_us);
+    if (err != ESP_OK) {
+        return err;
+    }
 
-    out->v_rms          = v_raw  / 10.0f;
-    out->i_rms          = i_raw  / 1000.0f;
-    out->power          = p_raw  / 10.0f;
-    out->energy         = (float)e_raw;          // in Wh
-    out->frequency      = f_raw  / 10.0f;
-    out->power_factor   = pf_raw / 100.0f;
-    out->power_apparent = out->v_rms * out->i_rms;
-    out->timestamp      = xTaskGetTickCount() * portTICK_PERIOD_MS;
-    out->valid          = true;
+    // Register values start at byte 3; layout comes from the descriptor
+    uint8_t channel = out->channel;
+    memset(out, 0, sizeof(*out));
+    meter_decode(m, phase, &response[3], out);
 
-    // Cache for web dashboard
-    if (s_last_mutex && xSemaphoreTake(s_last_mutex, pdMS_TO_TICKS(10)) == pdTRUE) {
-        s_last_reading = *out;
-        xSemaphoreGive(s_last_mutex);
-    }
+    out->channel      = channel;
+    out->energy_wh    = out->meter_wh;      // replaced by the lifetime total in read_channel
+    out->timestamp    = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    out->current_only = false;
+    out->valid        = true;
 
-    LOG_DEBUG(TAG_PZEM, "addr=0x%02X V=%.1fV I=%.3fA P=%.1fW E=%.0fWh F=%.1fHz PF=%.2f",
-              addr, out->v_rms, out->i_rms, out->power,
-              out->energy, out->frequency, out->power_factor);
+    LOG_DEBUG(TAG_PZEM, "addr=0x%02X V=%u dV I=%lu mA P=%lu dW E=%llu Wh F=%u dHz PF=%u%%",
+              addr, out->v_dv, (unsigned long)out->i_ma, (unsigned long)out->power_dw,
+              (unsigned long long)out->energy_wh, out->freq_dhz, out->pf_pct);
 
     return ESP_OK;
 }
 
 void pzem_sensor_get_last(pzem_data_t *out)
+{
+    pzem_sensor_get_last_channel(0, out);
+}
+
+void pzem_sensor_get_last_channel(uint8_t channel, pzem_data_t *out)
 {
     if (!out) return;
-    if (s_last_mutex && xSemaphoreTake(s_last_mutex, pdMS_TO_TICKS(20)) == pdTRUE) {
-        *out = s_last_reading;
+    if (channel < PZEM_CHANNEL_COUNT && s_last_mutex &&
+        xSemaphoreTake(s_last_mutex, pdMS_TO_TICKS(20)) == pdTRUE) {
+        *out = s_last_reading[channel];
         xSemaphoreGive(s_last_mutex);
     } else {
         out->valid = false;
@@ -272,77 +588,100 @@ void pzem_sensor_get_last(pzem_data_t *out)
 
 esp_err_t pzem_reset_energy(void)
 {
-    const uint8_t probe_addrs[] = {s_pzem_addr, PZEM_ADDR_FALLBACK_1, PZEM_ADDR_FALLBACK_2};
-    esp_err_t last_err = ESP_FAIL;
-
-    for (size_t i = 0; i < sizeof(probe_addrs); i++) {
-        uint8_t addr = probe_addrs[i];
-        bool duplicate = false;
+    return pzem_reset_energy_channel(0);
+}
 
-        for (size_t j = 0; j < i; j++) {
-            if (probe_addrs[j] == addr) {
-                duplicate = true;
-                break;
-            }
-        }
-        if (duplicate) continue;
+esp_err_t pzem_reset_energy_channel(uint8_t channel)
+{
+    if (channel >= PZEM_CHANNEL_COUNT) return ESP_ERR_INVALID_ARG;
 
-        esp_err_t err = pzem_reset_energy_with_addr(addr);
-        if (err == ESP_OK) {
-            if (s_pzem_addr != addr) {
-                ESP_LOGI(TAG_PZEM, "PZEM address detected during reset: 0x%02X", addr);
-            }
-            s_pzem_addr = addr;
-            ESP_LOGI(TAG_PZEM, "Energy accumulator reset (addr=0x%02X)", addr);
-            return ESP_OK;
-        }
+    uint8_t func = s_channel_model[channel]->reset_func;
+    if (func == 0) return ESP_ERR_NOT_SUPPORTED;   // e.g. SDM: reset only from the meter keypad
 
-        last_err = err;
+    esp_err_t err = pzem_reset_energy_with_addr(s_channel_addr[channel], func,
+                                                deadline_after_ms(PZEM_READ_TIMEOUT_MS));
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG_PZEM, "Energy accumulator reset (ch%u addr=0x%02X)",
+                 channel, s_channel_addr[channel]);
     }
-
-    return last_err;
+    return err;
 }
 
-static esp_err_t pzem_reset_energy_with_addr(uint8_t addr)
+static esp_err_t pzem_reset_energy_with_addr(uint8_t addr, uint8_t func, int64_t deadline_us)
 {
-    // Reset energy command: addr + 0x42 + CRC
+    // Reset energy command: addr + func (0x42 on PZEM) + CRC
     uint8_t request[PZEM_RESET_LEN];
     request[0] = addr;
-    request[1] = PZEM_RESET_FUNC;
-    uint16_t crc = crc16(request, 2);
-    request[2] = crc & 0xFF;
-    request[3] = (crc >> 8) & 0xFF;
-
-    uart_flush_input(PZEM_UART_NUM);
-    int written = uart_write_bytes(PZEM_UART_NUM, (const char *)request, sizeof(request));
-    if (written != (int)sizeof(request)) {
+    request[1] = func;
+    modbus_crc16_append(request, 2);
+
+    uint32_t timeout_ms = attempt_timeout_ms(addr, deadline_us);
+    if (timeout_ms == 0) return ESP_ERR_TIMEOUT;
+
+    // Echo response (4 bytes)
+    uint8_t   response[PZEM_RESET_LEN];
+    size_t    received = 0;
+    esp_err_t err = modbus_rtu_transact(request, sizeof(request),
+                                        response, sizeof(response), PZEM_RESET_LEN,
+                                        timeout_ms, &received);
+    if (err == ESP_FAIL) {
         ESP_LOGW(TAG_PZEM, "Energy reset write failed for 0x%02X", addr);
         return ESP_FAIL;
     }
-    uart_wait_tx_done(PZEM_UART_NUM, pdMS_TO_TICKS(50));
-
-    // Read echo response (4 bytes)
-    uint8_t response[PZEM_RESET_LEN];
-    int received = uart_read_bytes(PZEM_UART_NUM, response, sizeof(response),
-                                   pdMS_TO_TICKS(PZEM_READ_TIMEOUT_MS));
-    if (received < PZEM_RESET_LEN) {
+    if (err == ESP_ERR_INVALID_CRC) {
+        ESP_LOGW(TAG_PZEM, "Energy reset CRC mismatch for 0x%02X", addr);
+        return ESP_FAIL;
+    }
+    if (err == ESP_ERR_INVALID_RESPONSE) {
+        ESP_LOGW(TAG_PZEM, "Energy reset rejected by 0x%02X (exception 0x%02X)", addr, response[2]);
+        return ESP_FAIL;
+    }
+    if (err != ESP_OK) {
         ESP_LOGW(TAG_PZEM, "Energy reset timeout for 0x%02X", addr);
-        uart_flush_input(PZEM_UART_NUM);
         return ESP_ERR_TIMEOUT;
     }
 
-    uint16_t recv_crc = (uint16_t)response[PZEM_RESET_LEN - 1] << 8 |
-                        (uint16_t)response[PZEM_RESET_LEN - 2];
-    uint16_t calc_crc = crc16(response, PZEM_RESET_LEN - 2);
-    if (recv_crc != calc_crc) {
-        ESP_LOGW(TAG_PZEM, "Energy reset CRC mismatch for 0x%02X", addr);
+    if (response[0] != addr || response[1] != func) {
+        ESP_LOGW(TAG_PZEM, "Energy reset header mismatch for 0x%02X", addr);
+        modbus_rtu_note_header_error(addr);
         return ESP_FAIL;
     }
 
-    if (response[0] != addr || response[1] != PZEM_RESET_FUNC) {
-        ESP_LOGW(TAG_PZEM, "Energy reset header mismatch for 0x%02X", addr);
+    return ESP_OK;
+}
+
+static esp_err_t pzem_write_reg(uint8_t addr, uint16_t reg, uint16_t value, int64_t deadline_us)
+{
+    // Write single register (0x06); the slave echoes the request on success
+    uint8_t request[PZEM_WRITE_LEN];
+    request[0] = addr;
+    request[1] = 0x06;
+    request[2] = (reg >> 8) & 0xFF;
+    request[3] = reg & 0xFF;
+    request[4] = (value >> 8) & 0xFF;
+    request[5] = value & 0xFF;
+    modbus_crc16_append(request, 6);
+
+    uint32_t timeout_ms = attempt_timeout_ms(addr, deadline_us);
+    if (timeout_ms == 0) return ESP_ERR_TIMEOUT;
+
+    uint8_t   response[PZEM_WRITE_LEN];
+    size_t    received = 0;
+    esp_err_t err = modbus_rtu_transact(request, sizeof(request),
+                                        response, sizeof(response), PZEM_WRITE_LEN,
+                                        timeout_ms, &received);
+    if (err == ESP_ERR_INVALID_RESPONSE) {
+        ESP_LOGW(TAG_PZEM, "Register 0x%04X write rejected by 0x%02X (exception 0x%02X)",
+                 reg, addr, response[2]);
+        return ESP_FAIL;
+    }
+    if (err != ESP_OK) {
+        return err == ESP_ERR_TIMEOUT ? ESP_ERR_TIMEOUT : ESP_FAIL;
+    }
+    if (memcmp(request, response, PZEM_WRITE_LEN) != 0) {
+        ESP_LOGW(TAG_PZEM, "Register 0x%04X write echo mismatch from 0x%02X", reg, addr);
+        modbus_rtu_note_header_error(addr);
         return ESP_FAIL;
     }
-
     return ESP_OK;
 }
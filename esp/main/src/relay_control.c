@@ -6,10 +6,29 @@
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/semphr.h"
-
-static relay_context_t relay_ctx;
-static SemaphoreHandle_t relay_mutex = NULL;
+#include "esp_timer.h"
+
+#include <stdatomic.h>
+
+// ── State word ───────────────────────────────────────────────────────────────
+// Everything that decides what the pin should be lives in one word: bits 0-1
+// relay_state_t, bit 2 the prepaid lockout. It only changes inside s_lock
+// together with the pin write, so no task can ever drive the pin from a
+// state that has already been replaced. Readers load it without the lock.
+#define STATE_MASK          0x3u
+#define LOCKOUT_BIT         0x4u
+#define STATE_OF(w)         ((relay_state_t)((w) & STATE_MASK))
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static atomic_uint  s_word;
+static atomic_uint  s_last_toggle_ms;
+static atomic_uint  s_trip_count;
+static atomic_int   s_last_trip_reason;
+
+static uint32_t now_ms(void)
+{
+    return xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
 
 // SLA-05VDC-SL-C isolated module: active LOW
 // RELAY_ACTIVE_LEVEL = 0 -> relay ON when GPIO LOW
@@ -24,15 +43,15 @@ static void relay_set_gpio(relay_state_t state)
     gpio_set_level(RELAY_GPIO, level);
 }
 
-esp_err_t relay_init(void)
+// Publish a new state word and drive the pin to match. Caller holds s_lock.
+static void relay_commit(unsigned w)
 {
-    relay_mutex = xSemaphoreCreateBinary();
-    if (!relay_mutex) {
-        ESP_LOGE(TAG_RELAY, "Failed to create relay mutex");
-        return ESP_ERR_NO_MEM;
-    }
-    xSemaphoreGive(relay_mutex);
+    atomic_store(&s_word, w);
+    relay_set_gpio(STATE_OF(w));
+}
 
+esp_err_t relay_init(void)
+{
     gpio_config_t io_conf = {
         .pin_bit_mask = (1ULL << RELAY_GPIO),
         .mode         = GPIO_MODE_OUTPUT_OD,  // open-drain: releases to 5V pull-up on OFF
@@ -45,14 +64,13 @@ esp_err_t relay_init(void)
     // Safe initial state: relay OFF (de-energized)
     relay_set_gpio(RELAY_STATE_OFF);
 
-    relay_ctx.state            = RELAY_STATE_OFF;
+    atomic_store(&s_word, RELAY_STATE_OFF);
     // Initialise as if the cooldown already elapsed so buttons work immediately.
     // uint32 underflow trick: 0 - (COOLDOWN+1) wraps to a value whose distance
     // from any early 'now' is already >= RELAY_COOLDOWN_MS.
-    relay_ctx.last_toggle_ms   = (uint32_t)(-(int32_t)RELAY_COOLDOWN_MS - 1);
-    relay_ctx.auto_reset       = RELAY_AUTO_RESET;
-    relay_ctx.trip_count       = 0;
-    relay_ctx.last_trip_reason = ANOMALY_NONE;
+    atomic_store(&s_last_toggle_ms, (uint32_t)(-(int32_t)RELAY_COOLDOWN_MS - 1));
+    atomic_store(&s_trip_count, 0);
+    atomic_store(&s_last_trip_reason, ANOMALY_NONE);
 
     ESP_LOGI(TAG_RELAY, "Relay initialized: GPIO%d active-LOW (SLA-05VDC-SL-C)",
              RELAY_GPIO);
@@ -61,99 +79,126 @@ esp_err_t relay_init(void)
 
 bool relay_can_toggle(void)
 {
-    uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
-    return (now - relay_ctx.last_toggle_ms) >= RELAY_COOLDOWN_MS;
+    return (now_ms() - atomic_load(&s_last_toggle_ms)) >= RELAY_COOLDOWN_MS;
 }
 
 esp_err_t relay_set_state(relay_state_t new_state)
 {
-    if (xSemaphoreTake(relay_mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
-        return ESP_ERR_TIMEOUT;
-    }
+    // Read the clock before the critical section: nothing in there may block
+    uint32_t    now     = now_ms();
+    const char *refused = NULL;
+    bool        changed = false;
 
-    // Cannot override TRIPPED via normal set_state
-    if (relay_ctx.state == RELAY_STATE_TRIPPED && new_state != RELAY_STATE_OFF) {
-        xSemaphoreGive(relay_mutex);
-        ESP_LOGW(TAG_RELAY, "Relay is TRIPPED — reset required before changing state");
-        return ESP_ERR_INVALID_STATE;
-    }
+    portENTER_CRITICAL(&s_lock);
+    unsigned      w  = atomic_load(&s_word);
+    relay_state_t st = STATE_OF(w);
 
-    if (relay_ctx.state == new_state) {
-        xSemaphoreGive(relay_mutex);
-        return ESP_OK;
+    // Cannot override TRIPPED via normal set_state
+    if (st == RELAY_STATE_TRIPPED && new_state != RELAY_STATE_OFF) {
+        refused = "Relay is TRIPPED — reset required before changing state";
+    } else if (st == new_state) {
+        // nothing to do
+    } else if (new_state == RELAY_STATE_ON && (w & LOCKOUT_BIT)) {
+        refused = "Relay is locked out (no prepaid credit)";
+    } else if (new_state == RELAY_STATE_ON &&
+               (now - atomic_load(&s_last_toggle_ms)) < RELAY_COOLDOWN_MS) {
+        refused = "Relay cooldown not elapsed";
+    } else {
+        relay_commit((w & ~STATE_MASK) | (unsigned)new_state);
+        // Cooldown protects against rapid OFF→ON cycling.
+        // Timer only starts when going OFF so a quick ON→OFF→(wait 1s)→ON works.
+        if (new_state == RELAY_STATE_OFF) atomic_store(&s_last_toggle_ms, now);
+        changed = true;
     }
+    portEXIT_CRITICAL(&s_lock);
 
-    if (new_state == RELAY_STATE_ON && !relay_can_toggle() && relay_ctx.state != RELAY_STATE_TRIPPED) {
-        xSemaphoreGive(relay_mutex);
-        ESP_LOGW(TAG_RELAY, "Relay cooldown not elapsed");
+    if (refused) {
+        ESP_LOGW(TAG_RELAY, "%s", refused);
         return ESP_ERR_INVALID_STATE;
     }
-
-    relay_set_gpio(new_state);
-    relay_ctx.state = new_state;
-    // Cooldown protects against rapid OFF→ON cycling.
-    // Timer only starts when going OFF so a quick ON→OFF→(wait 1s)→ON works.
-    if (new_state == RELAY_STATE_OFF) {
-        relay_ctx.last_toggle_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    if (changed) {
+        ESP_LOGI(TAG_RELAY, "Relay -> %s",
+                 new_state == RELAY_STATE_ON  ? "ON"  :
+                 new_state == RELAY_STATE_OFF ? "OFF" : "TRIPPED");
     }
+    return ESP_OK;
+}
 
-    ESP_LOGI(TAG_RELAY, "Relay -> %s",
-             new_state == RELAY_STATE_ON  ? "ON"  :
-             new_state == RELAY_STATE_OFF ? "OFF" : "TRIPPED");
+esp_err_t relay_set_lockout(bool locked)
+{
+    uint32_t now = now_ms();
+
+    portENTER_CRITICAL(&s_lock);
+    unsigned w    = atomic_load(&s_word);
+    unsigned next = locked ? (w | LOCKOUT_BIT) : (w & ~LOCKOUT_BIT);
+    if (locked && STATE_OF(w) == RELAY_STATE_ON) {
+        relay_commit((next & ~STATE_MASK) | RELAY_STATE_OFF);
+        atomic_store(&s_last_toggle_ms, now);
+    } else {
+        atomic_store(&s_word, next);
+    }
+    portEXIT_CRITICAL(&s_lock);
 
-    xSemaphoreGive(relay_mutex);
+    // Setting the value it already has changes nothing: log transitions only
+    if ((w ^ next) & LOCKOUT_BIT) {
+        ESP_LOGW(TAG_RELAY, "Relay lockout %s", locked ? "ON — relay held open" : "released");
+    }
     return ESP_OK;
 }
 
-void relay_emergency_cutoff(anomaly_type_t reason)
+bool relay_is_locked_out(void)
 {
-    // Bypass cooldown — this is safety-critical
-    relay_set_gpio(RELAY_STATE_OFF);
+    return (atomic_load(&s_word) & LOCKOUT_BIT) != 0;
+}
 
-    if (xSemaphoreTake(relay_mutex, pdMS_TO_TICKS(10)) == pdTRUE) {
-        relay_ctx.state            = RELAY_STATE_TRIPPED;
-        relay_ctx.last_toggle_ms   = xTaskGetTickCount() * portTICK_PERIOD_MS;
-        relay_ctx.trip_count++;
-        relay_ctx.last_trip_reason = reason;
-        xSemaphoreGive(relay_mutex);
-    }
+int64_t relay_trip(anomaly_type_t reason)
+{
+    // Pin and state together: an ON in progress on the other core either
+    // finished before this (and is opened here) or sees TRIPPED and refuses
+    portENTER_CRITICAL(&s_lock);
+    relay_commit((atomic_load(&s_word) & ~STATE_MASK) | RELAY_STATE_TRIPPED);
+    int64_t open_us = esp_timer_get_time();
+    portEXIT_CRITICAL(&s_lock);
+
+    atomic_store(&s_last_toggle_ms, now_ms());
+    atomic_fetch_add(&s_trip_count, 1);
+    atomic_store(&s_last_trip_reason, reason);
+    return open_us;
+}
 
+void relay_emergency_cutoff(anomaly_type_t reason)
+{
+    relay_trip(reason);
     ESP_LOGE(TAG_RELAY, "EMERGENCY CUTOFF! Reason: %s  |  Trip #%lu",
-             anomaly_type_to_string(reason), (unsigned long)relay_ctx.trip_count);
+             anomaly_type_to_string(reason), (unsigned long)atomic_load(&s_trip_count));
 }
 
 relay_state_t relay_get_state(void)
 {
-    relay_state_t s = RELAY_STATE_OFF;
-    if (xSemaphoreTake(relay_mutex, pdMS_TO_TICKS(10)) == pdTRUE) {
-        s = relay_ctx.state;
-        xSemaphoreGive(relay_mutex);
-    }
-    return s;
+    return STATE_OF(atomic_load(&s_word));
 }
 
 uint32_t relay_get_trip_count(void)
 {
-    return relay_ctx.trip_count;
+    return atomic_load(&s_trip_count);
 }
 
 void relay_reset_trip_count(void)
 {
-    relay_ctx.trip_count = 0;
+    atomic_store(&s_trip_count, 0);
     ESP_LOGI(TAG_RELAY, "Trip count reset");
 }
 
 uint32_t relay_get_cooldown_remaining_ms(void)
 {
-    uint32_t now_ms  = xTaskGetTickCount() * portTICK_PERIOD_MS;
-    uint32_t elapsed = now_ms - relay_ctx.last_toggle_ms;
+    uint32_t elapsed = now_ms() - atomic_load(&s_last_toggle_ms);
     if (elapsed >= RELAY_COOLDOWN_MS) return 0;
     return RELAY_COOLDOWN_MS - elapsed;
 }
 
 anomaly_type_t relay_get_last_trip_reason(void)
 {
-    return relay_ctx.last_trip_reason;
+    return (anomaly_type_t)atomic_load(&s_last_trip_reason);
 }
 
 const char *anomaly_type_to_string(anomaly_type_t type)
@@ -161,12 +206,12 @@ const char *anomaly_type_to_string(anomaly_type_t type)
     switch (type) {
         case ANOMALY_SHORT_CIRCUIT: return "SHORT_CIRCUIT";
         case ANOMALY_OVERCURRENT:   return "OVERCURRENT";
+        case ANOMALY_OVERPOWER:     return "OVERPOWER";
         case ANOMALY_WIRE_FIRE:     return "WIRE_FIRE";
         case ANOMALY_OVERVOLTAGE:   return "OVERVOLTAGE";
         case ANOMALY_UNDERVOLTAGE:  return "UNDERVOLTAGE";
+        case ANOMALY_LOW_POWER_FACTOR: return "LOW_POWER_FACTOR";
+        case ANOMALY_FREQUENCY:     return "FREQUENCY_DEVIATION";
         default:                    return "NONE";
     }
 }
-
-
-
@@ -0,0 +1,118 @@
+#include "rolling_stats.h"
+
+#include <stddef.h>
+
+static inline uint16_t age_of(const rolling_stats_t *rs, uint16_t p)
+{
+    uint32_t period = 2u * rs->window;
+    return (uint16_t)((rs->pos + period - p) % period);
+}
+
+static inline uint32_t value_at(const rolling_stats_t *rs, uint16_t p)
+{
+    return rs->samples[p % rs->window];
+}
+
+void rolling_stats_init(rolling_stats_t *rs, uint32_t *samples,
+                        uint16_t *min_q, uint16_t *max_q, uint16_t window)
+{
+    if (window == 0) window = 1;
+    if (window > ROLLING_STATS_MAX_WINDOW) window = ROLLING_STATS_MAX_WINDOW;
+    rs->samples = samples;
+    rs->min_q   = min_q;
+    rs->max_q   = max_q;
+    rs->window  = window;
+    rolling_stats_clear(rs);
+}
+
+void rolling_stats_clear(rolling_stats_t *rs)
+{
+    rs->count    = 0;
+    rs->pos      = 0;
+    rs->min_head = rs->min_len = 0;
+    rs->max_head = rs->max_len = 0;
+    rs->sum      = 0;
+    rs->sum_sq   = 0;
+}
+
+// ── Monotonic deques ──────────────────────────────────────────────────────────
+
+// Drop front entries that have slid out of the window.
+static void deque_expire(const rolling_stats_t *rs, const uint16_t *q, uint16_t *head, uint16_t *len)
+{
+    while (*len && age_of(rs, q[*head]) >= rs->window) {
+        *head = (*head + 1) % rs->window;
+        (*len)--;
+    }
+}
+
+// Append the current position after popping every back entry it dominates:
+// keep_greater selects the max deque (drop values ≤ new), else the min deque.
+static void deque_push(rolling_stats_t *rs, uint16_t *q, uint16_t head, uint16_t *len,
+                       uint32_t value, bool keep_greater)
+{
+    while (*len) {
+        uint32_t back = value_at(rs, q[(head + *len - 1) % rs->window]);
+        if (keep_greater ? back > value : back < value) break;
+        (*len)--;
+    }
+    q[(head + *len) % rs->window] = rs->pos;
+    (*len)++;
+}
+
+// ── Update ────────────────────────────────────────────────────────────────────
+
+void rolling_stats_push(rolling_stats_t *rs, uint32_t value)
+{
+    uint16_t slot = rs->pos % rs->window;
+
+    deque_expire(rs, rs->min_q, &rs->min_head, &rs->min_len);
+    deque_expire(rs, rs->max_q, &rs->max_head, &rs->max_len);
+
+    if (rs->count == rs->window) {
+        uint32_t old = rs->samples[slot];
+        rs->sum    -= old;
+        rs->sum_sq -= (uint64_t)old * old;
+    } else {
+        rs->count++;
+    }
+    rs->samples[slot] = value;
+    rs->sum    += value;
+    rs->sum_sq += (uint64_t)value * value;
+
+    deque_push(rs, rs->min_q, rs->min_head, &rs->min_len, value, false);
+    deque_push(rs, rs->max_q, rs->max_head, &rs->max_len, value, true);
+
+    rs->pos = (uint16_t)((rs->pos + 1) % (2u * rs->window));
+}
+
+// ── Queries ───────────────────────────────────────────────────────────────────
+
+uint32_t rolling_stats_mean(const rolling_stats_t *rs)
+{
+    return rs->count ? (uint32_t)(rs->sum / rs->count) : 0;
+}
+
+uint64_t rolling_stats_variance(const rolling_stats_t *rs)
+{
+    if (rs->count < 2) return 0;
+
+    // sum²/n split as sum·q + sum·r/n: sum·q ≤ sum_sq, and sum·r < n²·max
+    // stays below 2^60 for any window and uint32 sample, so within the
+    // ROLLING_STATS_EXACT() bound nothing here exceeds 64 bits.
+    uint64_t n         = rs->count;
+    uint64_t q         = rs->sum / n;
+    uint64_t r         = rs->sum % n;
+    uint64_t sq_over_n = rs->sum * q + rs->sum * r / n;
+    return rs->sum_sq > sq_over_n ? (rs->sum_sq - sq_over_n) / n : 0;
+}
+
+uint32_t rolling_stats_min(const rolling_stats_t *rs)
+{
+    return rs->min_len ? value_at(rs, rs->min_q[rs->min_head]) : 0;
+}
+
+uint32_t rolling_stats_max(const rolling_stats_t *rs)
+{
+    return rs->max_len ? value_at(rs, rs->max_q[rs->max_head]) : 0;
+}
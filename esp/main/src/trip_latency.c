@@ -0,0 +1,98 @@
+#include "trip_latency.h"
+
+#include <string.h>
+
+// Buckets 0..3 hold 0..3 µs exactly; above that, octave k (2^k ≤ v < 2^(k+1))
+// is split into four. The top octave catches everything from 2^MAX_LOG2 µs.
+#define MAX_LOG2        23                      // ≈ 8.4 s
+#define BUCKETS         (4 * MAX_LOG2)
+
+typedef struct {
+    uint32_t bucket[BUCKETS];
+    uint32_t count;
+    uint32_t max_us;
+} hist_t;
+
+static hist_t   s_decision;
+static hist_t   s_open;
+static uint32_t s_decode_max_us;
+static uint32_t s_detect_max_us;
+static uint32_t s_gpio_max_us;
+
+static uint32_t elapsed_us(int64_t from, int64_t to)
+{
+    return to > from ? (uint32_t)(to - from) : 0;
+}
+
+static int bucket_of(uint32_t v)
+{
+    if (v < 4) return (int)v;
+    int k = 31 - __builtin_clz(v);
+    if (k > MAX_LOG2) return BUCKETS - 1;
+    int idx = 4 * (k - 1) + (int)((v >> (k - 2)) & 3);
+    return idx < BUCKETS ? idx : BUCKETS - 1;
+}
+
+static uint32_t bucket_upper(int idx)
+{
+    if (idx < 4) return (uint32_t)idx;
+    int k = idx / 4 + 1;
+    return ((uint32_t)(4 + idx % 4 + 1) << (k - 2)) - 1;
+}
+
+static void hist_add(hist_t *h, uint32_t v)
+{
+    h->bucket[bucket_of(v)]++;
+    h->count++;
+    if (v > h->max_us) h->max_us = v;
+}
+
+static uint32_t hist_percentile(const hist_t *h, uint32_t count, uint32_t pct)
+{
+    uint32_t rank = (uint32_t)(((uint64_t)count * pct + 99) / 100);
+    uint32_t seen = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        seen += h->bucket[i];
+        if (seen >= rank) {
+            uint32_t up = bucket_upper(i);
+            return up < h->max_us ? up : h->max_us;
+        }
+    }
+    return h->max_us;
+}
+
+static void hist_summary(const hist_t *h, trip_latency_dist_t *out)
+{
+    out->count  = h->count;
+    out->max_us = h->max_us;
+    out->p50_us = out->count ? hist_percentile(h, out->count, 50) : 0;
+    out->p99_us = out->count ? hist_percentile(h, out->count, 99) : 0;
+}
+
+void trip_latency_note_reading(int64_t frame_us, int64_t decoded_us, int64_t detected_us)
+{
+    uint32_t decode = elapsed_us(frame_us, decoded_us);
+    uint32_t detect = elapsed_us(decoded_us, detected_us);
+    if (decode > s_decode_max_us) s_decode_max_us = decode;
+    if (detect > s_detect_max_us) s_detect_max_us = detect;
+    hist_add(&s_decision, decode + detect);
+}
+
+uint32_t trip_latency_note_trip(int64_t frame_us, int64_t detected_us, int64_t open_us)
+{
+    uint32_t gpio  = elapsed_us(detected_us, open_us);
+    uint32_t total = elapsed_us(frame_us, open_us);
+    if (gpio > s_gpio_max_us) s_gpio_max_us = gpio;
+    hist_add(&s_open, total);
+    return total;
+}
+
+void trip_latency_get(trip_latency_report_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    hist_summary(&s_decision, &out->decision);
+    hist_summary(&s_open,     &out->open);
+    out->decode_max_us = s_decode_max_us;
+    out->detect_max_us = s_detect_max_us;
+    out->gpio_max_us   = s_gpio_max_us;
+}
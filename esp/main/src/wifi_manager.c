@@ -7,12 +7,15 @@
 #include "esp_event.h"
 #include "esp_netif.h"
 #include "esp_log.h"
+#include "esp_sntp.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
 #include "lwip/inet.h"
 
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
 
 #define WIFI_CONNECTED_BIT  BIT0
 #define WIFI_FAIL_BIT       BIT1
@@ -30,6 +33,20 @@ static wifi_context_t wifi_ctx = {
 static esp_netif_t *sta_netif = NULL;
 static esp_netif_t *ap_netif  = NULL;
 
+// Wall clock for the consumption forecast. SNTP keeps polling on its own
+// once started, so one start on the first connection is enough.
+static void time_sync_start(void)
+{
+    static bool started = false;
+    if (started) return;
+    started = true;
+
+    esp_sntp_setoperatingmode(ESP_SNTP_OPMODE_POLL);
+    esp_sntp_setservername(0, SNTP_SERVER);
+    esp_sntp_init();
+    LOG_INFO(TAG_WIFI, "SNTP started (%s)", SNTP_SERVER);
+}
+
 static void wifi_event_handler(void *arg, esp_event_base_t event_base,
                                int32_t event_id, void *event_data)
 {
@@ -64,6 +81,7 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base,
         wifi_ctx.retry_count = 0;
         xEventGroupSetBits(wifi_event_group, WIFI_CONNECTED_BIT);
         LOG_INFO(TAG_WIFI, "Connected! IP: %s", wifi_ctx.ip_addr);
+        time_sync_start();
 
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_AP_STACONNECTED) {
         wifi_event_ap_staconnected_t *ev = (wifi_event_ap_staconnected_t *)event_data;
@@ -79,6 +97,10 @@ esp_err_t wifi_init(void)
 {
     LOG_INFO(TAG_WIFI, "Initializing WiFi...");
 
+    // localtime_r() gives local hours once SNTP has set the clock
+    setenv("TZ", LOCAL_TZ, 1);
+    tzset();
+
     wifi_event_group = xEventGroupCreate();
 
     ESP_ERROR_CHECK(esp_netif_init());
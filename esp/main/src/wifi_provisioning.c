@@ -3,7 +3,9 @@
 #include "config.h"
 #include "pzem_sensor.h"
 #include "relay_control.h"
+#include "trip_latency.h"
 #include "anomaly_detector.h"
+#include "fixed_point.h"
 
 #include "esp_wifi.h"
 #include "esp_event.h"
@@ -301,7 +303,7 @@ static const char provisioning_html[] =
 "}"
 
 // ── Update relay UI ───────────────────────────────────────────────────────────
-"function setRelay(state,trips,cdms,reason){"
+"function setRelay(state,trips,cdms,reason,lat){"
 "var dot=document.getElementById('rdot'),"
 "badge=document.getElementById('rbadge'),"
 "info=document.getElementById('rinfo'),"
@@ -318,6 +320,7 @@ static const char provisioning_html[] =
 "var parts=[];"
 "if(trips>0)parts.push('Trips: '+trips);"
 "if(reason&&reason!=='NONE')parts.push('Last: '+reason);"
+"if(lat&&lat.trips>0)parts.push('Trip time: '+(lat.open_max/1000).toFixed(1)+' ms max');"
 "if(cdms>0&&state!=='TRIPPED')parts.push('Cooldown: '+Math.ceil(cdms/1000)+'s');"
 "info.textContent=parts.join(' \u2022 ');"
 "bon.disabled=(state==='TRIPPED')||(cdms>0);"
@@ -349,7 +352,7 @@ static const char provisioning_html[] =
 "sv('pf',ok?d.pf.toFixed(2):'--', ok?pfc(d.pf):'stale');"
 "sv('fr',ok?d.f.toFixed(1):'--',  ok?fc(d.f):'stale');"
 "sv('e', ok?d.e.toFixed(0):'--',  ok?'neutral':'stale');"
-"setRelay(d.relay,d.trip_count||0,d.cooldown_ms||0,d.last_reason||'NONE');"
+"setRelay(d.relay,d.trip_count||0,d.cooldown_ms||0,d.last_reason||'NONE',d.trip_us);"
 "var t=new Date();"
 "document.getElementById('upd').textContent="
 "(ok?'Updated ':'Sensor offline \u2014 ')"
@@ -706,23 +709,44 @@ static esp_err_t readings_handler(httpd_req_t *req)
     const char    *relay_str   = (rs == RELAY_STATE_ON)     ? "ON"      :
                                  (rs == RELAY_STATE_TRIPPED) ? "TRIPPED" : "OFF";
 
-    char buf[320];
+    // Trip path, µs: reading → decision over every reading, reading → relay
+    // open over trips, and the worst time per stage
+    trip_latency_report_t lat;
+    trip_latency_get(&lat);
+    char trip_us[200];
+    snprintf(trip_us, sizeof(trip_us),
+        "\"trip_us\":{\"p50\":%lu,\"p99\":%lu,\"max\":%lu,\"trips\":%lu,"
+        "\"open_p99\":%lu,\"open_max\":%lu,\"decode_max\":%lu,"
+        "\"detect_max\":%lu,\"gpio_max\":%lu}",
+        (unsigned long)lat.decision.p50_us, (unsigned long)lat.decision.p99_us,
+        (unsigned long)lat.decision.max_us, (unsigned long)lat.open.count,
+        (unsigned long)lat.open.p99_us, (unsigned long)lat.open.max_us,
+        (unsigned long)lat.decode_max_us, (unsigned long)lat.detect_max_us,
+        (unsigned long)lat.gpio_max_us);
+
+    char buf[512];
     if (d.valid) {
+        char v[12], i[16], p[16], s[16], pf[8], f[12];
+        fixed_fmt(v,  sizeof(v),  d.v_dv,         1);
+        fixed_fmt(i,  sizeof(i),  d.i_ma,         3);
+        fixed_fmt(p,  sizeof(p),  d.power_dw,     1);
+        fixed_fmt(s,  sizeof(s),  d.apparent_dva, 1);
+        fixed_fmt(pf, sizeof(pf), d.pf_pct,       2);
+        fixed_fmt(f,  sizeof(f),  d.freq_dhz,     1);
         snprintf(buf, sizeof(buf),
-            "{\"valid\":true,\"v\":%.1f,\"i\":%.3f,\"p\":%.1f,\"s\":%.1f,"
-            "\"pf\":%.2f,\"e\":%.0f,\"f\":%.1f,"
+            "{\"valid\":true,\"v\":%s,\"i\":%s,\"p\":%s,\"s\":%s,"
+            "\"pf\":%s,\"e\":%llu,\"f\":%s,"
             "\"relay\":\"%s\",\"trip_count\":%lu,"
-            "\"cooldown_ms\":%lu,\"last_reason\":\"%s\"}",
-            d.v_rms, d.i_rms, d.power, d.power_apparent,
-            d.power_factor, d.energy, d.frequency,
+            "\"cooldown_ms\":%lu,\"last_reason\":\"%s\",%s}",
+            v, i, p, s, pf, (unsigned long long)d.energy_wh, f,
             relay_str, (unsigned long)trips,
-            (unsigned long)cooldown_ms, last_reason);
+            (unsigned long)cooldown_ms, last_reason, trip_us);
     } else {
         snprintf(buf, sizeof(buf),
             "{\"valid\":false,\"relay\":\"%s\",\"trip_count\":%lu,"
-            "\"cooldown_ms\":%lu,\"last_reason\":\"%s\"}",
+            "\"cooldown_ms\":%lu,\"last_reason\":\"%s\",%s}",
             relay_str, (unsigned long)trips,
-            (unsigned long)cooldown_ms, last_reason);
+            (unsigned long)cooldown_ms, last_reason, trip_us);
     }
 
     httpd_resp_set_type(req, "application/json");
@@ -749,7 +773,7 @@ static esp_err_t relay_handler(httpd_req_t *req)
     if (strstr(buf, "action=on")) {
         esp_err_t err = relay_set_state(RELAY_STATE_ON);
         ok  = (err == ESP_OK);
-        msg = ok ? "Relay turned ON" : "Failed (cooldown or tripped)";
+        msg = ok ? "Relay turned ON" : "Failed (cooldown, tripped or no credit)";
     } else if (strstr(buf, "action=off")) {
         esp_err_t err = relay_set_state(RELAY_STATE_OFF);
         ok  = (err == ESP_OK);
@@ -762,9 +786,9 @@ static esp_err_t relay_handler(httpd_req_t *req)
         esp_err_t err = relay_set_state(RELAY_STATE_OFF);
         ok  = (err == ESP_OK);
         if (ok) {
-            // Clear overcurrent counter and fire-detector baseline so the
-            // next valid reading doesn't immediately re-trip the relay.
-            anomaly_detector_reset();
+            // Restart the rule confirm timers and fire-detector baseline so
+            // a stale run does not re-trip the relay (I²t heat is kept).
+            anomaly_detector_request_reset();
             msg = "Relay reset to OFF";
         } else {
             msg = "Reset failed";
@@ -784,6 +808,18 @@ static esp_err_t relay_handler(httpd_req_t *req)
     return ESP_OK;
 }
 
+// POST /meters/discover — rescan the Modbus bus on the read task's next cycle
+static esp_err_t discover_handler(httpd_req_t *req)
+{
+    pzem_sensor_request_discovery();
+
+    const char *resp = "{\"ok\":true,\"message\":\"Bus discovery scheduled\"}";
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_send(req, resp, strlen(resp));
+    return ESP_OK;
+}
+
 // POST /settings — save server URL, API key, and device ID to NVS
 static esp_err_t settings_handler(httpd_req_t *req)
 {
@@ -1010,6 +1046,13 @@ static esp_err_t start_provisioning_server(void)
     };
     httpd_register_uri_handler(provisioning_server, &relay_uri);
 
+    httpd_uri_t discover_uri = {
+        .uri     = "/meters/discover",
+        .method  = HTTP_POST,
+        .handler = discover_handler,
+    };
+    httpd_register_uri_handler(provisioning_server, &discover_uri);
+
     httpd_uri_t settings_uri = {
         .uri     = "/settings",
         .method  = HTTP_POST,
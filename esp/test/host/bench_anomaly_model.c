@@ -0,0 +1,94 @@
+// Cost of the learned scorer: the kernel on a full-size model (once per
+// window) and the per-reading accumulate that runs on every full read.
+
+#include "anomaly_model.h"
+#include "config.h"
+#include "test_util.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_ROUNDS 200000
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// volatile sink keeps the optimiser from dropping the loops
+static volatile uint32_t s_sink;
+
+static anomaly_model_t s_model;
+
+static void max_size_model(void)
+{
+    memset(&s_model, 0, sizeof(s_model));
+    s_model.version   = 1;
+    s_model.n_hidden  = ANOMALY_MODEL_MAX_HIDDEN;
+    s_model.shift1    = 7;
+    s_model.shift2    = 7;
+    s_model.confirm   = 1;
+    s_model.threshold = UINT32_MAX;     // never flags: measure the steady path
+    for (int k = 0; k < ANOMALY_MODEL_FEATURES; k++) {
+        s_model.center[k] = rand() % 5000;
+        s_model.mult[k]   = 1 << 12;
+        for (int j = 0; j < ANOMALY_MODEL_MAX_HIDDEN; j++) {
+            s_model.w1[j][k] = (int8_t)rand();
+            s_model.w2[k][j] = (int8_t)rand();
+        }
+    }
+}
+
+static void bench_kernel(void)
+{
+    max_size_model();
+    int32_t  x[ANOMALY_MODEL_FEATURES];
+    uint32_t acc = 0;
+    for (int k = 0; k < ANOMALY_MODEL_FEATURES; k++) x[k] = rand() % 10000;
+
+    double t0 = now_ns();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        x[r % ANOMALY_MODEL_FEATURES] ^= r & 0xFF;
+        acc += anomaly_model_score(&s_model, x);
+    }
+    double t1 = now_ns();
+    s_sink = acc;
+
+    printf("  kernel, %d hidden: %7.1f ns/window  (%d MACs)\n", ANOMALY_MODEL_MAX_HIDDEN,
+           (t1 - t0) / BENCH_ROUNDS, 2 * ANOMALY_MODEL_FEATURES * ANOMALY_MODEL_MAX_HIDDEN);
+}
+
+static void bench_update(void)
+{
+    max_size_model();
+    anomaly_model_init();
+    CHECK_EQ(anomaly_model_apply(&s_model), ESP_OK);
+
+    anomaly_model_flag_t flag;
+    pzem_data_t d = { .v_dv = 2300, .pf_pct = 95, .freq_dhz = 600, .valid = true };
+    uint32_t    flags = 0;
+
+    double t0 = now_ns();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        d.timestamp = (uint32_t)r * PZEM_READ_INTERVAL_MS;
+        d.i_ma      = 2000 + (r & 0x3FF);
+        d.power_dw  = d.i_ma * d.v_dv / 1000;
+        flags += anomaly_model_update(&d, &flag);
+    }
+    double t1 = now_ns();
+    s_sink = flags;
+
+    CHECK_EQ(flags, 0);
+    printf("  update: %7.1f ns/reading, scoring every %d  (%zu B static)\n",
+           (t1 - t0) / BENCH_ROUNDS, ANOMALY_MODEL_WINDOW, anomaly_model_ram_bytes());
+}
+
+int main(void)
+{
+    RUN_TEST(bench_kernel);
+    RUN_TEST(bench_update);
+    TEST_MAIN_END();
+}
@@ -0,0 +1,467 @@
+#include "host_fakes.h"
+
+#include "cJSON.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_rom_crc.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "driver/uart.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "nvs.h"
+
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ── Clock ─────────────────────────────────────────────────────────────────────
+
+static _Atomic int64_t s_now_us;
+
+void host_set_time_us(int64_t us) { atomic_store(&s_now_us, us); }
+void host_advance_us(int64_t us)  { atomic_fetch_add(&s_now_us, us); }
+void host_advance_ms(uint32_t ms) { atomic_fetch_add(&s_now_us, (int64_t)ms * 1000); }
+int64_t host_time_us(void)        { return atomic_load(&s_now_us); }
+
+int64_t esp_timer_get_time(void)
+{
+    host_preempt_point();
+    return atomic_load(&s_now_us);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    host_preempt_point();
+    return (TickType_t)(atomic_load(&s_now_us) / (1000 * portTICK_PERIOD_MS));
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    host_advance_ms(ticks * portTICK_PERIOD_MS);
+}
+
+BaseType_t xTaskCreate(void (*fn)(void *), const char *name, uint32_t stack,
+                       void *arg, UBaseType_t prio, TaskHandle_t *out)
+{
+    (void)fn; (void)name; (void)stack; (void)arg; (void)prio;
+    if (out) *out = NULL;
+    return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(void (*fn)(void *), const char *name, uint32_t stack,
+                                   void *arg, UBaseType_t prio, TaskHandle_t *out, int core)
+{
+    (void)core;
+    return xTaskCreate(fn, name, stack, arg, prio, out);
+}
+
+// ── Critical sections and preemption ──────────────────────────────────────────
+
+static _Thread_local char s_thread_token;
+static _Thread_local int  s_critical_depth;
+static _Thread_local int  s_in_hook;
+
+static host_preempt_fn_t s_preempt_fn;
+static void             *s_preempt_arg;
+static uint32_t          s_preempt_count;
+
+void host_critical_enter(portMUX_TYPE *mux)
+{
+    const void *self = &s_thread_token;
+    if (mux->owner != self) {
+        const void *expected = NULL;
+        while (!__atomic_compare_exchange_n(&mux->owner, &expected, self, false,
+                                            __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            expected = NULL;
+            sched_yield();
+        }
+    }
+    mux->count++;
+    s_critical_depth++;
+}
+
+void host_critical_exit(portMUX_TYPE *mux)
+{
+    s_critical_depth--;
+    if (--mux->count == 0) __atomic_store_n(&mux->owner, NULL, __ATOMIC_RELEASE);
+}
+
+void host_set_preempt_hook(host_preempt_fn_t fn, void *arg)
+{
+    s_preempt_fn    = fn;
+    s_preempt_arg   = arg;
+    s_preempt_count = 0;
+}
+
+uint32_t host_preempt_count(void)
+{
+    return s_preempt_count;
+}
+
+void host_preempt_point(void)
+{
+    if (!s_preempt_fn || s_critical_depth > 0 || s_in_hook) return;
+    s_preempt_count++;
+    s_in_hook = 1;
+    s_preempt_fn(s_preempt_arg);
+    s_in_hook = 0;
+}
+
+// ── Semaphores and queues ─────────────────────────────────────────────────────
+
+struct host_sem {
+    int taken;
+};
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return calloc(1, sizeof(struct host_sem));
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    (void)ticks;
+    host_preempt_point();
+    if (sem->taken) return pdFALSE;
+    sem->taken = 1;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    if (!sem->taken) return pdFALSE;
+    sem->taken = 0;
+    return pdTRUE;
+}
+
+struct host_queue {
+    UBaseType_t length, item_size, head, count;
+    uint8_t     items[];
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    QueueHandle_t q = calloc(1, sizeof(*q) + (size_t)length * item_size);
+    if (q) {
+        q->length    = length;
+        q->item_size = item_size;
+    }
+    return q;
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks)
+{
+    (void)ticks;
+    if (q->count == q->length) return pdFALSE;
+    memcpy(&q->items[((q->head + q->count) % q->length) * q->item_size], item, q->item_size);
+    q->count++;
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *out, TickType_t ticks)
+{
+    (void)ticks;
+    if (q->count == 0) return pdFALSE;
+    memcpy(out, &q->items[q->head * q->item_size], q->item_size);
+    q->head = (q->head + 1) % q->length;
+    q->count--;
+    return pdTRUE;
+}
+
+BaseType_t xQueueReset(QueueHandle_t q)
+{
+    q->head = q->count = 0;
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q)
+{
+    return q->count;
+}
+
+// ── GPIO ──────────────────────────────────────────────────────────────────────
+
+static _Atomic int      s_gpio_level[GPIO_NUM_MAX];
+static _Atomic uint32_t s_gpio_writes[GPIO_NUM_MAX];
+static host_gpio_observer_t s_gpio_observer;
+static void                *s_gpio_observer_arg;
+
+void host_set_gpio_observer(host_gpio_observer_t fn, void *arg)
+{
+    s_gpio_observer     = fn;
+    s_gpio_observer_arg = arg;
+}
+
+int host_gpio_level(gpio_num_t pin)
+{
+    return atomic_load(&s_gpio_level[pin]);
+}
+
+uint32_t host_gpio_writes(gpio_num_t pin)
+{
+    return atomic_load(&s_gpio_writes[pin]);
+}
+
+esp_err_t gpio_config(const gpio_config_t *cfg)               { (void)cfg; return ESP_OK; }
+esp_err_t gpio_set_direction(gpio_num_t pin, gpio_mode_t mode) { (void)pin; (void)mode; return ESP_OK; }
+esp_err_t gpio_pullup_en(gpio_num_t pin)                      { (void)pin; return ESP_OK; }
+
+esp_err_t gpio_set_level(gpio_num_t pin, uint32_t level)
+{
+    if (pin < 0 || pin >= GPIO_NUM_MAX) return ESP_ERR_INVALID_ARG;
+    host_preempt_point();
+    if (s_gpio_observer) s_gpio_observer(pin, level, s_gpio_observer_arg);
+    atomic_store(&s_gpio_level[pin], (int)(level ? 1 : 0));
+    atomic_fetch_add(&s_gpio_writes[pin], 1);
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t pin)
+{
+    int level = host_gpio_level(pin);
+    return level < 0 ? 0 : level;
+}
+
+// ── UART (no port on the host) ────────────────────────────────────────────────
+
+esp_err_t uart_driver_install(uart_port_t port, int rx_size, int tx_size, int queue_size,
+                              QueueHandle_t *queue, int intr_flags)
+{
+    (void)port; (void)rx_size; (void)tx_size; (void)queue_size; (void)intr_flags;
+    if (queue) *queue = NULL;
+    return ESP_OK;
+}
+
+esp_err_t uart_param_config(uart_port_t port, const uart_config_t *cfg) { (void)port; (void)cfg; return ESP_OK; }
+esp_err_t uart_set_pin(uart_port_t port, int tx, int rx, int rts, int cts)
+{
+    (void)port; (void)tx; (void)rx; (void)rts; (void)cts;
+    return ESP_OK;
+}
+esp_err_t uart_set_rx_timeout(uart_port_t port, const uint8_t tout) { (void)port; (void)tout; return ESP_OK; }
+esp_err_t uart_flush_input(uart_port_t port)                        { (void)port; return ESP_OK; }
+esp_err_t uart_wait_tx_done(uart_port_t port, TickType_t ticks)     { (void)port; (void)ticks; return ESP_OK; }
+
+int uart_write_bytes(uart_port_t port, const void *src, size_t size)
+{
+    (void)port; (void)src;
+    return (int)size;
+}
+
+int uart_read_bytes(uart_port_t port, void *buf, uint32_t length, TickType_t ticks)
+{
+    (void)port; (void)buf; (void)length;
+    vTaskDelay(ticks);
+    return 0;
+}
+
+// ── NVS ───────────────────────────────────────────────────────────────────────
+
+#define HOST_NVS_MAX_NS      8
+#define HOST_NVS_MAX_ENTRIES 32
+
+typedef struct {
+    char     key[16];
+    uint32_t ns;
+    size_t   len;
+    void    *data;
+} nvs_entry_t;
+
+static char        s_nvs_ns[HOST_NVS_MAX_NS][16];
+static nvs_entry_t s_nvs[HOST_NVS_MAX_ENTRIES];
+
+void host_nvs_erase(void)
+{
+    for (int i = 0; i < HOST_NVS_MAX_ENTRIES; i++) free(s_nvs[i].data);
+    memset(s_nvs, 0, sizeof(s_nvs));
+    memset(s_nvs_ns, 0, sizeof(s_nvs_ns));
+}
+
+static nvs_entry_t *nvs_find(nvs_handle_t h, const char *key)
+{
+    for (int i = 0; i < HOST_NVS_MAX_ENTRIES; i++) {
+        if (s_nvs[i].data && s_nvs[i].ns == h && strcmp(s_nvs[i].key, key) == 0) return &s_nvs[i];
+    }
+    return NULL;
+}
+
+esp_err_t nvs_open(const char *ns, nvs_open_mode_t mode, nvs_handle_t *out)
+{
+    (void)mode;
+    for (uint32_t i = 0; i < HOST_NVS_MAX_NS; i++) {
+        if (s_nvs_ns[i][0] == '\0') strncpy(s_nvs_ns[i], ns, sizeof(s_nvs_ns[i]) - 1);
+        if (strcmp(s_nvs_ns[i], ns) == 0) {
+            *out = i + 1;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NVS_NO_FREE_PAGES;
+}
+
+void      nvs_close(nvs_handle_t h)  { (void)h; }
+esp_err_t nvs_commit(nvs_handle_t h) { (void)h; return ESP_OK; }
+
+esp_err_t nvs_get_blob(nvs_handle_t h, const char *key, void *out, size_t *len)
+{
+    nvs_entry_t *e = nvs_find(h, key);
+    if (!e) return ESP_ERR_NVS_NOT_FOUND;
+    if (out) {
+        if (*len < e->len) return ESP_ERR_INVALID_SIZE;
+        memcpy(out, e->data, e->len);
+    }
+    *len = e->len;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t h, const char *key, const void *value, size_t len)
+{
+    nvs_entry_t *e = nvs_find(h, key);
+    for (int i = 0; !e && i < HOST_NVS_MAX_ENTRIES; i++) {
+        if (!s_nvs[i].data) e = &s_nvs[i];
+    }
+    if (!e) return ESP_ERR_NVS_NO_FREE_PAGES;
+
+    void *copy = malloc(len ? len : 1);
+    if (!copy) return ESP_ERR_NO_MEM;
+    memcpy(copy, value, len);
+    free(e->data);
+    strncpy(e->key, key, sizeof(e->key) - 1);
+    e->ns   = h;
+    e->len  = len;
+    e->data = copy;
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t h, const char *key)
+{
+    nvs_entry_t *e = nvs_find(h, key);
+    if (!e) return ESP_ERR_NVS_NOT_FOUND;
+    free(e->data);
+    memset(e, 0, sizeof(*e));
+    return ESP_OK;
+}
+
+// ── Logging ───────────────────────────────────────────────────────────────────
+
+#define HOST_LOG_MAX_TAGS 32
+
+static struct {
+    const char     *tag;
+    esp_log_level_t level;
+} s_log_levels[HOST_LOG_MAX_TAGS];
+
+static esp_log_level_t s_log_default = ESP_LOG_WARN;
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    if (strcmp(tag, "*") == 0) {
+        s_log_default = level;
+        return;
+    }
+    for (int i = 0; i < HOST_LOG_MAX_TAGS; i++) {
+        if (!s_log_levels[i].tag || strcmp(s_log_levels[i].tag, tag) == 0) {
+            s_log_levels[i].tag   = tag;
+            s_log_levels[i].level = level;
+            return;
+        }
+    }
+}
+
+int host_log_enabled(const char *tag, esp_log_level_t level)
+{
+    for (int i = 0; i < HOST_LOG_MAX_TAGS && s_log_levels[i].tag; i++) {
+        if (strcmp(s_log_levels[i].tag, tag) == 0) return level <= s_log_levels[i].level;
+    }
+    return level <= s_log_default;
+}
+
+// ── Misc ──────────────────────────────────────────────────────────────────────
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+        case ESP_OK:                return "ESP_OK";
+        case ESP_FAIL:              return "ESP_FAIL";
+        case ESP_ERR_NO_MEM:        return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG:   return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE:  return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND:     return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_TIMEOUT:       return "ESP_ERR_TIMEOUT";
+        case ESP_ERR_INVALID_CRC:   return "ESP_ERR_INVALID_CRC";
+        case ESP_ERR_NVS_NOT_FOUND: return "ESP_ERR_NVS_NOT_FOUND";
+        default:                    return "ESP_ERR_UNKNOWN";
+    }
+}
+
+static uint32_t s_random = 0x2545F491u;
+
+uint32_t esp_random(void)
+{
+    // xorshift32: deterministic so test runs repeat exactly
+    s_random ^= s_random << 13;
+    s_random ^= s_random >> 17;
+    s_random ^= s_random << 5;
+    return s_random;
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    crc = ~crc;
+    while (len--) {
+        crc ^= *buf++;
+        for (int b = 0; b < 8; b++) crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+    }
+    return ~crc;
+}
+
+void esp_restart(void) { abort(); }
+esp_reset_reason_t esp_reset_reason(void) { return ESP_RST_POWERON; }
+
+cJSON *cJSON_GetObjectItem(const cJSON *object, const char *name)
+{
+    cJSON *item;
+    if (!object || !name) return NULL;
+    cJSON_ArrayForEach(item, object) {
+        if (item->string && strcmp(item->string, name) == 0) return item;
+    }
+    return NULL;
+}
+
+int cJSON_GetArraySize(const cJSON *array)
+{
+    int n = 0;
+    cJSON *item;
+    cJSON_ArrayForEach(item, array) n++;
+    return n;
+}
+
+char *cJSON_GetStringValue(const cJSON *item)
+{
+    return item && (item->type & cJSON_String) ? item->valuestring : NULL;
+}
+
+bool cJSON_IsNumber(const cJSON *item) { return item && (item->type & cJSON_Number); }
+bool cJSON_IsArray(const cJSON *item)  { return item && (item->type & cJSON_Array); }
+bool cJSON_IsObject(const cJSON *item) { return item && (item->type & cJSON_Object); }
+
+// ── Reset ─────────────────────────────────────────────────────────────────────
+
+void host_reset(void)
+{
+    atomic_store(&s_now_us, 0);
+    for (int i = 0; i < GPIO_NUM_MAX; i++) {
+        atomic_store(&s_gpio_level[i], -1);
+        atomic_store(&s_gpio_writes[i], 0);
+    }
+    s_gpio_observer = NULL;
+    s_preempt_fn    = NULL;
+    s_preempt_count = 0;
+    s_random        = 0x2545F491u;
+    host_nvs_erase();
+}
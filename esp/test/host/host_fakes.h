@@ -0,0 +1,59 @@
+#pragma once
+
+// ============================================================
+// Host fakes for the ESP-IDF / FreeRTOS surface the firmware uses
+//
+// Time is virtual: esp_timer_get_time() and xTaskGetTickCount() read one
+// microsecond clock that only tests move. NVS is an in-memory store, GPIO
+// writes are recorded, and a preemption hook lets a test run code at every
+// point where the target scheduler could switch tasks — each fake call made
+// outside a critical section.
+// ============================================================
+
+#include <stddef.h>
+#include <stdint.h>
+#include "driver/gpio.h"
+
+/**
+ * @brief Clear every fake: clock to zero, NVS empty, pin history and hooks off.
+ */
+void host_reset(void);
+
+// ── Clock ─────────────────────────────────────────────────────────────────────
+
+void    host_set_time_us(int64_t us);
+void    host_advance_us(int64_t us);
+void    host_advance_ms(uint32_t ms);
+int64_t host_time_us(void);
+
+// ── GPIO ──────────────────────────────────────────────────────────────────────
+
+typedef void (*host_gpio_observer_t)(gpio_num_t pin, uint32_t level, void *arg);
+
+/**
+ * @brief Call fn on every gpio_set_level(), before the level is recorded.
+ */
+void     host_set_gpio_observer(host_gpio_observer_t fn, void *arg);
+int      host_gpio_level(gpio_num_t pin);     // last level written, -1 if never
+uint32_t host_gpio_writes(gpio_num_t pin);    // number of writes since reset
+
+// ── Scheduling ────────────────────────────────────────────────────────────────
+
+typedef void (*host_preempt_fn_t)(void *arg);
+
+/**
+ * @brief Run fn at every preemption point on this thread until cleared.
+ *
+ * The hook never fires inside portENTER_CRITICAL, and never re-enters itself.
+ */
+void host_set_preempt_hook(host_preempt_fn_t fn, void *arg);
+void host_preempt_point(void);
+
+/**
+ * @brief Number of preemption points reached since the hook was installed.
+ */
+uint32_t host_preempt_count(void);
+
+// ── NVS ───────────────────────────────────────────────────────────────────────
+
+void host_nvs_erase(void);
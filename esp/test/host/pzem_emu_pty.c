@@ -0,0 +1,110 @@
+#define _GNU_SOURCE
+#include "pzem_emu_pty.h"
+#include "host_fakes.h"
+#include "pzem_emulator.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PTY_FRAME_GAP_MS    5       // 3.5 characters at 9600 baud, rounded up
+#define PTY_REQ_MAX         64
+
+static int64_t mono_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void sleep_ms(uint32_t ms)
+{
+    struct timespec ts = { .tv_sec = ms / 1000, .tv_nsec = (long)(ms % 1000) * 1000000L };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {}
+}
+
+int pzem_emu_pty_open(char *slave_path, size_t cap)
+{
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0) return -1;
+    if (grantpt(master) != 0 || unlockpt(master) != 0 ||
+        ptsname_r(master, slave_path, cap) != 0) {
+        close(master);
+        return -1;
+    }
+
+    // Raw 8N1: no echo, no line discipline, bytes pass through untouched
+    struct termios tio;
+    if (tcgetattr(master, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(master, TCSANOW, &tio);
+    }
+
+    pzem_emulator_init();
+    return master;
+}
+
+// Collect one request: block for the first byte, then read until the line
+// has been idle for a frame gap. Returns 0 on stop, -1 on a closed link.
+static int read_request(int fd, uint8_t *buf, size_t cap, atomic_bool *stop)
+{
+    size_t len = 0;
+    for (;;) {
+        struct pollfd p = { .fd = fd, .events = POLLIN };
+        int r = poll(&p, 1, len ? PTY_FRAME_GAP_MS : 50);
+        if (r < 0 && errno != EINTR) return -1;
+        if (r == 0) {
+            if (len) return (int)len;
+            if (stop && atomic_load(stop)) return 0;
+            continue;
+        }
+        if (r < 0) continue;
+        if (p.revents & POLLHUP) {
+            // No slave open yet (or the client went away): wait for one
+            if (stop && atomic_load(stop)) return 0;
+            sleep_ms(10);
+            continue;
+        }
+
+        uint8_t chunk[PTY_REQ_MAX];
+        ssize_t n = read(fd, chunk, sizeof(chunk));
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EIO) continue;
+            return -1;
+        }
+        size_t take = (size_t)n < cap - len ? (size_t)n : cap - len;
+        memcpy(buf + len, chunk, take);
+        len += take;
+    }
+}
+
+unsigned pzem_emu_pty_serve(int master_fd, unsigned max_requests, atomic_bool *stop)
+{
+    int64_t  t0      = mono_us();
+    unsigned handled = 0;
+
+    while (!max_requests || handled < max_requests) {
+        uint8_t req[PTY_REQ_MAX];
+        int len = read_request(master_fd, req, sizeof(req), stop);
+        if (len <= 0) break;
+        handled++;
+
+        // The emulator's script clock follows wall time while it serves
+        host_set_time_us(mono_us() - t0);
+
+        uint8_t  resp[32];
+        uint32_t delay_ms = 0;
+        size_t   n = pzem_emulator_respond(req, (size_t)len, resp, sizeof(resp), &delay_ms);
+        if (n == 0) continue;       // silent meter: the master times out
+
+        sleep_ms(delay_ms);
+        if (write(master_fd, resp, n) != (ssize_t)n) break;
+    }
+    return handled;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+// ============================================================
+// PZEM-004T emulator behind a Linux pseudo-terminal
+//
+// The master side is served here; the slave side (/dev/pts/N) behaves like
+// the USB-RS485 adapter a real meter hangs off, so anything that opens a
+// serial port — a Modbus tool, a Python script, a test — talks to the same
+// pzem_emulator_respond() the firmware uses in-process. Requests are framed
+// by the inter-frame gap and each reply is written after the latency the
+// emulator asks for, so timeouts and fault injection behave as on the wire.
+// ============================================================
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+/**
+ * @brief Open a raw pty pair and initialise the emulated meters.
+ * @param slave_path  Receives the slave device path.
+ * @return Master fd, or -1 on error.
+ */
+int pzem_emu_pty_open(char *slave_path, size_t cap);
+
+/**
+ * @brief Answer requests on the master fd until *stop is set or
+ *        max_requests frames have been handled (0 = no limit).
+ * @return Number of request frames handled.
+ */
+unsigned pzem_emu_pty_serve(int master_fd, unsigned max_requests, atomic_bool *stop);
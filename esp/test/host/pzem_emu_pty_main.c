@@ -0,0 +1,76 @@
+// Serve the PZEM-004T emulator on a pty until interrupted:
+//
+//   pzem_emu_pty [-s scenario] [-x silent%] [-g garble%] [-t truncate%]
+//                [-d delay_ms] [-j jitter_ms] [-l symlink]
+//
+// The slave path is printed on stdout; -l also links it (e.g. /tmp/ttyPZEM)
+// so clients can use a fixed name.
+
+#include "pzem_emu_pty.h"
+#include "pzem_emulator.h"
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static atomic_bool s_stop;
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    atomic_store(&s_stop, true);
+}
+
+int main(int argc, char **argv)
+{
+    pzem_emu_scenario_t scenario = PZEM_EMU_STEADY;
+    pzem_emu_faults_t   faults   = { 0 };
+    const char         *link     = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:x:g:t:d:j:l:")) != -1) {
+        switch (opt) {
+            case 's': scenario              = (pzem_emu_scenario_t)atoi(optarg); break;
+            case 'x': faults.silent_pct     = (uint8_t)atoi(optarg);             break;
+            case 'g': faults.garble_pct     = (uint8_t)atoi(optarg);             break;
+            case 't': faults.truncate_pct   = (uint8_t)atoi(optarg);             break;
+            case 'd': faults.extra_delay_ms = (uint16_t)atoi(optarg);            break;
+            case 'j': faults.jitter_ms      = (uint16_t)atoi(optarg);            break;
+            case 'l': link                  = optarg;                            break;
+            default:
+                fprintf(stderr, "usage: %s [-s scenario] [-x silent%%] [-g garble%%] "
+                                "[-t truncate%%] [-d delay_ms] [-j jitter_ms] [-l symlink]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (scenario >= PZEM_EMU_SCENARIO_COUNT) {
+        fprintf(stderr, "scenario must be 0..%d\n", PZEM_EMU_SCENARIO_COUNT - 1);
+        return 2;
+    }
+
+    char slave[64];
+    int  fd = pzem_emu_pty_open(slave, sizeof(slave));
+    if (fd < 0) {
+        perror("posix_openpt");
+        return 1;
+    }
+    pzem_emulator_set_scenario(0, scenario);
+    pzem_emulator_set_faults(0, &faults);
+
+    if (link) {
+        unlink(link);
+        if (symlink(slave, link) != 0) perror("symlink");
+    }
+    printf("%s\n", slave);
+    fflush(stdout);
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    unsigned n = pzem_emu_pty_serve(fd, 0, &s_stop);
+
+    if (link) unlink(link);
+    fprintf(stderr, "served %u request(s)\n", n);
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+// Host stand-in for the cJSON accessors the firmware uses. There is no parser:
+// tests that need a document build the node tree by hand.
+
+#include <stdbool.h>
+
+#define cJSON_Invalid  0
+#define cJSON_False    (1 << 0)
+#define cJSON_True     (1 << 1)
+#define cJSON_NULL     (1 << 2)
+#define cJSON_Number   (1 << 3)
+#define cJSON_String   (1 << 4)
+#define cJSON_Array    (1 << 5)
+#define cJSON_Object   (1 << 6)
+
+typedef struct cJSON {
+    struct cJSON *next;
+    struct cJSON *prev;
+    struct cJSON *child;
+    int           type;
+    char         *valuestring;
+    int           valueint;
+    double        valuedouble;
+    char         *string;
+} cJSON;
+
+cJSON *cJSON_GetObjectItem(const cJSON *object, const char *name);
+int    cJSON_GetArraySize(const cJSON *array);
+char  *cJSON_GetStringValue(const cJSON *item);
+bool   cJSON_IsNumber(const cJSON *item);
+bool   cJSON_IsArray(const cJSON *item);
+bool   cJSON_IsObject(const cJSON *item);
+
+#define cJSON_ArrayForEach(element, array) \
+    for (element = (array) != NULL ? (array)->child : NULL; element != NULL; element = element->next)
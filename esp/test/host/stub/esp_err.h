@@ -0,0 +1,28 @@
+#pragma once
+
+// Host stand-in for ESP-IDF esp_err.h
+
+#include <stdint.h>
+
+typedef int esp_err_t;
+
+#define ESP_OK                          0
+#define ESP_FAIL                        -1
+#define ESP_ERR_NO_MEM                  0x101
+#define ESP_ERR_INVALID_ARG             0x102
+#define ESP_ERR_INVALID_STATE           0x103
+#define ESP_ERR_INVALID_SIZE            0x104
+#define ESP_ERR_NOT_FOUND               0x105
+#define ESP_ERR_NOT_SUPPORTED           0x106
+#define ESP_ERR_TIMEOUT                 0x107
+#define ESP_ERR_INVALID_RESPONSE        0x108
+#define ESP_ERR_INVALID_CRC             0x109
+#define ESP_ERR_INVALID_VERSION         0x10A
+#define ESP_ERR_NVS_NOT_FOUND           0x1102
+#define ESP_ERR_NVS_NO_FREE_PAGES       0x110d
+#define ESP_ERR_NVS_NEW_VERSION_FOUND   0x1110
+
+const char *esp_err_to_name(esp_err_t code);
+
+#define ESP_ERROR_CHECK(x)                  (void)(x)
+#define ESP_ERROR_CHECK_WITHOUT_ABORT(x)    (x)
@@ -0,0 +1,27 @@
+#pragma once
+
+// Host stand-in for ESP-IDF esp_log.h: ESP_LOGx print to stdout unless the
+// tag has been silenced with esp_log_level_set().
+
+#include <stdio.h>
+
+typedef enum {
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE,
+} esp_log_level_t;
+
+void esp_log_level_set(const char *tag, esp_log_level_t level);
+int  host_log_enabled(const char *tag, esp_log_level_t level);
+
+#define HOST_LOG(lvl, c, tag, fmt, ...) \
+    do { if (host_log_enabled(tag, lvl)) printf(c " (%s) " fmt "\n", tag, ##__VA_ARGS__); } while (0)
+
+#define ESP_LOGE(tag, fmt, ...) HOST_LOG(ESP_LOG_ERROR,   "E", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) HOST_LOG(ESP_LOG_WARN,    "W", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) HOST_LOG(ESP_LOG_INFO,    "I", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) HOST_LOG(ESP_LOG_DEBUG,   "D", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGV(tag, fmt, ...) HOST_LOG(ESP_LOG_VERBOSE, "V", tag, fmt, ##__VA_ARGS__)
@@ -0,0 +1,7 @@
+#pragma once
+
+// Host stand-in for ESP-IDF esp_random.h (deterministic sequence).
+
+#include <stdint.h>
+
+uint32_t esp_random(void);
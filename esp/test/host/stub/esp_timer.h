@@ -0,0 +1,7 @@
+#pragma once
+
+// Host stand-in for ESP-IDF esp_timer.h, driven by host_fakes.
+
+#include <stdint.h>
+
+int64_t esp_timer_get_time(void);
@@ -0,0 +1,37 @@
+#pragma once
+
+// Host stand-in for FreeRTOS.h at the target's 100 Hz tick. Critical sections
+// take a real recursive spinlock so multi-threaded tests see the same mutual
+// exclusion the dual-core target gets from portMUX.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint32_t     TickType_t;
+typedef int          BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdTRUE              1
+#define pdFALSE             0
+#define pdPASS              1
+#define pdFAIL              0
+#define portMAX_DELAY       0xFFFFFFFFu
+#define configTICK_RATE_HZ  100
+#define portTICK_PERIOD_MS  (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms)   ((TickType_t)((uint64_t)(ms) * configTICK_RATE_HZ / 1000))
+
+typedef struct {
+    const void *volatile owner;
+    int count;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED { NULL, 0 }
+
+void host_critical_enter(portMUX_TYPE *mux);
+void host_critical_exit(portMUX_TYPE *mux);
+
+#define portENTER_CRITICAL(mux)     host_critical_enter(mux)
+#define portEXIT_CRITICAL(mux)      host_critical_exit(mux)
+#define portENTER_CRITICAL_ISR(mux) host_critical_enter(mux)
+#define portEXIT_CRITICAL_ISR(mux)  host_critical_exit(mux)
@@ -0,0 +1,13 @@
+#pragma once
+
+// Host stand-in for FreeRTOS queue.h (single-threaded ring buffer).
+
+#include "FreeRTOS.h"
+
+typedef struct host_queue *QueueHandle_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+BaseType_t    xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks);
+BaseType_t    xQueueReceive(QueueHandle_t q, void *out, TickType_t ticks);
+BaseType_t    xQueueReset(QueueHandle_t q);
+UBaseType_t   uxQueueMessagesWaiting(QueueHandle_t q);
@@ -0,0 +1,12 @@
+#pragma once
+
+// Host stand-in for FreeRTOS semphr.h. A taken mutex makes further takes fail
+// at once, which is how tests model a holder that outlasts the timeout.
+
+#include "FreeRTOS.h"
+
+typedef struct host_sem *SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+BaseType_t        xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t        xSemaphoreGive(SemaphoreHandle_t sem);
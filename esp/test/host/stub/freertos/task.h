@@ -0,0 +1,15 @@
+#pragma once
+
+// Host stand-in for FreeRTOS task.h. Tasks are never started; delays advance
+// the fake clock instead of sleeping.
+
+#include "FreeRTOS.h"
+
+typedef void *TaskHandle_t;
+
+TickType_t xTaskGetTickCount(void);
+void       vTaskDelay(TickType_t ticks);
+BaseType_t xTaskCreate(void (*fn)(void *), const char *name, uint32_t stack,
+                       void *arg, UBaseType_t prio, TaskHandle_t *out);
+BaseType_t xTaskCreatePinnedToCore(void (*fn)(void *), const char *name, uint32_t stack,
+                                   void *arg, UBaseType_t prio, TaskHandle_t *out, int core);
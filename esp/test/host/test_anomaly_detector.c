@@ -0,0 +1,347 @@
+// Rule-engine behaviour of anomaly_analyze() against the default table,
+// fed synthetic fast-poll and full-read samples on a virtual clock.
+
+#include "anomaly_detector.h"
+#include "anomaly_rules.h"
+#include "pzem_sensor.h"
+#include "relay_control.h"
+#include "config.h"
+#include "test_util.h"
+
+#include <string.h>
+
+#define POLL_MS     200
+
+void pzem_sensor_set_power_alarm(uint32_t watts) { (void)watts; }
+
+static uint32_t s_now;
+
+static void setup(void)
+{
+    anomaly_rules_init();
+    anomaly_detector_init();
+    s_now = 0;
+}
+
+static pzem_data_t fast_sample(uint32_t i_ma)
+{
+    pzem_data_t d = { .i_ma = i_ma, .v_dv = 2300, .current_only = true, .valid = true };
+    s_now += POLL_MS;
+    d.timestamp = s_now;
+    return d;
+}
+
+// Feed constant current until an onset of `type` (or limit_ms); returns the
+// time of the onset relative to start_ms, or UINT32_MAX if none came.
+static uint32_t run_until_onset(uint32_t i_ma, anomaly_type_t type, uint32_t limit_ms,
+                                anomaly_event_t *out)
+{
+    uint32_t start = s_now;
+    while (s_now - start < limit_ms) {
+        pzem_data_t     d = fast_sample(i_ma);
+        anomaly_event_t ev[ANOMALY_TYPE_COUNT];
+        uint8_t n = anomaly_analyze(&d, ev, ANOMALY_TYPE_COUNT);
+        for (uint8_t k = 0; k < n; k++) {
+            if (ev[k].type == type && ev[k].phase == ANOMALY_PHASE_ONSET) {
+                if (out) *out = ev[k];
+                return s_now - start;
+            }
+        }
+    }
+    return UINT32_MAX;
+}
+
+static void feed(uint32_t i_ma, uint32_t ms)
+{
+    for (uint32_t t = 0; t < ms; t += POLL_MS) {
+        pzem_data_t     d = fast_sample(i_ma);
+        anomaly_event_t ev[ANOMALY_TYPE_COUNT];
+        anomaly_analyze(&d, ev, ANOMALY_TYPE_COUNT);
+    }
+}
+
+static anomaly_ruleset_t active_table(void)
+{
+    anomaly_ruleset_t copy = *anomaly_rules_acquire();
+    anomaly_rules_release();
+    return copy;
+}
+
+static int rule_index(const anomaly_ruleset_t *set, uint8_t metric)
+{
+    for (uint8_t i = 0; i < set->count; i++) {
+        if (set->rules[i].metric == metric) return i;
+    }
+    return -1;
+}
+
+// ── Inverse-time overcurrent ──────────────────────────────────────────────────
+
+static void test_thermal_trip_times(void)
+{
+    // K = 1960 A²s at 28 A rated: 42 A → 1960 / (42² − 28²) = 2 s
+    setup();
+    anomaly_event_t ev;
+    feed(0, POLL_MS);                       // first sample starts the integrator
+    uint32_t t = run_until_onset(42000, ANOMALY_OVERCURRENT, 10000, &ev);
+    CHECK(t >= 2000 && t <= 2000 + POLL_MS);
+    CHECK(ev.relay_triggered);
+
+    // 45 A → 1960 / 1241 = 1.58 s
+    setup();
+    feed(0, POLL_MS);
+    t = run_until_onset(45000, ANOMALY_OVERCURRENT, 10000, NULL);
+    CHECK(t >= 1579 && t <= 1579 + POLL_MS);
+
+    // 29 A → 1960 / 57 = 34.4 s
+    setup();
+    feed(0, POLL_MS);
+    t = run_until_onset(29000, ANOMALY_OVERCURRENT, 60000, NULL);
+    CHECK(t >= 34386 && t <= 34386 + POLL_MS);
+
+    // at rated current it never trips
+    setup();
+    feed(0, POLL_MS);
+    CHECK_EQ(run_until_onset(28000, ANOMALY_OVERCURRENT, 120000, NULL), UINT32_MAX);
+}
+
+static void test_thermal_heat_survives_unrelated_publish(void)
+{
+    setup();
+    feed(0, POLL_MS);
+    feed(42000, 1000);                      // half of the 2 s budget
+
+    anomaly_ruleset_t set = active_table();
+    int ov = rule_index(&set, RULE_METRIC_VOLTAGE);
+    CHECK(ov >= 0);
+    set.version++;
+    set.rules[ov].threshold += 10;
+    CHECK_EQ(anomaly_rules_apply(&set), ESP_OK);
+
+    uint32_t t = run_until_onset(42000, ANOMALY_OVERCURRENT, 10000, NULL);
+    CHECK(t <= 1000 + POLL_MS);             // the remaining half, not a fresh 2 s
+}
+
+static void test_thermal_heat_survives_reset(void)
+{
+    setup();
+    feed(0, POLL_MS);
+    feed(42000, 1000);
+
+    anomaly_detector_request_reset();       // relay reset from the dashboard
+    uint32_t t = run_until_onset(42000, ANOMALY_OVERCURRENT, 10000, NULL);
+    CHECK(t <= 1000 + POLL_MS);
+}
+
+static void test_thermal_heat_survives_cooling_edit(void)
+{
+    setup();
+    feed(0, POLL_MS);
+    feed(42000, 1000);
+
+    anomaly_ruleset_t set = active_table();
+    int th = rule_index(&set, RULE_METRIC_THERMAL);
+    set.version++;
+    set.rules[th].arg2 *= 2;                // τ only: same rated current and K
+    CHECK_EQ(anomaly_rules_apply(&set), ESP_OK);
+
+    uint32_t t = run_until_onset(42000, ANOMALY_OVERCURRENT, 10000, NULL);
+    CHECK(t <= 1000 + POLL_MS);
+}
+
+static void test_thermal_heat_reset_when_limit_changes(void)
+{
+    setup();
+    feed(0, POLL_MS);
+    feed(42000, 1000);
+
+    // Two publishes between samples bring the detector's old buffer back:
+    // the K change must still be seen.
+    anomaly_ruleset_t set = active_table();
+    int th = rule_index(&set, RULE_METRIC_THERMAL);
+    int ov = rule_index(&set, RULE_METRIC_VOLTAGE);
+    set.version++;
+    set.rules[th].arg = 2 * OVERCURRENT_TRIP_K_A2S;
+    CHECK_EQ(anomaly_rules_apply(&set), ESP_OK);
+    set.version++;
+    set.rules[ov].threshold += 10;
+    CHECK_EQ(anomaly_rules_apply(&set), ESP_OK);
+
+    // fresh integrator against K = 3920: 4 s, plus the re-start sample
+    uint32_t t = run_until_onset(42000, ANOMALY_OVERCURRENT, 10000, NULL);
+    CHECK(t >= 4000 && t <= 4000 + 2 * POLL_MS);
+}
+
+// ── Episode ownership ─────────────────────────────────────────────────────────
+
+// OVERCURRENT reported from 20 A, tripped from 35 A after 400 ms
+static void apply_log_and_trip_rules(void)
+{
+    anomaly_ruleset_t set = {
+        .version = 1,
+        .count   = 2,
+        .rules   = {
+            { .type = ANOMALY_OVERCURRENT, .metric = RULE_METRIC_CURRENT, .cmp = RULE_CMP_GT,
+              .severity = RULE_SEVERITY_MEDIUM, .action = RULE_ACTION_LOG, .threshold = 20000 },
+            { .type = ANOMALY_OVERCURRENT, .metric = RULE_METRIC_CURRENT, .cmp = RULE_CMP_GT,
+              .severity = RULE_SEVERITY_HIGH, .action = RULE_ACTION_TRIP, .confirm_ms = 400,
+              .threshold = 35000 },
+        },
+    };
+    CHECK_EQ(anomaly_rules_apply(&set), ESP_OK);
+}
+
+static void test_trip_rule_escalates_log_episode(void)
+{
+    setup();
+    apply_log_and_trip_rules();
+
+    anomaly_event_t onset;
+    CHECK_EQ(run_until_onset(25000, ANOMALY_OVERCURRENT, 1000, &onset), POLL_MS);
+    CHECK(!onset.relay_triggered);
+    feed(25000, 2000);
+
+    anomaly_event_t trip;
+    uint32_t t = run_until_onset(40000, ANOMALY_OVERCURRENT, 5000, &trip);
+    CHECK(t >= 400 && t <= 400 + POLL_MS);
+    CHECK(trip.relay_triggered);
+    CHECK_EQ(trip.episode_id, onset.episode_id);
+    CHECK_EQ(trip.severity, RULE_SEVERITY_HIGH);
+    CHECK_EQ(trip.peak, 40000);
+
+    // the trip rule owns the episode now: no second trip onset while it lasts
+    CHECK_EQ(run_until_onset(40000, ANOMALY_OVERCURRENT, 3000, NULL), UINT32_MAX);
+}
+
+static void test_trip_rule_opens_when_both_confirm(void)
+{
+    setup();
+    apply_log_and_trip_rules();
+
+    // the log rule confirms at once but must not claim the episode for good
+    anomaly_event_t ev[2];
+    uint32_t n_onsets = 0, n_trips = 0;
+    for (uint32_t t = 0; t < 2000; t += POLL_MS) {
+        pzem_data_t     d = fast_sample(40000);
+        anomaly_event_t out[ANOMALY_TYPE_COUNT];
+        uint8_t n = anomaly_analyze(&d, out, ANOMALY_TYPE_COUNT);
+        for (uint8_t k = 0; k < n; k++) {
+            if (out[k].phase != ANOMALY_PHASE_ONSET) continue;
+            if (n_onsets < 2) ev[n_onsets] = out[k];
+            n_onsets++;
+            if (out[k].relay_triggered) n_trips++;
+        }
+    }
+    CHECK_EQ(n_trips, 1);
+    CHECK_EQ(n_onsets, 2);
+    CHECK_EQ(ev[1].episode_id, ev[0].episode_id);
+}
+
+// ── Reset handoff ─────────────────────────────────────────────────────────────
+
+// OVERCURRENT tripped from 35 A after 400 ms
+static void apply_trip_rule(void)
+{
+    anomaly_ruleset_t set = {
+        .version = 1,
+        .count   = 1,
+        .rules   = {
+            { .type = ANOMALY_OVERCURRENT, .metric = RULE_METRIC_CURRENT, .cmp = RULE_CMP_GT,
+              .severity = RULE_SEVERITY_HIGH, .action = RULE_ACTION_TRIP, .confirm_ms = 400,
+              .threshold = 35000 },
+        },
+    };
+    CHECK_EQ(anomaly_rules_apply(&set), ESP_OK);
+}
+
+static void test_requested_reset_runs_in_next_analyze(void)
+{
+    setup();
+    apply_trip_rule();
+    feed(40000, POLL_MS);                               // confirm timer running
+    CHECK_EQ(run_until_onset(40000, ANOMALY_OVERCURRENT, 2000, NULL), 400);
+
+    setup();
+    apply_trip_rule();
+    feed(40000, POLL_MS);
+    anomaly_detector_request_reset();                   // as the HTTP task does
+
+    // the first pass restarts the timer; a flag left set would restart it
+    // on every pass and the trip would never confirm
+    CHECK_EQ(run_until_onset(40000, ANOMALY_OVERCURRENT, 2000, NULL), 400 + POLL_MS);
+}
+
+// ── Re-trip after a reset ─────────────────────────────────────────────────────
+
+static uint32_t        s_trips;
+static anomaly_event_t s_trip_onset;
+
+// One sample through the detector and the read task's trip decision: trip
+// on any confirmed trip rule while the relay is not already open
+static void sense(uint32_t i_ma)
+{
+    pzem_data_t     d = fast_sample(i_ma);
+    anomaly_event_t ev[ANOMALY_TYPE_COUNT];
+    uint8_t n = anomaly_analyze(&d, ev, ANOMALY_TYPE_COUNT);
+    for (uint8_t k = 0; k < n; k++) {
+        if (ev[k].type == ANOMALY_OVERCURRENT && ev[k].phase == ANOMALY_PHASE_ONSET &&
+            ev[k].relay_triggered) {
+            s_trip_onset = ev[k];
+        }
+    }
+    uint32_t due = anomaly_detector_trips_due(d.channel);
+    if (due && relay_get_state() != RELAY_STATE_TRIPPED) {
+        relay_trip((anomaly_type_t)__builtin_ctz(due));
+        s_trips++;
+    }
+}
+
+static void test_reset_into_persisting_fault_trips_again(void)
+{
+    setup();
+    apply_trip_rule();
+    relay_init();
+    host_advance_ms(RELAY_COOLDOWN_MS);
+    CHECK_EQ(relay_set_state(RELAY_STATE_ON), ESP_OK);
+    s_trips = 0;
+
+    for (uint32_t t = 0; t < 2000 && !s_trips; t += POLL_MS) sense(40000);
+    CHECK_EQ(s_trips, 1);
+    CHECK_EQ(relay_get_state(), RELAY_STATE_TRIPPED);
+    uint32_t episode = s_trip_onset.episode_id;
+
+    // Reset and switch back on inside the clear hold: the episode is still
+    // open when the relay closes into the same fault
+    CHECK_EQ(relay_set_state(RELAY_STATE_OFF), ESP_OK);
+    anomaly_detector_request_reset();
+    for (uint32_t t = 0; t < RELAY_COOLDOWN_MS; t += POLL_MS) sense(0);
+    host_advance_ms(RELAY_COOLDOWN_MS);
+    CHECK(RELAY_COOLDOWN_MS < ANOMALY_CLEAR_HOLD_MS);
+    CHECK_EQ(relay_set_state(RELAY_STATE_ON), ESP_OK);
+
+    memset(&s_trip_onset, 0, sizeof(s_trip_onset));
+    for (uint32_t t = 0; t < 2000 && s_trips < 2; t += POLL_MS) sense(40000);
+    CHECK_EQ(s_trips, 2);
+    CHECK_EQ(relay_get_state(), RELAY_STATE_TRIPPED);
+    CHECK_EQ(s_trip_onset.episode_id, episode);     // reported again, same episode
+
+    // open again: nothing more to report until the next reset
+    memset(&s_trip_onset, 0, sizeof(s_trip_onset));
+    for (uint32_t t = 0; t < 2000; t += POLL_MS) sense(40000);
+    CHECK_EQ(s_trips, 2);
+    CHECK_EQ(s_trip_onset.episode_id, 0);
+}
+
+int main(void)
+{
+    RUN_TEST(test_thermal_trip_times);
+    RUN_TEST(test_thermal_heat_survives_unrelated_publish);
+    RUN_TEST(test_thermal_heat_survives_reset);
+    RUN_TEST(test_thermal_heat_survives_cooling_edit);
+    RUN_TEST(test_thermal_heat_reset_when_limit_changes);
+    RUN_TEST(test_trip_rule_escalates_log_episode);
+    RUN_TEST(test_trip_rule_opens_when_both_confirm);
+    RUN_TEST(test_requested_reset_runs_in_next_analyze);
+    RUN_TEST(test_reset_into_persisting_fault_trips_again);
+    TEST_MAIN_END();
+}
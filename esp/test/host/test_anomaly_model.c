@@ -0,0 +1,264 @@
+// Int8 autoencoder scorer: the kernel against a plain reference, the
+// window features it is fed, and the confirm / holdoff logic around it.
+
+#include "anomaly_model.h"
+#include "config.h"
+#include "test_util.h"
+
+#include <string.h>
+
+static uint32_t s_rng = 0x2545F491u;
+
+static uint32_t rnd(void)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return s_rng;
+}
+
+static int32_t clamp(int64_t v, int32_t lo, int32_t hi)
+{
+    return v < lo ? lo : v > hi ? hi : (int32_t)v;
+}
+
+// The formula in anomaly_model.h, written out with no shortcuts
+static uint32_t score_reference(const anomaly_model_t *m, const int32_t x[ANOMALY_MODEL_FEATURES])
+{
+    int32_t q[ANOMALY_MODEL_FEATURES], h[ANOMALY_MODEL_MAX_HIDDEN];
+    for (int k = 0; k < ANOMALY_MODEL_FEATURES; k++) {
+        q[k] = clamp((((int64_t)x[k] - m->center[k]) * m->mult[k]) >> 16, -127, 127);
+    }
+    for (int j = 0; j < m->n_hidden; j++) {
+        int64_t acc = m->b1[j];
+        for (int k = 0; k < ANOMALY_MODEL_FEATURES; k++) acc += (int64_t)m->w1[j][k] * q[k];
+        h[j] = clamp((acc > 0 ? acc : 0) >> m->shift1, 0, 127);
+    }
+    uint32_t score = 0;
+    for (int k = 0; k < ANOMALY_MODEL_FEATURES; k++) {
+        int64_t acc = m->b2[k];
+        for (int j = 0; j < m->n_hidden; j++) acc += (int64_t)m->w2[k][j] * h[j];
+        int32_t e = q[k] - clamp(acc >> m->shift2, -127, 127);
+        score += (uint32_t)(e * e);
+    }
+    return score;
+}
+
+static void random_model(anomaly_model_t *m)
+{
+    memset(m, 0, sizeof(*m));
+    m->version  = 1;
+    m->n_hidden = 1 + rnd() % ANOMALY_MODEL_MAX_HIDDEN;
+    m->shift1   = rnd() % 10;
+    m->shift2   = rnd() % 10;
+    m->confirm  = 1;
+    m->threshold = 1;
+    for (int k = 0; k < ANOMALY_MODEL_FEATURES; k++) {
+        m->center[k] = (int32_t)(rnd() % 100000) - 50000;
+        m->mult[k]   = (int32_t)(rnd() % (1 << 18));
+        m->b2[k]     = (int32_t)(rnd() % 20001) - 10000;
+        for (int j = 0; j < ANOMALY_MODEL_MAX_HIDDEN; j++) {
+            m->w1[j][k] = (int8_t)rnd();
+            m->w2[k][j] = (int8_t)rnd();
+        }
+    }
+    for (int j = 0; j < ANOMALY_MODEL_MAX_HIDDEN; j++) m->b1[j] = (int32_t)(rnd() % 20001) - 10000;
+}
+
+// Reconstructs every input as 1, so every window scores Σ (q − 1)² and
+// with mult = 0 that is exactly ANOMALY_MODEL_FEATURES: flags expose the
+// window features without the weights getting in the way
+static void constant_model(anomaly_model_t *m, uint8_t confirm)
+{
+    memset(m, 0, sizeof(*m));
+    m->version   = 7;
+    m->n_hidden  = 1;
+    m->confirm   = confirm;
+    m->threshold = ANOMALY_MODEL_FEATURES;
+    for (int k = 0; k < ANOMALY_MODEL_FEATURES; k++) m->b2[k] = 1;
+}
+
+static pzem_data_t reading(uint32_t t_ms, uint16_t v_dv, uint32_t i_ma)
+{
+    return (pzem_data_t){ .timestamp = t_ms, .v_dv = v_dv, .i_ma = i_ma,
+                          .power_dw = (uint32_t)v_dv * i_ma / 1000, .pf_pct = 95,
+                          .freq_dhz = 600, .valid = true };
+}
+
+// ── Kernel ────────────────────────────────────────────────────────────────────
+
+static void test_kernel_matches_reference(void)
+{
+    static anomaly_model_t m;
+    for (int r = 0; r < 2000; r++) {
+        random_model(&m);
+        int32_t x[ANOMALY_MODEL_FEATURES];
+        for (int k = 0; k < ANOMALY_MODEL_FEATURES; k++) x[k] = (int32_t)(rnd() % 200000) - 100000;
+        uint32_t got = anomaly_model_score(&m, x), want = score_reference(&m, x);
+        if (got != want) {
+            CHECK_EQ(got, want);
+            return;
+        }
+    }
+}
+
+static void test_kernel_saturates(void)
+{
+    static anomaly_model_t m;
+    constant_model(&m, 1);
+    for (int k = 0; k < ANOMALY_MODEL_FEATURES; k++) {
+        m.mult[k] = 1 << 16;        // one LSB per native unit
+        m.b2[k]   = -(1 << 20);     // output pinned at −127
+    }
+    int32_t x[ANOMALY_MODEL_FEATURES];
+    for (int k = 0; k < ANOMALY_MODEL_FEATURES; k++) x[k] = INT32_MAX;
+
+    // every input clamps to +127, every output to −127
+    CHECK_EQ(anomaly_model_score(&m, x), ANOMALY_MODEL_FEATURES * 254 * 254);
+}
+
+// ── Windows ───────────────────────────────────────────────────────────────────
+
+static void test_window_features(void)
+{
+    static anomaly_model_t m;
+    constant_model(&m, 1);
+    anomaly_model_init();
+    CHECK_EQ(anomaly_model_apply(&m), ESP_OK);
+
+    // Load toggling 2 A / 6 A on a 0.5 Ω source: V sags 2 V with the 4 A step
+    anomaly_model_flag_t flag;
+    int flags = 0;
+    for (uint32_t k = 0; k < ANOMALY_MODEL_WINDOW; k++) {
+        uint32_t    i = k % 2 ? 6000 : 2000;
+        pzem_data_t d = reading(1000 + k * PZEM_READ_INTERVAL_MS, (uint16_t)(2310 - i / 200), i);
+        d.pf_pct = k == 3 ? 80 : 95;
+        flags += anomaly_model_update(&d, &flag);
+    }
+    CHECK_EQ(flags, 1);
+    CHECK_EQ(flag.model_version, 7);
+    CHECK_EQ(flag.score, ANOMALY_MODEL_FEATURES);
+    CHECK_EQ(flag.count, ANOMALY_MODEL_WINDOW);
+    CHECK_EQ(flag.start_ms, 1000);
+    CHECK_EQ(flag.features[AMODEL_F_V_MEAN], 2290);
+    CHECK_EQ(flag.features[AMODEL_F_V_SPREAD], 20);
+    CHECK_EQ(flag.features[AMODEL_F_I_MEAN], 4000);
+    CHECK_EQ(flag.features[AMODEL_F_I_SPREAD], 4000);
+    CHECK_EQ(flag.features[AMODEL_F_I_STEP], 4000);
+    CHECK_EQ(flag.features[AMODEL_F_PF_MIN], 80);
+    CHECK_EQ(flag.features[AMODEL_F_PF_MEAN], (95 * (ANOMALY_MODEL_WINDOW - 1) + 80) / ANOMALY_MODEL_WINDOW);
+    CHECK_EQ(flag.features[AMODEL_F_F_MEAN], 600);
+    CHECK_EQ(flag.features[AMODEL_F_SOURCE_Z], 500);
+    CHECK_EQ(flag.samples[1].dt_ms, PZEM_READ_INTERVAL_MS);
+    CHECK_EQ(flag.samples[1].i_ma, 6000);
+}
+
+static void test_steady_current_has_no_source_z(void)
+{
+    static anomaly_model_t m;
+    constant_model(&m, 1);
+    anomaly_model_init();
+    CHECK_EQ(anomaly_model_apply(&m), ESP_OK);
+
+    anomaly_model_flag_t flag = { 0 };
+    for (uint32_t k = 0; k < ANOMALY_MODEL_WINDOW; k++) {
+        pzem_data_t d = reading(k * PZEM_READ_INTERVAL_MS, (uint16_t)(2300 - k), 4000 + k * 10);
+        anomaly_model_update(&d, &flag);
+    }
+    CHECK_EQ(flag.count, ANOMALY_MODEL_WINDOW);
+    CHECK_EQ(flag.features[AMODEL_F_SOURCE_Z], 0);   // spread under ANOMALY_MODEL_Z_MIN_SPREAD_MA
+}
+
+static uint32_t feed_windows(uint32_t *t_ms, int windows)
+{
+    anomaly_model_flag_t flag;
+    uint32_t flags = 0;
+    for (int k = 0; k < windows * ANOMALY_MODEL_WINDOW; k++) {
+        pzem_data_t d = reading(*t_ms, 2300, 4000);
+        flags += anomaly_model_update(&d, &flag);
+        *t_ms += PZEM_READ_INTERVAL_MS;
+    }
+    return flags;
+}
+
+static void test_confirm_and_holdoff(void)
+{
+    static anomaly_model_t m;
+    constant_model(&m, 2);
+    anomaly_model_init();
+    CHECK_EQ(anomaly_model_apply(&m), ESP_OK);
+
+    uint32_t t = 1000;
+    CHECK_EQ(feed_windows(&t, 1), 0);               // first window over threshold
+    CHECK_EQ(feed_windows(&t, 1), 1);               // second in a row flags
+    CHECK_EQ(feed_windows(&t, 5), 0);               // held off
+
+    t += ANOMALY_MODEL_HOLDOFF_MS;
+    CHECK_EQ(feed_windows(&t, 1), 1);               // the run never broke
+
+    m.threshold = ANOMALY_MODEL_FEATURES + 1;
+    CHECK_EQ(anomaly_model_apply(&m), ESP_OK);
+    CHECK_EQ(feed_windows(&t, 1), 0);               // one window under threshold…
+
+    m.threshold = ANOMALY_MODEL_FEATURES;
+    CHECK_EQ(anomaly_model_apply(&m), ESP_OK);
+    t += ANOMALY_MODEL_HOLDOFF_MS;
+    CHECK_EQ(feed_windows(&t, 1), 0);               // …restarts the confirm count
+    CHECK_EQ(feed_windows(&t, 1), 1);
+}
+
+static void test_gap_restarts_window(void)
+{
+    static anomaly_model_t m;
+    constant_model(&m, 1);
+    anomaly_model_init();
+    CHECK_EQ(anomaly_model_apply(&m), ESP_OK);
+
+    anomaly_model_flag_t flag;
+    uint32_t t = 0;
+    int      flags = 0;
+    for (int k = 0; k < ANOMALY_MODEL_WINDOW - 1; k++, t += PZEM_READ_INTERVAL_MS) {
+        pzem_data_t d = reading(t, 2300, 4000);
+        flags += anomaly_model_update(&d, &flag);
+    }
+    t += 2 * PZEM_READ_INTERVAL_MS;                 // three intervals after the last read
+    for (int k = 0; k < ANOMALY_MODEL_WINDOW; k++, t += PZEM_READ_INTERVAL_MS) {
+        pzem_data_t d = reading(t, 2300, 4000);
+        flags += anomaly_model_update(&d, &flag);
+    }
+    CHECK_EQ(flags, 1);
+    CHECK_EQ(flag.start_ms, (ANOMALY_MODEL_WINDOW + 1) * PZEM_READ_INTERVAL_MS);
+
+    // fast current-only samples never enter a window
+    pzem_data_t fast = reading(t, 0, 90000);
+    fast.current_only = true;
+    CHECK(!anomaly_model_update(&fast, &flag));
+}
+
+static void test_invalid_model_rejected(void)
+{
+    static anomaly_model_t m;
+    anomaly_model_init();
+    constant_model(&m, 1);
+    m.version = 9;
+    CHECK_EQ(anomaly_model_apply(&m), ESP_OK);
+
+    constant_model(&m, 1);
+    m.n_hidden = ANOMALY_MODEL_MAX_HIDDEN + 1;
+    CHECK_EQ(anomaly_model_apply(&m), ESP_ERR_INVALID_ARG);
+    constant_model(&m, 0);
+    CHECK_EQ(anomaly_model_apply(&m), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(anomaly_model_version(), 9);
+}
+
+int main(void)
+{
+    RUN_TEST(test_kernel_matches_reference);
+    RUN_TEST(test_kernel_saturates);
+    RUN_TEST(test_window_features);
+    RUN_TEST(test_steady_current_has_no_source_z);
+    RUN_TEST(test_confirm_and_holdoff);
+    RUN_TEST(test_gap_restarts_window);
+    RUN_TEST(test_invalid_model_rejected);
+    TEST_MAIN_END();
+}
@@ -0,0 +1,191 @@
+// Hour-of-week profile and budget projection of forecast.c on a virtual
+// wall clock in the device's time zone.
+
+#include "forecast.h"
+#include "energy_counter.h"
+#include "config.h"
+#include "test_util.h"
+
+#include <stdlib.h>
+#include <time.h>
+
+#define MONDAY_0000     1767542400LL    // 2026-01-05 00:00 in LOCAL_TZ (UTC+8)
+#define HOUR            3600LL
+#define WEEK            (168 * HOUR)
+
+static int64_t  s_wall;
+static uint64_t s_sum_wh;
+
+time_t time(time_t *out)
+{
+    if (out) *out = (time_t)s_wall;
+    return (time_t)s_wall;
+}
+
+uint64_t energy_counter_sum(void) { return s_sum_wh; }
+
+static void setup(void)
+{
+    setenv("TZ", LOCAL_TZ, 1);
+    tzset();
+    s_wall   = MONDAY_0000;
+    s_sum_wh = 50000;
+    forecast_init();
+}
+
+// One full read per PZEM_READ_INTERVAL_MS at constant power for `seconds`
+// (read task)
+static void read_only(uint32_t watts, int64_t seconds)
+{
+    for (int64_t t = 0; t < seconds; t += PZEM_READ_INTERVAL_MS / 1000) {
+        forecast_note_power(watts * 10);
+        s_wall += PZEM_READ_INTERVAL_MS / 1000;
+        host_advance_ms(PZEM_READ_INTERVAL_MS);
+    }
+}
+
+// The same with the energy task's pass every FORECAST_EVAL_MS of wall time
+static void feed(uint32_t watts, int64_t seconds)
+{
+    for (int64_t t = 0; t < seconds; t += PZEM_READ_INTERVAL_MS / 1000) {
+        read_only(watts, PZEM_READ_INTERVAL_MS / 1000);
+        if (s_wall % (FORECAST_EVAL_MS / 1000) == 0) forecast_update();
+    }
+}
+
+// Budget for [now, now + length): with nothing used, the projection is the
+// profile's energy over exactly that span
+static int64_t project(int64_t length)
+{
+    forecast_budget_t b = { .seq = (uint32_t)s_wall, .budget_wh = 1000000, .warn_pct = 80,
+                            .period_start = s_wall, .period_end = s_wall + length,
+                            .period_used_wh = -1 };
+    CHECK_EQ(forecast_apply(&b), ESP_OK);
+
+    forecast_status_t st;
+    forecast_get_status(&st);
+    CHECK_EQ(st.used_wh, 0);
+    return st.projected_wh;
+}
+
+static uint8_t learned(void)
+{
+    forecast_status_t st;
+    forecast_get_status(&st);
+    return st.learned;
+}
+
+static void test_full_hour_seeds_its_bucket(void)
+{
+    setup();
+    feed(1000, HOUR - 60);
+    CHECK_EQ(learned(), 0);
+    feed(1000, 60);                     // the pass at 01:00 closes it
+    CHECK_EQ(learned(), 1);
+
+    // Monday 01:00 is unlearned and filled with the learned mean
+    CHECK_EQ(project(HOUR - 1), 1000 * (HOUR - 1) / HOUR);
+}
+
+static void test_reading_after_the_hour_waits_for_the_pass(void)
+{
+    setup();
+    feed(1000, HOUR - 30);              // last pass at 00:59:00
+    read_only(1000, 30);
+    read_only(3000, 30);                // 01:00:00 – 01:00:29, not folded in yet
+    forecast_update();
+    CHECK_EQ(learned(), 1);
+
+    // Monday 00:00 saw only its own 3600 readings at 1000 W
+    CHECK_EQ(project(HOUR - 1), 1000 * (HOUR - 1) / HOUR);
+}
+
+static void test_partial_hour_is_not_learned(void)
+{
+    setup();
+    feed(1000, HOUR);
+    // Monday 01:00 observed for less than FORECAST_MIN_COVERAGE_PCT
+    feed(3000, HOUR * FORECAST_MIN_COVERAGE_PCT / 100 - 10);
+    s_wall = MONDAY_0000 + 2 * HOUR;
+    feed(1000, 60);
+    CHECK_EQ(learned(), 1);
+}
+
+static void test_same_hour_next_week_is_an_ewma(void)
+{
+    setup();
+    feed(1000, HOUR);
+    s_wall = MONDAY_0000 + WEEK;
+    feed(2000, HOUR);
+    CHECK_EQ(learned(), 1);
+
+    // 1000 W + (2000 − 1000) / 2^FORECAST_EWMA_SHIFT
+    int64_t expect = 1000 + 1000 / (1 << FORECAST_EWMA_SHIFT);
+    CHECK_EQ(project(HOUR - 1), expect * (HOUR - 1) / HOUR);
+}
+
+static void test_buckets_wrap_at_end_of_week(void)
+{
+    setup();
+    // Sunday 23:00 local, the last bucket of the week
+    s_wall = MONDAY_0000 - HOUR;
+    feed(800, HOUR);
+    // Monday 00:00 local is the first
+    feed(200, HOUR);
+    CHECK_EQ(learned(), 2);
+
+    // next Sunday 23:00 to Monday 01:00 spans both buckets and the wrap
+    s_wall = MONDAY_0000 + WEEK - HOUR;
+    forecast_update();
+    int64_t p = project(2 * HOUR - 1);
+    CHECK(p >= 800 + 200 - 2 && p <= 800 + 200);
+}
+
+static void test_projection_spans_whole_weeks(void)
+{
+    setup();
+    feed(1000, HOUR);
+    // every hour filled at 1000 W: two weeks and a half hour
+    CHECK_EQ(project(2 * WEEK + HOUR / 2), 1000 * (2 * 168) + 500);
+}
+
+static void test_budget_states(void)
+{
+    setup();
+    feed(1000, HOUR);
+    forecast_take_sync_request();
+
+    // 24 h at 1000 W projects 24 kWh
+    forecast_budget_t b = { .seq = 1, .budget_wh = 40000, .warn_pct = 50,
+                            .period_start = s_wall, .period_end = s_wall + 24 * HOUR,
+                            .period_used_wh = -1 };
+    CHECK_EQ(forecast_apply(&b), ESP_OK);
+    forecast_status_t st;
+    forecast_get_status(&st);
+    CHECK_EQ(st.state, FORECAST_STATE_WARNING);
+    CHECK(forecast_take_sync_request());
+
+    b.seq = 2;
+    b.budget_wh = 20000;
+    CHECK_EQ(forecast_apply(&b), ESP_OK);
+    forecast_get_status(&st);
+    CHECK_EQ(st.state, FORECAST_STATE_OVER);
+
+    s_sum_wh += 20001;
+    feed(1000, FORECAST_EVAL_MS / 1000 + 1);   // next periodic evaluation
+    forecast_get_status(&st);
+    CHECK_EQ(st.state, FORECAST_STATE_EXCEEDED);
+    CHECK_EQ(st.used_wh, 20001);
+}
+
+int main(void)
+{
+    RUN_TEST(test_full_hour_seeds_its_bucket);
+    RUN_TEST(test_reading_after_the_hour_waits_for_the_pass);
+    RUN_TEST(test_partial_hour_is_not_learned);
+    RUN_TEST(test_same_hour_next_week_is_an_ewma);
+    RUN_TEST(test_buckets_wrap_at_end_of_week);
+    RUN_TEST(test_projection_spans_whole_weeks);
+    RUN_TEST(test_budget_states);
+    TEST_MAIN_END();
+}
@@ -0,0 +1,89 @@
+#include "modbus_crc.h"
+#include "test_util.h"
+
+#include <string.h>
+
+// Bitwise reference the table was generated from.
+static uint16_t crc_bitwise(const uint8_t *data, size_t len)
+{
+    uint16_t c = MODBUS_CRC16_INIT;
+    while (len--) {
+        c ^= *data++;
+        for (int b = 0; b < 8; b++) c = (c & 1) ? (c >> 1) ^ 0xA001 : c >> 1;
+    }
+    return c;
+}
+
+static void test_known_vectors(void)
+{
+    // "123456789" is the standard CRC-16/MODBUS check value
+    CHECK_EQ(modbus_crc16((const uint8_t *)"123456789", 9), 0x4B37);
+
+    // PZEM-004T read-input-registers request: 01 04 0000 000A → CRC 70 0D
+    uint8_t req[8] = { 0x01, 0x04, 0x00, 0x00, 0x00, 0x0A };
+    CHECK_EQ(modbus_crc16_append(req, 6), 8);
+    CHECK_EQ(req[6], 0x70);
+    CHECK_EQ(req[7], 0x0D);
+
+    CHECK_EQ(modbus_crc16(NULL, 0), MODBUS_CRC16_INIT);
+}
+
+static void test_table_matches_bitwise(void)
+{
+    uint8_t buf[256];
+    for (int i = 0; i < 256; i++) {
+        uint8_t b = (uint8_t)i;
+        CHECK_EQ(modbus_crc16(&b, 1), crc_bitwise(&b, 1));
+        buf[i] = (uint8_t)(i * 151 + 7);
+    }
+    for (size_t len = 0; len <= sizeof(buf); len += 17) {
+        CHECK_EQ(modbus_crc16(buf, len), crc_bitwise(buf, len));
+    }
+}
+
+static void test_incremental_equals_one_shot(void)
+{
+    uint8_t buf[64];
+    for (int i = 0; i < 64; i++) buf[i] = (uint8_t)(i ^ 0x5A);
+
+    uint16_t one_shot = modbus_crc16(buf, sizeof(buf));
+
+    uint16_t per_byte = MODBUS_CRC16_INIT;
+    for (size_t i = 0; i < sizeof(buf); i++) per_byte = modbus_crc16_update(per_byte, buf[i]);
+    CHECK_EQ(per_byte, one_shot);
+
+    uint16_t chunked = MODBUS_CRC16_INIT;
+    chunked = modbus_crc16_update_buf(chunked, buf, 5);
+    chunked = modbus_crc16_update_buf(chunked, buf + 5, 0);
+    chunked = modbus_crc16_update_buf(chunked, buf + 5, sizeof(buf) - 5);
+    CHECK_EQ(chunked, one_shot);
+}
+
+static void test_residue_detects_corruption(void)
+{
+    uint8_t frame[27] = { 0x01, 0x04, 0x14 };
+    for (int i = 3; i < 25; i++) frame[i] = (uint8_t)(i * 13);
+    size_t len = modbus_crc16_append(frame, 25);
+
+    CHECK(modbus_crc16_frame_ok(frame, len));
+    CHECK_EQ(modbus_crc16(frame, len), MODBUS_CRC16_RESIDUE);
+    CHECK(!modbus_crc16_frame_ok(frame, 1));
+
+    // every single-bit error is caught
+    for (size_t byte = 0; byte < len; byte++) {
+        for (int bit = 0; bit < 8; bit++) {
+            frame[byte] ^= (uint8_t)(1u << bit);
+            CHECK(!modbus_crc16_frame_ok(frame, len));
+            frame[byte] ^= (uint8_t)(1u << bit);
+        }
+    }
+}
+
+int main(void)
+{
+    RUN_TEST(test_known_vectors);
+    RUN_TEST(test_table_matches_bitwise);
+    RUN_TEST(test_incremental_equals_one_shot);
+    RUN_TEST(test_residue_detects_corruption);
+    TEST_MAIN_END();
+}
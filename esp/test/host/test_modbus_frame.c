@@ -0,0 +1,142 @@
+#include "modbus_crc.h"
+#include "modbus_rtu.h"
+#include "test_util.h"
+
+#include <string.h>
+
+// PZEM-004T input-register reply: addr, 0x04, byte count 20, 20 data bytes, CRC
+static size_t make_reply(uint8_t *out)
+{
+    out[0] = 0x01;
+    out[1] = 0x04;
+    out[2] = 20;
+    for (int i = 0; i < 20; i++) out[3 + i] = (uint8_t)(0x10 + i);
+    return modbus_crc16_append(out, 23);
+}
+
+static modbus_rx_status_t assemble(const uint8_t *data, size_t n, size_t chunk,
+                                   size_t expected, bool idle_at_end, size_t *len)
+{
+    uint8_t buf[32];
+    modbus_frame_t f;
+    modbus_frame_begin(&f, buf, sizeof(buf), expected);
+
+    modbus_rx_status_t st = MODBUS_RX_IN_PROGRESS;
+    for (size_t off = 0; off < n && st == MODBUS_RX_IN_PROGRESS; off += chunk) {
+        size_t take = n - off < chunk ? n - off : chunk;
+        modbus_frame_feed(&f, data + off, take);
+        st = modbus_frame_status(&f, false);
+    }
+    if (st == MODBUS_RX_IN_PROGRESS && idle_at_end) st = modbus_frame_status(&f, true);
+    if (len) *len = f.len;
+    return st;
+}
+
+static void test_complete_in_any_chunking(void)
+{
+    uint8_t reply[25];
+    size_t n = make_reply(reply);
+    CHECK_EQ(n, 25);
+
+    // byte count in the header ends the frame without waiting for the gap
+    for (size_t chunk = 1; chunk <= n; chunk++) {
+        size_t len = 0;
+        CHECK_EQ(assemble(reply, n, chunk, 0, false, &len), MODBUS_RX_COMPLETE);
+        CHECK_EQ(len, n);
+    }
+}
+
+static void test_in_progress_until_full(void)
+{
+    uint8_t reply[25];
+    make_reply(reply);
+    for (size_t n = 0; n < 25; n++) {
+        CHECK_EQ(assemble(reply, n, 25, 0, false, NULL), MODBUS_RX_IN_PROGRESS);
+    }
+}
+
+static void test_short_on_idle(void)
+{
+    uint8_t reply[25];
+    make_reply(reply);
+    CHECK_EQ(assemble(reply, 10, 4, 0, true, NULL), MODBUS_RX_SHORT);
+    CHECK_EQ(assemble(reply, 0, 1, 0, true, NULL), MODBUS_RX_SHORT);
+}
+
+static void test_crc_error(void)
+{
+    uint8_t reply[25];
+    make_reply(reply);
+    reply[7] ^= 0x40;
+    CHECK_EQ(assemble(reply, 25, 3, 0, false, NULL), MODBUS_RX_CRC_ERROR);
+}
+
+static void test_trailing_noise_ignored(void)
+{
+    uint8_t reply[28];
+    make_reply(reply);
+    reply[25] = 0xFF;
+    reply[26] = 0x00;
+    reply[27] = 0x55;
+
+    // one read that carries the frame plus line noise
+    uint8_t buf[32];
+    modbus_frame_t f;
+    modbus_frame_begin(&f, buf, sizeof(buf), 0);
+    modbus_frame_feed(&f, reply, sizeof(reply));
+    CHECK_EQ(modbus_frame_status(&f, false), MODBUS_RX_COMPLETE);
+}
+
+static void test_exception_frame(void)
+{
+    uint8_t exc[MODBUS_EXCEPTION_LEN] = { 0x01, 0x04 | MODBUS_EXCEPTION_BIT, 0x02 };
+    modbus_crc16_append(exc, 3);
+
+    // exception length wins over the caller's expected length
+    CHECK_EQ(assemble(exc, sizeof(exc), 1, 8, false, NULL), MODBUS_RX_EXCEPTION);
+    CHECK_EQ(assemble(exc, sizeof(exc), 1, 0, false, NULL), MODBUS_RX_EXCEPTION);
+}
+
+static void test_expected_length_echo(void)
+{
+    // write-single-register echo: fixed 8 bytes, no byte count field
+    uint8_t echo[8] = { 0x01, 0x06, 0x00, 0x01, 0x0B, 0xB8 };
+    modbus_crc16_append(echo, 6);
+
+    CHECK_EQ(assemble(echo, 7, 1, 8, false, NULL), MODBUS_RX_IN_PROGRESS);
+    CHECK_EQ(assemble(echo, 8, 1, 8, false, NULL), MODBUS_RX_COMPLETE);
+
+    // unknown length: only the idle gap can end it
+    CHECK_EQ(assemble(echo, 8, 1, 0, false, NULL), MODBUS_RX_IN_PROGRESS);
+    CHECK_EQ(assemble(echo, 8, 1, 0, true, NULL), MODBUS_RX_COMPLETE);
+    echo[3] ^= 1;
+    CHECK_EQ(assemble(echo, 8, 1, 0, true, NULL), MODBUS_RX_CRC_ERROR);
+}
+
+static void test_overflow(void)
+{
+    uint8_t reply[25];
+    make_reply(reply);
+
+    uint8_t buf[16];
+    modbus_frame_t f;
+    modbus_frame_begin(&f, buf, sizeof(buf), 0);
+    modbus_frame_feed(&f, reply, 10);
+    CHECK_EQ(modbus_frame_status(&f, false), MODBUS_RX_IN_PROGRESS);
+    modbus_frame_feed(&f, reply + 10, 15);
+    CHECK_EQ(modbus_frame_status(&f, false), MODBUS_RX_OVERFLOW);
+    CHECK_EQ(f.len, sizeof(buf));
+}
+
+int main(void)
+{
+    RUN_TEST(test_complete_in_any_chunking);
+    RUN_TEST(test_in_progress_until_full);
+    RUN_TEST(test_short_on_idle);
+    RUN_TEST(test_crc_error);
+    RUN_TEST(test_trailing_noise_ignored);
+    RUN_TEST(test_exception_frame);
+    RUN_TEST(test_expected_length_echo);
+    RUN_TEST(test_overflow);
+    TEST_MAIN_END();
+}
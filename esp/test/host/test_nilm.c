@@ -0,0 +1,180 @@
+// Step-change NILM: edges out of segmented levels, on/off pairing against
+// the signature table, inrush from fast samples, and energy per signature.
+//
+// The tables outlive nilm_init, so every test uses loads of its own size.
+
+#include "nilm.h"
+#include "config.h"
+#include "test_util.h"
+
+#include <math.h>
+#include <string.h>
+
+#define V_DV    2300
+
+static uint32_t     s_t;
+static nilm_event_t s_ev[32];
+static uint8_t      s_nev;
+
+static void setup(void)
+{
+    nilm_init();
+    s_t   = 1000;
+    s_nev = 0;
+    memset(s_ev, 0, sizeof(s_ev));
+}
+
+// `reads` full reads at one level, PZEM_READ_INTERVAL_MS apart
+static void feed(int32_t p_dw, int32_t q_dvar, int reads)
+{
+    uint32_t s_dva = (uint32_t)lround(sqrt((double)p_dw * p_dw + (double)q_dvar * q_dvar));
+    for (int k = 0; k < reads; k++) {
+        pzem_data_t d = { .timestamp = s_t, .v_dv = V_DV, .power_dw = (uint32_t)p_dw,
+                          .apparent_dva = s_dva, .i_ma = s_dva * 1000 / V_DV,
+                          .pf_pct = s_dva ? (uint8_t)(p_dw * 100 / s_dva) : 100,
+                          .freq_dhz = 600, .valid = true };
+        s_nev += nilm_update(&d, s_ev + s_nev, (uint8_t)(32 - s_nev));
+        s_t   += PZEM_READ_INTERVAL_MS;
+    }
+}
+
+static void fast_sample(uint32_t i_ma)
+{
+    pzem_data_t d = { .timestamp = s_t - PZEM_FAST_POLL_INTERVAL_MS, .v_dv = V_DV,
+                      .i_ma = i_ma, .current_only = true, .valid = true };
+    CHECK_EQ(nilm_update(&d, s_ev + s_nev, 1), 0);
+}
+
+static const nilm_appliance_t *find(uint16_t id)
+{
+    static nilm_appliance_t app[NILM_MAX_APPLIANCES];
+    uint8_t n = nilm_get_appliances(0, app, NILM_MAX_APPLIANCES);
+    for (uint8_t k = 0; k < n; k++) {
+        if (app[k].id == id) return &app[k];
+    }
+    return NULL;
+}
+
+static void test_on_off_pair_and_energy(void)
+{
+    setup();
+    feed(1000, 0, 5);                       // 100 W base
+    feed(22000, 0, NILM_SETTLE_READS);      // +2100 W kettle
+    CHECK_EQ(s_nev, 1);
+    CHECK_EQ(s_ev[0].edge, NILM_EDGE_ON);
+    CHECK_EQ(s_ev[0].dp_dw, 21000);
+    CHECK(s_ev[0].flags & NILM_FLAG_NEW);
+    CHECK(s_ev[0].appliance != 0);
+    uint16_t id = s_ev[0].appliance;
+
+    feed(22000, 0, 33);
+    feed(1000, 0, NILM_SETTLE_READS);
+    CHECK_EQ(s_nev, 2);
+    CHECK_EQ(s_ev[1].edge, NILM_EDGE_OFF);
+    CHECK_EQ(s_ev[1].dp_dw, -21000);
+    CHECK_EQ(s_ev[1].appliance, id);
+    CHECK_EQ(s_ev[1].flags, 0);
+
+    // charged from the on-edge to the off-edge: 2100 W for 36 s
+    const nilm_appliance_t *a = find(id);
+    CHECK(a != NULL);
+    if (!a) return;
+    CHECK_EQ(a->running, 0);
+    CHECK_EQ(a->edges, 1);
+    CHECK_EQ(a->run_ms, 36 * PZEM_READ_INTERVAL_MS);
+    CHECK_EQ(a->energy_mwh, 21000);
+
+    // the same step again is the same appliance
+    feed(22000, 0, NILM_SETTLE_READS);
+    CHECK_EQ(s_nev, 3);
+    CHECK_EQ(s_ev[2].appliance, id);
+    CHECK_EQ(s_ev[2].flags, 0);
+    feed(1000, 0, NILM_SETTLE_READS);
+    CHECK_EQ(find(id)->edges, 2);
+}
+
+static void test_off_edge_pairs_with_its_own_load(void)
+{
+    setup();
+    feed(1000, 0, 5);
+    feed(1000 + 15000, 0, NILM_SETTLE_READS);           // resistive heater
+    feed(1000 + 15000 + 6000, 8000, NILM_SETTLE_READS); // motor on top
+    CHECK_EQ(s_nev, 2);
+    uint16_t heater = s_ev[0].appliance, motor = s_ev[1].appliance;
+    CHECK(heater != motor);
+    CHECK(s_ev[1].dq_dvar > 7800 && s_ev[1].dq_dvar < 8200);
+
+    // heater leaves first: its off-edge must not close the motor
+    feed(1000 + 6000, 8000, NILM_SETTLE_READS);
+    CHECK_EQ(s_nev, 3);
+    CHECK_EQ(s_ev[2].edge, NILM_EDGE_OFF);
+    CHECK_EQ(s_ev[2].appliance, heater);
+    CHECK_EQ(find(heater)->running, 0);
+    CHECK_EQ(find(motor)->running, 1);
+
+    feed(1000, 0, NILM_SETTLE_READS);
+    CHECK_EQ(s_nev, 4);
+    CHECK_EQ(s_ev[3].appliance, motor);
+    CHECK_EQ(find(motor)->running, 0);
+}
+
+static void test_idle_closes_everything_running(void)
+{
+    setup();
+    feed(1000, 0, 5);
+    feed(1000 + 9000, 0, NILM_SETTLE_READS);
+    feed(1000 + 9000 + 3000, 4000, NILM_SETTLE_READS);
+    CHECK_EQ(s_nev, 2);
+    uint16_t a = s_ev[0].appliance, b = s_ev[1].appliance;
+
+    // both drop out in one settle window (breaker, power cut)
+    feed(0, 0, NILM_SETTLE_READS);
+    CHECK_EQ(s_nev, 5);
+    CHECK_EQ(s_ev[2].appliance, 0);                     // the merged step matches neither
+    int closed = 0;
+    for (int k = 3; k < s_nev; k++) {
+        CHECK_EQ(s_ev[k].edge, NILM_EDGE_OFF);
+        CHECK(s_ev[k].flags & NILM_FLAG_IDLE);
+        closed |= (s_ev[k].appliance == a) << 0 | (s_ev[k].appliance == b) << 1;
+    }
+    CHECK_EQ(closed, 3);
+    CHECK_EQ(find(a)->running, 0);
+    CHECK_EQ(find(b)->running, 0);
+}
+
+static void test_fast_samples_set_inrush(void)
+{
+    setup();
+    feed(2000, 0, 5);
+    uint32_t pre_i = 2000 * 1000 / V_DV, on_i = 14000 * 1000 / V_DV;
+    fast_sample(pre_i + 4 * (on_i - pre_i));            // motor start at 4× its running step
+    feed(14000, 0, NILM_SETTLE_READS);
+    CHECK_EQ(s_nev, 1);
+    CHECK_EQ(s_ev[0].edge, NILM_EDGE_ON);
+    CHECK_EQ(s_ev[0].inrush_pct, 400);
+    feed(2000, 0, NILM_SETTLE_READS);
+}
+
+static void test_small_and_drifting_steps_are_not_edges(void)
+{
+    setup();
+    feed(40000, 0, 5);
+    // under NILM_STEP_PCT of a 4 kW level: tracked as drift
+    feed(40000 + 40000 * NILM_STEP_PCT / 100 - 100, 0, 10);
+    // a level that never settles is rebased without an edge
+    for (int k = 0; k < NILM_MAX_TRANSIENT_MS / PZEM_READ_INTERVAL_MS + 2; k++) {
+        feed(k % 2 ? 50000 : 60000, 0, 1);
+    }
+    CHECK_EQ(s_nev, 0);
+    feed(0, 0, NILM_SETTLE_READS);
+}
+
+int main(void)
+{
+    RUN_TEST(test_on_off_pair_and_energy);
+    RUN_TEST(test_off_edge_pairs_with_its_own_load);
+    RUN_TEST(test_idle_closes_everything_running);
+    RUN_TEST(test_fast_samples_set_inrush);
+    RUN_TEST(test_small_and_drifting_steps_are_not_edges);
+    TEST_MAIN_END();
+}
@@ -0,0 +1,188 @@
+// Prepaid credit enforcement: balance from the energy totals, warning
+// levels, cutoff through the relay lockout, and reconnection on top-up.
+
+#include "prepaid.h"
+#include "relay_control.h"
+#include "energy_counter.h"
+#include "config.h"
+#include "test_util.h"
+
+static uint64_t s_sum_wh;
+
+uint64_t energy_counter_sum(void) { return s_sum_wh; }
+
+static void setup(void)
+{
+    s_sum_wh = 100000;
+    relay_init();
+    prepaid_init();
+}
+
+static prepaid_doc_t doc(uint32_t seq, int64_t granted_wh)
+{
+    return (prepaid_doc_t){ .seq = seq, .enabled = true, .granted_wh = granted_wh,
+                            .tariff_milli = 12000, .warn_low_wh = 50, .warn_critical_wh = 20 };
+}
+
+static prepaid_status_t status(void)
+{
+    prepaid_status_t st = { 0 };
+    CHECK(prepaid_get_status(&st));
+    return st;
+}
+
+// Credit of granted_wh with the relay ON, anchored at the current total
+static void start_with_credit(int64_t granted_wh)
+{
+    prepaid_doc_t d = doc(1, granted_wh);
+    CHECK_EQ(prepaid_apply(&d), ESP_OK);
+    prepaid_update();                       // anchors the consumption count
+    CHECK_EQ(relay_set_state(RELAY_STATE_ON), ESP_OK);
+}
+
+static void test_exhaust_cuts_and_locks_out(void)
+{
+    setup();
+    start_with_credit(100);
+    CHECK_EQ(status().state, PREPAID_STATE_OK);
+    CHECK_EQ(status().balance_wh, 100);
+    prepaid_take_sync_request();
+
+    s_sum_wh += 60;
+    prepaid_update();
+    CHECK_EQ(status().state, PREPAID_STATE_LOW);
+    CHECK(prepaid_take_sync_request());     // crossing a level asks for a sync
+
+    s_sum_wh += 25;
+    prepaid_update();
+    CHECK_EQ(status().state, PREPAID_STATE_CRITICAL);
+    CHECK_EQ(relay_get_state(), RELAY_STATE_ON);
+
+    s_sum_wh += 15;
+    prepaid_update();
+    CHECK_EQ(status().state, PREPAID_STATE_EXHAUSTED);
+    CHECK_EQ(status().balance_wh, 0);
+    CHECK(relay_is_locked_out());
+    CHECK_EQ(relay_get_state(), RELAY_STATE_OFF);
+    CHECK_EQ(host_gpio_level(RELAY_GPIO), 1 - RELAY_ACTIVE_LEVEL);
+
+    // nothing closes it while the balance is gone, cooldown or not
+    host_advance_ms(RELAY_COOLDOWN_MS * 2);
+    CHECK_EQ(relay_set_state(RELAY_STATE_ON), ESP_ERR_INVALID_STATE);
+    prepaid_update();
+    CHECK_EQ(relay_get_state(), RELAY_STATE_OFF);
+}
+
+static void test_topup_recloses_after_cooldown(void)
+{
+    setup();
+    start_with_credit(100);
+    s_sum_wh += 120;
+    prepaid_update();
+    CHECK_EQ(relay_get_state(), RELAY_STATE_OFF);
+
+    // top-up lands inside the cooldown the cutoff started
+    prepaid_doc_t d = doc(2, 300);
+    CHECK_EQ(prepaid_apply(&d), ESP_OK);
+    CHECK_EQ(status().state, PREPAID_STATE_OK);
+    CHECK_EQ(status().balance_wh, 180);
+    CHECK(!relay_is_locked_out());
+    CHECK_EQ(relay_get_state(), RELAY_STATE_OFF);
+
+    host_advance_ms(RELAY_COOLDOWN_MS);
+    prepaid_update();
+    CHECK_EQ(relay_get_state(), RELAY_STATE_ON);
+    CHECK_EQ(host_gpio_level(RELAY_GPIO), RELAY_ACTIVE_LEVEL);
+
+    // reconnecting is one-shot: a later manual OFF stays OFF
+    CHECK_EQ(relay_set_state(RELAY_STATE_OFF), ESP_OK);
+    host_advance_ms(RELAY_COOLDOWN_MS);
+    prepaid_update();
+    CHECK_EQ(relay_get_state(), RELAY_STATE_OFF);
+}
+
+static void test_topup_leaves_an_off_relay_off(void)
+{
+    setup();
+    start_with_credit(100);
+    CHECK_EQ(relay_set_state(RELAY_STATE_OFF), ESP_OK);
+    s_sum_wh += 120;
+    prepaid_update();
+    CHECK(relay_is_locked_out());
+
+    prepaid_doc_t d = doc(2, 300);
+    CHECK_EQ(prepaid_apply(&d), ESP_OK);
+    host_advance_ms(RELAY_COOLDOWN_MS);
+    prepaid_update();
+    CHECK(!relay_is_locked_out());
+    CHECK_EQ(relay_get_state(), RELAY_STATE_OFF);
+}
+
+static void test_trip_during_cutoff_is_not_undone(void)
+{
+    setup();
+    start_with_credit(100);
+    s_sum_wh += 120;
+    prepaid_update();
+    CHECK(relay_is_locked_out());
+
+    relay_trip(ANOMALY_SHORT_CIRCUIT);
+    CHECK_EQ(relay_get_state(), RELAY_STATE_TRIPPED);
+
+    prepaid_doc_t d = doc(2, 300);
+    CHECK_EQ(prepaid_apply(&d), ESP_OK);
+    for (int k = 0; k < 3; k++) {
+        host_advance_ms(RELAY_COOLDOWN_MS);
+        prepaid_update();
+    }
+    CHECK(!relay_is_locked_out());
+    CHECK_EQ(relay_get_state(), RELAY_STATE_TRIPPED);
+    CHECK_EQ(host_gpio_level(RELAY_GPIO), 1 - RELAY_ACTIVE_LEVEL);
+
+    // after a manual reset the old cutoff must not reclose it either
+    CHECK_EQ(relay_set_state(RELAY_STATE_OFF), ESP_OK);
+    host_advance_ms(RELAY_COOLDOWN_MS);
+    prepaid_update();
+    CHECK_EQ(relay_get_state(), RELAY_STATE_OFF);
+}
+
+static void test_replayed_document_changes_nothing(void)
+{
+    setup();
+    start_with_credit(100);
+    s_sum_wh += 120;
+    prepaid_update();
+
+    prepaid_doc_t d = doc(1, 1000);          // same seq, bigger grant
+    CHECK_EQ(prepaid_apply(&d), ESP_OK);
+    CHECK_EQ(status().state, PREPAID_STATE_EXHAUSTED);
+    CHECK_EQ(prepaid_seq(), 1);
+    CHECK(relay_is_locked_out());
+}
+
+static void test_exhausted_credit_survives_reboot(void)
+{
+    setup();
+    start_with_credit(100);
+    s_sum_wh += 120;
+    prepaid_update();
+    prepaid_persist();
+
+    // boot: energy totals restored, relay OFF, lockout before any command
+    relay_init();
+    CHECK_EQ(prepaid_init(), ESP_OK);
+    CHECK(relay_is_locked_out());
+    CHECK_EQ(status().state, PREPAID_STATE_EXHAUSTED);
+    CHECK_EQ(relay_set_state(RELAY_STATE_ON), ESP_ERR_INVALID_STATE);
+}
+
+int main(void)
+{
+    RUN_TEST(test_exhaust_cuts_and_locks_out);
+    RUN_TEST(test_topup_recloses_after_cooldown);
+    RUN_TEST(test_topup_leaves_an_off_relay_off);
+    RUN_TEST(test_trip_during_cutoff_is_not_undone);
+    RUN_TEST(test_replayed_document_changes_nothing);
+    RUN_TEST(test_exhausted_credit_survives_reboot);
+    TEST_MAIN_END();
+}
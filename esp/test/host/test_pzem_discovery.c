@@ -0,0 +1,120 @@
+// Discovery against a scripted bus: the Modbus transport is replaced by a
+// fake that answers from one meter address and charges bus time to the
+// virtual clock, so slice budgets and address coverage can be checked.
+
+#include "pzem_sensor.h"
+#include "modbus_crc.h"
+#include "modbus_rtu.h"
+#include "config.h"
+#include "test_util.h"
+
+#include <string.h>
+
+#define REPLY_MS    25
+
+static uint8_t  s_meter_addr;
+static bool     s_meter_answers_general;
+static uint32_t s_probes;
+
+esp_err_t modbus_rtu_init(void)                                 { return ESP_OK; }
+uint32_t  modbus_rtu_timeout_ms(uint8_t addr)                   { (void)addr; return 100; }
+void      modbus_rtu_note_header_error(uint8_t addr)            { (void)addr; }
+void      modbus_rtu_note_read_ok(uint8_t addr, uint32_t n)     { (void)addr; (void)n; }
+void      modbus_rtu_forget(uint8_t addr)                       { (void)addr; }
+uint64_t  energy_counter_update(uint8_t ch, uint32_t wh)        { (void)ch; return wh; }
+
+esp_err_t modbus_rtu_transact(const uint8_t *req, size_t req_len,
+                              uint8_t *resp, size_t resp_cap, size_t expected_len,
+                              uint32_t timeout_ms, size_t *out_len)
+{
+    (void)req_len; (void)expected_len;
+    s_probes++;
+    bool hit = s_meter_addr && (req[0] == s_meter_addr ||
+                                (req[0] == 0xF8 && s_meter_answers_general));
+    if (!hit || resp_cap < 7) {
+        host_advance_ms(timeout_ms);
+        *out_len = 0;
+        return ESP_ERR_TIMEOUT;
+    }
+    host_advance_ms(REPLY_MS);
+    resp[0] = req[0];
+    resp[1] = req[1];
+    resp[2] = 2;
+    resp[3] = 0x08;
+    resp[4] = 0xFC;
+    *out_len = modbus_crc16_append(resp, 5);
+    return ESP_OK;
+}
+
+// Run slices until the pass ends; every slice must respect its budget.
+static esp_err_t run_pass(uint32_t *slices)
+{
+    esp_err_t err = ESP_ERR_TIMEOUT;
+    *slices = 0;
+    while (pzem_sensor_discovery_pending() && *slices < 1000) {
+        int64_t t0 = host_time_us();
+        err = pzem_sensor_discover(PZEM_DISCOVERY_SLICE_MS);
+        int64_t spent_ms = (host_time_us() - t0) / 1000;
+        CHECK(spent_ms <= PZEM_DISCOVERY_SLICE_MS + PZEM_PROBE_TIMEOUT_MS);
+        (*slices)++;
+    }
+    return err;
+}
+
+static void test_finds_meter_at_top_of_range(void)
+{
+    // A meter that ignores 0xF8 and sits far above the old 5 s scan limit
+    s_meter_addr            = 0xF0;
+    s_meter_answers_general = false;
+    CHECK_EQ(pzem_sensor_init(), ESP_OK);
+
+    uint32_t slices = 0;
+    CHECK_EQ(run_pass(&slices), ESP_OK);
+    CHECK_EQ(pzem_sensor_channel_addr(0), 0xF0);
+    CHECK(slices > 1);
+    CHECK(!pzem_sensor_discovery_pending());
+    printf("  0xF0 found after %u slices, %u probes\n", (unsigned)slices, (unsigned)s_probes);
+
+    // registry remembers it: the next pass is a single verify probe
+    s_probes = 0;
+    CHECK_EQ(pzem_sensor_init(), ESP_OK);
+    CHECK_EQ(pzem_sensor_channel_addr(0), 0xF0);
+    pzem_sensor_request_discovery();
+    CHECK_EQ(run_pass(&slices), ESP_OK);
+    CHECK_EQ(slices, 1);
+    CHECK_EQ(s_probes, 1);
+}
+
+static void test_lone_meter_on_general_address(void)
+{
+    s_meter_addr            = 0x37;
+    s_meter_answers_general = true;
+    CHECK_EQ(pzem_sensor_init(), ESP_OK);
+    pzem_sensor_request_discovery();
+
+    uint32_t slices = 0;
+    CHECK_EQ(run_pass(&slices), ESP_OK);
+    CHECK_EQ(slices, 1);
+}
+
+static void test_missing_meter_covers_whole_range(void)
+{
+    s_meter_addr = 0;
+    s_probes     = 0;
+    CHECK_EQ(pzem_sensor_init(), ESP_OK);
+    pzem_sensor_request_discovery();
+
+    uint32_t slices = 0;
+    CHECK_EQ(run_pass(&slices), ESP_ERR_NOT_FOUND);
+    // every scan address 0x01–0xF7 once, plus the verify candidates
+    CHECK(s_probes >= 0xF7);
+    CHECK(!pzem_sensor_discovery_pending());
+}
+
+int main(void)
+{
+    RUN_TEST(test_finds_meter_at_top_of_range);
+    RUN_TEST(test_lone_meter_on_general_address);
+    RUN_TEST(test_missing_meter_covers_whole_range);
+    TEST_MAIN_END();
+}
@@ -0,0 +1,152 @@
+// Relay state machine, and trips / lockouts landing at every point where
+// the scheduler could switch away from a task in the middle of a change.
+
+#include "relay_control.h"
+#include "config.h"
+#include "test_util.h"
+
+#define PIN_ON      RELAY_ACTIVE_LEVEL
+#define PIN_OFF     (1 - RELAY_ACTIVE_LEVEL)
+
+static void setup(void)
+{
+    relay_init();
+    host_advance_ms(RELAY_COOLDOWN_MS);
+}
+
+// ── State machine ─────────────────────────────────────────────────────────────
+
+static void test_cooldown_applies_to_on_only(void)
+{
+    setup();
+    CHECK_EQ(host_gpio_level(RELAY_GPIO), PIN_OFF);
+    CHECK_EQ(relay_set_state(RELAY_STATE_ON), ESP_OK);
+    CHECK_EQ(host_gpio_level(RELAY_GPIO), PIN_ON);
+    CHECK_EQ(relay_set_state(RELAY_STATE_OFF), ESP_OK);
+    CHECK_EQ(host_gpio_level(RELAY_GPIO), PIN_OFF);
+
+    host_advance_ms(RELAY_COOLDOWN_MS - 10);
+    CHECK_EQ(relay_set_state(RELAY_STATE_ON), ESP_ERR_INVALID_STATE);
+    CHECK_EQ(relay_get_cooldown_remaining_ms(), 10);
+    CHECK_EQ(relay_set_state(RELAY_STATE_OFF), ESP_OK);     // already OFF: no new cooldown
+    host_advance_ms(10);
+    CHECK_EQ(relay_set_state(RELAY_STATE_ON), ESP_OK);
+    CHECK_EQ(host_gpio_level(RELAY_GPIO), PIN_ON);
+}
+
+static void test_lockout_opens_and_holds(void)
+{
+    setup();
+    CHECK_EQ(relay_set_state(RELAY_STATE_ON), ESP_OK);
+    CHECK_EQ(relay_set_lockout(true), ESP_OK);
+    CHECK_EQ(relay_get_state(), RELAY_STATE_OFF);
+    CHECK_EQ(host_gpio_level(RELAY_GPIO), PIN_OFF);
+
+    host_advance_ms(RELAY_COOLDOWN_MS);
+    CHECK_EQ(relay_set_state(RELAY_STATE_ON), ESP_ERR_INVALID_STATE);
+
+    CHECK_EQ(relay_set_lockout(false), ESP_OK);
+    CHECK_EQ(relay_get_state(), RELAY_STATE_OFF);           // releasing does not close
+    CHECK_EQ(relay_set_state(RELAY_STATE_ON), ESP_OK);
+}
+
+static void test_trip_needs_a_reset(void)
+{
+    setup();
+    CHECK_EQ(relay_set_state(RELAY_STATE_ON), ESP_OK);
+    host_advance_us(1234);
+    int64_t open_us = relay_trip(ANOMALY_OVERCURRENT);
+    CHECK_EQ(open_us, host_time_us());
+    CHECK_EQ(relay_get_state(), RELAY_STATE_TRIPPED);
+    CHECK_EQ(host_gpio_level(RELAY_GPIO), PIN_OFF);
+    CHECK_EQ(relay_get_trip_count(), 1);
+    CHECK_EQ(relay_get_last_trip_reason(), ANOMALY_OVERCURRENT);
+
+    host_advance_ms(RELAY_COOLDOWN_MS);
+    CHECK_EQ(relay_set_state(RELAY_STATE_ON), ESP_ERR_INVALID_STATE);
+    CHECK_EQ(relay_set_state(RELAY_STATE_OFF), ESP_OK);
+    CHECK_EQ(relay_set_state(RELAY_STATE_ON), ESP_ERR_INVALID_STATE);   // reset starts a cooldown
+    host_advance_ms(RELAY_COOLDOWN_MS);
+    CHECK_EQ(relay_set_state(RELAY_STATE_ON), ESP_OK);
+
+    relay_reset_trip_count();
+    CHECK_EQ(relay_get_trip_count(), 0);
+}
+
+// ── Interleavings ─────────────────────────────────────────────────────────────
+
+static uint32_t s_fire_at;
+static int      s_bad_writes;
+static void   (*s_intruder)(void);
+
+static void fire_at_k(void *arg)
+{
+    if (host_preempt_count() == s_fire_at) s_intruder();
+}
+
+// Whoever writes the pin, it must never close the relay unless the state
+// word says ON at that moment
+static void check_on_write(gpio_num_t pin, uint32_t level, void *arg)
+{
+    if (pin == RELAY_GPIO && (int)level == PIN_ON && relay_get_state() != RELAY_STATE_ON) {
+        s_bad_writes++;
+    }
+}
+
+static void trip_now(void)   { relay_trip(ANOMALY_SHORT_CIRCUIT); }
+static void lock_now(void)   { relay_set_lockout(true); }
+static void switch_on(void)  { relay_set_state(RELAY_STATE_ON); }
+
+// Run `victim` once per preemption point it reaches, with `intruder` run at
+// that point, and return how many points there were
+static uint32_t interleave(void (*victim)(void), void (*intruder)(void),
+                           relay_state_t want_state, bool want_locked)
+{
+    uint32_t k;
+    for (k = 1;; k++) {
+        host_reset();
+        setup();
+        s_bad_writes = 0;
+        s_fire_at    = k;
+        s_intruder   = intruder;
+        host_set_gpio_observer(check_on_write, NULL);
+        host_set_preempt_hook(fire_at_k, NULL);
+        victim();
+        uint32_t points = host_preempt_count();
+        host_set_preempt_hook(NULL, NULL);
+        host_set_gpio_observer(NULL, NULL);
+        if (points < k) break;      // the intruder never ran: every point covered
+
+        CHECK_EQ(s_bad_writes, 0);
+        CHECK_EQ(relay_get_state(), want_state);
+        CHECK_EQ(relay_is_locked_out(), want_locked);
+        CHECK_EQ(host_gpio_level(RELAY_GPIO), PIN_OFF);
+    }
+    return k - 1;
+}
+
+static void test_trip_during_switch_on(void)
+{
+    CHECK(interleave(switch_on, trip_now, RELAY_STATE_TRIPPED, false) > 0);
+}
+
+static void test_switch_on_during_trip(void)
+{
+    CHECK(interleave(trip_now, switch_on, RELAY_STATE_TRIPPED, false) > 0);
+}
+
+static void test_lockout_during_switch_on(void)
+{
+    CHECK(interleave(switch_on, lock_now, RELAY_STATE_OFF, true) > 0);
+}
+
+int main(void)
+{
+    RUN_TEST(test_cooldown_applies_to_on_only);
+    RUN_TEST(test_lockout_opens_and_holds);
+    RUN_TEST(test_trip_needs_a_reset);
+    RUN_TEST(test_trip_during_switch_on);
+    RUN_TEST(test_switch_on_during_trip);
+    RUN_TEST(test_lockout_during_switch_on);
+    TEST_MAIN_END();
+}
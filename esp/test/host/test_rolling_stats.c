@@ -0,0 +1,126 @@
+#include "rolling_stats.h"
+#include "test_util.h"
+
+#include <stdlib.h>
+
+#define MAX_N   16383
+
+static uint32_t s_samples[MAX_N];
+static uint16_t s_min_q[MAX_N], s_max_q[MAX_N];
+static uint32_t s_ref[MAX_N];
+
+// Brute-force statistics of the newest n of `count` values pushed into the
+// s_ref ring (slot = push index % window).
+typedef struct {
+    uint64_t sum;
+    uint32_t min, max;
+    uint64_t var;
+} ref_stats_t;
+
+static ref_stats_t ref_stats(uint32_t count, uint32_t n)
+{
+    ref_stats_t r = { .min = UINT32_MAX };
+    unsigned __int128 sq = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t v = s_ref[(count - 1 - i) % n];
+        r.sum += v;
+        sq    += (unsigned __int128)v * v;
+        if (v < r.min) r.min = v;
+        if (v > r.max) r.max = v;
+    }
+    unsigned __int128 s2 = (unsigned __int128)r.sum * r.sum / n;
+    r.var = n < 2 ? 0 : (uint64_t)((sq - s2) / n);
+    return r;
+}
+
+static void run_against_reference(uint16_t window, uint32_t max_sample, uint32_t pushes)
+{
+    rolling_stats_t rs;
+    rolling_stats_init(&rs, s_samples, s_min_q, s_max_q, window);
+
+    for (uint32_t k = 1; k <= pushes; k++) {
+        uint32_t v = (uint32_t)(((uint64_t)rand() << 16 ^ (uint64_t)rand()) % ((uint64_t)max_sample + 1));
+        if (k % 97 == 0) v = max_sample;        // saturate now and then
+        rolling_stats_push(&rs, v);
+        s_ref[(k - 1) % window] = v;
+
+        uint32_t n = k < window ? k : window;
+        CHECK_EQ(rs.count, n);
+        CHECK_EQ(rolling_stats_full(&rs), n == window);
+        if (k % 7 && k != pushes) continue;     // full compare on a subset
+
+        ref_stats_t r = ref_stats(k, n);
+        CHECK_EQ(rolling_stats_sum(&rs), r.sum);
+        CHECK_EQ(rolling_stats_mean(&rs), r.sum / n);
+        CHECK_EQ(rolling_stats_min(&rs), r.min);
+        CHECK_EQ(rolling_stats_max(&rs), r.max);
+        if (ROLLING_STATS_EXACT(window, max_sample)) {
+            CHECK(rolling_stats_variance(&rs) == r.var);
+        }
+    }
+}
+
+static void test_small_windows(void)
+{
+    srand(1);
+    run_against_reference(1, 1000, 50);
+    run_against_reference(2, 1000, 50);
+    run_against_reference(10, 230000, 2000);    // the fire window: 0.1 W samples
+}
+
+static void test_monotonic_runs(void)
+{
+    // strictly rising then falling input keeps one deque at full length
+    rolling_stats_t rs;
+    rolling_stats_init(&rs, s_samples, s_min_q, s_max_q, 8);
+    for (uint32_t v = 0; v < 20; v++) rolling_stats_push(&rs, v);
+    CHECK_EQ(rolling_stats_min(&rs), 12);
+    CHECK_EQ(rolling_stats_max(&rs), 19);
+    for (uint32_t v = 20; v > 0; v--) rolling_stats_push(&rs, v);
+    CHECK_EQ(rolling_stats_min(&rs), 1);
+    CHECK_EQ(rolling_stats_max(&rs), 8);
+    CHECK_EQ(rolling_stats_mean(&rs), (1 + 8) * 8 / 2 / 8);
+}
+
+static void test_exact_bound_at_largest_window(void)
+{
+    // 2^25 is the documented ceiling at ROLLING_STATS_MAX_WINDOW
+    CHECK(ROLLING_STATS_EXACT(MAX_N, 1u << 25));
+    CHECK(!ROLLING_STATS_EXACT(MAX_N, 1u << 26));
+    CHECK(ROLLING_STATS_EXACT(1, UINT32_MAX));
+    CHECK(!ROLLING_STATS_EXACT(2, UINT32_MAX));
+
+    srand(2);
+    run_against_reference(MAX_N, 1u << 25, 3 * MAX_N);
+}
+
+static void test_clear_and_init_clamp(void)
+{
+    rolling_stats_t rs;
+    rolling_stats_init(&rs, s_samples, s_min_q, s_max_q, 0);
+    CHECK_EQ(rs.window, 1);
+    rolling_stats_push(&rs, 5);
+    rolling_stats_push(&rs, 9);
+    CHECK_EQ(rolling_stats_mean(&rs), 9);
+    CHECK_EQ(rolling_stats_variance(&rs), 0);
+
+    rolling_stats_init(&rs, s_samples, s_min_q, s_max_q, 4);
+    for (uint32_t v = 1; v <= 4; v++) rolling_stats_push(&rs, v * 10);
+    rolling_stats_clear(&rs);
+    CHECK_EQ(rs.count, 0);
+    CHECK_EQ(rolling_stats_mean(&rs), 0);
+    CHECK_EQ(rolling_stats_min(&rs), 0);
+    CHECK_EQ(rolling_stats_max(&rs), 0);
+    rolling_stats_push(&rs, 7);
+    CHECK_EQ(rolling_stats_min(&rs), 7);
+    CHECK_EQ(rolling_stats_max(&rs), 7);
+}
+
+int main(void)
+{
+    RUN_TEST(test_small_windows);
+    RUN_TEST(test_monotonic_runs);
+    RUN_TEST(test_exact_bound_at_largest_window);
+    RUN_TEST(test_clear_and_init_clamp);
+    TEST_MAIN_END();
+}
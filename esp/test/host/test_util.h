@@ -0,0 +1,39 @@
+#pragma once
+
+// Minimal assertion helpers: a failed CHECK reports and counts, the test
+// carries on, and TEST_MAIN_END turns the count into the exit status.
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "host_fakes.h"
+
+static int s_test_failures;
+
+#define CHECK(cond)                                                             \
+    do {                                                                        \
+        if (!(cond)) {                                                          \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);     \
+            s_test_failures++;                                                  \
+        }                                                                       \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                          \
+    do {                                                                        \
+        long long _a = (long long)(a), _b = (long long)(b);                     \
+        if (_a != _b) {                                                         \
+            printf("%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n",            \
+                   __FILE__, __LINE__, #a, #b, _a, _b);                         \
+            s_test_failures++;                                                  \
+        }                                                                       \
+    } while (0)
+
+#define RUN_TEST(fn)                                                            \
+    do {                                                                        \
+        int _before = s_test_failures;                                          \
+        host_reset();                                                           \
+        fn();                                                                   \
+        printf("%s %s\n", s_test_failures == _before ? "PASS" : "FAIL", #fn);   \
+    } while (0)
+
+#define TEST_MAIN_END() return s_test_failures ? 1 : 0
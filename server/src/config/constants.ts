@@ -33,8 +33,59 @@ export const ANOMALY_TYPES = [
   'overpower',
   'arc_fault',
   'ground_fault',
+  'low_power_factor',
+  'frequency_deviation',
 ] as const;
 
+export const ANOMALY_PHASES = ['onset', 'update', 'clear'] as const;
+
+// Upper bound on one black-box upload (firmware keeps 10 s × 5 Hz per channel)
+export const BLACKBOX_MAX_SAMPLES = 1000;
+
+export const PQ_KINDS = ['sag', 'swell', 'interruption'] as const;
+
+// IEEE 1159 duration classes
+export const PQ_CATEGORIES = ['instantaneous', 'momentary', 'temporary', 'sustained'] as const;
+
+// Upper bound on records in one upload (firmware batches up to 8)
+export const PQ_MAX_EVENTS_PER_POST = 32;
+
+// Firmware rule table (esp/main/include/anomaly_rules.h)
+export const ANOMALY_RULE_METRICS = [
+  'current',
+  'voltage',
+  'power',
+  'power_alarm',
+  'power_rise',
+  'thermal',
+  'power_factor',
+  'frequency',
+  'rocof',
+] as const;
+
+export const ANOMALY_RULE_MAX = 16;
+
+// Firmware anomaly model (esp/main/include/anomaly_model.h)
+export const ANOMALY_MODEL_FEATURES = 12;
+export const ANOMALY_MODEL_MAX_HIDDEN = 16;
+export const ANOMALY_MODEL_FLAG_REVIEWS = ['fault', 'normal'] as const;
+
+// Upper bound on readings in one flagged window (firmware: 10, at most 60 s)
+export const ANOMALY_MODEL_MAX_SAMPLES = 60;
+
+// Firmware appliance events (esp/main/include/nilm.h)
+export const APPLIANCE_EDGES = ['on', 'off'] as const;
+
+// Upper bounds on one upload (firmware batches up to 8 edges, 12 signatures)
+export const APPLIANCE_MAX_EVENTS_PER_POST = 32;
+export const APPLIANCE_MAX_SIGNATURES = 64;
+
+// Firmware prepaid states (esp/main/include/prepaid.h)
+export const PREPAID_STATES = ['disabled', 'ok', 'low', 'critical', 'exhausted'] as const;
+
+// Firmware forecast states (esp/main/include/forecast.h)
+export const FORECAST_STATES = ['none', 'ok', 'warning', 'over', 'exceeded'] as const;
+
 export const RELAY_STATUSES = ['on', 'off', 'tripped'] as const;
 
 export const USER_ROLES = ['admin', 'user'] as const;
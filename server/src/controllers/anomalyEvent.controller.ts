@@ -1,18 +1,36 @@
 import { Request, Response, NextFunction } from 'express';
 import { DeviceModel } from '../models/device.model';
 import { AnomalyEventModel } from '../models/anomalyEvent.model';
+import { AnomalyBlackboxModel } from '../models/anomalyBlackbox.model';
 import { sseService } from '../services/sse.service';
 import { AppError } from '../utils/AppError';
 import { sendSuccess } from '../utils/apiResponse';
 import { asyncHandler } from '../utils/asyncHandler';
 import { HTTP_STATUS, ERROR_CODES } from '../config/constants';
-import { AnomalyEventRequest } from '../types/api';
+import { AnomalyEventRequest, BlackboxUploadRequest } from '../types/api';
+import { AnomalyEpisodeRollup } from '../types/models';
 import { logger } from '../utils/logger';
 
 export const submitAnomalyEvent = asyncHandler(
   async (req: Request, res: Response, _next: NextFunction) => {
-    const { device_id, timestamp, anomaly_type, current, voltage, power, relay_tripped, severity } =
-      req.body as AnomalyEventRequest;
+    const {
+      device_id,
+      timestamp,
+      anomaly_type,
+      current,
+      voltage,
+      power,
+      relay_tripped,
+      trip_latency_us,
+      severity,
+      episode_id,
+      phase,
+      metric,
+      duration_ms,
+      peak,
+      min,
+      integral,
+    } = req.body as AnomalyEventRequest;
 
     const device = await DeviceModel.findByDeviceId(device_id);
 
@@ -45,6 +63,68 @@ export const submitAnomalyEvent = asyncHandler(
 
     const determinedSeverity = relay_tripped ? 'critical' : severity || 'medium';
 
+    const episode: AnomalyEpisodeRollup | undefined =
+      episode_id !== undefined
+        ? {
+            episode_id,
+            phase: phase ?? 'onset',
+            metric,
+            duration_ms: duration_ms ?? 0,
+            peak,
+            min,
+            integral,
+          }
+        : undefined;
+
+    // Rollups and clears (and retried onsets) land on the episode's row
+    const existing = episode
+      ? await AnomalyEventModel.findByEpisode(device.id, episode.episode_id)
+      : null;
+    if (existing && episode) {
+      await AnomalyEventModel.updateEpisode(
+        existing.id,
+        episode,
+        episode.phase === 'clear' ? eventTimestamp : null
+      );
+      // An onset re-sent with relay_tripped is a trip rule taking over an
+      // episode that opened as log-only
+      const escalated = !!relay_tripped && !existing.relay_tripped;
+      if (escalated) {
+        await AnomalyEventModel.markTripped(
+          existing.id,
+          episode.metric ?? null,
+          trip_latency_us ?? null
+        );
+        await DeviceModel.update(device.id, { relay_status: 'tripped' });
+        logger.warn(
+          `Anomaly episode ${episode.episode_id} escalated to a trip on device ${device_id} (ID: ${existing.id})`
+        );
+      }
+      await DeviceModel.updateLastSeen(device.id);
+
+      sseService.sendToDevice(device.id, `anomaly_${episode.phase}`, {
+        event_id: existing.id,
+        device_id,
+        anomaly_type,
+        episode_id: episode.episode_id,
+        relay_tripped: !!relay_tripped || !!existing.relay_tripped,
+        ...(escalated && { severity: 'critical', trip_latency_us }),
+        duration_ms: episode.duration_ms,
+        peak_value: episode.peak,
+        min_value: episode.min,
+        integral_value: episode.integral,
+        timestamp: eventTimestamp,
+      });
+
+      sendSuccess(res, {
+        event_id: existing.id,
+        message: `Anomaly episode ${episode.phase} recorded`,
+      });
+      return;
+    }
+
+    // First report of the episode — normally its onset, but a lost onset
+    // is recovered from whichever report arrives first
     const eventId = await AnomalyEventModel.create(
       device.id,
       eventTimestamp,
@@ -53,7 +133,9 @@ export const submitAnomalyEvent = asyncHandler(
       current,
       voltage,
       power,
-      relay_tripped
+      relay_tripped,
+      episode,
+      trip_latency_us
     );
 
     if (relay_tripped) {
@@ -72,10 +154,12 @@ export const submitAnomalyEvent = asyncHandler(
       anomaly_type,
       severity: determinedSeverity,
       relay_tripped,
+      trip_latency_us,
       timestamp: eventTimestamp,
       current_value: current,
       voltage_value: voltage,
       power_value: power,
+      episode_id,
     });
 
     sendSuccess(
@@ -86,6 +170,46 @@ export const submitAnomalyEvent = asyncHandler(
   }
 );
 
+/** POST /anomaly-events/blackbox — ESP: readings leading up to a trip or abnormal reset */
+export const submitBlackbox = asyncHandler(
+  async (req: Request, res: Response, _next: NextFunction) => {
+    const { device_id, reason, episode_id, reset_reason, samples } =
+      req.body as BlackboxUploadRequest;
+
+    const device = await DeviceModel.findByDeviceId(device_id);
+
+    if (!device) {
+      throw new AppError('Device not found', HTTP_STATUS.NOT_FOUND, ERROR_CODES.DEVICE_NOT_FOUND);
+    }
+
+    // The firmware uploads after the anomaly event, so the episode row normally exists
+    const event =
+      episode_id !== undefined
+        ? await AnomalyEventModel.findByEpisode(device.id, episode_id)
+        : null;
+
+    const recordingId = await AnomalyBlackboxModel.create(
+      device.id,
+      event ? event.id : null,
+      episode_id ?? null,
+      reason,
+      reset_reason ?? null,
+      samples
+    );
+
+    logger.info(
+      `Black box (${reason}, ${samples.length} samples) from device ${device_id}` +
+        (event ? ` linked to anomaly ${event.id}` : '')
+    );
+
+    sendSuccess(
+      res,
+      { recording_id: recordingId, event_id: event ? event.id : null },
+      HTTP_STATUS.CREATED
+    );
+  }
+);
+
 export const getAnomalyEvents = asyncHandler(
   async (req: Request, res: Response, _next: NextFunction) => {
     if (!req.user) {
@@ -202,6 +326,47 @@ export const resolveAnomaly = asyncHandler(
   }
 );
 
+/** GET /anomaly-events/:id/blackbox — readings recorded before the event's trip */
+export const getAnomalyBlackbox = asyncHandler(
+  async (req: Request, res: Response, _next: NextFunction) => {
+    if (!req.user) {
+      throw new AppError(
+        'User not authenticated',
+        HTTP_STATUS.UNAUTHORIZED,
+        ERROR_CODES.UNAUTHORIZED
+      );
+    }
+
+    const eventId = parseInt(req.params.id, 10);
+
+    const event = await AnomalyEventModel.findById(eventId);
+
+    if (!event) {
+      throw new AppError('Anomaly event not found', HTTP_STATUS.NOT_FOUND, ERROR_CODES.NOT_FOUND);
+    }
+
+    const ok =
+      req.user.role === 'admin' ||
+      (await DeviceModel.isAccessibleByUser(event.device_id, req.user.id));
+
+    if (!ok) {
+      throw new AppError('Access denied', HTTP_STATUS.FORBIDDEN, ERROR_CODES.FORBIDDEN);
+    }
+
+    const recording = await AnomalyBlackboxModel.findByEvent(eventId);
+
+    if (!recording) {
+      throw new AppError(
+        'No black-box recording for this event',
+        HTTP_STATUS.NOT_FOUND,
+        ERROR_CODES.NOT_FOUND
+      );
+    }
+
+    sendSuccess(res, recording);
+  }
+);
+
 /** DELETE /anomaly-events/:id — admin: delete a single anomaly event */
 export const deleteAnomalyEvent = asyncHandler(
   async (req: Request, res: Response, _next: NextFunction) => {
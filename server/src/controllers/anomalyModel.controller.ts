@@ -0,0 +1,182 @@
+import { Request, Response, NextFunction } from 'express';
+import { AnomalyModelModel } from '../models/anomalyModel.model';
+import { AnomalyModelFlagModel } from '../models/anomalyModelFlag.model';
+import { DeviceModel } from '../models/device.model';
+import { sseService } from '../services/sse.service';
+import { AppError } from '../utils/AppError';
+import { sendSuccess } from '../utils/apiResponse';
+import { asyncHandler } from '../utils/asyncHandler';
+import { HTTP_STATUS, ERROR_CODES } from '../config/constants';
+import { ModelFlagReviewRequest, ModelFlagUploadRequest } from '../types/api';
+import { AnomalyModelDoc } from '../types/models';
+import { logger } from '../utils/logger';
+
+/** GET /devices/:id/anomaly-model — ESP polls its scoring model (API key auth) */
+export const getDeviceAnomalyModel = asyncHandler(
+  async (req: Request, res: Response, _next: NextFunction) => {
+    const deviceId = req.deviceId;
+    if (!deviceId)
+      throw new AppError(
+        'Device not identified',
+        HTTP_STATUS.UNAUTHORIZED,
+        ERROR_CODES.UNAUTHORIZED
+      );
+
+    const stored = await AnomalyModelModel.findByDevice(deviceId);
+
+    // null tells the firmware to keep whatever it has (NVS copy or no model)
+    sendSuccess(res, {
+      version: stored ? stored.version : null,
+      model: stored ? stored.model : null,
+    });
+  }
+);
+
+/** GET /devices/:id/anomaly-model/admin — admin views the stored model */
+export const getAnomalyModel = asyncHandler(
+  async (req: Request, res: Response, _next: NextFunction) => {
+    const deviceId = parseInt(req.params.id, 10);
+    const stored = await AnomalyModelModel.findByDevice(deviceId);
+    sendSuccess(res, { anomaly_model: stored });
+  }
+);
+
+/** PUT /devices/:id/anomaly-model — admin installs a model trained offline */
+export const setAnomalyModel = asyncHandler(
+  async (req: Request, res: Response, _next: NextFunction) => {
+    if (!req.user)
+      throw new AppError('Unauthenticated', HTTP_STATUS.UNAUTHORIZED, ERROR_CODES.UNAUTHORIZED);
+
+    const deviceId = parseInt(req.params.id, 10);
+    const device = await DeviceModel.findById(deviceId);
+    if (!device)
+      throw new AppError('Device not found', HTTP_STATUS.NOT_FOUND, ERROR_CODES.DEVICE_NOT_FOUND);
+
+    // Keep only the fields the firmware reads
+    const m = req.body.model as AnomalyModelDoc;
+    const model: AnomalyModelDoc = {
+      features: m.features,
+      n_hidden: m.n_hidden,
+      shift1: m.shift1,
+      shift2: m.shift2,
+      threshold: m.threshold,
+      confirm: m.confirm,
+      center: m.center,
+      mult: m.mult,
+      w1: m.w1,
+      b1: m.b1,
+      w2: m.w2,
+      b2: m.b2,
+    };
+
+    const stored = await AnomalyModelModel.upsert(deviceId, model, req.user.id);
+    logger.info(
+      `[Model] v${stored.version} (${model.n_hidden} hidden) set for device "${device.device_id}" (db#${deviceId}) by user=${req.user.id}`
+    );
+
+    sendSuccess(res, { anomaly_model: stored });
+  }
+);
+
+/** DELETE /devices/:id/anomaly-model — admin removes the stored model */
+export const deleteAnomalyModel = asyncHandler(
+  async (req: Request, res: Response, _next: NextFunction) => {
+    const deviceId = parseInt(req.params.id, 10);
+    await AnomalyModelModel.remove(deviceId);
+    sendSuccess(res, { message: 'Anomaly model removed' });
+  }
+);
+
+/** POST /anomaly-events/model-flags — ESP: a window its model could not reconstruct */
+export const submitModelFlag = asyncHandler(
+  async (req: Request, res: Response, _next: NextFunction) => {
+    const { device_id, model_version, score, threshold, age_ms, features, samples } =
+      req.body as ModelFlagUploadRequest;
+
+    const device = await DeviceModel.findByDeviceId(device_id);
+
+    if (!device) {
+      throw new AppError('Device not found', HTTP_STATUS.NOT_FOUND, ERROR_CODES.DEVICE_NOT_FOUND);
+    }
+
+    // The window start arrives as an age, so the ESP's clock does not matter
+    const windowStart = new Date(Date.now() - age_ms);
+    const flagId = await AnomalyModelFlagModel.create(device.id, {
+      modelVersion: model_version,
+      score,
+      threshold,
+      windowStart,
+      features,
+      samples,
+    });
+    await DeviceModel.updateLastSeen(device.id);
+
+    logger.info(
+      `Model v${model_version} flagged a window on device ${device_id}: score ${score} (threshold ${threshold})`
+    );
+    sseService.sendToDevice(device.id, 'anomaly_model_flag', {
+      device_id,
+      flag_id: flagId,
+      model_version,
+      score,
+      threshold,
+      window_start: windowStart,
+    });
+
+    sendSuccess(res, { flag_id: flagId }, HTTP_STATUS.CREATED);
+  }
+);
+
+/** GET /anomaly-events/devices/:id/model-flags — flagged windows, newest first */
+export const getModelFlags = asyncHandler(
+  async (req: Request, res: Response, _next: NextFunction) => {
+    if (!req.user) {
+      throw new AppError(
+        'User not authenticated',
+        HTTP_STATUS.UNAUTHORIZED,
+        ERROR_CODES.UNAUTHORIZED
+      );
+    }
+
+    const deviceId = parseInt(req.params.id, 10);
+    const ok =
+      req.user.role === 'admin' || (await DeviceModel.isAccessibleByUser(deviceId, req.user.id));
+
+    if (!ok) {
+      throw new AppError('Access denied', HTTP_STATUS.FORBIDDEN, ERROR_CODES.FORBIDDEN);
+    }
+
+    const startTime = req.query.start_time ? new Date(req.query.start_time as string) : new Date(0);
+    const endTime = req.query.end_time
+      ? new Date(req.query.end_time as string)
+      : new Date(Date.now() + 24 * 60 * 60 * 1000);
+    const limit = req.query.limit ? parseInt(req.query.limit as string, 10) : 100;
+    const unreviewed = req.query.unreviewed === 'true';
+
+    const flags = await AnomalyModelFlagModel.findByDeviceAndTimeRange(
+      deviceId,
+      startTime,
+      endTime,
+      unreviewed,
+      limit
+    );
+
+    sendSuccess(res, { flags, count: flags.length });
+  }
+);
+
+/** PUT /anomaly-events/model-flags/:id/review — admin labels a flagged window */
+export const reviewModelFlag = asyncHandler(
+  async (req: Request, res: Response, _next: NextFunction) => {
+    const flagId = parseInt(req.params.id, 10);
+    const { review, note } = req.body as ModelFlagReviewRequest;
+
+    const flag = await AnomalyModelFlagModel.findById(flagId);
+    if (!flag) {
+      throw new AppError('Model flag not found', HTTP_STATUS.NOT_FOUND, ERROR_CODES.NOT_FOUND);
+    }
+
+    await AnomalyModelFlagModel.review(flagId, review, note ?? null, req.user!.id);
+    sendSuccess(res, { flag: await AnomalyModelFlagModel.findById(flagId) });
+  }
+);
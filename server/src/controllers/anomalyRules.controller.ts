@@ -0,0 +1,85 @@
+import { Request, Response, NextFunction } from 'express';
+import { AnomalyRulesModel } from '../models/anomalyRules.model';
+import { DeviceModel } from '../models/device.model';
+import { AnomalyRule } from '../types/models';
+import { AppError } from '../utils/AppError';
+import { sendSuccess } from '../utils/apiResponse';
+import { asyncHandler } from '../utils/asyncHandler';
+import { HTTP_STATUS, ERROR_CODES } from '../config/constants';
+import { logger } from '../utils/logger';
+
+/** GET /devices/:id/anomaly-rules — ESP polls its rule table (API key auth) */
+export const getDeviceAnomalyRules = asyncHandler(
+  async (req: Request, res: Response, _next: NextFunction) => {
+    const deviceId = req.deviceId;
+    if (!deviceId)
+      throw new AppError(
+        'Device not identified',
+        HTTP_STATUS.UNAUTHORIZED,
+        ERROR_CODES.UNAUTHORIZED
+      );
+
+    const table = await AnomalyRulesModel.findByDevice(deviceId);
+
+    // null tells the firmware to keep whatever it has (NVS or built-in defaults)
+    sendSuccess(res, {
+      version: table ? table.version : null,
+      rules: table ? table.rules : null,
+    });
+  }
+);
+
+/** GET /devices/:id/anomaly-rules/admin — admin views the stored table */
+export const getAnomalyRules = asyncHandler(
+  async (req: Request, res: Response, _next: NextFunction) => {
+    const deviceId = parseInt(req.params.id, 10);
+    const table = await AnomalyRulesModel.findByDevice(deviceId);
+    sendSuccess(res, { anomaly_rules: table });
+  }
+);
+
+/** PUT /devices/:id/anomaly-rules — admin replaces the device's rule table */
+export const setAnomalyRules = asyncHandler(
+  async (req: Request, res: Response, _next: NextFunction) => {
+    if (!req.user)
+      throw new AppError('Unauthenticated', HTTP_STATUS.UNAUTHORIZED, ERROR_CODES.UNAUTHORIZED);
+
+    const deviceId = parseInt(req.params.id, 10);
+    const device = await DeviceModel.findById(deviceId);
+    if (!device)
+      throw new AppError('Device not found', HTTP_STATUS.NOT_FOUND, ERROR_CODES.DEVICE_NOT_FOUND);
+
+    // Keep only the fields the firmware reads; order is evaluation priority
+    const rules: AnomalyRule[] = (req.body.rules as AnomalyRule[]).map((r) => ({
+      type: r.type,
+      metric: r.metric,
+      op: r.op,
+      threshold: Number(r.threshold),
+      confirm_ms: r.confirm_ms !== undefined ? Number(r.confirm_ms) : 0,
+      severity: r.severity ?? 'medium',
+      action: r.action ?? 'log',
+      ...(r.min_power !== undefined ? { min_power: Number(r.min_power) } : {}),
+      ...(r.k !== undefined ? { k: Number(r.k) } : {}),
+      ...(r.cool_ms !== undefined ? { cool_ms: Number(r.cool_ms) } : {}),
+      ...(r.min_current !== undefined ? { min_current: Number(r.min_current) } : {}),
+      ...(r.max_current !== undefined ? { max_current: Number(r.max_current) } : {}),
+      ...(r.window_ms !== undefined ? { window_ms: Number(r.window_ms) } : {}),
+    }));
+
+    const table = await AnomalyRulesModel.upsert(deviceId, rules, req.user.id);
+    logger.info(
+      `[Rules] v${table.version} (${rules.length} rules) set for device "${device.device_id}" (db#${deviceId}) by user=${req.user.id}`
+    );
+
+    sendSuccess(res, { anomaly_rules: table });
+  }
+);
+
+/** DELETE /devices/:id/anomaly-rules — admin reverts the device to its built-in rules */
+export const deleteAnomalyRules = asyncHandler(
+  async (req: Request, res: Response, _next: NextFunction) => {
+    const deviceId = parseInt(req.params.id, 10);
+    await AnomalyRulesModel.remove(deviceId);
+    sendSuccess(res, { message: 'Anomaly rules removed' });
+  }
+);
@@ -0,0 +1,188 @@
+import { Request, Response, NextFunction } from 'express';
+import { DeviceModel } from '../models/device.model';
+import { DeviceApplianceModel } from '../models/deviceAppliance.model';
+import { ApplianceEventModel, ApplianceEventInsert } from '../models/applianceEvent.model';
+import { sseService } from '../services/sse.service';
+import { AppError } from '../utils/AppError';
+import { sendSuccess } from '../utils/apiResponse';
+import { asyncHandler } from '../utils/asyncHandler';
+import { HTTP_STATUS, ERROR_CODES } from '../config/constants';
+import {
+  ApplianceEventUploadRequest,
+  ApplianceSummaryRequest,
+  ApplianceLabelRequest,
+} from '../types/api';
+import { logger } from '../utils/logger';
+
+async function findActiveDevice(deviceId: string) {
+  const device = await DeviceModel.findByDeviceId(deviceId);
+
+  if (!device) {
+    throw new AppError('Device not found', HTTP_STATUS.NOT_FOUND, ERROR_CODES.DEVICE_NOT_FOUND);
+  }
+
+  if (!device.is_active) {
+    throw new AppError('Device is not active', HTTP_STATUS.FORBIDDEN, ERROR_CODES.DEVICE_INACTIVE);
+  }
+
+  return device;
+}
+
+/** POST /appliance-events — ESP: on/off edges from the step-change detector */
+export const submitApplianceEvents = asyncHandler(
+  async (req: Request, res: Response, _next: NextFunction) => {
+    const { device_id, events } = req.body as ApplianceEventUploadRequest;
+
+    const device = await findActiveDevice(device_id);
+
+    // Edge times arrive as an age relative to the upload, like power-quality records
+    const receivedAt = Date.now();
+    const rows: ApplianceEventInsert[] = events.map((e) => ({
+      applianceId: e.appliance_id > 0 ? e.appliance_id : null,
+      edge: e.edge,
+      occurredAt: new Date(receivedAt - e.age_ms),
+      powerStep: e.power_step,
+      reactiveStep: e.reactive_step,
+      pfStep: e.pf_step,
+      inrushPct: e.inrush_pct,
+      settleMs: e.settle_ms,
+      newSignature: e.new_signature === true,
+      atIdle: e.at_idle === true,
+    }));
+
+    // A signature is listed from its first edge; totals follow with the next summary
+    for (const r of rows) {
+      if (r.edge === 'on' && r.applianceId !== null) {
+        await DeviceApplianceModel.ensure(
+          device.id,
+          r.applianceId,
+          r.powerStep,
+          r.reactiveStep,
+          r.inrushPct
+        );
+      }
+    }
+
+    const count = await ApplianceEventModel.createMany(device.id, rows);
+    await DeviceModel.updateLastSeen(device.id);
+
+    logger.info(`${count} appliance edge(s) recorded for device ${device_id}`);
+
+    sseService.sendToDevice(device.id, 'appliance_event', {
+      device_id,
+      events: rows.map((r) => ({
+        appliance_id: r.applianceId,
+        edge: r.edge,
+        occurred_at: r.occurredAt,
+        power_step: r.powerStep,
+        inrush_pct: r.inrushPct,
+        new_signature: r.newSignature,
+      })),
+    });
+
+    sendSuccess(res, { recorded: count }, HTTP_STATUS.CREATED);
+  }
+);
+
+/** POST /appliance-events/summary — ESP: signature table and per-appliance energy */
+export const submitApplianceSummary = asyncHandler(
+  async (req: Request, res: Response, _next: NextFunction) => {
+    const { device_id, appliances } = req.body as ApplianceSummaryRequest;
+
+    const device = await findActiveDevice(device_id);
+
+    const count = await DeviceApplianceModel.upsertSummary(device.id, appliances);
+    await DeviceModel.updateLastSeen(device.id);
+
+    sendSuccess(res, { updated: count });
+  }
+);
+
+/**
+ * GET /appliance-events/devices/:id — learned appliances with their energy
+ * and trip counts, plus the edge log (newest first, ?appliance_id= for one)
+ */
+export const getDeviceAppliances = asyncHandler(
+  async (req: Request, res: Response, _next: NextFunction) => {
+    if (!req.user) {
+      throw new AppError(
+        'User not authenticated',
+        HTTP_STATUS.UNAUTHORIZED,
+        ERROR_CODES.UNAUTHORIZED
+      );
+    }
+
+    const deviceId = parseInt(req.params.id, 10);
+
+    const device = await DeviceModel.findById(deviceId);
+
+    if (!device) {
+      throw new AppError('Device not found', HTTP_STATUS.NOT_FOUND, ERROR_CODES.DEVICE_NOT_FOUND);
+    }
+
+    const ok =
+      req.user.role === 'admin' || (await DeviceModel.isAccessibleByUser(deviceId, req.user.id));
+
+    if (!ok) {
+      throw new AppError('Access denied', HTTP_STATUS.FORBIDDEN, ERROR_CODES.FORBIDDEN);
+    }
+
+    const startTime = req.query.start_time ? new Date(req.query.start_time as string) : new Date(0);
+    const endTime = req.query.end_time
+      ? new Date(req.query.end_time as string)
+      : new Date(Date.now() + 24 * 60 * 60 * 1000);
+    const limit = req.query.limit ? parseInt(req.query.limit as string, 10) : 100;
+    const applianceId = req.query.appliance_id
+      ? parseInt(req.query.appliance_id as string, 10)
+      : null;
+
+    const [appliances, events] = await Promise.all([
+      DeviceApplianceModel.findByDevice(deviceId),
+      ApplianceEventModel.findByDeviceAndTimeRange(
+        deviceId,
+        startTime,
+        endTime,
+        applianceId,
+        limit
+      ),
+    ]);
+
+    sendSuccess(res, { appliances, events, count: events.length });
+  }
+);
+
+/** PUT /appliance-events/devices/:id/appliances/:applianceId — owner names a signature */
+export const updateApplianceLabel = asyncHandler(
+  async (req: Request, res: Response, _next: NextFunction) => {
+    if (!req.user) {
+      throw new AppError(
+        'User not authenticated',
+        HTTP_STATUS.UNAUTHORIZED,
+        ERROR_CODES.UNAUTHORIZED
+      );
+    }
+
+    const deviceId = parseInt(req.params.id, 10);
+    const applianceId = parseInt(req.params.applianceId, 10);
+    const { label } = req.body as ApplianceLabelRequest;
+
+    const device = await DeviceModel.findById(deviceId);
+
+    if (!device) {
+      throw new AppError('Device not found', HTTP_STATUS.NOT_FOUND, ERROR_CODES.DEVICE_NOT_FOUND);
+    }
+
+    const isOwner = await DeviceModel.isOwnedByUser(deviceId, req.user.id);
+    if (!isOwner && req.user.role !== 'admin') {
+      throw new AppError('Access denied', HTTP_STATUS.FORBIDDEN, ERROR_CODES.FORBIDDEN);
+    }
+
+    const found = await DeviceApplianceModel.setLabel(deviceId, applianceId, label ?? null);
+
+    if (!found) {
+      throw new AppError('Appliance not found', HTTP_STATUS.NOT_FOUND, ERROR_CODES.NOT_FOUND);
+    }
+
+    sendSuccess(res, { appliance_id: applianceId, label: label ?? null });
+  }
+);
@@ -0,0 +1,148 @@
+import { Request, Response, NextFunction } from 'express';
+import { DeviceBudgetModel } from '../models/deviceBudget.model';
+import { DeviceModel } from '../models/device.model';
+import { PowerReadingModel } from '../models/powerReading.model';
+import { BudgetService } from '../services/budget.service';
+import { sseService } from '../services/sse.service';
+import { AppError } from '../utils/AppError';
+import { sendSuccess } from '../utils/apiResponse';
+import { asyncHandler } from '../utils/asyncHandler';
+import { HTTP_STATUS, ERROR_CODES } from '../config/constants';
+import { BudgetSettingsRequest } from '../types/api';
+import { ForecastState } from '../types/models';
+import { logger } from '../utils/logger';
+
+const ALERT_STATES: ForecastState[] = ['warning', 'over', 'exceeded'];
+
+const toEpoch = (d: Date): number => Math.floor(d.getTime() / 1000);
+
+/**
+ * GET /devices/:id/budget?period_start=&state=&used_wh=&projected_wh=&learned=
+ * ESP reports its forecast and fetches the budget for the current period (API key auth)
+ */
+export const getDeviceBudget = asyncHandler(
+  async (req: Request, res: Response, _next: NextFunction) => {
+    const deviceId = req.deviceId;
+    if (!deviceId)
+      throw new AppError(
+        'Device not identified',
+        HTTP_STATUS.UNAUTHORIZED,
+        ERROR_CODES.UNAUTHORIZED
+      );
+
+    const budget = await DeviceBudgetModel.findByDevice(deviceId);
+    if (!budget) {
+      sendSuccess(res, { budget: null });
+      return;
+    }
+
+    const state = req.query.state as ForecastState | undefined;
+    if (state !== undefined && req.query.used_wh !== undefined) {
+      const usedWh = parseInt(req.query.used_wh as string, 10);
+      const projectedWh = req.query.projected_wh
+        ? parseInt(req.query.projected_wh as string, 10)
+        : -1;
+      const learned = req.query.learned ? parseInt(req.query.learned as string, 10) : 0;
+      await DeviceBudgetModel.recordReport(
+        deviceId,
+        state,
+        usedWh,
+        projectedWh >= 0 ? projectedWh : null,
+        learned
+      );
+
+      if (state !== budget.reported_state && ALERT_STATES.includes(state)) {
+        logger.warn(
+          `Budget ${state} on device ${deviceId}: ${usedWh} Wh used, ${projectedWh} Wh projected`
+        );
+        sseService.sendToDevice(deviceId, 'budget_alert', {
+          device_id: deviceId,
+          state,
+          used_wh: usedWh,
+          projected_wh: projectedWh >= 0 ? projectedWh : null,
+          budget_wh: Math.round(budget.budget_kwh * 1000),
+        });
+      }
+    }
+
+    const now = new Date();
+    const period = await BudgetService.currentPeriod(deviceId, now);
+    const periodStart = toEpoch(period.start);
+
+    // The device counts the period from its own energy total once it has an
+    // anchor; only a device new to this period needs the energy used so far
+    const reportedStart = req.query.period_start
+      ? parseInt(req.query.period_start as string, 10)
+      : 0;
+    const periodUsedWh =
+      reportedStart === periodStart
+        ? null
+        : Math.round((await PowerReadingModel.energyBetween(deviceId, period.start, now)) * 1000);
+
+    sendSuccess(res, {
+      budget: {
+        seq: budget.seq,
+        budget_wh: Math.round(budget.budget_kwh * 1000),
+        warn_pct: budget.warn_pct,
+        period_start: periodStart,
+        period_end: toEpoch(period.end),
+        period_used_wh: periodUsedWh,
+      },
+    });
+  }
+);
+
+/** GET /devices/:id/budget/status — budget, current period and last forecast (JWT) */
+export const getBudget = asyncHandler(async (req: Request, res: Response, _next: NextFunction) => {
+  if (!req.user) {
+    throw new AppError(
+      'User not authenticated',
+      HTTP_STATUS.UNAUTHORIZED,
+      ERROR_CODES.UNAUTHORIZED
+    );
+  }
+
+  const deviceId = parseInt(req.params.id, 10);
+  const ok =
+    req.user.role === 'admin' || (await DeviceModel.isAccessibleByUser(deviceId, req.user.id));
+  if (!ok) {
+    throw new AppError('Access denied', HTTP_STATUS.FORBIDDEN, ERROR_CODES.FORBIDDEN);
+  }
+
+  const budget = await DeviceBudgetModel.findByDevice(deviceId);
+  const period = budget ? await BudgetService.currentPeriod(deviceId, new Date()) : null;
+  sendSuccess(res, { budget, period });
+});
+
+/** PUT /devices/:id/budget — admin sets the per-period energy budget */
+export const updateBudget = asyncHandler(
+  async (req: Request, res: Response, _next: NextFunction) => {
+    const deviceId = parseInt(req.params.id, 10);
+    const { budget_kwh, warn_pct } = req.body as BudgetSettingsRequest;
+
+    const device = await DeviceModel.findById(deviceId);
+    if (!device) {
+      throw new AppError('Device not found', HTTP_STATUS.NOT_FOUND, ERROR_CODES.DEVICE_NOT_FOUND);
+    }
+
+    const existing = await DeviceBudgetModel.findByDevice(deviceId);
+    const budget = await DeviceBudgetModel.upsert(
+      deviceId,
+      budget_kwh,
+      warn_pct ?? existing?.warn_pct ?? 80,
+      req.user!.id
+    );
+
+    logger.info(`Budget for device ${deviceId} set to ${budget_kwh} kWh (seq ${budget.seq})`);
+    sendSuccess(res, { budget });
+  }
+);
+
+/** DELETE /devices/:id/budget — admin removes the budget */
+export const deleteBudget = asyncHandler(
+  async (req: Request, res: Response, _next: NextFunction) => {
+    const deviceId = parseInt(req.params.id, 10);
+    await DeviceBudgetModel.remove(deviceId);
+    sendSuccess(res, { message: 'Budget removed' });
+  }
+);
@@ -0,0 +1,174 @@
+import { Request, Response, NextFunction } from 'express';
+import { DeviceCreditModel } from '../models/deviceCredit.model';
+import { DeviceModel } from '../models/device.model';
+import { PadModel } from '../models/pad.model';
+import { CreditService } from '../services/credit.service';
+import { sseService } from '../services/sse.service';
+import { AppError } from '../utils/AppError';
+import { sendSuccess } from '../utils/apiResponse';
+import { asyncHandler } from '../utils/asyncHandler';
+import { HTTP_STATUS, ERROR_CODES } from '../config/constants';
+import { CreditSettingsRequest, CreditTopupRequest } from '../types/api';
+import { PrepaidState } from '../types/models';
+import { logger } from '../utils/logger';
+
+// Used when the device is not assigned to a pad (matches the admin default)
+const DEFAULT_TARIFF_PER_KWH = 11.0;
+
+const ALERT_STATES: PrepaidState[] = ['low', 'critical', 'exhausted'];
+
+/**
+ * GET /devices/:id/credit?seq=&state=&balance_wh= — ESP reports its balance
+ * and fetches the signed credit document (API key auth)
+ */
+export const getDeviceCredit = asyncHandler(
+  async (req: Request, res: Response, _next: NextFunction) => {
+    const deviceId = req.deviceId;
+    if (!deviceId)
+      throw new AppError(
+        'Device not identified',
+        HTTP_STATUS.UNAUTHORIZED,
+        ERROR_CODES.UNAUTHORIZED
+      );
+
+    const credit = await DeviceCreditModel.findByDevice(deviceId);
+    if (!credit) {
+      sendSuccess(res, { credit: null });
+      return;
+    }
+
+    const state = req.query.state as PrepaidState | undefined;
+    if (state !== undefined && req.query.balance_wh !== undefined) {
+      const balanceWh = parseInt(req.query.balance_wh as string, 10);
+      const seq = req.query.seq ? parseInt(req.query.seq as string, 10) : 0;
+      await DeviceCreditModel.recordReport(deviceId, balanceWh, state, seq);
+
+      if (state !== credit.reported_state && ALERT_STATES.includes(state)) {
+        logger.warn(`Prepaid credit ${state} on device ${deviceId}: ${balanceWh} Wh left`);
+        sseService.sendToDevice(deviceId, 'credit_alert', {
+          device_id: deviceId,
+          state,
+          balance_wh: balanceWh,
+        });
+      }
+    }
+
+    const device = await DeviceModel.findById(deviceId);
+    if (!device) {
+      throw new AppError('Device not found', HTTP_STATUS.NOT_FOUND, ERROR_CODES.DEVICE_NOT_FOUND);
+    }
+
+    // Signed with the key this request authenticated with, which is the
+    // one the device holds
+    const apiKey = req.headers['x-api-key'] as string;
+    sendSuccess(res, { credit: CreditService.signDocument(device.device_id, credit, apiKey) });
+  }
+);
+
+/** GET /devices/:id/credit/status — account, last device report and top-ups (JWT) */
+export const getCredit = asyncHandler(async (req: Request, res: Response, _next: NextFunction) => {
+  if (!req.user) {
+    throw new AppError(
+      'User not authenticated',
+      HTTP_STATUS.UNAUTHORIZED,
+      ERROR_CODES.UNAUTHORIZED
+    );
+  }
+
+  const deviceId = parseInt(req.params.id, 10);
+  const ok =
+    req.user.role === 'admin' || (await DeviceModel.isAccessibleByUser(deviceId, req.user.id));
+  if (!ok) {
+    throw new AppError('Access denied', HTTP_STATUS.FORBIDDEN, ERROR_CODES.FORBIDDEN);
+  }
+
+  const credit = await DeviceCreditModel.findByDevice(deviceId);
+  const topups = credit ? await DeviceCreditModel.findTopups(deviceId) : [];
+  sendSuccess(res, { credit, topups });
+});
+
+/** PUT /devices/:id/credit — admin creates the account or changes tariff/warnings */
+export const updateCreditSettings = asyncHandler(
+  async (req: Request, res: Response, _next: NextFunction) => {
+    const deviceId = parseInt(req.params.id, 10);
+    const { enabled, tariff_per_kwh, warn_low_kwh, warn_critical_kwh } =
+      req.body as CreditSettingsRequest;
+
+    const device = await DeviceModel.findById(deviceId);
+    if (!device) {
+      throw new AppError('Device not found', HTTP_STATUS.NOT_FOUND, ERROR_CODES.DEVICE_NOT_FOUND);
+    }
+
+    const existing = await DeviceCreditModel.findByDevice(deviceId);
+    const warnLowWh =
+      warn_low_kwh !== undefined ? Math.round(warn_low_kwh * 1000) : existing?.warn_low_wh;
+    const warnCriticalWh =
+      warn_critical_kwh !== undefined
+        ? Math.round(warn_critical_kwh * 1000)
+        : existing?.warn_critical_wh;
+    if ((warnCriticalWh ?? 1000) > (warnLowWh ?? 5000)) {
+      throw new AppError(
+        'warn_critical_kwh must not exceed warn_low_kwh',
+        HTTP_STATUS.BAD_REQUEST,
+        ERROR_CODES.VALIDATION_ERROR
+      );
+    }
+
+    const pad = await PadModel.findByDeviceId(deviceId);
+    const credit = await DeviceCreditModel.upsertSettings(
+      deviceId,
+      { enabled, tariffPerKwh: tariff_per_kwh, warnLowWh, warnCriticalWh },
+      pad ? Number(pad.rate_per_kwh) : DEFAULT_TARIFF_PER_KWH,
+      req.user!.id
+    );
+
+    sendSuccess(res, { credit });
+  }
+);
+
+/** POST /devices/:id/credit/topups — admin adds credit by currency amount or kWh */
+export const topUpCredit = asyncHandler(
+  async (req: Request, res: Response, _next: NextFunction) => {
+    const deviceId = parseInt(req.params.id, 10);
+    const { amount, energy_kwh } = req.body as CreditTopupRequest;
+
+    const credit = await DeviceCreditModel.findByDevice(deviceId);
+    if (!credit) {
+      throw new AppError(
+        'Prepaid credit is not set up for this device',
+        HTTP_STATUS.NOT_FOUND,
+        ERROR_CODES.NOT_FOUND
+      );
+    }
+
+    const energyWh =
+      amount !== undefined
+        ? CreditService.amountToWh(amount, credit.tariff_per_kwh)
+        : Math.round(energy_kwh! * 1000);
+    if (energyWh < 1) {
+      throw new AppError(
+        'Top-up buys less than 1 Wh',
+        HTTP_STATUS.BAD_REQUEST,
+        ERROR_CODES.VALIDATION_ERROR
+      );
+    }
+
+    const updated = await DeviceCreditModel.addTopup(
+      deviceId,
+      energyWh,
+      amount ?? null,
+      req.user!.id
+    );
+
+    logger.info(`Prepaid top-up of ${energyWh} Wh on device ${deviceId} (seq ${updated.seq})`);
+    sseService.sendToDevice(deviceId, 'credit_topup', {
+      device_id: deviceId,
+      energy_wh: energyWh,
+      amount: amount ?? null,
+      granted_wh: updated.granted_wh,
+      seq: updated.seq,
+    });
+
+    sendSuccess(res, { credit: updated, energy_wh: energyWh }, HTTP_STATUS.CREATED);
+  }
+);
@@ -0,0 +1,107 @@
+import { Request, Response, NextFunction } from 'express';
+import { DeviceModel } from '../models/device.model';
+import { PowerQualityEventModel, PowerQualityInsert } from '../models/powerQualityEvent.model';
+import { sseService } from '../services/sse.service';
+import { AppError } from '../utils/AppError';
+import { sendSuccess } from '../utils/apiResponse';
+import { asyncHandler } from '../utils/asyncHandler';
+import { HTTP_STATUS, ERROR_CODES } from '../config/constants';
+import { PowerQualityUploadRequest } from '../types/api';
+import { logger } from '../utils/logger';
+
+/** POST /power-quality-events — ESP: finished sags, swells and interruptions */
+export const submitPowerQualityEvents = asyncHandler(
+  async (req: Request, res: Response, _next: NextFunction) => {
+    const { device_id, events } = req.body as PowerQualityUploadRequest;
+
+    const device = await DeviceModel.findByDeviceId(device_id);
+
+    if (!device) {
+      throw new AppError('Device not found', HTTP_STATUS.NOT_FOUND, ERROR_CODES.DEVICE_NOT_FOUND);
+    }
+
+    if (!device.is_active) {
+      throw new AppError(
+        'Device is not active',
+        HTTP_STATUS.FORBIDDEN,
+        ERROR_CODES.DEVICE_INACTIVE
+      );
+    }
+
+    // Start times arrive as an age relative to the upload, so the ESP's
+    // clock does not need to be synced
+    const receivedAt = Date.now();
+    const rows: PowerQualityInsert[] = events.map((e) => ({
+      kind: e.kind,
+      category: e.category,
+      startedAt: new Date(receivedAt - e.age_ms),
+      durationMs: e.duration_ms,
+      minVoltage: e.min_voltage,
+      maxVoltage: e.max_voltage,
+      meterSilent: e.meter_silent === true,
+    }));
+
+    const count = await PowerQualityEventModel.createMany(device.id, rows);
+    await DeviceModel.updateLastSeen(device.id);
+
+    logger.info(`${count} power-quality event(s) recorded for device ${device_id}`);
+
+    sseService.sendToDevice(device.id, 'power_quality', {
+      device_id,
+      events: rows.map((r) => ({
+        kind: r.kind,
+        category: r.category,
+        started_at: r.startedAt,
+        duration_ms: r.durationMs,
+        min_voltage: r.minVoltage,
+        max_voltage: r.maxVoltage,
+        meter_silent: r.meterSilent,
+      })),
+    });
+
+    sendSuccess(res, { recorded: count }, HTTP_STATUS.CREATED);
+  }
+);
+
+/** GET /power-quality-events/devices/:id — events of one device, newest first */
+export const getPowerQualityEvents = asyncHandler(
+  async (req: Request, res: Response, _next: NextFunction) => {
+    if (!req.user) {
+      throw new AppError(
+        'User not authenticated',
+        HTTP_STATUS.UNAUTHORIZED,
+        ERROR_CODES.UNAUTHORIZED
+      );
+    }
+
+    const deviceId = parseInt(req.params.id, 10);
+
+    const device = await DeviceModel.findById(deviceId);
+
+    if (!device) {
+      throw new AppError('Device not found', HTTP_STATUS.NOT_FOUND, ERROR_CODES.DEVICE_NOT_FOUND);
+    }
+
+    const ok =
+      req.user.role === 'admin' || (await DeviceModel.isAccessibleByUser(deviceId, req.user.id));
+
+    if (!ok) {
+      throw new AppError('Access denied', HTTP_STATUS.FORBIDDEN, ERROR_CODES.FORBIDDEN);
+    }
+
+    const startTime = req.query.start_time ? new Date(req.query.start_time as string) : new Date(0);
+    const endTime = req.query.end_time
+      ? new Date(req.query.end_time as string)
+      : new Date(Date.now() + 24 * 60 * 60 * 1000);
+    const limit = req.query.limit ? parseInt(req.query.limit as string, 10) : 100;
+
+    const events = await PowerQualityEventModel.findByDeviceAndTimeRange(
+      deviceId,
+      startTime,
+      endTime,
+      limit
+    );
+
+    sendSuccess(res, { events, count: events.length });
+  }
+);
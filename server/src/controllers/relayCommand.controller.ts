@@ -1,5 +1,6 @@
 import { Request, Response, NextFunction } from 'express';
 import { RelayCommandModel } from '../models/relayCommand.model';
+import { DeviceCreditModel } from '../models/deviceCredit.model';
 import { DeviceModel } from '../models/device.model';
 import { AppError } from '../utils/AppError';
 import { sendSuccess } from '../utils/apiResponse';
@@ -59,10 +60,13 @@ export const getPendingCommand = asyncHandler(
       );
 
     const cmd = await RelayCommandModel.findPendingForDevice(deviceId);
+    const creditSeq = await DeviceCreditModel.findSeq(deviceId);
 
+    // credit_seq lets the ESP fetch a top-up on this poll instead of its next credit poll
     sendSuccess(res, {
       command: cmd ? cmd.command : null,
       command_id: cmd ? cmd.id : null,
+      credit_seq: creditSeq,
     });
   }
 );
@@ -0,0 +1,13 @@
+-- Migration 025: Per-device anomaly rule tables
+-- The ESP polls its table and applies it when the version changes
+
+CREATE TABLE IF NOT EXISTS device_anomaly_rules (
+  device_id   INT UNSIGNED NOT NULL PRIMARY KEY,
+  version     INT UNSIGNED NOT NULL DEFAULT 1,
+  rules       JSON NOT NULL,
+  updated_by  INT UNSIGNED NULL,
+  updated_at  DATETIME NOT NULL DEFAULT NOW(),
+
+  CONSTRAINT fk_arules_device FOREIGN KEY (device_id)  REFERENCES devices(id) ON DELETE CASCADE,
+  CONSTRAINT fk_arules_user   FOREIGN KEY (updated_by) REFERENCES users(id)   ON DELETE SET NULL
+);
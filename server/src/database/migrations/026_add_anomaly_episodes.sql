@@ -0,0 +1,14 @@
+-- Migration 026: Anomaly episodes
+-- The ESP reports each anomaly once at onset, then rollups and a clear that
+-- update the same row (matched on device + episode_id)
+
+ALTER TABLE anomaly_events
+  ADD COLUMN episode_id     INT UNSIGNED  DEFAULT NULL AFTER device_id,
+  ADD COLUMN phase          ENUM('onset','update','clear') DEFAULT NULL AFTER severity,
+  ADD COLUMN metric         VARCHAR(16)   DEFAULT NULL AFTER phase,
+  ADD COLUMN duration_ms    INT UNSIGNED  DEFAULT NULL AFTER metric,
+  ADD COLUMN peak_value     FLOAT         DEFAULT NULL AFTER duration_ms,
+  ADD COLUMN min_value      FLOAT         DEFAULT NULL AFTER peak_value,
+  ADD COLUMN integral_value DOUBLE        DEFAULT NULL AFTER min_value,
+  ADD COLUMN ended_at       TIMESTAMP     NULL DEFAULT NULL AFTER integral_value,
+  ADD UNIQUE KEY uq_dev_episode (device_id, episode_id);
@@ -0,0 +1,22 @@
+-- Migration 027: Pre-trip black-box recordings
+-- The ESP uploads the readings leading up to a relay trip (or an abnormal
+-- reset) after the anomaly event; trip recordings link to it by episode_id.
+-- samples rows: [ms relative to trip, channel, mA, 0.1 V, 0.1 W]
+-- (current-only fast samples carry the first three fields)
+
+CREATE TABLE IF NOT EXISTS anomaly_blackbox (
+  id                INT UNSIGNED AUTO_INCREMENT PRIMARY KEY,
+  device_id         INT UNSIGNED NOT NULL,
+  anomaly_event_id  BIGINT UNSIGNED NULL,
+  episode_id        INT UNSIGNED NULL,
+  reason            ENUM('trip','reset') NOT NULL,
+  reset_reason      TINYINT UNSIGNED NULL,
+  sample_count      SMALLINT UNSIGNED NOT NULL,
+  samples           JSON NOT NULL,
+  created_at        DATETIME NOT NULL DEFAULT NOW(),
+
+  INDEX idx_bb_device (device_id, created_at),
+  INDEX idx_bb_event (anomaly_event_id),
+  CONSTRAINT fk_bb_device FOREIGN KEY (device_id)        REFERENCES devices(id)        ON DELETE CASCADE,
+  CONSTRAINT fk_bb_event  FOREIGN KEY (anomaly_event_id) REFERENCES anomaly_events(id) ON DELETE SET NULL
+);
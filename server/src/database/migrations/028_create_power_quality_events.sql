@@ -0,0 +1,21 @@
+-- Migration 028: Power-quality events (IEEE 1159 RMS variations)
+-- One row per finished sag, swell or interruption reported by the ESP.
+-- meter_silent: the meter stopped answering for part of the event, which is
+-- how a supply interruption looks to a line-powered meter (and also how a
+-- broken bus looks).
+
+CREATE TABLE IF NOT EXISTS power_quality_events (
+  id            BIGINT UNSIGNED AUTO_INCREMENT PRIMARY KEY,
+  device_id     INT UNSIGNED NOT NULL,
+  kind          ENUM('sag','swell','interruption') NOT NULL,
+  category      ENUM('instantaneous','momentary','temporary','sustained') NOT NULL,
+  started_at    DATETIME(3) NOT NULL,
+  duration_ms   INT UNSIGNED NOT NULL,
+  min_voltage   DECIMAL(6,1) NOT NULL,
+  max_voltage   DECIMAL(6,1) NOT NULL,
+  meter_silent  TINYINT(1) NOT NULL DEFAULT 0,
+  created_at    DATETIME NOT NULL DEFAULT NOW(),
+
+  INDEX idx_pq_device (device_id, started_at),
+  CONSTRAINT fk_pq_device FOREIGN KEY (device_id) REFERENCES devices(id) ON DELETE CASCADE
+);
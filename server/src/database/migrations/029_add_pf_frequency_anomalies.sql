@@ -0,0 +1,8 @@
+-- Migration 029: Power-factor and frequency anomaly types
+-- Firmware rules on the PF and frequency fields of the full read report
+-- low_power_factor and frequency_deviation episodes.
+
+ALTER TABLE anomaly_events
+  MODIFY COLUMN anomaly_type ENUM('overcurrent', 'short_circuit', 'wire_fire', 'overvoltage',
+    'undervoltage', 'overpower', 'arc_fault', 'ground_fault',
+    'low_power_factor', 'frequency_deviation') NOT NULL;
@@ -0,0 +1,39 @@
+-- Migration 030: Prepaid energy credit
+-- The device keeps and enforces the balance itself; the server holds the
+-- cumulative energy granted by top-ups plus tariff and warning levels, and
+-- hands them out as a signed document. seq goes up on every change so the
+-- device can ignore replays. reported_* is the device's last balance report.
+
+CREATE TABLE IF NOT EXISTS device_credit (
+  device_id           INT UNSIGNED NOT NULL PRIMARY KEY,
+  enabled             TINYINT(1) NOT NULL DEFAULT 1,
+  seq                 INT UNSIGNED NOT NULL DEFAULT 1,
+  granted_wh          BIGINT UNSIGNED NOT NULL DEFAULT 0,
+  tariff_per_kwh      DECIMAL(10,4) NOT NULL,
+  warn_low_wh         INT UNSIGNED NOT NULL DEFAULT 5000,
+  warn_critical_wh    INT UNSIGNED NOT NULL DEFAULT 1000,
+  reported_balance_wh BIGINT NULL,
+  reported_state      ENUM('disabled','ok','low','critical','exhausted') NULL,
+  reported_seq        INT UNSIGNED NULL,
+  reported_at         DATETIME NULL,
+  updated_by          INT UNSIGNED NULL,
+  updated_at          DATETIME NOT NULL DEFAULT NOW(),
+
+  CONSTRAINT fk_credit_device FOREIGN KEY (device_id)  REFERENCES devices(id) ON DELETE CASCADE,
+  CONSTRAINT fk_credit_user   FOREIGN KEY (updated_by) REFERENCES users(id)   ON DELETE SET NULL
+);
+
+CREATE TABLE IF NOT EXISTS credit_topups (
+  id              INT UNSIGNED AUTO_INCREMENT PRIMARY KEY,
+  device_id       INT UNSIGNED NOT NULL,
+  energy_wh       BIGINT UNSIGNED NOT NULL,
+  amount          DECIMAL(10,2) NULL,           -- currency paid, when bought by amount
+  tariff_per_kwh  DECIMAL(10,4) NOT NULL,
+  seq             INT UNSIGNED NOT NULL,        -- document version that carried it
+  created_by      INT UNSIGNED NULL,
+  created_at      DATETIME NOT NULL DEFAULT NOW(),
+
+  INDEX idx_topup_device (device_id, created_at),
+  CONSTRAINT fk_topup_device FOREIGN KEY (device_id)  REFERENCES devices(id) ON DELETE CASCADE,
+  CONSTRAINT fk_topup_user   FOREIGN KEY (created_by) REFERENCES users(id)   ON DELETE SET NULL
+);
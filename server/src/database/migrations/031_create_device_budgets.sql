@@ -0,0 +1,21 @@
+-- Migration 031: Consumption budgets
+-- The ESP learns its own load profile and projects period energy; the
+-- server only stores the budget and the device's latest report. The
+-- period is the pad's active stay cycle, else the calendar month (PHT).
+
+CREATE TABLE IF NOT EXISTS device_budgets (
+  device_id             INT UNSIGNED NOT NULL PRIMARY KEY,
+  seq                   INT UNSIGNED NOT NULL DEFAULT 1,
+  budget_kwh            DECIMAL(10,3) NOT NULL,
+  warn_pct              TINYINT UNSIGNED NOT NULL DEFAULT 80,
+  reported_state        ENUM('none','ok','warning','over','exceeded') NULL,
+  reported_used_wh      BIGINT NULL,
+  reported_projected_wh BIGINT NULL,
+  reported_learned      SMALLINT UNSIGNED NULL,   -- hour-of-week buckets learned (of 168)
+  reported_at           DATETIME NULL,
+  updated_by            INT UNSIGNED NULL,
+  updated_at            DATETIME NOT NULL DEFAULT NOW(),
+
+  CONSTRAINT fk_budget_device FOREIGN KEY (device_id)  REFERENCES devices(id) ON DELETE CASCADE,
+  CONSTRAINT fk_budget_user   FOREIGN KEY (updated_by) REFERENCES users(id)   ON DELETE SET NULL
+);
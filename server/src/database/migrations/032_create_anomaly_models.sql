@@ -0,0 +1,36 @@
+-- Migration 032: Learned anomaly scorer
+-- device_anomaly_models: the int8 autoencoder each ESP scores its windows
+-- with (polled and applied when the version changes, like anomaly rules).
+-- anomaly_model_flags: windows the model could not reconstruct, uploaded
+-- for review. They never trip the relay; review labels feed retraining.
+
+CREATE TABLE IF NOT EXISTS device_anomaly_models (
+  device_id   INT UNSIGNED NOT NULL PRIMARY KEY,
+  version     INT UNSIGNED NOT NULL DEFAULT 1,
+  model       JSON NOT NULL,
+  updated_by  INT UNSIGNED NULL,
+  updated_at  DATETIME NOT NULL DEFAULT NOW(),
+
+  CONSTRAINT fk_amodel_device FOREIGN KEY (device_id)  REFERENCES devices(id) ON DELETE CASCADE,
+  CONSTRAINT fk_amodel_user   FOREIGN KEY (updated_by) REFERENCES users(id)   ON DELETE SET NULL
+);
+
+CREATE TABLE IF NOT EXISTS anomaly_model_flags (
+  id             BIGINT UNSIGNED AUTO_INCREMENT PRIMARY KEY,
+  device_id      INT UNSIGNED NOT NULL,
+  model_version  INT UNSIGNED NOT NULL,
+  score          INT UNSIGNED NOT NULL,
+  threshold      INT UNSIGNED NOT NULL,
+  window_start   DATETIME(3) NOT NULL,
+  features       JSON NOT NULL,                -- native units, firmware feature order
+  samples        JSON NOT NULL,                -- [dt_ms, 0.1 V, mA, 0.1 W, 0.01 PF, 0.1 Hz]
+  review         ENUM('fault','normal') NULL,  -- NULL until reviewed
+  review_note    VARCHAR(255) NULL,
+  reviewed_by    INT UNSIGNED NULL,
+  reviewed_at    DATETIME NULL,
+  created_at     DATETIME NOT NULL DEFAULT NOW(),
+
+  INDEX idx_amflag_device (device_id, window_start),
+  CONSTRAINT fk_amflag_device FOREIGN KEY (device_id)   REFERENCES devices(id) ON DELETE CASCADE,
+  CONSTRAINT fk_amflag_user   FOREIGN KEY (reviewed_by) REFERENCES users(id)   ON DELETE SET NULL
+);
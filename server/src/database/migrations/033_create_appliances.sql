@@ -0,0 +1,43 @@
+-- Migration 033: Appliance events (on-device step-change NILM)
+-- device_appliances: one row per signature the ESP has learned, with the
+-- totals from its latest summary and a label the owner can give it.
+-- appliance_events: the on/off edges. An edge that matched no signature
+-- has appliance_id NULL.
+
+CREATE TABLE IF NOT EXISTS device_appliances (
+  device_id      INT UNSIGNED NOT NULL,
+  appliance_id   SMALLINT UNSIGNED NOT NULL,              -- firmware signature id
+  label          VARCHAR(64) NULL,
+  power_step     DECIMAL(10,1) NOT NULL,                  -- W, typical on-step
+  reactive_step  DECIMAL(10,1) NOT NULL DEFAULT 0,        -- var
+  inrush_pct     SMALLINT UNSIGNED NOT NULL DEFAULT 0,
+  edges          INT UNSIGNED NOT NULL DEFAULT 0,
+  trips          INT UNSIGNED NOT NULL DEFAULT 0,         -- relay trips while it was running
+  running        TINYINT UNSIGNED NOT NULL DEFAULT 0,
+  energy_wh      DECIMAL(14,3) NOT NULL DEFAULT 0,
+  run_seconds    BIGINT UNSIGNED NOT NULL DEFAULT 0,
+  first_seen_at  DATETIME NOT NULL DEFAULT NOW(),
+  reported_at    DATETIME NULL,                           -- latest summary
+
+  PRIMARY KEY (device_id, appliance_id),
+  CONSTRAINT fk_appliance_device FOREIGN KEY (device_id) REFERENCES devices(id) ON DELETE CASCADE
+);
+
+CREATE TABLE IF NOT EXISTS appliance_events (
+  id             BIGINT UNSIGNED AUTO_INCREMENT PRIMARY KEY,
+  device_id      INT UNSIGNED NOT NULL,
+  appliance_id   SMALLINT UNSIGNED NULL,
+  edge           ENUM('on','off') NOT NULL,
+  occurred_at    DATETIME(3) NOT NULL,
+  power_step     DECIMAL(10,1) NOT NULL,                  -- W, signed
+  reactive_step  DECIMAL(10,1) NOT NULL DEFAULT 0,
+  pf_step        DECIMAL(4,2) NOT NULL DEFAULT 0,
+  inrush_pct     SMALLINT UNSIGNED NOT NULL DEFAULT 0,
+  settle_ms      INT UNSIGNED NOT NULL DEFAULT 0,
+  new_signature  BOOLEAN NOT NULL DEFAULT FALSE,
+  at_idle        BOOLEAN NOT NULL DEFAULT FALSE,          -- closed by the load dropping to idle
+  created_at     DATETIME NOT NULL DEFAULT NOW(),
+
+  INDEX idx_appliance_event_device (device_id, occurred_at),
+  CONSTRAINT fk_appliance_event_device FOREIGN KEY (device_id) REFERENCES devices(id) ON DELETE CASCADE
+);
@@ -0,0 +1,6 @@
+-- Migration 034: Trip latency
+-- Tripping onsets carry the time from the reading that caused the trip to
+-- the relay GPIO being written, measured on the device.
+
+ALTER TABLE anomaly_events
+  ADD COLUMN trip_latency_us INT UNSIGNED DEFAULT NULL AFTER relay_tripped;
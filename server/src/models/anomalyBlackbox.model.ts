@@ -0,0 +1,44 @@
+import { pool } from '../database/connection';
+import { AnomalyBlackbox, BlackboxSample } from '../types/models';
+import { RowDataPacket, ResultSetHeader } from 'mysql2';
+
+export class AnomalyBlackboxModel {
+  static async create(
+    deviceId: number,
+    anomalyEventId: number | null,
+    episodeId: number | null,
+    reason: 'trip' | 'reset',
+    resetReason: number | null,
+    samples: BlackboxSample[]
+  ): Promise<number> {
+    const [result] = await pool.execute<ResultSetHeader>(
+      `INSERT INTO anomaly_blackbox
+       (device_id, anomaly_event_id, episode_id, reason, reset_reason, sample_count, samples)
+       VALUES (?, ?, ?, ?, ?, ?, ?)`,
+      [
+        deviceId,
+        anomalyEventId,
+        episodeId,
+        reason,
+        resetReason,
+        samples.length,
+        JSON.stringify(samples),
+      ]
+    );
+
+    return result.insertId;
+  }
+
+  static async findByEvent(anomalyEventId: number): Promise<AnomalyBlackbox | null> {
+    const [rows] = await pool.execute<RowDataPacket[]>(
+      `SELECT * FROM anomaly_blackbox WHERE anomaly_event_id = ? ORDER BY id DESC LIMIT 1`,
+      [anomalyEventId]
+    );
+    if (rows.length === 0) return null;
+
+    const row = rows[0];
+    // mysql2 returns JSON columns parsed, but some drivers hand back a string
+    const samples = typeof row.samples === 'string' ? JSON.parse(row.samples) : row.samples;
+    return { ...row, samples } as AnomalyBlackbox;
+  }
+}
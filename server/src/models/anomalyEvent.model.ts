@@ -1,5 +1,5 @@
 import { pool } from '../database/connection';
-import { AnomalyEvent } from '../types/models';
+import { AnomalyEvent, AnomalyEpisodeRollup } from '../types/models';
 import { RowDataPacket, ResultSetHeader } from 'mysql2';
 
 export class AnomalyEventModel {
@@ -11,21 +11,98 @@ export class AnomalyEventModel {
     current: number,
     voltage: number,
     power: number,
-    relayTripped: boolean
+    relayTripped: boolean,
+    episode?: AnomalyEpisodeRollup,
+    tripLatencyUs?: number
   ): Promise<number> {
     const [result] = await pool.execute<ResultSetHeader>(
       `INSERT INTO anomaly_events
-       (device_id, timestamp, anomaly_type, severity, current_value, voltage_value, power_value, relay_tripped)
-       VALUES (?, ?, ?, ?, ?, ?, ?, ?)`,
-      [deviceId, timestamp, anomalyType, severity, current, voltage, power, relayTripped]
+       (device_id, episode_id, timestamp, anomaly_type, severity, phase, metric, duration_ms,
+        peak_value, min_value, integral_value, ended_at,
+        current_value, voltage_value, power_value, relay_tripped, trip_latency_us)
+       VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)`,
+      [
+        deviceId,
+        episode?.episode_id ?? null,
+        timestamp,
+        anomalyType,
+        severity,
+        episode?.phase ?? null,
+        episode?.metric ?? null,
+        episode?.duration_ms ?? null,
+        episode?.peak ?? null,
+        episode?.min ?? null,
+        episode?.integral ?? null,
+        episode?.phase === 'clear' ? timestamp : null,
+        current,
+        voltage,
+        power,
+        relayTripped,
+        tripLatencyUs ?? null,
+      ]
     );
 
     return result.insertId;
   }
 
+  static async findByEpisode(deviceId: number, episodeId: number): Promise<AnomalyEvent | null> {
+    const [rows] = await pool.execute<RowDataPacket[]>(
+      `SELECT id, device_id, episode_id, timestamp, anomaly_type, severity, phase, metric,
+              duration_ms, peak_value, min_value, integral_value, ended_at,
+              current_value, voltage_value, power_value, trip_latency_us,
+              relay_tripped, is_resolved, resolved_at, resolved_by, notes, created_at
+       FROM anomaly_events WHERE device_id = ? AND episode_id = ?`,
+      [deviceId, episodeId]
+    );
+
+    return rows.length ? (rows[0] as AnomalyEvent) : null;
+  }
+
+  // Later reports of an episode overwrite the rollup; the onset row keeps
+  // its timestamp and readings.
+  static async updateEpisode(
+    id: number,
+    episode: AnomalyEpisodeRollup,
+    endedAt: Date | null
+  ): Promise<void> {
+    await pool.execute(
+      `UPDATE anomaly_events
+       SET phase = ?, duration_ms = ?, peak_value = ?, min_value = ?, integral_value = ?,
+           ended_at = COALESCE(?, ended_at)
+       WHERE id = ?`,
+      [
+        episode.phase,
+        episode.duration_ms,
+        episode.peak ?? null,
+        episode.min ?? null,
+        episode.integral ?? null,
+        endedAt,
+        id,
+      ]
+    );
+  }
+
+  // A trip rule took over an episode a log-only rule opened: the row
+  // becomes a tripping one, and the rollup is in the trip rule's metric.
+  static async markTripped(
+    id: number,
+    metric: string | null,
+    tripLatencyUs: number | null
+  ): Promise<void> {
+    await pool.execute(
+      `UPDATE anomaly_events
+       SET relay_tripped = TRUE, severity = 'critical', metric = COALESCE(?, metric),
+           trip_latency_us = COALESCE(?, trip_latency_us)
+       WHERE id = ?`,
+      [metric, tripLatencyUs, id]
+    );
+  }
+
   static async findById(id: number): Promise<AnomalyEvent | null> {
     const [rows] = await pool.execute<RowDataPacket[]>(
-      `SELECT id, device_id, timestamp, anomaly_type, severity, current_value, voltage_value, power_value,
+      `SELECT id, device_id, episode_id, timestamp, anomaly_type, severity, phase, metric,
+              duration_ms, peak_value, min_value, integral_value, ended_at,
+              current_value, voltage_value, power_value, trip_latency_us,
               relay_tripped, is_resolved, resolved_at, resolved_by, notes, created_at
        FROM anomaly_events WHERE id = ?`,
       [id]
@@ -47,7 +124,9 @@ export class AnomalyEventModel {
     const fmt = (d: Date) => d.toISOString().slice(0, 19).replace('T', ' ');
     const safeLimit = Math.max(1, Math.min(1000, Math.floor(limit)));
     const [rows] = await pool.execute<RowDataPacket[]>(
-      `SELECT id, device_id, timestamp, anomaly_type, severity, current_value, voltage_value, power_value,
+      `SELECT id, device_id, episode_id, timestamp, anomaly_type, severity, phase, metric,
+              duration_ms, peak_value, min_value, integral_value, ended_at,
+              current_value, voltage_value, power_value, trip_latency_us,
               relay_tripped, is_resolved, resolved_at, resolved_by, notes, created_at
        FROM anomaly_events
        WHERE device_id = ? AND timestamp BETWEEN ? AND ?
@@ -61,7 +140,9 @@ export class AnomalyEventModel {
 
   static async findUnresolvedByDevice(deviceId: number): Promise<AnomalyEvent[]> {
     const [rows] = await pool.execute<RowDataPacket[]>(
-      `SELECT id, device_id, timestamp, anomaly_type, severity, current_value, voltage_value, power_value,
+      `SELECT id, device_id, episode_id, timestamp, anomaly_type, severity, phase, metric,
+              duration_ms, peak_value, min_value, integral_value, ended_at,
+              current_value, voltage_value, power_value, trip_latency_us,
               relay_tripped, is_resolved, resolved_at, resolved_by, notes, created_at
        FROM anomaly_events
        WHERE device_id = ? AND is_resolved = 0
@@ -0,0 +1,38 @@
+import { pool } from '../database/connection';
+import { AnomalyModelDoc, DeviceAnomalyModel } from '../types/models';
+import { RowDataPacket } from 'mysql2';
+
+export class AnomalyModelModel {
+  static async findByDevice(deviceId: number): Promise<DeviceAnomalyModel | null> {
+    const [rows] = await pool.execute<RowDataPacket[]>(
+      `SELECT * FROM device_anomaly_models WHERE device_id = ?`,
+      [deviceId]
+    );
+    if (rows.length === 0) return null;
+
+    const row = rows[0];
+    // mysql2 returns JSON columns parsed, but some drivers hand back a string
+    const model = typeof row.model === 'string' ? JSON.parse(row.model) : row.model;
+    return { ...row, model } as DeviceAnomalyModel;
+  }
+
+  /** Replace the device's model and bump its version so the ESP picks it up */
+  static async upsert(
+    deviceId: number,
+    model: AnomalyModelDoc,
+    updatedBy: number
+  ): Promise<DeviceAnomalyModel> {
+    await pool.execute(
+      `INSERT INTO device_anomaly_models (device_id, version, model, updated_by)
+       VALUES (?, 1, ?, ?)
+       ON DUPLICATE KEY UPDATE version = version + 1, model = VALUES(model),
+                               updated_by = VALUES(updated_by), updated_at = NOW()`,
+      [deviceId, JSON.stringify(model), updatedBy]
+    );
+    return (await AnomalyModelModel.findByDevice(deviceId))!;
+  }
+
+  static async remove(deviceId: number): Promise<void> {
+    await pool.execute(`DELETE FROM device_anomaly_models WHERE device_id = ?`, [deviceId]);
+  }
+}
@@ -0,0 +1,90 @@
+import { pool } from '../database/connection';
+import { AnomalyModelFlag, AnomalyModelReview, AnomalyModelSample } from '../types/models';
+import { RowDataPacket, ResultSetHeader } from 'mysql2';
+
+export interface AnomalyModelFlagInsert {
+  modelVersion: number;
+  score: number;
+  threshold: number;
+  windowStart: Date;
+  features: number[];
+  samples: AnomalyModelSample[];
+}
+
+// mysql2 returns JSON columns parsed, but some drivers hand back a string
+const parseJson = (v: unknown) => (typeof v === 'string' ? JSON.parse(v) : v);
+
+export class AnomalyModelFlagModel {
+  static async create(deviceId: number, flag: AnomalyModelFlagInsert): Promise<number> {
+    const [result] = await pool.execute<ResultSetHeader>(
+      `INSERT INTO anomaly_model_flags
+       (device_id, model_version, score, threshold, window_start, features, samples)
+       VALUES (?, ?, ?, ?, ?, ?, ?)`,
+      [
+        deviceId,
+        flag.modelVersion,
+        flag.score,
+        flag.threshold,
+        flag.windowStart,
+        JSON.stringify(flag.features),
+        JSON.stringify(flag.samples),
+      ]
+    );
+    return result.insertId;
+  }
+
+  static async findById(id: number): Promise<AnomalyModelFlag | null> {
+    const [rows] = await pool.execute<RowDataPacket[]>(
+      `SELECT * FROM anomaly_model_flags WHERE id = ?`,
+      [id]
+    );
+    if (rows.length === 0) return null;
+
+    const row = rows[0];
+    return {
+      ...row,
+      features: parseJson(row.features),
+      samples: parseJson(row.samples),
+    } as AnomalyModelFlag;
+  }
+
+  /** Newest first; `unreviewed` limits the list to the review queue */
+  static async findByDeviceAndTimeRange(
+    deviceId: number,
+    startTime: Date,
+    endTime: Date,
+    unreviewed: boolean,
+    limit: number = 100
+  ): Promise<AnomalyModelFlag[]> {
+    const fmt = (d: Date) => d.toISOString().slice(0, 19).replace('T', ' ');
+    const safeLimit = Math.max(1, Math.min(1000, Math.floor(limit)));
+    const [rows] = await pool.execute<RowDataPacket[]>(
+      `SELECT * FROM anomaly_model_flags
+       WHERE device_id = ? AND window_start BETWEEN ? AND ?
+         ${unreviewed ? 'AND review IS NULL' : ''}
+       ORDER BY window_start DESC
+       LIMIT ${safeLimit}`,
+      [deviceId, fmt(startTime), fmt(endTime)]
+    );
+
+    return rows.map((row) => ({
+      ...row,
+      features: parseJson(row.features),
+      samples: parseJson(row.samples),
+    })) as AnomalyModelFlag[];
+  }
+
+  static async review(
+    id: number,
+    review: AnomalyModelReview,
+    note: string | null,
+    reviewedBy: number
+  ): Promise<void> {
+    await pool.execute(
+      `UPDATE anomaly_model_flags
+       SET review = ?, review_note = ?, reviewed_by = ?, reviewed_at = NOW()
+       WHERE id = ?`,
+      [review, note, reviewedBy, id]
+    );
+  }
+}
@@ -0,0 +1,38 @@
+import { pool } from '../database/connection';
+import { AnomalyRule, DeviceAnomalyRules } from '../types/models';
+import { RowDataPacket } from 'mysql2';
+
+export class AnomalyRulesModel {
+  static async findByDevice(deviceId: number): Promise<DeviceAnomalyRules | null> {
+    const [rows] = await pool.execute<RowDataPacket[]>(
+      `SELECT * FROM device_anomaly_rules WHERE device_id = ?`,
+      [deviceId]
+    );
+    if (rows.length === 0) return null;
+
+    const row = rows[0];
+    // mysql2 returns JSON columns parsed, but some drivers hand back a string
+    const rules = typeof row.rules === 'string' ? JSON.parse(row.rules) : row.rules;
+    return { ...row, rules } as DeviceAnomalyRules;
+  }
+
+  /** Replace the device's table and bump its version so the ESP picks it up */
+  static async upsert(
+    deviceId: number,
+    rules: AnomalyRule[],
+    updatedBy: number
+  ): Promise<DeviceAnomalyRules> {
+    await pool.execute(
+      `INSERT INTO device_anomaly_rules (device_id, version, rules, updated_by)
+       VALUES (?, 1, ?, ?)
+       ON DUPLICATE KEY UPDATE version = version + 1, rules = VALUES(rules),
+                               updated_by = VALUES(updated_by), updated_at = NOW()`,
+      [deviceId, JSON.stringify(rules), updatedBy]
+    );
+    return (await AnomalyRulesModel.findByDevice(deviceId))!;
+  }
+
+  static async remove(deviceId: number): Promise<void> {
+    await pool.execute(`DELETE FROM device_anomaly_rules WHERE device_id = ?`, [deviceId]);
+  }
+}
@@ -0,0 +1,72 @@
+import { pool } from '../database/connection';
+import { ApplianceEdge, ApplianceEvent } from '../types/models';
+import { RowDataPacket, ResultSetHeader } from 'mysql2';
+
+export interface ApplianceEventInsert {
+  applianceId: number | null;
+  edge: ApplianceEdge;
+  occurredAt: Date;
+  powerStep: number;
+  reactiveStep: number;
+  pfStep: number;
+  inrushPct: number;
+  settleMs: number;
+  newSignature: boolean;
+  atIdle: boolean;
+}
+
+export class ApplianceEventModel {
+  static async createMany(deviceId: number, events: ApplianceEventInsert[]): Promise<number> {
+    if (events.length === 0) return 0;
+
+    const placeholders = events.map(() => '(?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)').join(', ');
+    const values = events.flatMap((e) => [
+      deviceId,
+      e.applianceId,
+      e.edge,
+      e.occurredAt,
+      e.powerStep,
+      e.reactiveStep,
+      e.pfStep,
+      e.inrushPct,
+      e.settleMs,
+      e.newSignature,
+      e.atIdle,
+    ]);
+
+    const [result] = await pool.execute<ResultSetHeader>(
+      `INSERT INTO appliance_events
+       (device_id, appliance_id, edge, occurred_at, power_step, reactive_step, pf_step,
+        inrush_pct, settle_ms, new_signature, at_idle)
+       VALUES ${placeholders}`,
+      values
+    );
+
+    return result.affectedRows;
+  }
+
+  /** Newest first; `applianceId` narrows the log to one signature */
+  static async findByDeviceAndTimeRange(
+    deviceId: number,
+    startTime: Date,
+    endTime: Date,
+    applianceId: number | null,
+    limit: number = 100
+  ): Promise<ApplianceEvent[]> {
+    const fmt = (d: Date) => d.toISOString().slice(0, 19).replace('T', ' ');
+    const safeLimit = Math.max(1, Math.min(1000, Math.floor(limit)));
+    const params: (number | string)[] = [deviceId, fmt(startTime), fmt(endTime)];
+    if (applianceId !== null) params.push(applianceId);
+
+    const [rows] = await pool.execute<RowDataPacket[]>(
+      `SELECT * FROM appliance_events
+       WHERE device_id = ? AND occurred_at BETWEEN ? AND ?
+         ${applianceId !== null ? 'AND appliance_id = ?' : ''}
+       ORDER BY occurred_at DESC
+       LIMIT ${safeLimit}`,
+      params
+    );
+
+    return rows as ApplianceEvent[];
+  }
+}
@@ -0,0 +1,81 @@
+import { pool } from '../database/connection';
+import { DeviceAppliance } from '../types/models';
+import { ApplianceSummaryRecord } from '../types/api';
+import { RowDataPacket, ResultSetHeader } from 'mysql2';
+
+export class DeviceApplianceModel {
+  /** Appliances running at trips first, then by energy */
+  static async findByDevice(deviceId: number): Promise<DeviceAppliance[]> {
+    const [rows] = await pool.execute<RowDataPacket[]>(
+      `SELECT * FROM device_appliances
+       WHERE device_id = ?
+       ORDER BY trips DESC, energy_wh DESC, appliance_id`,
+      [deviceId]
+    );
+    return rows as DeviceAppliance[];
+  }
+
+  /** Row for a signature first seen in an edge; a later summary fills the totals */
+  static async ensure(
+    deviceId: number,
+    applianceId: number,
+    powerStep: number,
+    reactiveStep: number,
+    inrushPct: number
+  ): Promise<void> {
+    await pool.execute(
+      `INSERT IGNORE INTO device_appliances
+       (device_id, appliance_id, power_step, reactive_step, inrush_pct)
+       VALUES (?, ?, ?, ?, ?)`,
+      [deviceId, applianceId, powerStep, reactiveStep, inrushPct]
+    );
+  }
+
+  /** Replace the firmware's view of each signature; labels are kept */
+  static async upsertSummary(
+    deviceId: number,
+    appliances: ApplianceSummaryRecord[]
+  ): Promise<number> {
+    if (appliances.length === 0) return 0;
+
+    const placeholders = appliances.map(() => '(?, ?, ?, ?, ?, ?, ?, ?, ?, ?, NOW())').join(', ');
+    const values = appliances.flatMap((a) => [
+      deviceId,
+      a.appliance_id,
+      a.power_step,
+      a.reactive_step,
+      a.inrush_pct,
+      a.edges,
+      a.trips,
+      a.running,
+      a.energy_wh,
+      a.run_seconds,
+    ]);
+
+    await pool.execute(
+      `INSERT INTO device_appliances
+       (device_id, appliance_id, power_step, reactive_step, inrush_pct, edges, trips,
+        running, energy_wh, run_seconds, reported_at)
+       VALUES ${placeholders}
+       ON DUPLICATE KEY UPDATE
+         power_step = VALUES(power_step), reactive_step = VALUES(reactive_step),
+         inrush_pct = VALUES(inrush_pct), edges = VALUES(edges), trips = VALUES(trips),
+         running = VALUES(running), energy_wh = VALUES(energy_wh),
+         run_seconds = VALUES(run_seconds), reported_at = VALUES(reported_at)`,
+      values
+    );
+    return appliances.length;
+  }
+
+  static async setLabel(
+    deviceId: number,
+    applianceId: number,
+    label: string | null
+  ): Promise<boolean> {
+    const [result] = await pool.execute<ResultSetHeader>(
+      `UPDATE device_appliances SET label = ? WHERE device_id = ? AND appliance_id = ?`,
+      [label, deviceId, applianceId]
+    );
+    return result.affectedRows > 0;
+  }
+}
@@ -0,0 +1,59 @@
+import { pool } from '../database/connection';
+import { DeviceBudget, ForecastState } from '../types/models';
+import { RowDataPacket } from 'mysql2';
+
+export class DeviceBudgetModel {
+  static async findByDevice(deviceId: number): Promise<DeviceBudget | null> {
+    const [rows] = await pool.execute<RowDataPacket[]>(
+      `SELECT * FROM device_budgets WHERE device_id = ?`,
+      [deviceId]
+    );
+    if (rows.length === 0) return null;
+
+    const row = rows[0];
+    return {
+      ...row,
+      budget_kwh: Number(row.budget_kwh),
+      reported_used_wh: row.reported_used_wh === null ? undefined : Number(row.reported_used_wh),
+      reported_projected_wh:
+        row.reported_projected_wh === null ? undefined : Number(row.reported_projected_wh),
+    } as DeviceBudget;
+  }
+
+  static async upsert(
+    deviceId: number,
+    budgetKwh: number,
+    warnPct: number,
+    updatedBy: number
+  ): Promise<DeviceBudget> {
+    await pool.execute(
+      `INSERT INTO device_budgets (device_id, budget_kwh, warn_pct, updated_by)
+       VALUES (?, ?, ?, ?)
+       ON DUPLICATE KEY UPDATE seq = seq + 1, budget_kwh = VALUES(budget_kwh),
+                               warn_pct = VALUES(warn_pct),
+                               updated_by = VALUES(updated_by), updated_at = NOW()`,
+      [deviceId, budgetKwh, warnPct, updatedBy]
+    );
+    return (await DeviceBudgetModel.findByDevice(deviceId))!;
+  }
+
+  static async recordReport(
+    deviceId: number,
+    state: ForecastState,
+    usedWh: number,
+    projectedWh: number | null,
+    learned: number
+  ): Promise<void> {
+    await pool.execute(
+      `UPDATE device_budgets
+       SET reported_state = ?, reported_used_wh = ?, reported_projected_wh = ?,
+           reported_learned = ?, reported_at = NOW()
+       WHERE device_id = ?`,
+      [state, usedWh, projectedWh, learned, deviceId]
+    );
+  }
+
+  static async remove(deviceId: number): Promise<void> {
+    await pool.execute(`DELETE FROM device_budgets WHERE device_id = ?`, [deviceId]);
+  }
+}
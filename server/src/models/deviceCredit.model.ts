@@ -0,0 +1,128 @@
+import { pool, getConnection } from '../database/connection';
+import { CreditTopup, DeviceCredit, PrepaidState } from '../types/models';
+import { RowDataPacket } from 'mysql2';
+
+export interface CreditSettings {
+  enabled?: boolean;
+  tariffPerKwh?: number;
+  warnLowWh?: number;
+  warnCriticalWh?: number;
+}
+
+export class DeviceCreditModel {
+  static async findByDevice(deviceId: number): Promise<DeviceCredit | null> {
+    const [rows] = await pool.execute<RowDataPacket[]>(
+      `SELECT * FROM device_credit WHERE device_id = ?`,
+      [deviceId]
+    );
+    if (rows.length === 0) return null;
+
+    // BIGINT comes back as a string once it outgrows a double's safe range
+    const row = rows[0];
+    return {
+      ...row,
+      enabled: !!row.enabled,
+      granted_wh: Number(row.granted_wh),
+      tariff_per_kwh: Number(row.tariff_per_kwh),
+      reported_balance_wh:
+        row.reported_balance_wh === null ? undefined : Number(row.reported_balance_wh),
+    } as DeviceCredit;
+  }
+
+  /** Version only — the relay-command poll announces it so top-ups reach the ESP at once */
+  static async findSeq(deviceId: number): Promise<number | null> {
+    const [rows] = await pool.execute<RowDataPacket[]>(
+      `SELECT seq FROM device_credit WHERE device_id = ?`,
+      [deviceId]
+    );
+    return rows.length ? (rows[0].seq as number) : null;
+  }
+
+  /** Create the account or change its settings; every change bumps seq */
+  static async upsertSettings(
+    deviceId: number,
+    settings: CreditSettings,
+    defaultTariff: number,
+    updatedBy: number
+  ): Promise<DeviceCredit> {
+    await pool.execute(
+      `INSERT INTO device_credit
+       (device_id, enabled, tariff_per_kwh, warn_low_wh, warn_critical_wh, updated_by)
+       VALUES (?, COALESCE(?, 1), COALESCE(?, ?), COALESCE(?, 5000), COALESCE(?, 1000), ?)
+       ON DUPLICATE KEY UPDATE seq = seq + 1,
+                               enabled = COALESCE(?, enabled),
+                               tariff_per_kwh = COALESCE(?, tariff_per_kwh),
+                               warn_low_wh = COALESCE(?, warn_low_wh),
+                               warn_critical_wh = COALESCE(?, warn_critical_wh),
+                               updated_by = VALUES(updated_by), updated_at = NOW()`,
+      [
+        deviceId,
+        settings.enabled ?? null,
+        settings.tariffPerKwh ?? null,
+        defaultTariff,
+        settings.warnLowWh ?? null,
+        settings.warnCriticalWh ?? null,
+        updatedBy,
+        settings.enabled ?? null,
+        settings.tariffPerKwh ?? null,
+        settings.warnLowWh ?? null,
+        settings.warnCriticalWh ?? null,
+      ]
+    );
+    return (await DeviceCreditModel.findByDevice(deviceId))!;
+  }
+
+  /** Add a top-up to the cumulative grant and log it under the new seq */
+  static async addTopup(
+    deviceId: number,
+    energyWh: number,
+    amount: number | null,
+    createdBy: number
+  ): Promise<DeviceCredit> {
+    const conn = await getConnection();
+    try {
+      await conn.beginTransaction();
+      await conn.execute(
+        `UPDATE device_credit
+         SET granted_wh = granted_wh + ?, seq = seq + 1, updated_by = ?, updated_at = NOW()
+         WHERE device_id = ?`,
+        [energyWh, createdBy, deviceId]
+      );
+      await conn.execute(
+        `INSERT INTO credit_topups (device_id, energy_wh, amount, tariff_per_kwh, seq, created_by)
+         SELECT device_id, ?, ?, tariff_per_kwh, seq, ? FROM device_credit WHERE device_id = ?`,
+        [energyWh, amount, createdBy, deviceId]
+      );
+      await conn.commit();
+    } catch (error) {
+      await conn.rollback();
+      throw error;
+    } finally {
+      conn.release();
+    }
+    return (await DeviceCreditModel.findByDevice(deviceId))!;
+  }
+
+  static async recordReport(
+    deviceId: number,
+    balanceWh: number,
+    state: PrepaidState,
+    seq: number
+  ): Promise<void> {
+    await pool.execute(
+      `UPDATE device_credit
+       SET reported_balance_wh = ?, reported_state = ?, reported_seq = ?, reported_at = NOW()
+       WHERE device_id = ?`,
+      [balanceWh, state, seq, deviceId]
+    );
+  }
+
+  static async findTopups(deviceId: number, limit: number = 50): Promise<CreditTopup[]> {
+    const safeLimit = Math.max(1, Math.min(500, Math.floor(limit)));
+    const [rows] = await pool.execute<RowDataPacket[]>(
+      `SELECT * FROM credit_topups WHERE device_id = ? ORDER BY created_at DESC LIMIT ${safeLimit}`,
+      [deviceId]
+    );
+    return rows as CreditTopup[];
+  }
+}
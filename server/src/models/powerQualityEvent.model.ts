@@ -0,0 +1,61 @@
+import { pool } from '../database/connection';
+import { PowerQualityEvent, PowerQualityKind, PowerQualityCategory } from '../types/models';
+import { RowDataPacket, ResultSetHeader } from 'mysql2';
+
+export interface PowerQualityInsert {
+  kind: PowerQualityKind;
+  category: PowerQualityCategory;
+  startedAt: Date;
+  durationMs: number;
+  minVoltage: number;
+  maxVoltage: number;
+  meterSilent: boolean;
+}
+
+export class PowerQualityEventModel {
+  static async createMany(deviceId: number, events: PowerQualityInsert[]): Promise<number> {
+    if (events.length === 0) return 0;
+
+    const placeholders = events.map(() => '(?, ?, ?, ?, ?, ?, ?, ?)').join(', ');
+    const values = events.flatMap((e) => [
+      deviceId,
+      e.kind,
+      e.category,
+      e.startedAt,
+      e.durationMs,
+      e.minVoltage,
+      e.maxVoltage,
+      e.meterSilent,
+    ]);
+
+    const [result] = await pool.execute<ResultSetHeader>(
+      `INSERT INTO power_quality_events
+       (device_id, kind, category, started_at, duration_ms, min_voltage, max_voltage, meter_silent)
+       VALUES ${placeholders}`,
+      values
+    );
+
+    return result.affectedRows;
+  }
+
+  static async findByDeviceAndTimeRange(
+    deviceId: number,
+    startTime: Date,
+    endTime: Date,
+    limit: number = 100
+  ): Promise<PowerQualityEvent[]> {
+    const fmt = (d: Date) => d.toISOString().slice(0, 19).replace('T', ' ');
+    const safeLimit = Math.max(1, Math.min(1000, Math.floor(limit)));
+    const [rows] = await pool.execute<RowDataPacket[]>(
+      `SELECT id, device_id, kind, category, started_at, duration_ms,
+              min_voltage, max_voltage, meter_silent, created_at
+       FROM power_quality_events
+       WHERE device_id = ? AND started_at BETWEEN ? AND ?
+       ORDER BY started_at DESC
+       LIMIT ${safeLimit}`,
+      [deviceId, fmt(startTime), fmt(endTime)]
+    );
+
+    return rows as PowerQualityEvent[];
+  }
+}
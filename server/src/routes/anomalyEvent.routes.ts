@@ -1,9 +1,15 @@
 import { Router } from 'express';
 import * as anomalyEventController from '../controllers/anomalyEvent.controller';
+import * as anomalyModelController from '../controllers/anomalyModel.controller';
 import {
   anomalyEventValidator,
+  blackboxUploadValidator,
   resolveAnomalyValidator,
 } from '../validators/anomalyEvent.validators';
+import {
+  modelFlagUploadValidator,
+  reviewModelFlagValidator,
+} from '../validators/anomalyModel.validators';
 import { deviceIdParamValidator } from '../validators/device.validators';
 import { queryTimeRangeValidator } from '../validators/powerData.validators';
 import { validate } from '../middleware/validation.middleware';
@@ -20,6 +26,29 @@ router.post(
   anomalyEventController.submitAnomalyEvent
 );
 
+router.post(
+  '/blackbox',
+  authenticateApiKey,
+  deviceDataLimiter,
+  validate(blackboxUploadValidator),
+  anomalyEventController.submitBlackbox
+);
+
+router.post(
+  '/model-flags',
+  authenticateApiKey,
+  deviceDataLimiter,
+  validate(modelFlagUploadValidator),
+  anomalyModelController.submitModelFlag
+);
+
+router.get(
+  '/:id/blackbox',
+  authenticateJWT,
+  validate(resolveAnomalyValidator),
+  anomalyEventController.getAnomalyBlackbox
+);
+
 router.get(
   '/devices/:id/anomaly-events',
   authenticateJWT,
@@ -34,6 +63,13 @@ router.get(
   anomalyEventController.getUnresolvedAnomalies
 );
 
+router.get(
+  '/devices/:id/model-flags',
+  authenticateJWT,
+  validate([...deviceIdParamValidator, ...queryTimeRangeValidator]),
+  anomalyModelController.getModelFlags
+);
+
 router.put(
   '/:id/resolve',
   authenticateJWT,
@@ -43,6 +79,14 @@ router.put(
 
 import { requireAdmin } from '../middleware/auth.middleware';
 
+router.put(
+  '/model-flags/:id/review',
+  authenticateJWT,
+  requireAdmin,
+  validate(reviewModelFlagValidator),
+  anomalyModelController.reviewModelFlag
+);
+
 router.delete(
   '/devices/:id/by-type',
   authenticateJWT,
@@ -0,0 +1,28 @@
+import { Router } from 'express';
+import { authenticateJWT, authenticateApiKey, requireAdmin } from '../middleware/auth.middleware';
+import { validate } from '../middleware/validation.middleware';
+import { setAnomalyModelValidator } from '../validators/anomalyModel.validators';
+import {
+  getDeviceAnomalyModel,
+  getAnomalyModel,
+  setAnomalyModel,
+  deleteAnomalyModel,
+} from '../controllers/anomalyModel.controller';
+
+const router = Router();
+
+// ESP polls its scoring model (API key auth)
+router.get('/:id/anomaly-model', authenticateApiKey, getDeviceAnomalyModel);
+
+// Admin views, replaces or removes a device's model
+router.get('/:id/anomaly-model/admin', authenticateJWT, requireAdmin, getAnomalyModel);
+router.put(
+  '/:id/anomaly-model',
+  authenticateJWT,
+  requireAdmin,
+  validate(setAnomalyModelValidator),
+  setAnomalyModel
+);
+router.delete('/:id/anomaly-model', authenticateJWT, requireAdmin, deleteAnomalyModel);
+
+export default router;
@@ -0,0 +1,28 @@
+import { Router } from 'express';
+import { authenticateJWT, authenticateApiKey, requireAdmin } from '../middleware/auth.middleware';
+import { validate } from '../middleware/validation.middleware';
+import { setAnomalyRulesValidator } from '../validators/anomalyRules.validators';
+import {
+  getDeviceAnomalyRules,
+  getAnomalyRules,
+  setAnomalyRules,
+  deleteAnomalyRules,
+} from '../controllers/anomalyRules.controller';
+
+const router = Router();
+
+// ESP polls its rule table (API key auth)
+router.get('/:id/anomaly-rules', authenticateApiKey, getDeviceAnomalyRules);
+
+// Admin views, replaces or clears a device's rule table
+router.get('/:id/anomaly-rules/admin', authenticateJWT, requireAdmin, getAnomalyRules);
+router.put(
+  '/:id/anomaly-rules',
+  authenticateJWT,
+  requireAdmin,
+  validate(setAnomalyRulesValidator),
+  setAnomalyRules
+);
+router.delete('/:id/anomaly-rules', authenticateJWT, requireAdmin, deleteAnomalyRules);
+
+export default router;
@@ -0,0 +1,47 @@
+import { Router } from 'express';
+import * as applianceController from '../controllers/appliance.controller';
+import {
+  applianceEventUploadValidator,
+  applianceSummaryValidator,
+  applianceQueryValidator,
+  applianceLabelValidator,
+} from '../validators/appliance.validators';
+import { deviceIdParamValidator } from '../validators/device.validators';
+import { queryTimeRangeValidator } from '../validators/powerData.validators';
+import { validate } from '../middleware/validation.middleware';
+import { authenticateJWT, authenticateApiKey } from '../middleware/auth.middleware';
+import { deviceDataLimiter } from '../middleware/rateLimit.middleware';
+
+const router = Router();
+
+router.post(
+  '/',
+  authenticateApiKey,
+  deviceDataLimiter,
+  validate(applianceEventUploadValidator),
+  applianceController.submitApplianceEvents
+);
+
+router.post(
+  '/summary',
+  authenticateApiKey,
+  deviceDataLimiter,
+  validate(applianceSummaryValidator),
+  applianceController.submitApplianceSummary
+);
+
+router.get(
+  '/devices/:id',
+  authenticateJWT,
+  validate([...deviceIdParamValidator, ...queryTimeRangeValidator, ...applianceQueryValidator]),
+  applianceController.getDeviceAppliances
+);
+
+router.put(
+  '/devices/:id/appliances/:applianceId',
+  authenticateJWT,
+  validate(applianceLabelValidator),
+  applianceController.updateApplianceLabel
+);
+
+export default router;
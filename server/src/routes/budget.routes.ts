@@ -0,0 +1,35 @@
+import { Router } from 'express';
+import { authenticateJWT, authenticateApiKey, requireAdmin } from '../middleware/auth.middleware';
+import { validate } from '../middleware/validation.middleware';
+import { deviceIdParamValidator } from '../validators/device.validators';
+import { budgetReportValidator, budgetSettingsValidator } from '../validators/budget.validators';
+import {
+  getDeviceBudget,
+  getBudget,
+  updateBudget,
+  deleteBudget,
+} from '../controllers/budget.controller';
+
+const router = Router();
+
+// ESP reports its forecast and fetches the budget for the current period (API key auth)
+router.get('/:id/budget', authenticateApiKey, validate(budgetReportValidator), getDeviceBudget);
+
+// Owner or admin views the budget and last forecast; admin sets or removes it
+router.get('/:id/budget/status', authenticateJWT, validate(deviceIdParamValidator), getBudget);
+router.put(
+  '/:id/budget',
+  authenticateJWT,
+  requireAdmin,
+  validate(budgetSettingsValidator),
+  updateBudget
+);
+router.delete(
+  '/:id/budget',
+  authenticateJWT,
+  requireAdmin,
+  validate(deviceIdParamValidator),
+  deleteBudget
+);
+
+export default router;
@@ -0,0 +1,39 @@
+import { Router } from 'express';
+import { authenticateJWT, authenticateApiKey, requireAdmin } from '../middleware/auth.middleware';
+import { validate } from '../middleware/validation.middleware';
+import { deviceIdParamValidator } from '../validators/device.validators';
+import {
+  creditReportValidator,
+  creditSettingsValidator,
+  creditTopupValidator,
+} from '../validators/credit.validators';
+import {
+  getDeviceCredit,
+  getCredit,
+  updateCreditSettings,
+  topUpCredit,
+} from '../controllers/credit.controller';
+
+const router = Router();
+
+// ESP reports its balance and fetches the signed credit document (API key auth)
+router.get('/:id/credit', authenticateApiKey, validate(creditReportValidator), getDeviceCredit);
+
+// Owner or admin views the account; admin configures it and tops it up
+router.get('/:id/credit/status', authenticateJWT, validate(deviceIdParamValidator), getCredit);
+router.put(
+  '/:id/credit',
+  authenticateJWT,
+  requireAdmin,
+  validate(creditSettingsValidator),
+  updateCreditSettings
+);
+router.post(
+  '/:id/credit/topups',
+  authenticateJWT,
+  requireAdmin,
+  validate(creditTopupValidator),
+  topUpCredit
+);
+
+export default router;
@@ -4,6 +4,8 @@ import adminRoutes from './admin.routes';
 import deviceRoutes from './device.routes';
 import powerDataRoutes from './powerData.routes';
 import anomalyEventRoutes from './anomalyEvent.routes';
+import powerQualityRoutes from './powerQuality.routes';
+import applianceRoutes from './appliance.routes';
 import uploadRoutes from './upload.routes';
 import sseRoutes from './sse.routes';
 import padRoutes from './pad.routes';
@@ -11,6 +13,10 @@ import billingRoutes from './billing.routes';
 import paymentRoutes from './payment.routes';
 import reportsRoutes from './reports.routes';
 import relayCommandRoutes from './relayCommand.routes';
+import anomalyRulesRoutes from './anomalyRules.routes';
+import anomalyModelRoutes from './anomalyModel.routes';
+import creditRoutes from './credit.routes';
+import budgetRoutes from './budget.routes';
 import stayRoutes from './stay.routes';
 
 const router = Router();
@@ -19,8 +25,14 @@ router.use('/auth', authRoutes);
 router.use('/admin', adminRoutes);
 router.use('/devices', deviceRoutes);
 router.use('/devices', relayCommandRoutes); // /:id/relay-command
+router.use('/devices', anomalyRulesRoutes); // /:id/anomaly-rules
+router.use('/devices', anomalyModelRoutes); // /:id/anomaly-model
+router.use('/devices', creditRoutes); // /:id/credit
+router.use('/devices', budgetRoutes); // /:id/budget
 router.use('/power-data', powerDataRoutes);
 router.use('/anomaly-events', anomalyEventRoutes);
+router.use('/power-quality-events', powerQualityRoutes);
+router.use('/appliance-events', applianceRoutes);
 router.use('/upload', uploadRoutes);
 router.use('/sse', sseRoutes);
 router.use('/pads', padRoutes);
@@ -0,0 +1,27 @@
+import { Router } from 'express';
+import * as powerQualityController from '../controllers/powerQuality.controller';
+import { powerQualityUploadValidator } from '../validators/powerQuality.validators';
+import { deviceIdParamValidator } from '../validators/device.validators';
+import { queryTimeRangeValidator } from '../validators/powerData.validators';
+import { validate } from '../middleware/validation.middleware';
+import { authenticateJWT, authenticateApiKey } from '../middleware/auth.middleware';
+import { deviceDataLimiter } from '../middleware/rateLimit.middleware';
+
+const router = Router();
+
+router.post(
+  '/',
+  authenticateApiKey,
+  deviceDataLimiter,
+  validate(powerQualityUploadValidator),
+  powerQualityController.submitPowerQualityEvents
+);
+
+router.get(
+  '/devices/:id',
+  authenticateJWT,
+  validate([...deviceIdParamValidator, ...queryTimeRangeValidator]),
+  powerQualityController.getPowerQualityEvents
+);
+
+export default router;
@@ -0,0 +1,25 @@
+import { PadModel } from '../models/pad.model';
+import { StayModel } from '../models/stay.model';
+import { StayBillingService } from './stayBilling.service';
+
+const PHT_OFFSET_MS = 8 * 3600 * 1000;
+
+export class BudgetService {
+  /**
+   * Billing period a device's budget applies to: the active stay's cycle
+   * on the device's pad, else the calendar month in PHT.
+   */
+  static async currentPeriod(deviceId: number, now: Date): Promise<{ start: Date; end: Date }> {
+    const pad = await PadModel.findByDeviceId(deviceId);
+    const stay = pad ? await StayModel.findActiveByPad(pad.id) : null;
+    if (stay) return StayBillingService.currentCycle(stay, now);
+
+    const pht = new Date(now.getTime() + PHT_OFFSET_MS);
+    const y = pht.getUTCFullYear();
+    const m = pht.getUTCMonth();
+    return {
+      start: new Date(Date.UTC(y, m, 1) - PHT_OFFSET_MS),
+      end: new Date(Date.UTC(y, m + 1, 1) - PHT_OFFSET_MS),
+    };
+  }
+}
@@ -0,0 +1,49 @@
+import crypto from 'crypto';
+import { DeviceCredit } from '../types/models';
+
+export interface SignedCreditDocument {
+  seq: number;
+  enabled: boolean;
+  granted_wh: number;
+  tariff_milli: number; // currency thousandths per kWh
+  warn_low_wh: number;
+  warn_critical_wh: number;
+  sig: string;
+}
+
+export class CreditService {
+  /**
+   * Sign the credit document with the key the device authenticated with.
+   * The canonical form must match credit_sig_valid() in esp/main/src/http_client.c.
+   */
+  static signDocument(
+    deviceSerial: string,
+    credit: DeviceCredit,
+    apiKey: string
+  ): SignedCreditDocument {
+    const doc = {
+      seq: credit.seq,
+      enabled: credit.enabled,
+      granted_wh: credit.granted_wh,
+      tariff_milli: Math.round(credit.tariff_per_kwh * 1000),
+      warn_low_wh: credit.warn_low_wh,
+      warn_critical_wh: credit.warn_critical_wh,
+    };
+    const canonical = [
+      deviceSerial,
+      doc.seq,
+      doc.enabled ? 1 : 0,
+      doc.granted_wh,
+      doc.tariff_milli,
+      doc.warn_low_wh,
+      doc.warn_critical_wh,
+    ].join('|');
+    const sig = crypto.createHmac('sha256', apiKey).update(canonical).digest('hex');
+    return { ...doc, sig };
+  }
+
+  /** Energy a currency amount buys at the tariff */
+  static amountToWh(amount: number, tariffPerKwh: number): number {
+    return Math.floor((amount / tariffPerKwh) * 1000);
+  }
+}
@@ -81,6 +81,23 @@ export class StayBillingService {
     }
   }
 
+  /**
+   * Bounds of the billing cycle a stay is in at `now`, counted the same
+   * way billStay() counts completed cycles.
+   */
+  static currentCycle(stay: any, now: Date): { start: Date; end: Date } {
+    const checkIn: Date = new Date(stay.check_in_at);
+    const fullCycleDurationMs = cycleDurationMs(checkIn, stay.billing_cycle);
+    const completed = Math.max(
+      0,
+      Math.floor((now.getTime() - checkIn.getTime()) / fullCycleDurationMs)
+    );
+    return {
+      start: addCycles(checkIn, completed, stay.billing_cycle),
+      end: addCycles(checkIn, completed + 1, stay.billing_cycle),
+    };
+  }
+
   /**
    * Generate all missing bills for a single stay.
    * Returns the number of bills created.
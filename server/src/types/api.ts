@@ -36,6 +36,111 @@ export interface AnomalyEventRequest {
   voltage: number;
   power: number;
   relay_tripped: boolean;
+  trip_latency_us?: number; // reading → relay open, tripping onsets only
+  // Episode reporting (firmware with onset/update/clear)
+  episode_id?: number;
+  phase?: 'onset' | 'update' | 'clear';
+  metric?: string;
+  duration_ms?: number;
+  peak?: number;
+  min?: number;
+  integral?: number;
+}
+
+export interface BlackboxUploadRequest {
+  device_id: string;
+  reason: 'trip' | 'reset';
+  episode_id?: number;
+  anomaly_type?: string;
+  reset_reason?: number;
+  samples: number[][];
+}
+
+export interface PowerQualityRecord {
+  kind: 'sag' | 'swell' | 'interruption';
+  category: 'instantaneous' | 'momentary' | 'temporary' | 'sustained';
+  age_ms: number; // event start, ms before the upload
+  duration_ms: number;
+  min_voltage: number;
+  max_voltage: number;
+  meter_silent?: boolean;
+}
+
+export interface PowerQualityUploadRequest {
+  device_id: string;
+  events: PowerQualityRecord[];
+}
+
+export interface ModelFlagUploadRequest {
+  device_id: string;
+  model_version: number;
+  score: number;
+  threshold: number;
+  age_ms: number; // window start, ms before the upload
+  features: number[];
+  samples: number[][];
+}
+
+export interface ModelFlagReviewRequest {
+  review: 'fault' | 'normal';
+  note?: string;
+}
+
+export interface CreditSettingsRequest {
+  enabled?: boolean;
+  tariff_per_kwh?: number;
+  warn_low_kwh?: number;
+  warn_critical_kwh?: number;
+}
+
+// Exactly one of amount (currency, converted at the tariff) or energy_kwh
+export interface CreditTopupRequest {
+  amount?: number;
+  energy_kwh?: number;
+}
+
+export interface BudgetSettingsRequest {
+  budget_kwh: number;
+  warn_pct?: number;
+}
+
+export interface ApplianceEventRecord {
+  appliance_id: number; // 0 = matched no signature
+  edge: 'on' | 'off';
+  age_ms: number; // first reading of the step, ms before the upload
+  power_step: number;
+  reactive_step: number;
+  pf_step: number;
+  inrush_pct: number;
+  settle_ms: number;
+  new_signature?: boolean;
+  at_idle?: boolean;
+}
+
+export interface ApplianceEventUploadRequest {
+  device_id: string;
+  events: ApplianceEventRecord[];
+}
+
+export interface ApplianceSummaryRecord {
+  appliance_id: number;
+  power_step: number;
+  reactive_step: number;
+  inrush_pct: number;
+  edges: number;
+  trips: number;
+  running: number;
+  energy_wh: number;
+  run_seconds: number;
+}
+
+export interface ApplianceSummaryRequest {
+  device_id: string;
+  appliances: ApplianceSummaryRecord[];
+}
+
+export interface ApplianceLabelRequest {
+  label: string | null;
 }
 
 // Response types
@@ -65,12 +65,23 @@ export interface AnomalyEvent {
     | 'undervoltage'
     | 'overpower'
     | 'arc_fault'
-    | 'ground_fault';
+    | 'ground_fault'
+    | 'low_power_factor'
+    | 'frequency_deviation';
   severity: 'low' | 'medium' | 'high' | 'critical';
+  episode_id?: number;
+  phase?: AnomalyPhase;
+  metric?: string;
+  duration_ms?: number;
+  peak_value?: number;
+  min_value?: number;
+  integral_value?: number;
+  ended_at?: Date;
   current_value?: number;
   voltage_value?: number;
   power_value?: number;
   relay_tripped: boolean;
+  trip_latency_us?: number;
   is_resolved: boolean;
   resolved_at?: Date;
   resolved_by?: number;
@@ -78,6 +89,51 @@ export interface AnomalyEvent {
   created_at: Date;
 }
 
+export type AnomalyPhase = 'onset' | 'update' | 'clear';
+
+// Rollup the ESP sends with every report of an anomaly episode
+export interface AnomalyEpisodeRollup {
+  episode_id: number;
+  phase: AnomalyPhase;
+  metric?: string;
+  duration_ms: number;
+  peak?: number;
+  min?: number;
+  integral?: number;
+}
+
+// [ms relative to trip, channel, mA, 0.1 V, 0.1 W]; fast samples stop after 0.1 V
+// (after mA from firmware that polls current only)
+export type BlackboxSample = number[];
+
+export interface AnomalyBlackbox {
+  id: number;
+  device_id: number;
+  anomaly_event_id?: number;
+  episode_id?: number;
+  reason: 'trip' | 'reset';
+  reset_reason?: number;
+  sample_count: number;
+  samples: BlackboxSample[];
+  created_at: Date;
+}
+
+export type PowerQualityKind = 'sag' | 'swell' | 'interruption';
+export type PowerQualityCategory = 'instantaneous' | 'momentary' | 'temporary' | 'sustained';
+
+export interface PowerQualityEvent {
+  id: number;
+  device_id: number;
+  kind: PowerQualityKind;
+  category: PowerQualityCategory;
+  started_at: Date;
+  duration_ms: number;
+  min_voltage: number;
+  max_voltage: number;
+  meter_silent: boolean;
+  created_at: Date;
+}
+
 export interface Pad {
   id: number;
   name: string;
@@ -209,3 +265,171 @@ export interface PowerAggregateMonthly {
   anomaly_count: number;
   created_at: Date;
 }
+
+export interface AnomalyRule {
+  type:
+    | 'overcurrent'
+    | 'short_circuit'
+    | 'wire_fire'
+    | 'overvoltage'
+    | 'undervoltage'
+    | 'overpower'
+    | 'arc_fault'
+    | 'ground_fault'
+    | 'low_power_factor'
+    | 'frequency_deviation';
+  metric:
+    | 'current'
+    | 'voltage'
+    | 'power'
+    | 'power_alarm'
+    | 'power_rise'
+    | 'thermal'
+    | 'power_factor'
+    | 'frequency'
+    | 'rocof';
+  op: '>' | '<';
+  threshold: number;
+  confirm_ms?: number;
+  severity?: 'low' | 'medium' | 'high' | 'critical';
+  action?: 'log' | 'trip';
+  min_power?: number;
+  max_current?: number; // power_rise: A above which a rise is left to overcurrent
+  k?: number; // thermal: trip constant, A²s
+  cool_ms?: number; // thermal: cooling time constant
+  min_current?: number; // power_factor: A below which PF is ignored
+  window_ms?: number; // rocof: span df/dt is measured over
+}
+
+export interface DeviceAnomalyRules {
+  device_id: number;
+  version: number;
+  rules: AnomalyRule[];
+  updated_by?: number;
+  updated_at: Date;
+}
+
+// int8 autoencoder in firmware feature order; w1 is n_hidden × features,
+// w2 is features × n_hidden, both row-major
+export interface AnomalyModelDoc {
+  features: number;
+  n_hidden: number;
+  shift1: number;
+  shift2: number;
+  threshold: number;
+  confirm: number;
+  center: number[];
+  mult: number[];
+  w1: number[];
+  b1: number[];
+  w2: number[];
+  b2: number[];
+}
+
+export interface DeviceAnomalyModel {
+  device_id: number;
+  version: number;
+  model: AnomalyModelDoc;
+  updated_by?: number;
+  updated_at: Date;
+}
+
+export type AnomalyModelReview = 'fault' | 'normal';
+
+// [dt_ms, 0.1 V, mA, 0.1 W, 0.01 PF, 0.1 Hz]
+export type AnomalyModelSample = number[];
+
+export interface AnomalyModelFlag {
+  id: number;
+  device_id: number;
+  model_version: number;
+  score: number;
+  threshold: number;
+  window_start: Date;
+  features: number[];
+  samples: AnomalyModelSample[];
+  review?: AnomalyModelReview;
+  review_note?: string;
+  reviewed_by?: number;
+  reviewed_at?: Date;
+  created_at: Date;
+}
+
+export type PrepaidState = 'disabled' | 'ok' | 'low' | 'critical' | 'exhausted';
+
+export interface DeviceCredit {
+  device_id: number;
+  enabled: boolean;
+  seq: number;
+  granted_wh: number; // cumulative top-ups
+  tariff_per_kwh: number;
+  warn_low_wh: number;
+  warn_critical_wh: number;
+  reported_balance_wh?: number;
+  reported_state?: PrepaidState;
+  reported_seq?: number;
+  reported_at?: Date;
+  updated_by?: number;
+  updated_at: Date;
+}
+
+export interface CreditTopup {
+  id: number;
+  device_id: number;
+  energy_wh: number;
+  amount?: number;
+  tariff_per_kwh: number;
+  seq: number;
+  created_by?: number;
+  created_at: Date;
+}
+
+export type ForecastState = 'none' | 'ok' | 'warning' | 'over' | 'exceeded';
+
+export interface DeviceBudget {
+  device_id: number;
+  seq: number;
+  budget_kwh: number;
+  warn_pct: number;
+  reported_state?: ForecastState;
+  reported_used_wh?: number;
+  reported_projected_wh?: number;
+  reported_learned?: number;
+  reported_at?: Date;
+  updated_by?: number;
+  updated_at: Date;
+}
+
+export type ApplianceEdge = 'on' | 'off';
+
+export interface DeviceAppliance {
+  device_id: number;
+  appliance_id: number;
+  label?: string;
+  power_step: number;
+  reactive_step: number;
+  inrush_pct: number;
+  edges: number;
+  trips: number;
+  running: number;
+  energy_wh: number;
+  run_seconds: number;
+  first_seen_at: Date;
+  reported_at?: Date;
+}
+
+export interface ApplianceEvent {
+  id: number;
+  device_id: number;
+  appliance_id?: number;
+  edge: ApplianceEdge;
+  occurred_at: Date;
+  power_step: number;
+  reactive_step: number;
+  pf_step: number;
+  inrush_pct: number;
+  settle_ms: number;
+  new_signature: boolean;
+  at_idle: boolean;
+  created_at: Date;
+}
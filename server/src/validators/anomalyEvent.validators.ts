@@ -1,5 +1,5 @@
 import { body, param } from 'express-validator';
-import { ANOMALY_TYPES } from '../config/constants';
+import { ANOMALY_TYPES, ANOMALY_PHASES, BLACKBOX_MAX_SAMPLES } from '../config/constants';
 
 export const anomalyEventValidator = [
   body('device_id').trim().notEmpty().withMessage('Device ID is required'),
@@ -12,8 +12,42 @@ export const anomalyEventValidator = [
   body('voltage').isFloat({ min: 0 }).withMessage('Voltage must be a positive number'),
   body('power').isFloat({ min: 0 }).withMessage('Power must be a positive number'),
   body('relay_tripped').isBoolean().withMessage('Relay tripped must be a boolean'),
+  body('trip_latency_us')
+    .optional()
+    .isInt({ min: 0 })
+    .withMessage('Trip latency must be a positive integer'),
+  body('episode_id')
+    .optional()
+    .isInt({ min: 1 })
+    .withMessage('Episode ID must be a positive integer'),
+  body('phase')
+    .optional()
+    .isIn(ANOMALY_PHASES)
+    .withMessage(`Phase must be one of: ${ANOMALY_PHASES.join(', ')}`),
+  body('duration_ms')
+    .optional()
+    .isInt({ min: 0 })
+    .withMessage('Duration must be a positive integer'),
+  body(['peak', 'min', 'integral'])
+    .optional()
+    .isFloat()
+    .withMessage('Episode rollup values must be numbers'),
 ];
 
 export const resolveAnomalyValidator = [
   param('id').isInt({ min: 1 }).withMessage('Valid anomaly event ID is required'),
 ];
+
+export const blackboxUploadValidator = [
+  body('device_id').trim().notEmpty().withMessage('Device ID is required'),
+  body('reason').isIn(['trip', 'reset']).withMessage('Reason must be trip or reset'),
+  body('episode_id')
+    .optional()
+    .isInt({ min: 1 })
+    .withMessage('Episode ID must be a positive integer'),
+  body('reset_reason').optional().isInt({ min: 0, max: 255 }),
+  body('samples').isArray({ max: BLACKBOX_MAX_SAMPLES }).withMessage('Samples must be an array'),
+  body('samples.*')
+    .isArray({ min: 3, max: 5 })
+    .withMessage('Each sample is [dt_ms, channel, mA(, dV, dW)]'),
+];
@@ -0,0 +1,74 @@
+import { body, param } from 'express-validator';
+import {
+  ANOMALY_MODEL_FEATURES,
+  ANOMALY_MODEL_MAX_HIDDEN,
+  ANOMALY_MODEL_FLAG_REVIEWS,
+  ANOMALY_MODEL_MAX_SAMPLES,
+} from '../config/constants';
+
+const INT32_MAX = 2147483647;
+const F = ANOMALY_MODEL_FEATURES;
+
+// Array of exactly `len(req)` integers within [min, max]
+const intArray = (field: string, len: (hidden: number) => number, min: number, max: number) =>
+  body(field).custom((value, { req }) => {
+    const n = len(Number(req.body.model?.n_hidden));
+    if (!Array.isArray(value) || value.length !== n) {
+      throw new Error(`${field} must be an array of ${n} integers`);
+    }
+    if (!value.every((v) => Number.isInteger(v) && v >= min && v <= max)) {
+      throw new Error(`${field} entries must be integers in ${min}–${max}`);
+    }
+    return true;
+  });
+
+export const setAnomalyModelValidator = [
+  param('id').isInt({ min: 1 }).withMessage('Valid device ID is required'),
+  body('model.features')
+    .isInt({ min: F, max: F })
+    .withMessage(`model.features must be ${F} (firmware feature set)`),
+  body('model.n_hidden')
+    .isInt({ min: 1, max: ANOMALY_MODEL_MAX_HIDDEN })
+    .withMessage(`model.n_hidden must be 1–${ANOMALY_MODEL_MAX_HIDDEN}`),
+  body('model.shift1').isInt({ min: 0, max: 24 }).withMessage('model.shift1 must be 0–24'),
+  body('model.shift2').isInt({ min: 0, max: 24 }).withMessage('model.shift2 must be 0–24'),
+  body('model.threshold')
+    .isInt({ min: 1, max: 4294967295 })
+    .withMessage('model.threshold must be a positive integer'),
+  body('model.confirm').isInt({ min: 1, max: 255 }).withMessage('model.confirm must be 1–255'),
+  intArray('model.center', () => F, -INT32_MAX, INT32_MAX),
+  intArray('model.mult', () => F, -INT32_MAX, INT32_MAX),
+  intArray('model.w1', (h) => h * F, -128, 127),
+  intArray('model.b1', (h) => h, -(INT32_MAX >> 1), INT32_MAX >> 1),
+  intArray('model.w2', (h) => F * h, -128, 127),
+  intArray('model.b2', () => F, -(INT32_MAX >> 1), INT32_MAX >> 1),
+];
+
+export const modelFlagUploadValidator = [
+  body('device_id').trim().notEmpty().withMessage('Device ID is required'),
+  body('model_version').isInt({ min: 1 }).withMessage('model_version must be >= 1'),
+  body('score').isInt({ min: 0 }).withMessage('score must be >= 0'),
+  body('threshold').isInt({ min: 1 }).withMessage('threshold must be >= 1'),
+  body('age_ms').isInt({ min: 0 }).withMessage('age_ms must be >= 0'),
+  body('features')
+    .isArray({ min: F, max: F })
+    .withMessage(`features must be an array of ${F} numbers`),
+  body('samples')
+    .isArray({ max: ANOMALY_MODEL_MAX_SAMPLES })
+    .withMessage('Samples must be an array'),
+  body('samples.*')
+    .isArray({ min: 6, max: 6 })
+    .withMessage('Each sample is [dt_ms, dV, mA, dW, PF%, dHz]'),
+];
+
+export const reviewModelFlagValidator = [
+  param('id').isInt({ min: 1 }).withMessage('Valid flag ID is required'),
+  body('review')
+    .isIn(ANOMALY_MODEL_FLAG_REVIEWS)
+    .withMessage(`review must be one of: ${ANOMALY_MODEL_FLAG_REVIEWS.join(', ')}`),
+  body('note')
+    .optional()
+    .isString()
+    .isLength({ max: 255 })
+    .withMessage('note must be at most 255 characters'),
+];
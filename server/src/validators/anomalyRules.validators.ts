@@ -0,0 +1,42 @@
+import { body, param } from 'express-validator';
+import { ANOMALY_TYPES, ANOMALY_RULE_METRICS, ANOMALY_RULE_MAX } from '../config/constants';
+
+export const setAnomalyRulesValidator = [
+  param('id').isInt({ min: 1 }).withMessage('Valid device ID is required'),
+  body('rules')
+    .isArray({ min: 1, max: ANOMALY_RULE_MAX })
+    .withMessage(`Rules must be an array of 1–${ANOMALY_RULE_MAX} entries`),
+  body('rules.*.type')
+    .toLowerCase()
+    .isIn(ANOMALY_TYPES)
+    .withMessage(`Rule type must be one of: ${ANOMALY_TYPES.join(', ')}`),
+  body('rules.*.metric')
+    .isIn(ANOMALY_RULE_METRICS)
+    .withMessage(`Rule metric must be one of: ${ANOMALY_RULE_METRICS.join(', ')}`),
+  body('rules.*.op').isIn(['>', '<']).withMessage('Rule op must be > or <'),
+  body('rules.*.threshold').isFloat({ min: 0 }).withMessage('Rule threshold must be >= 0'),
+  body('rules.*.confirm_ms')
+    .optional()
+    .isInt({ min: 0, max: 65535 })
+    .withMessage('confirm_ms must be 0–65535'),
+  body('rules.*.severity')
+    .optional()
+    .isIn(['low', 'medium', 'high', 'critical'])
+    .withMessage('Severity must be low, medium, high, or critical'),
+  body('rules.*.action').optional().isIn(['log', 'trip']).withMessage('Action must be log or trip'),
+  body('rules.*.min_power').optional().isFloat({ min: 0 }).withMessage('min_power must be >= 0'),
+  body('rules.*.max_current')
+    .optional()
+    .isFloat({ min: 0 })
+    .withMessage('max_current must be >= 0'),
+  body('rules.*.k').optional().isFloat({ gt: 0 }).withMessage('k must be > 0'),
+  body('rules.*.cool_ms').optional().isInt({ min: 1 }).withMessage('cool_ms must be >= 1'),
+  body('rules.*.min_current')
+    .optional()
+    .isFloat({ min: 0 })
+    .withMessage('min_current must be >= 0'),
+  body('rules.*.window_ms')
+    .optional()
+    .isInt({ min: 1, max: 60000 })
+    .withMessage('window_ms must be 1–60000'),
+];
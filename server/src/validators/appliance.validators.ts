@@ -0,0 +1,72 @@
+import { body, param, query } from 'express-validator';
+import {
+  APPLIANCE_EDGES,
+  APPLIANCE_MAX_EVENTS_PER_POST,
+  APPLIANCE_MAX_SIGNATURES,
+} from '../config/constants';
+
+export const applianceEventUploadValidator = [
+  body('device_id').trim().notEmpty().withMessage('Device ID is required'),
+  body('events')
+    .isArray({ min: 1, max: APPLIANCE_MAX_EVENTS_PER_POST })
+    .withMessage(`Events must be an array of 1–${APPLIANCE_MAX_EVENTS_PER_POST} records`),
+  body('events.*.appliance_id')
+    .isInt({ min: 0, max: 65535 })
+    .withMessage('appliance_id must be 0–65535'),
+  body('events.*.edge')
+    .isIn(APPLIANCE_EDGES)
+    .withMessage(`Edge must be one of: ${APPLIANCE_EDGES.join(', ')}`),
+  body(['events.*.age_ms', 'events.*.inrush_pct', 'events.*.settle_ms'])
+    .isInt({ min: 0 })
+    .withMessage('age_ms, inrush_pct and settle_ms must be non-negative integers'),
+  body(['events.*.power_step', 'events.*.reactive_step'])
+    .isFloat()
+    .withMessage('Steps must be numbers'),
+  body('events.*.pf_step')
+    .isFloat({ min: -1, max: 1 })
+    .withMessage('pf_step must be between -1 and 1'),
+  body(['events.*.new_signature', 'events.*.at_idle']).optional().isBoolean(),
+];
+
+export const applianceSummaryValidator = [
+  body('device_id').trim().notEmpty().withMessage('Device ID is required'),
+  body('appliances')
+    .isArray({ min: 1, max: APPLIANCE_MAX_SIGNATURES })
+    .withMessage(`Appliances must be an array of 1–${APPLIANCE_MAX_SIGNATURES} records`),
+  body('appliances.*.appliance_id')
+    .isInt({ min: 1, max: 65535 })
+    .withMessage('appliance_id must be 1–65535'),
+  body(['appliances.*.power_step', 'appliances.*.reactive_step'])
+    .isFloat()
+    .withMessage('Steps must be numbers'),
+  body([
+    'appliances.*.inrush_pct',
+    'appliances.*.edges',
+    'appliances.*.trips',
+    'appliances.*.running',
+    'appliances.*.run_seconds',
+  ])
+    .isInt({ min: 0 })
+    .withMessage('Counters must be non-negative integers'),
+  body('appliances.*.energy_wh')
+    .isFloat({ min: 0 })
+    .withMessage('energy_wh must be a non-negative number'),
+];
+
+export const applianceQueryValidator = [
+  query('appliance_id')
+    .optional()
+    .isInt({ min: 1, max: 65535 })
+    .withMessage('appliance_id must be 1–65535'),
+];
+
+export const applianceLabelValidator = [
+  param('id').isInt({ min: 1 }).withMessage('Valid device ID is required'),
+  param('applianceId').isInt({ min: 1, max: 65535 }).withMessage('Valid appliance ID is required'),
+  body('label')
+    .optional({ nullable: true })
+    .isString()
+    .trim()
+    .isLength({ min: 1, max: 64 })
+    .withMessage('label must be 1–64 characters, or null to clear it'),
+];
@@ -0,0 +1,21 @@
+import { body, param, query } from 'express-validator';
+import { FORECAST_STATES } from '../config/constants';
+
+export const budgetReportValidator = [
+  query('period_start').optional().isInt({ min: 0 }).withMessage('period_start must be >= 0'),
+  query('state')
+    .optional()
+    .isIn(FORECAST_STATES)
+    .withMessage(`state must be one of: ${FORECAST_STATES.join(', ')}`),
+  query('used_wh').optional().isInt().withMessage('used_wh must be an integer'),
+  query('projected_wh').optional().isInt().withMessage('projected_wh must be an integer'),
+  query('learned').optional().isInt({ min: 0, max: 168 }).withMessage('learned must be 0-168'),
+];
+
+export const budgetSettingsValidator = [
+  param('id').isInt({ min: 1 }).withMessage('Valid device ID is required'),
+  body('budget_kwh')
+    .isFloat({ gt: 0, max: 4294967 })
+    .withMessage('budget_kwh must be > 0 and at most 4294967'),
+  body('warn_pct').optional().isInt({ min: 1, max: 100 }).withMessage('warn_pct must be 1-100'),
+];
@@ -0,0 +1,37 @@
+import { body, param, query } from 'express-validator';
+import { PREPAID_STATES } from '../config/constants';
+
+export const creditReportValidator = [
+  query('seq').optional().isInt({ min: 0 }).withMessage('seq must be >= 0'),
+  query('state')
+    .optional()
+    .isIn(PREPAID_STATES)
+    .withMessage(`state must be one of: ${PREPAID_STATES.join(', ')}`),
+  query('balance_wh').optional().isInt().withMessage('balance_wh must be an integer'),
+];
+
+export const creditSettingsValidator = [
+  param('id').isInt({ min: 1 }).withMessage('Valid device ID is required'),
+  body('enabled').optional().isBoolean().withMessage('enabled must be a boolean'),
+  body('tariff_per_kwh')
+    .optional()
+    .isFloat({ gt: 0, max: 999999 })
+    .withMessage('tariff_per_kwh must be > 0'),
+  body('warn_low_kwh').optional().isFloat({ min: 0 }).withMessage('warn_low_kwh must be >= 0'),
+  body('warn_critical_kwh')
+    .optional()
+    .isFloat({ min: 0 })
+    .withMessage('warn_critical_kwh must be >= 0'),
+];
+
+export const creditTopupValidator = [
+  param('id').isInt({ min: 1 }).withMessage('Valid device ID is required'),
+  body('amount').optional().isFloat({ gt: 0 }).withMessage('amount must be > 0'),
+  body('energy_kwh').optional().isFloat({ gt: 0 }).withMessage('energy_kwh must be > 0'),
+  body().custom((value) => {
+    if ((value.amount === undefined) === (value.energy_kwh === undefined)) {
+      throw new Error('Give exactly one of amount or energy_kwh');
+    }
+    return true;
+  }),
+];
@@ -0,0 +1,22 @@
+import { body } from 'express-validator';
+import { PQ_KINDS, PQ_CATEGORIES, PQ_MAX_EVENTS_PER_POST } from '../config/constants';
+
+export const powerQualityUploadValidator = [
+  body('device_id').trim().notEmpty().withMessage('Device ID is required'),
+  body('events')
+    .isArray({ min: 1, max: PQ_MAX_EVENTS_PER_POST })
+    .withMessage(`Events must be an array of 1–${PQ_MAX_EVENTS_PER_POST} records`),
+  body('events.*.kind')
+    .isIn(PQ_KINDS)
+    .withMessage(`Kind must be one of: ${PQ_KINDS.join(', ')}`),
+  body('events.*.category')
+    .isIn(PQ_CATEGORIES)
+    .withMessage(`Category must be one of: ${PQ_CATEGORIES.join(', ')}`),
+  body(['events.*.age_ms', 'events.*.duration_ms'])
+    .isInt({ min: 0 })
+    .withMessage('age_ms and duration_ms must be non-negative integers'),
+  body(['events.*.min_voltage', 'events.*.max_voltage'])
+    .isFloat({ min: 0 })
+    .withMessage('Voltages must be non-negative numbers'),
+  body('events.*.meter_silent').optional().isBoolean(),
+];